@@ -0,0 +1,159 @@
+/*
+* intrade-bar-api-cpp - C ++ API client for intrade.bar
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#include <iostream>
+#include <fstream>
+#include <functional>
+#include "intrade-bar-common.hpp"
+#include "intrade-bar-candle-store.hpp"
+#include "xquotes_history.hpp"
+
+#define PROGRAM_VERSION "1.0"
+#define PROGRAM_DATE    "19.10.2026"
+
+using namespace std;
+
+/* обработать все аргументы */
+bool process_arguments(
+    const int argc,
+    char **argv,
+    std::function<void(
+        const std::string &key,
+        const std::string &value)> f) noexcept {
+    if(argc <= 1) return false;
+    bool is_error = true;
+    for(int i = 1; i < argc; ++i) {
+        std::string key = std::string(argv[i]);
+        if(key.size() > 0 && (key[0] == '-' || key[0] == '/')) {
+            uint32_t delim_offset = 0;
+            if(key.size() > 2 && (key.substr(2) == "--") == 0) delim_offset = 1;
+            std::string value;
+            if((i + 1) < argc) value = std::string(argv[i + 1]);
+            is_error = false;
+            f(key.substr(delim_offset), value);
+        }
+    }
+    return !is_error;
+}
+
+inline bool check_file(const std::string &file_name) {
+    std::ifstream file(file_name);
+    return (bool)file;
+}
+
+int main(int argc, char **argv) {
+    std::cout << "intrade.bar candle store converter" << std::endl;
+    std::cout
+        << "version: " << PROGRAM_VERSION
+        << " date: " << PROGRAM_DATE
+        << std::endl << std::endl;
+
+    bool is_to_qhs5 = false;    // конвертировать из колоночного хранилища в qhs5
+    std::string path_qhs5;
+    std::string path_store;
+    std::string symbol_name;
+
+    if(!process_arguments(
+            argc,
+            argv,
+            [&](
+                const std::string &key,
+                const std::string &value){
+        if(key == "path_qhs5" || key == "pq") {
+            path_qhs5 = value;
+        } else
+        if(key == "path_store" || key == "ps") {
+            path_store = value;
+        } else
+        if(key == "symbol" || key == "s") {
+            symbol_name = value;
+        } else
+        if(key == "to_qhs5") {
+            is_to_qhs5 = true;
+        } else
+        if(key == "to_store") {
+            is_to_qhs5 = false;
+        }
+    })) {
+        std::cerr << "Error! No parameters!" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if(path_qhs5.empty() || path_store.empty()) {
+        std::cerr << "parameter error: path_qhs5 and path_store are required" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "path qhs5: " << path_qhs5 << std::endl;
+    std::cout << "path store: " << path_store << std::endl;
+    std::cout << "direction: " << (is_to_qhs5 ? "store -> qhs5" : "qhs5 -> store") << std::endl << std::endl;
+
+    uint32_t number_errors = 0;
+    for(uint32_t symbol = 0; symbol < intrade_bar_common::CURRENCY_PAIRS; ++symbol) {
+        const std::string &name = intrade_bar_common::currency_pairs[symbol];
+        if(!symbol_name.empty() && symbol_name != name) continue;
+
+        const std::string file_name_qhs5 = path_qhs5 + "/" + name + ".qhs5";
+        const std::string file_name_store = path_store + "/" + name + ".ibcs";
+        if(!check_file(is_to_qhs5 ? file_name_store : file_name_qhs5)) continue;
+
+        xquotes_history::QuotesHistory<> hist(
+            file_name_qhs5,
+            xquotes_history::PRICE_OHLCV,
+            xquotes_history::USE_COMPRESSION);
+        intrade_bar::CandleStore store(file_name_store, intrade_bar_common::pricescale_currency_pairs[symbol]);
+
+        xtime::timestamp_t min_timestamp = 0, max_timestamp = 0;
+        int err = is_to_qhs5 ?
+            store.get_min_max_day_timestamp(min_timestamp, max_timestamp) :
+            hist.get_min_max_day_timestamp(min_timestamp, max_timestamp);
+        if(err != intrade_bar_common::OK) {
+            std::cout << name << ": no data" << std::endl;
+            continue;
+        }
+
+        uint32_t number_days = 0;
+        std::array<xquotes_common::Candle, xtime::MINUTES_IN_DAY> candles;
+        for(xtime::timestamp_t t = min_timestamp; t <= max_timestamp; t += xtime::SECONDS_IN_DAY) {
+            err = is_to_qhs5 ? store.get_candles(candles, t) : hist.get_candles(candles, t);
+            /* дни без данных пропускаем, в колоночном хранилище они все равно займут место */
+            if(err != intrade_bar_common::OK) continue;
+            err = is_to_qhs5 ? hist.write_candles(candles, t) : store.write_candles(candles, t);
+            if(err != intrade_bar_common::OK) {
+                std::cerr << name << ": write error " << err << " date " << xtime::get_str_date(t) << std::endl;
+                ++number_errors;
+                continue;
+            }
+            ++number_days;
+        }
+        if(is_to_qhs5) hist.save();
+        std::cout << name << ": " << number_days << " days" << std::endl;
+    }
+
+    if(number_errors != 0) {
+        std::cerr << "errors: " << number_errors << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "ok" << std::endl;
+    return EXIT_SUCCESS;
+}
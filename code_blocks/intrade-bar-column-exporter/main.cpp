@@ -0,0 +1,153 @@
+/*
+* intrade-bar-api-cpp - C ++ API client for intrade.bar
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#include <iostream>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <atomic>
+#include <vector>
+#include "intrade-bar-common.hpp"
+#include "intrade-bar-column-exporter.hpp"
+#include "xquotes_history.hpp"
+
+#define PROGRAM_VERSION "1.0"
+#define PROGRAM_DATE    "19.10.2026"
+
+using namespace std;
+
+/* обработать все аргументы */
+bool process_arguments(
+    const int argc,
+    char **argv,
+    std::function<void(
+        const std::string &key,
+        const std::string &value)> f) noexcept {
+    if(argc <= 1) return false;
+    bool is_error = true;
+    for(int i = 1; i < argc; ++i) {
+        std::string key = std::string(argv[i]);
+        if(key.size() > 0 && (key[0] == '-' || key[0] == '/')) {
+            uint32_t delim_offset = 0;
+            if(key.size() > 2 && (key.substr(2) == "--") == 0) delim_offset = 1;
+            std::string value;
+            if((i + 1) < argc) value = std::string(argv[i + 1]);
+            is_error = false;
+            f(key.substr(delim_offset), value);
+        }
+    }
+    return !is_error;
+}
+
+inline bool check_file(const std::string &file_name) {
+    std::ifstream file(file_name);
+    return (bool)file;
+}
+
+int main(int argc, char **argv) {
+    std::cout << "intrade.bar column exporter" << std::endl;
+    std::cout
+        << "version: " << PROGRAM_VERSION
+        << " date: " << PROGRAM_DATE
+        << std::endl << std::endl;
+
+    uint32_t max_threads = 4;   // количество символов, которые экспортируются одновременно
+    std::string path_qhs5;
+    std::string path_export;
+    std::string symbol_name;
+
+    if(!process_arguments(
+            argc,
+            argv,
+            [&](
+                const std::string &key,
+                const std::string &value){
+        if(key == "path_qhs5" || key == "pq") {
+            path_qhs5 = value;
+        } else
+        if(key == "path_export" || key == "pe") {
+            path_export = value;
+        } else
+        if(key == "symbol" || key == "s") {
+            symbol_name = value;
+        } else
+        if(key == "max_threads" || key == "mt") {
+            max_threads = std::max(1, atoi(value.c_str()));
+        }
+    })) {
+        std::cerr << "Error! No parameters!" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if(path_qhs5.empty() || path_export.empty()) {
+        std::cerr << "parameter error: path_qhs5 and path_export are required" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "path qhs5: " << path_qhs5 << std::endl;
+    std::cout << "path export: " << path_export << std::endl << std::endl;
+
+    std::vector<uint32_t> symbols;
+    for(uint32_t symbol = 0; symbol < intrade_bar_common::CURRENCY_PAIRS; ++symbol) {
+        const std::string &name = intrade_bar_common::currency_pairs[symbol];
+        if(!symbol_name.empty() && symbol_name != name) continue;
+        if(!check_file(path_qhs5 + "/" + name + ".qhs5")) continue;
+        symbols.push_back(symbol);
+    }
+
+    /* каждый символ экспортирует один поток, день за днем */
+    std::atomic<uint32_t> next_symbol = ATOMIC_VAR_INIT(0);
+    std::atomic<uint32_t> number_errors = ATOMIC_VAR_INIT(0);
+    std::vector<std::future<void>> workers;
+    for(uint32_t w = 0; w < std::min(max_threads, (uint32_t)symbols.size()); ++w) {
+        workers.push_back(std::async(std::launch::async, [&]() {
+            uint32_t index = 0;
+            while((index = next_symbol++) < symbols.size()) {
+                const uint32_t symbol = symbols[index];
+                const std::string &name = intrade_bar_common::currency_pairs[symbol];
+                xquotes_history::QuotesHistory<> hist(
+                    path_qhs5 + "/" + name + ".qhs5",
+                    xquotes_history::PRICE_OHLCV,
+                    xquotes_history::USE_COMPRESSION);
+                intrade_bar::ColumnExporter exporter(path_export, name, intrade_bar_common::pricescale_currency_pairs[symbol]);
+                const int err = exporter.export_history(hist);
+                if(err != intrade_bar_common::OK) {
+                    intrade_bar_common::PrintThread{} << name << ": export error " << err << std::endl;
+                    ++number_errors;
+                    continue;
+                }
+                intrade_bar_common::PrintThread{} << name << ": " << exporter.get_rows() << " rows" << std::endl;
+            }
+        }));
+    }
+    for(size_t w = 0; w < workers.size(); ++w) {
+        workers[w].wait();
+    }
+
+    if(number_errors != 0) {
+        std::cerr << "errors: " << number_errors << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "ok" << std::endl;
+    return EXIT_SUCCESS;
+}
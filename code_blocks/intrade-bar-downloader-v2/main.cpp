@@ -22,7 +22,11 @@
 * SOFTWARE.
 */
 #include <iostream>
+#include "intrade-bar-api.hpp"
 #include "intrade-bar-https-api.hpp"
+#include "intrade-bar-history-downloader.hpp"
+#include "intrade-bar-history-manifest.hpp"
+#include "intrade-bar-column-exporter.hpp"
 #include "xquotes_history.hpp"
 #include <cstdlib>
 #include <csignal>
@@ -32,6 +36,12 @@
 
 using namespace std;
 
+std::atomic<bool> is_daemon_stop = ATOMIC_VAR_INIT(false);
+
+void signal_handler_stop(int signal) {
+    is_daemon_stop = true;
+}
+
 void signal_handler_abnormal(int signal) {
     std::cerr << "abnormal termination condition, as is e.g. initiated by std::abort(), code: " << signal << '\n';
     std::cerr << "Delete the quotes store and download it again!" << std::endl;
@@ -89,15 +99,22 @@ int main(int argc, char **argv) {
     bool is_only_broker_supported_currency_pairs = false; // Загружать только поддерживаемые брокером валютные пары
     uint32_t price_type = intrade_bar_common::FXCM_USE_HIST_QUOTES_BID_ASK_DIV2;
     uint32_t check_last_days = 0;
+    uint32_t days_per_task = 5;
+    uint32_t history_max_bars = 10000; // максимальное количество баров в одном ответе сервера
+    uint32_t max_threads = 8;       // максимальное количество одновременных запросов
+    bool is_daemon = false;         // после загрузки продолжать обновлять хранилище каждую минуту
+    uint32_t daemon_history_period = 60; // период проверки исторических данных в режиме демона, минуты
 
     std::string point("1.intrade.bar");
     std::string json_file;
     std::string path_store;
+    std::string path_export;       // директория для экспорта колонок, пусто - без экспорта
     std::string environmental_variable;
     std::string sert_file("curl-ca-bundle.crt");
     std::string cookie_file("intrade-bar.cookie");
     std::string file_name_bets_log("logger/intrade-bar-bets.log");
     std::string file_name_work_log("logger/intrade-bar-https-work.log");
+    std::string file_name_websocket_log("logger/intrade-bar-websocket.log");
 
     if(!process_arguments(
             argc,
@@ -114,6 +131,9 @@ int main(int argc, char **argv) {
         if(key == "path_store" || key == "path_storage" || key == "ps") {
             path_store = value;
         } else
+        if(key == "path_export" || key == "pe") {
+            path_export = value;
+        } else
         if(key == "use_day_off" || key == "udo") {
             is_use_day_off = true;
         } else
@@ -147,6 +167,21 @@ int main(int argc, char **argv) {
         } else
         if(key == "check_last_days" || key == "cld") {
             check_last_days = atoi(value.c_str());
+        } else
+        if(key == "max_threads" || key == "mt") {
+            max_threads = std::max(1, atoi(value.c_str()));
+        } else
+        if(key == "days_per_task" || key == "dpt") {
+            days_per_task = std::max(1, atoi(value.c_str()));
+        } else
+        if(key == "history_max_bars" || key == "hmb") {
+            history_max_bars = std::max(2, atoi(value.c_str()));
+        } else
+        if(key == "daemon" || key == "dm") {
+            is_daemon = true;
+        } else
+        if(key == "daemon_history_period" || key == "dhp") {
+            daemon_history_period = std::max(1, atoi(value.c_str()));
         }
     })) {
         std::cerr << "Error! No parameters!" << std::endl;
@@ -176,6 +211,8 @@ int main(int argc, char **argv) {
             //
             if(auth_json["path_store"] != nullptr)
                 path_store = auth_json["path_store"];
+            if(auth_json["path_export"] != nullptr)
+                path_export = auth_json["path_export"];
             if(auth_json["path_storage"] != nullptr)
                 path_store = auth_json["path_storage"];
             if(auth_json["environmental_variable"] != nullptr)
@@ -213,6 +250,24 @@ int main(int argc, char **argv) {
             if(auth_json["check_last_days"] != nullptr) {
                 check_last_days = auth_json["check_last_days"];
             }
+            if(auth_json["max_threads"] != nullptr) {
+                max_threads = auth_json["max_threads"];
+            }
+            if(auth_json["days_per_task"] != nullptr) {
+                days_per_task = auth_json["days_per_task"];
+            }
+            if(auth_json["history_max_bars"] != nullptr) {
+                history_max_bars = auth_json["history_max_bars"];
+            }
+            if(auth_json["daemon"] != nullptr) {
+                is_daemon = auth_json["daemon"];
+            }
+            if(auth_json["daemon_history_period"] != nullptr) {
+                daemon_history_period = auth_json["daemon_history_period"];
+            }
+            if(auth_json["websocket_log_file"] != nullptr) {
+                file_name_websocket_log = auth_json["websocket_log_file"];
+            }
         }
         catch (intrade_bar::json::parse_error &e) {
             std::cerr << "json parser error: " << std::string(e.what()) << std::endl;
@@ -242,6 +297,7 @@ int main(int argc, char **argv) {
         cookie_file = std::string(env_ptr) + "/" + cookie_file;
         file_name_bets_log = std::string(env_ptr) + "/" + file_name_bets_log;
         file_name_work_log = std::string(env_ptr) + "/" + file_name_work_log;
+        file_name_websocket_log = std::string(env_ptr) + "/" + file_name_websocket_log;
     }
 
     /* проверяем настройки */
@@ -274,301 +330,542 @@ int main(int argc, char **argv) {
     if(check_last_days > 0) {
         std::cout << "check last days: " << check_last_days << std::endl;
     }
-    std::cout << std::endl;
-
-    /* получаем конечную дату загрузки */
-    xtime::timestamp_t current_timestamp = xtime::get_timestamp();
-    xtime::timestamp_t timestamp = current_timestamp;
-    if(!is_use_current_day) {
-        timestamp = xtime::get_first_timestamp_day(timestamp) -
-            xtime::SECONDS_IN_DAY;
+    if(!path_export.empty()) {
+        std::cout << "path export: " << path_export << std::endl;
     }
+    if(is_daemon) {
+        std::cout << "daemon mode: true" << std::endl;
+    }
+    std::cout << std::endl;
 
     /* создаем папку для записи котировок */
     bf::create_directory(path_store);
 
-#if(0)
-    /* создаем хранилища котировок */
+    /* хранилища котировок и манифесты открываются по мере необходимости */
     std::vector<std::shared_ptr<xquotes_history::QuotesHistory<>>> hists(intrade_bar_common::CURRENCY_PAIRS);
-    for(uint32_t symbol = 0;
-        symbol < intrade_bar_common::CURRENCY_PAIRS;
-        ++symbol) {
-        /* пропускаем те валютные пары, которых нет у брокера */
-        if(is_only_broker_supported_currency_pairs &&
-            !intrade_bar_common::is_currency_pairs[symbol]) continue;
-
-        std::string file_name =
-            path_store + "/" +
-            intrade_bar_common::currency_pairs[symbol] + ".qhs5";
-
+    std::vector<std::shared_ptr<intrade_bar::HistoryManifest>> manifests(intrade_bar_common::CURRENCY_PAIRS);
+    /* хранилище символа изменяют потоки записи загрузчика и, в режиме демона, поток котировок */
+    std::array<std::mutex, intrade_bar_common::CURRENCY_PAIRS> symbol_mutex;
+    /* клиент для поиска начальной даты котировок, создается только если поиск нужен */
+    std::unique_ptr<intrade_bar::IntradeBarHttpApi> search_api;
+
+    auto open_hist = [&](const uint32_t symbol) {
+        if(hists[symbol]) return;
         hists[symbol] = std::make_shared<xquotes_history::QuotesHistory<>>(
-            file_name,
+            path_store + "/" + intrade_bar_common::currency_pairs[symbol] + ".qhs5",
             xquotes_history::PRICE_OHLCV,
             xquotes_history::USE_COMPRESSION);
-    }
-#endif
-
-
-    std::cout << std::endl;
+    };
+
+    intrade_bar::HistoryDownloader downloader(
+        point,
+        sert_file,
+        cookie_file,
+        file_name_bets_log,
+        file_name_work_log);
+    downloader.set_concurrency(1, max_threads, std::min(2U, max_threads));
+    downloader.set_pipeline(1, 2, 2 * max_threads);
+    downloader.set_retry(5, 1.0, 60.0);
+    downloader.set_hist_type(price_type);
+    downloader.set_history_max_bars(history_max_bars);
+
+    /* загрузить все недостающие данные
+     * current_timestamp - время начала загрузки
+     * is_load_current_day - загружать текущий день
+     * is_check_last_days - загрузить и сверить последние check_last_days дней
+     * number_tasks - количество задач загрузки
+     */
+    auto download_history = [&](
+            const xtime::timestamp_t current_timestamp,
+            const bool is_load_current_day,
+            const bool is_check_last_days,
+            uint64_t &number_tasks) -> int {
+        number_tasks = 0;
+        /* получаем конечную дату загрузки */
+        xtime::timestamp_t timestamp = current_timestamp;
+        if(!is_load_current_day) {
+            timestamp = xtime::get_first_timestamp_day(timestamp) -
+                xtime::SECONDS_IN_DAY;
+        }
+        const xtime::timestamp_t stop_date = xtime::get_first_timestamp_day(timestamp);
+
+        for(uint32_t symbol = 0;
+            symbol < intrade_bar_common::CURRENCY_PAIRS;
+            ++symbol) {
+            /* пропускаем те валютные пары, которых нет у брокера */
+            if(is_only_broker_supported_currency_pairs &&
+                !intrade_bar_common::is_currency_pairs[symbol]) continue;
+
+            std::unique_lock<std::mutex> lock(symbol_mutex[symbol]);
+
+            /* манифест читаем с диска только при первой загрузке, дальше он хранится в памяти */
+            xtime::timestamp_t min_timestamp = intrade_bar_common::start_date_currency_pairs[symbol];
+            const bool is_new_manifest = !manifests[symbol];
+            if(is_new_manifest) {
+                manifests[symbol] = std::make_shared<intrade_bar::HistoryManifest>(
+                    path_store + "/" +
+                    intrade_bar_common::currency_pairs[symbol] + ".manifest.json");
+            }
+            if(!is_new_manifest || manifests[symbol]->load() == intrade_bar_common::OK) {
+                if(manifests[symbol]->get_first_day() != 0) min_timestamp = manifests[symbol]->get_first_day();
+            } else {
+                /* манифеста еще нет: считаем полными все дни хранилища, кроме последнего,
+                 * как и раньше загрузка продолжится с последнего дня
+                 * функция get_min_max_day_timestamp позволяет получить метки времени данных по дате,
+                 * т.е. переменные min_timestamp и max_timestamp содержат только начало дня
+                 */
+                open_hist(symbol);
+                xtime::timestamp_t hist_min_timestamp = 0, hist_max_timestamp = 0;
+                int err = hists[symbol]->get_min_max_day_timestamp(hist_min_timestamp, hist_max_timestamp);
+                if(err == xquotes_common::OK) {
+                    min_timestamp = hist_min_timestamp;
+                    for(xtime::timestamp_t t = hist_min_timestamp; t < hist_max_timestamp; t += xtime::SECONDS_IN_DAY) {
+                        manifests[symbol]->set_complete(t);
+                    }
+                }
+                manifests[symbol]->save();
+            }
 
-    std::atomic<bool> is_error_writing;
-    is_error_writing = false;
-
-    /* создаем 4 потока, и качаем котировки в 4 потока */
-    const uint32_t num_thread = 2;
-    std::vector<std::future<void>> request_future(num_thread);
-
-    /* скачиваем исторические данные котировок */
-    for(uint32_t nthread = 0;
-        nthread < num_thread;
-        ++nthread) {
-
-        request_future[nthread] = std::async(std::launch::async,[&,
-                        nthread,
-                        num_thread,
-                        path_store,
-                        sert_file,
-                        cookie_file,
-                        file_name_bets_log,
-                        file_name_work_log] {
-            for(uint32_t symbol = nthread;
-                symbol < intrade_bar_common::CURRENCY_PAIRS;
-                symbol += num_thread) {
-                /* пропускаем те валютные пары, которых нет у брокера */
-                if(is_only_broker_supported_currency_pairs &&
-                    !intrade_bar_common::is_currency_pairs[symbol]) continue;
-
-                intrade_bar::IntradeBarHttpApi iApi(
-                    point,
-                    sert_file,
-                    cookie_file,
-                    file_name_bets_log,
-                    file_name_work_log);
-
-                /* пробуем загрузить данные в несколько попыток */
-                const uint32_t attempt_max = 3;
-                for(uint32_t a = 0; a < attempt_max; ++a) {
-                    /* тут начинается попытка загрузки */
-
-                    std::string file_name =
-                        path_store + "/" +
-                        intrade_bar_common::currency_pairs[symbol] + ".qhs5";
-
-                    std::shared_ptr<xquotes_history::QuotesHistory<>> hist = std::make_shared<xquotes_history::QuotesHistory<>>(
-                        file_name,
-                        xquotes_history::PRICE_OHLCV,
-                        xquotes_history::USE_COMPRESSION);
-
-                    /* получаем время уже загруженных даных
-                     * функция get_min_max_day_timestamp позволяет получить метки времени данных по дате,
-                      * т.е. переменные min_timestamp и max_timestampтолько содержат начало дня
+            /* хранилище пустое: находим начальную дату котировок один раз и запоминаем ее в манифесте */
+            if(manifests[symbol]->get_first_day() == 0) {
+                if(manifests[symbol]->get_start_date() == 0) {
+                    /* поиск идет по сети долго, на это время блокировку символа отпускаем,
+                     * чтобы не задерживать сохранение загруженных данных символа
                      */
-                    int err = xquotes_common::OK;
-                    xtime::timestamp_t min_timestamp = 0, max_timestamp = 0;
-                    err = hist->get_min_max_day_timestamp(min_timestamp, max_timestamp);
-
-                    if(err != xquotes_common::OK) {
-                        min_timestamp = intrade_bar_common::start_date_currency_pairs[symbol];
-                        /*
-                        intrade_bar_common::PrintThread{} << "search for the starting date symbol: "
-                            << intrade_bar_common::currency_pairs[symbol]
-                            << "..." << std::endl;
-                        err = iApi.search_start_date_quotes(
-                                symbol,
-                                min_timestamp,
-                                [&](const uint32_t day){
-                            intrade_bar_common::PrintThread{}
-                                << "symbol: "
-                                << intrade_bar_common::currency_pairs[symbol]
-                                << ", new start date: "
-                                << xtime::get_str_date(day * xtime::SECONDS_IN_DAY)
-                                << std::endl;
-                        });
-                        intrade_bar_common::PrintThread{}
-                                << "download: " << intrade_bar_common::currency_pairs[symbol]
-                                << ", start date: " << xtime::get_str_date(xtime::get_first_timestamp_day(min_timestamp))
-                                << ", stop date: " << xtime::get_str_date(xtime::get_first_timestamp_day(timestamp))
-                                << std::endl;
-                        if(err != intrade_bar_common::OK) {
-                            intrade_bar_common::PrintThread{} << "error getting the start date of the currency pair!" << std::endl;
-                            continue;
-                        }
-                        */
-                        intrade_bar_common::PrintThread{}
-                                << "download: " << intrade_bar_common::currency_pairs[symbol]
-                                << ", start date: " << xtime::get_str_date(xtime::get_first_timestamp_day(min_timestamp))
-                                << ", stop date: " << xtime::get_str_date(xtime::get_first_timestamp_day(timestamp))
-                                << std::endl;
-                    } else {
-                        intrade_bar_common::PrintThread{}
-                                << "symbol: " << intrade_bar_common::currency_pairs[symbol]
-                                << ", start date: " << xtime::get_str_date(xtime::get_first_timestamp_day(min_timestamp))
-                                << ", stop date: " << xtime::get_str_date(xtime::get_first_timestamp_day(timestamp))
-                                << std::endl;
-                        min_timestamp = max_timestamp - check_last_days * xtime::SECONDS_IN_DAY;
-                        const xtime::timestamp_t stop_date = xtime::get_first_timestamp_day(timestamp);
-                        intrade_bar_common::PrintThread{}
-                                << "download: " << intrade_bar_common::currency_pairs[symbol]
-                                << ", start date: " << xtime::get_str_date(xtime::get_first_timestamp_day(min_timestamp))
-                                << ", stop date: " << xtime::get_str_date(xtime::get_first_timestamp_day(stop_date))
-                                << std::endl;
+                    lock.unlock();
+                    if(!search_api) {
+                        search_api = std::unique_ptr<intrade_bar::IntradeBarHttpApi>(new intrade_bar::IntradeBarHttpApi(
+                            point,
+                            sert_file,
+                            cookie_file,
+                            file_name_bets_log,
+                            file_name_work_log));
                     }
+                    xtime::timestamp_t start_date = intrade_bar_common::start_date_currency_pairs[symbol];
+                    const int err = search_api->search_start_date_quotes(symbol, start_date, nullptr, max_threads);
+                    lock.lock();
+                    if(err == intrade_bar_common::OK && manifests[symbol]->get_start_date() == 0) {
+                        manifests[symbol]->set_start_date(start_date);
+                        manifests[symbol]->save();
+                    }
+                    intrade_bar_common::PrintThread{}
+                        << "search start date: " << intrade_bar_common::currency_pairs[symbol]
+                        << ", date: " << xtime::get_str_date(start_date)
+                        << ", code: " << err
+                        << std::endl;
+                }
+                if(manifests[symbol]->get_start_date() != 0) min_timestamp = manifests[symbol]->get_start_date();
+            }
 
-                    /* непосредственно здесь уже проходимся по датам и скачиваем данные */
-                    const xtime::timestamp_t stop_date = xtime::get_first_timestamp_day(timestamp);
-                    for(xtime::timestamp_t t = xtime::get_first_timestamp_day(min_timestamp);
-                        t <= stop_date;
-                        t += xtime::SECONDS_IN_DAY) {
-                        /* пропускаем данные, которые нет смысла загружать повторно */
-                        //if(t < max_timestamp && hists[symbol]->check_timestamp(t)) continue;
-
-                        /* пропускаем выходной день, если указано его пропускать*/
-                        if(!is_use_day_off && xtime::is_day_off(t)) continue;
-
-                        /* находим конечную метку времени загрузки данных */
-                        const xtime::timestamp_t end_day_timestamp =
-                            (t == stop_date && is_use_current_day) ? xtime::get_first_timestamp_minute(current_timestamp) :
-                            t + xtime::SECONDS_IN_DAY - xtime::SECONDS_IN_MINUTE;
-
-                        /* теперь загружаем данные */
-                        bool is_error_receiving = false;
-                        std::vector<xquotes_common::Candle> candles;
-                        for(uint32_t ah = 0; ah < attempt_max; ++ah) {
-                            int err = iApi.get_historical_data(
-                                symbol,
-                                t,
-                                end_day_timestamp,
-                                candles,
-                                price_type,
-                                intrade_bar_common::pricescale_currency_pairs[symbol]);
-                            if(err != intrade_bar_common::OK) {
-                                intrade_bar_common::PrintThread{} <<
-                                    "error receiving data "
-                                    << intrade_bar_common::currency_pairs[symbol]
-                                    << ", "
-                                    << xtime::get_str_date(t)
-                                    << " code: "
-                                    << std::to_string(err)
-                                    << std::endl;
-                                std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-                                is_error_receiving = true;
-                                continue;
-                            }
-                            is_error_receiving = false;
-                            break;
-                        }
-
-                        /* если данные не удалось загрузить, выходим */
-                        if(is_error_receiving) continue;
-
-                        /* подготавливаем данные */
-                        std::array<xquotes_common::Candle, xtime::MINUTES_IN_DAY> bars_inside_day;
-                        for(size_t i = 0; i < candles.size(); ++i) {
-                            bars_inside_day[xtime::get_minute_day(candles[i].timestamp)] = candles[i];
-                        }
+            /* последние check_last_days дней загружаем и сверяем в любом случае */
+            const xtime::timestamp_t check_timestamp = (is_check_last_days && check_last_days > 0) ?
+                stop_date - (check_last_days - 1) * xtime::SECONDS_IN_DAY : stop_date + xtime::SECONDS_IN_DAY;
+
+            /* подряд идущие дни объединяем в одну задачу загрузчика,
+             * запрос на несколько дней сервер отдает одним ответом
+             */
+            xtime::timestamp_t task_start = 0;
+            xtime::timestamp_t task_last_day = 0;
+            uint32_t task_days = 0;
+            uint32_t symbol_tasks = 0;
+            auto add_task = [&]() {
+                if(task_days == 0) return;
+                /* находим конечную метку времени загрузки данных */
+                const xtime::timestamp_t end_timestamp =
+                    (task_last_day == stop_date && is_load_current_day) ? xtime::get_first_timestamp_minute(current_timestamp) :
+                    task_last_day + xtime::SECONDS_IN_DAY - xtime::SECONDS_IN_MINUTE;
+                task_days = 0;
+                if(end_timestamp < task_start) return;
+                downloader.add_task(symbol, task_start, end_timestamp);
+                ++symbol_tasks;
+            };
+
+            for(xtime::timestamp_t t = xtime::get_first_timestamp_day(min_timestamp);
+                t <= stop_date;
+                t += xtime::SECONDS_IN_DAY) {
+                /* пропускаем выходной день, если указано его пропускать*/
+                if(!is_use_day_off && xtime::is_day_off(t)) {
+                    add_task();
+                    continue;
+                }
+                const bool is_check = t >= check_timestamp;
+                if(!is_check && manifests[symbol]->is_done(t)) {
+                    add_task();
+                    continue;
+                }
+                /* неполный день догружаем с последнего бара */
+                xtime::timestamp_t watermark = is_check ? 0 : manifests[symbol]->get_watermark(t);
+                if(watermark >= (t + xtime::SECONDS_IN_DAY - xtime::SECONDS_IN_MINUTE) &&
+                    (t + xtime::SECONDS_IN_DAY + xtime::SECONDS_IN_HOUR) <= current_timestamp) {
+                    /* последний бар прошедшего дня уже записан, например потоком котировок в режиме демона.
+                     * По одной отметке день не закрываем: перед закрытием загружаем его целиком
+                     * и сверяем с историческими данными
+                     */
+                    watermark = 0;
+                }
+                if(watermark != 0) {
+                    add_task();
+                    task_start = watermark + xtime::SECONDS_IN_MINUTE;
+                } else
+                if(task_days == 0) {
+                    task_start = t;
+                }
+                task_last_day = t;
+                ++task_days;
+                if(task_days >= days_per_task) add_task();
+            }
+            add_task();
+
+            if(symbol_tasks == 0) continue;
+            open_hist(symbol);
+            number_tasks += symbol_tasks;
+            intrade_bar_common::PrintThread{}
+                    << "download: " << intrade_bar_common::currency_pairs[symbol]
+                    << ", tasks: " << symbol_tasks
+                    << ", stop date: " << xtime::get_str_date(stop_date)
+                    << std::endl;
+        }
 
-                        /* записываем данные */
-                        if(candles.size() > 0) {
-                            err = hist->write_candles(bars_inside_day, t);
-                            intrade_bar_common::PrintThread{}
-                                    << "write "
-                                    << intrade_bar_common::currency_pairs[symbol]
-                                    << ", "
-                                    << xtime::get_str_date(t)
-                                    << " - " + xtime::get_str_date_time(candles.back().timestamp)
-                                    << ", code: "
-                                    << std::to_string(err)
-                                    << std::endl;
-                            if(err != xquotes_common::OK) {
-                                intrade_bar_common::PrintThread{}
-                                    << std::endl << "error of writing, code: " <<
-                                    std::to_string(err) << std::endl;
-                                is_error_writing = true;
-                                break; // Больше не пытаемся записовать
-                            }
-                        } else {
-                            intrade_bar::print_line(
-                                    "skip " +
-                                    intrade_bar_common::currency_pairs[symbol] +
-                                    ", " +
-                                    xtime::get_str_date(t));
+        if(number_tasks == 0) return intrade_bar_common::OK;
+        std::cout << std::endl;
+
+        std::atomic<bool> is_error_writing;
+        is_error_writing = false;
+
+        /* выводим статистику загрузки раз в 10 секунд */
+        std::atomic<bool> is_download_finished;
+        is_download_finished = false;
+        std::future<void> stats_future = std::async(std::launch::async, [&]() {
+            uint32_t tick = 0;
+            while(!is_download_finished) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                if(++tick % 100 != 0) continue;
+                const intrade_bar::HistoryDownloader::Stats stats = downloader.get_stats();
+                intrade_bar_common::PrintThread{}
+                    << "progress: " << (stats.completed + stats.empty + stats.failed) << "/" << stats.tasks
+                    << ", retries: " << stats.retries
+                    << ", ddos: " << stats.ddos
+                    << ", concurrency: " << stats.limit
+                    << ", load fetch/decode/write: "
+                    << (int)(stats.fetch_load * 100.0) << "/"
+                    << (int)(stats.decode_load * 100.0) << "/"
+                    << (int)(stats.persist_load * 100.0) << "%"
+                    << ", queues decode/write: " << stats.decode_queue << "/" << stats.persist_queue
+                    << std::endl;
+            }
+        });
+
+        /* скачиваем исторические данные котировок
+         * функция обратного вызова для одного символа всегда вызывается из одного потока записи
+         */
+        const int err_download = downloader.run([&](
+                const uint32_t symbol,
+                const xtime::timestamp_t date_start,
+                const xtime::timestamp_t date_stop,
+                const std::vector<xquotes_common::Candle> &candles) -> int {
+            std::lock_guard<std::mutex> lock(symbol_mutex[symbol]);
+            std::shared_ptr<xquotes_history::QuotesHistory<>> hist = hists[symbol];
+            std::shared_ptr<intrade_bar::HistoryManifest> manifest = manifests[symbol];
+
+            /* раскладываем бары по дням */
+            std::map<xtime::timestamp_t, std::array<xquotes_common::Candle, xtime::MINUTES_IN_DAY>> days;
+            intrade_bar::IntradeBarHttpApi::group_candles_by_day(candles, days);
+
+            for(xtime::timestamp_t t = xtime::get_first_timestamp_day(date_start);
+                t <= date_stop;
+                t += xtime::SECONDS_IN_DAY) {
+                /* день закончился до начала загрузки (с запасом на задержку данных на сервере)
+                 * и загружен до конца, значит данные дня больше не изменятся
+                 */
+                const bool is_final_day =
+                    (t + xtime::SECONDS_IN_DAY + xtime::SECONDS_IN_HOUR) <= current_timestamp &&
+                    date_stop >= (t + xtime::SECONDS_IN_DAY - xtime::SECONDS_IN_MINUTE);
+                /* диапазон продолжает уже записанное начало дня. Если части дня пришли не по порядку,
+                 * день не отмечается в манифесте, пока не будет записано его начало
+                 */
+                const xtime::timestamp_t watermark = manifest->get_watermark(t);
+                const bool is_contiguous = date_start <= t ||
+                    (watermark != 0 && (watermark + xtime::SECONDS_IN_MINUTE) >= date_start);
+
+                auto it_day = days.find(t);
+                if(it_day == days.end()) {
+                    if(is_final_day && date_start <= t) {
+                        manifest->set_empty(t);
+                        manifest->save();
+                    } else
+                    if(is_final_day && is_contiguous) {
+                        /* пустой остаток дня после уже записанного начала: данных после последнего бара нет */
+                        manifest->set_complete(t);
+                        manifest->save();
+                    }
+                    continue;
+                }
+                std::array<xquotes_common::Candle, xtime::MINUTES_IN_DAY> &bars_inside_day = it_day->second;
+
+                /* загружена только часть дня: записанные бары вне диапазона загрузки сохраняем,
+                 * с обеих сторон, потому что части дня могут записываться в любом порядке
+                 */
+                const uint32_t first_minute = date_start > t ? xtime::get_minute_day(date_start) : 0;
+                const uint32_t last_minute = date_stop < (t + xtime::SECONDS_IN_DAY - xtime::SECONDS_IN_MINUTE) ?
+                    xtime::get_minute_day(date_stop) : (xtime::MINUTES_IN_DAY - 1);
+                /* записанные бары внутри диапазона (например, бары потока котировок в режиме демона)
+                 * сверяем с историческими данными: считаем заполненные пропуски и исправленные бары
+                 */
+                uint32_t filled_bars = 0;
+                uint32_t changed_bars = 0;
+                std::array<xquotes_common::Candle, xtime::MINUTES_IN_DAY> stored_bars;
+                if(hist->get_candles(stored_bars, t) == xquotes_common::OK) {
+                    for(uint32_t m = 0; m < first_minute; ++m) {
+                        bars_inside_day[m] = stored_bars[m];
+                    }
+                    for(uint32_t m = last_minute + 1; m < xtime::MINUTES_IN_DAY; ++m) {
+                        bars_inside_day[m] = stored_bars[m];
+                    }
+                    const double diff = 1.5 / intrade_bar_common::pricescale_currency_pairs[symbol];
+                    for(uint32_t m = first_minute; m <= last_minute; ++m) {
+                        if(stored_bars[m].timestamp == 0) {
+                            if(bars_inside_day[m].timestamp != 0) ++filled_bars;
+                            continue;
                         }
-
-                        /* читаем данные и сравниваем */
-                        if(candles.size() > 0 && check_last_days != 0) {
-                            //hist->save();
-                            bool is_skip = false;
-                            for(uint64_t m = 0; m < xtime::MINUTES_IN_DAY; ++m) {
-                                xquotes_common::Candle candle;
-                                /* адок пипсовщика, точность 1.5 КАРЛ!!! на самом деле так не должно быть.
-                                 * После перезаписи точность вроде как 1.0, как и полагается
-                                 */
-                                const double diff = 1.5/ intrade_bar_common::pricescale_currency_pairs[symbol];
-                                err = hist->get_candle(candle, m * xtime::SECONDS_IN_MINUTE + t);
-                                if(std::abs(candle.close - bars_inside_day[m].close) > diff) {
-                                    //intrade_bar_common::PrintThread{} << fixed;
-                                    //intrade_bar_common::PrintThread{}.precision(6);
-                                    intrade_bar_common::PrintThread{} << std::endl
-                                        << "error of compare price, code: " <<
-                                        std::to_string(err) <<
-                                        //" c1: " << candle.close <<
-                                        //" c2: " << bars_inside_day[m].close <<
-                                        " ps: " << intrade_bar_common::pricescale_currency_pairs[symbol] <<
-                                        " t: " << xtime::get_str_date_time(m * xtime::SECONDS_IN_MINUTE + t) <<
-                                        std::endl;
-
-                                    //uint32_t ti = xquotes_common::convert_to_uint(bars_inside_day[m].close);
-                                    //double td = xquotes_common::convert_to_double(ti);
-                                    //std::cerr << "c: " << bars_inside_day[m].close << " ti " << ti << " td " << td << std::endl;
-
-                                    is_error_writing = true;
-                                    is_skip = true;
-                                    break; // Больше не пытаемся записовать
-                                }
-                            }
-                            if(is_skip) break;
+                        if(bars_inside_day[m].timestamp == 0 ||
+                            std::abs(stored_bars[m].close - bars_inside_day[m].close) > diff) ++changed_bars;
+                    }
+                }
+
+                /* записываем данные */
+                int err = hist->write_candles(bars_inside_day, t);
+                intrade_bar_common::PrintThread{}
+                        << "write "
+                        << intrade_bar_common::currency_pairs[symbol]
+                        << ", "
+                        << xtime::get_str_date(t)
+                        << ", filled: " << filled_bars
+                        << ", changed: " << changed_bars
+                        << ", code: "
+                        << std::to_string(err)
+                        << std::endl;
+                if(err != xquotes_common::OK) {
+                    intrade_bar_common::PrintThread{}
+                        << std::endl << "error of writing, code: " <<
+                        std::to_string(err) << std::endl;
+                    is_error_writing = true;
+                    return err;
+                }
+
+                /* читаем данные и сравниваем */
+                if(check_last_days != 0) {
+                    for(uint64_t m = 0; m < xtime::MINUTES_IN_DAY; ++m) {
+                        xquotes_common::Candle candle;
+                        /* адок пипсовщика, точность 1.5 КАРЛ!!! на самом деле так не должно быть.
+                         * После перезаписи точность вроде как 1.0, как и полагается
+                         */
+                        const double diff = 1.5/ intrade_bar_common::pricescale_currency_pairs[symbol];
+                        err = hist->get_candle(candle, m * xtime::SECONDS_IN_MINUTE + t);
+                        if(std::abs(candle.close - bars_inside_day[m].close) > diff) {
+                            intrade_bar_common::PrintThread{} << std::endl
+                                << "error of compare price, code: " <<
+                                std::to_string(err) <<
+                                " ps: " << intrade_bar_common::pricescale_currency_pairs[symbol] <<
+                                " t: " << xtime::get_str_date_time(m * xtime::SECONDS_IN_MINUTE + t) <<
+                                std::endl;
+                            is_error_writing = true;
+                            /* задача будет повторена загрузчиком */
+                            return intrade_bar_common::STRANGE_PROGRAM_BEHAVIOR;
                         }
-                    } // for t
-                    //hist->save();
-                    if(is_error_writing) {
-                        intrade_bar_common::PrintThread{}
-                            << "attempt: " << a
-                            << ", " << (symbol + 1)
-                            << "/" << (intrade_bar_common::CURRENCY_PAIRS)
-                            << std::endl << std::endl;
-                        is_error_writing = false;
-                        continue;
                     }
+                }
+
+                /* отмечаем день в манифесте */
+                if(is_final_day && is_contiguous) {
+                    manifest->set_complete(t);
+                } else
+                if(is_contiguous) {
+                    /* отметка только по барам этого диапазона, более поздние бары дня могли прийти без начала */
+                    for(uint32_t m = last_minute + 1; m > 0; --m) {
+                        if(bars_inside_day[m - 1].timestamp == 0) continue;
+                        manifest->set_watermark(bars_inside_day[m - 1].timestamp);
+                        break;
+                    }
+                }
+                err = manifest->save();
+                if(err != intrade_bar_common::OK) {
                     intrade_bar_common::PrintThread{}
-                            << "data writing to file completed: " << intrade_bar_common::currency_pairs[symbol]
-                            << " " << xtime::get_str_date(xtime::get_first_timestamp_day(min_timestamp))
-                            << " - " << xtime::get_str_date(xtime::get_first_timestamp_day(timestamp))
-                            << ", " << (symbol + 1)
-                            << "/" << (intrade_bar_common::CURRENCY_PAIRS)
-                            << std::endl << std::endl;
-                    break;
-                } // for a
-            } // for symbol
-        }); // asyn
-    } //
-
-
-    for(size_t i = 0; i < request_future.size(); ++i) {
-        if(request_future[i].valid()) {
-            try {
-                request_future[i].wait();
-                request_future[i].get();
-            }
-            catch(const std::exception &e) {
-                std::cerr << "Error! What: " << e.what() << std::endl;
-            }
-            catch(...) {
-                std::cerr << "Error!" << std::endl;
+                        << std::endl << "error of writing manifest, code: " <<
+                        std::to_string(err) << std::endl;
+                    is_error_writing = true;
+                    return err;
+                }
             }
+            return intrade_bar_common::OK;
+        });
+
+        is_download_finished = true;
+        stats_future.wait();
+
+        const intrade_bar::HistoryDownloader::Stats stats = downloader.get_stats();
+        intrade_bar_common::PrintThread{}
+            << "data writing to files completed, tasks: " << stats.tasks
+            << ", completed: " << stats.completed
+            << ", empty: " << stats.empty
+            << ", failed: " << stats.failed
+            << ", retries: " << stats.retries
+            << ", ddos: " << stats.ddos
+            << ", load fetch/decode/write: "
+            << (int)(stats.fetch_load * 100.0) << "/"
+            << (int)(stats.decode_load * 100.0) << "/"
+            << (int)(stats.persist_load * 100.0) << "%"
+            << std::endl;
+
+        return err_download;
+    };
+
+    /* дописать новые дни хранилища в колоночные файлы, символы экспортируются параллельно */
+    auto export_columns = [&]() -> int {
+        if(path_export.empty()) return intrade_bar_common::OK;
+        bf::create_directory(path_export);
+        std::atomic<uint32_t> next_symbol = ATOMIC_VAR_INIT(0);
+        std::atomic<uint32_t> number_errors = ATOMIC_VAR_INIT(0);
+        std::vector<std::future<void>> workers;
+        for(uint32_t w = 0; w < max_threads; ++w) {
+            workers.push_back(std::async(std::launch::async, [&]() {
+                uint32_t symbol = 0;
+                while((symbol = next_symbol++) < intrade_bar_common::CURRENCY_PAIRS) {
+                    std::lock_guard<std::mutex> lock(symbol_mutex[symbol]);
+                    if(!manifests[symbol]) continue;
+                    open_hist(symbol);
+                    intrade_bar::ColumnExporter exporter(
+                        path_export,
+                        intrade_bar_common::currency_pairs[symbol],
+                        intrade_bar_common::pricescale_currency_pairs[symbol]);
+                    const int err = exporter.export_history(*hists[symbol]);
+                    if(err == intrade_bar_common::OK || err == intrade_bar_common::DATA_NOT_AVAILABLE) continue;
+                    intrade_bar_common::PrintThread{}
+                        << "error of export " << intrade_bar_common::currency_pairs[symbol]
+                        << ", code: " << err << std::endl;
+                    ++number_errors;
+                }
+            }));
+        }
+        for(size_t w = 0; w < workers.size(); ++w) {
+            workers[w].wait();
+        }
+        return number_errors == 0 ? intrade_bar_common::OK : intrade_bar_common::STRANGE_PROGRAM_BEHAVIOR;
+    };
+
+    uint64_t number_tasks = 0;
+    const int err_download = download_history(xtime::get_timestamp(), is_use_current_day, true, number_tasks);
+    if(number_tasks == 0) std::cout << "all data is already downloaded" << std::endl;
+    const int err_export = export_columns();
+    if(!path_export.empty() && err_export == intrade_bar_common::OK) std::cout << "export completed" << std::endl;
+    if(!is_daemon) {
+        if(err_download != intrade_bar_common::OK || err_export != intrade_bar_common::OK) return EXIT_FAILURE;
+        return EXIT_SUCCESS;
+    }
+
+    /* режим демона: бары потока котировок дописываются в хранилище сразу после закрытия минуты,
+     * прошедшие дни догружаются и закрываются в манифесте по историческим данным
+     */
+    std::signal(SIGINT, signal_handler_stop);
+    std::signal(SIGTERM, signal_handler_stop);
+
+    /* записать закрытый бар потока котировок */
+    auto write_stream_candle = [&](
+            const uint32_t symbol,
+            const xquotes_common::Candle &candle) {
+        std::lock_guard<std::mutex> lock(symbol_mutex[symbol]);
+        if(!manifests[symbol]) return;
+        open_hist(symbol);
+        const xtime::timestamp_t day = xtime::get_first_timestamp_day(candle.timestamp);
+        std::array<xquotes_common::Candle, xtime::MINUTES_IN_DAY> bars_inside_day;
+        if(hists[symbol]->get_candles(bars_inside_day, day) != xquotes_common::OK) {
+            bars_inside_day.fill(xquotes_common::Candle());
+        }
+        bars_inside_day[xtime::get_minute_day(candle.timestamp)] = candle;
+        const int err = hists[symbol]->write_candles(bars_inside_day, day);
+        if(err != xquotes_common::OK) {
+            intrade_bar_common::PrintThread{}
+                << "error of writing stream bar " << intrade_bar_common::currency_pairs[symbol]
+                << ", code: " << err << std::endl;
+            return;
+        }
+        /* отметка двигается только по непрерывным барам: если поток пропустил минуты,
+         * день останется неполным и будет догружен по историческим данным
+         */
+        const xtime::timestamp_t watermark = manifests[symbol]->get_watermark(day);
+        const bool is_contiguous = watermark == 0 ?
+            candle.timestamp == day :
+            candle.timestamp <= (watermark + xtime::SECONDS_IN_MINUTE);
+        if(!manifests[symbol]->is_complete(day) && is_contiguous) {
+            manifests[symbol]->set_watermark(candle.timestamp);
+            manifests[symbol]->save();
         }
+    };
+
+    /* поток котировок дает цены (bid+ask)/2, для других типов цены используем только исторические данные */
+    const bool is_use_stream = price_type == intrade_bar_common::FXCM_USE_HIST_QUOTES_BID_ASK_DIV2;
+    std::unique_ptr<intrade_bar::IntradeBarApi> stream_api;
+    if(is_use_stream) {
+        /* поток начинает с последнего записанного бара текущего дня */
+        const xtime::timestamp_t current_minute = xtime::get_first_timestamp_minute(xtime::get_timestamp());
+        xtime::timestamp_t seed_timestamp = current_minute;
+        for(uint32_t symbol = 0; symbol < intrade_bar_common::CURRENCY_PAIRS; ++symbol) {
+            if(!manifests[symbol]) continue;
+            std::lock_guard<std::mutex> lock(symbol_mutex[symbol]);
+            const xtime::timestamp_t watermark = manifests[symbol]->get_watermark(current_minute);
+            seed_timestamp = std::min(seed_timestamp, watermark == 0 ?
+                xtime::get_first_timestamp_day(current_minute) : watermark + xtime::SECONDS_IN_MINUTE);
+        }
+        const uint32_t number_bars = std::max(1U, std::min(
+            (uint32_t)xtime::MINUTES_IN_DAY,
+            (uint32_t)((current_minute - seed_timestamp) / xtime::SECONDS_IN_MINUTE)));
+
+        stream_api = std::unique_ptr<intrade_bar::IntradeBarApi>(new intrade_bar::IntradeBarApi(
+            point,
+            number_bars,
+            [&](const std::map<std::string,xquotes_common::Candle> &candles,
+                const intrade_bar::IntradeBarApi::EventType event,
+                const xtime::timestamp_t timestamp) {
+            /* пишем только закрытые бары и их исправления по историческим данным */
+            if(event == intrade_bar::IntradeBarApi::EventType::NEW_TICK) return;
+            for(uint32_t symbol = 0; symbol < intrade_bar_common::CURRENCY_PAIRS; ++symbol) {
+                auto it_candle = candles.find(intrade_bar_common::currency_pairs[symbol]);
+                if(it_candle == candles.end() || it_candle->second.close == 0) continue;
+                xquotes_common::Candle candle = it_candle->second;
+                candle.timestamp = timestamp;
+                write_stream_candle(symbol, candle);
+            }
+        },
+            false,  // не ждем формирования первого бара
+            true,   // цена открытия равна цене закрытия предыдущего бара
+            true,   // исторический бар сливается с баром потока котировок
+            true,   // сверяем бары потока с историческими данными
+            sert_file,
+            cookie_file,
+            file_name_bets_log,
+            file_name_work_log,
+            file_name_websocket_log));
+        stream_api->set_option_instant_bar_sealing(true);
     }
 
-    if(is_error_writing) return EXIT_FAILURE;
+    std::cout << "daemon mode started" << std::endl;
+    xtime::timestamp_t last_update = xtime::get_first_timestamp_minute(xtime::get_timestamp());
+    while(!is_daemon_stop) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        const xtime::timestamp_t current_timestamp = xtime::get_timestamp();
+        const xtime::timestamp_t current_minute = xtime::get_first_timestamp_minute(current_timestamp);
+        /* с потоком котировок исторические данные нужны только для закрытия прошедших дней,
+         * без него каждую минуту догружаем текущий день
+         */
+        const xtime::timestamp_t update_period = is_use_stream ?
+            daemon_history_period * xtime::SECONDS_IN_MINUTE : xtime::SECONDS_IN_MINUTE;
+        if((current_minute - last_update) < update_period) continue;
+        /* ждем, пока исторические данные закрытой минуты появятся на сервере */
+        if(xtime::get_second_minute(current_timestamp) < 5) continue;
+        last_update = current_minute;
+        download_history(current_timestamp, !is_use_stream, false, number_tasks);
+        export_columns();
+    }
+    std::cout << "daemon mode stopped" << std::endl;
+    stream_api.reset();
     return EXIT_SUCCESS;
 }
-
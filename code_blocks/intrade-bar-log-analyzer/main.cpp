@@ -0,0 +1,688 @@
+/*
+* intrade-bar-api-cpp - C ++ API client for intrade.bar
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <array>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <future>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
+#include <dirent.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "zstd.h"
+
+#define PROGRAM_VERSION "1.0"
+#define PROGRAM_DATE    "19.10.2026"
+
+/* значения IntradeBarHttpApi::BetStatus */
+enum {
+    BET_OPENING_ERROR = 1,
+    BET_CHECK_ERROR = 2,
+    BET_WIN = 4,
+    BET_LOSS = 5,
+    BET_STANDOFF = 6,
+};
+
+const double SECONDS_IN_HOUR = 3600.0;
+const double SECONDS_IN_DAY = 86400.0;
+
+/** \brief Файл, отображенный в память
+ */
+class MappedFile {
+private:
+#ifdef _WIN32
+    HANDLE file_handle = INVALID_HANDLE_VALUE;
+    HANDLE mapping_handle = NULL;
+#else
+    int file_descriptor = -1;
+#endif
+    const char *data = nullptr;
+    size_t size = 0;
+
+public:
+    MappedFile() {};
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile &operator=(const MappedFile&) = delete;
+
+    /** \brief Отобразить файл в память
+     * \param file_name Имя файла
+     * \return Вернет true в случае успеха
+     */
+    bool open(const std::string &file_name) {
+#ifdef _WIN32
+        file_handle = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+            NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if(file_handle == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER file_size;
+        if(!GetFileSizeEx(file_handle, &file_size)) return false;
+        size = (size_t)file_size.QuadPart;
+        if(size == 0) return true;
+        mapping_handle = CreateFileMappingA(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+        if(mapping_handle == NULL) return false;
+        data = (const char*)MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+        return data != nullptr;
+#else
+        file_descriptor = ::open(file_name.c_str(), O_RDONLY);
+        if(file_descriptor < 0) return false;
+        struct stat file_stat;
+        if(fstat(file_descriptor, &file_stat) != 0) return false;
+        size = (size_t)file_stat.st_size;
+        if(size == 0) return true;
+        void *ptr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+        if(ptr == MAP_FAILED) return false;
+        madvise(ptr, size, MADV_SEQUENTIAL);
+        data = (const char*)ptr;
+        return true;
+#endif
+    }
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if(data != nullptr) UnmapViewOfFile(data);
+        if(mapping_handle != NULL) CloseHandle(mapping_handle);
+        if(file_handle != INVALID_HANDLE_VALUE) CloseHandle(file_handle);
+#else
+        if(data != nullptr) munmap((void*)data, size);
+        if(file_descriptor >= 0) ::close(file_descriptor);
+#endif
+    }
+
+    inline const char *get_data() const {return data;}
+    inline size_t get_size() const {return size;}
+};
+
+/** \brief Содержимое файла лога
+ *
+ * Несжатый файл читается прямо из отображения в память,
+ * сжатый zstd распаковывается в буфер
+ */
+class LogView {
+public:
+    std::string file_name;
+    std::unique_ptr<MappedFile> mapped_file;
+    std::string buffer;
+    const char *data = nullptr;
+    size_t size = 0;
+    bool is_error = false;
+};
+
+/** \brief Распаковать zstd
+ * \param src Сжатые данные
+ * \param src_size Размер сжатых данных
+ * \param output Распакованные данные
+ * \return Вернет true в случае успеха
+ */
+bool decompress_zstd(const char *src, const size_t src_size, std::string &output) {
+    output.clear();
+    const unsigned long long content_size = ZSTD_getFrameContentSize(src, src_size);
+    if(content_size != ZSTD_CONTENTSIZE_ERROR && content_size != ZSTD_CONTENTSIZE_UNKNOWN) {
+        output.reserve(content_size);
+    } else {
+        output.reserve(src_size * 8);
+    }
+    ZSTD_DCtx *dctx = ZSTD_createDCtx();
+    if(dctx == NULL) return false;
+    std::vector<char> buffer_out(ZSTD_DStreamOutSize());
+    ZSTD_inBuffer input = {src, src_size, 0};
+    bool is_ok = true;
+    while(input.pos < input.size) {
+        ZSTD_outBuffer out = {buffer_out.data(), buffer_out.size(), 0};
+        const size_t ret = ZSTD_decompressStream(dctx, &out, &input);
+        if(ZSTD_isError(ret)) {
+            is_ok = false;
+            break;
+        }
+        output.append(buffer_out.data(), out.pos);
+    }
+    ZSTD_freeDCtx(dctx);
+    return is_ok;
+}
+
+/** \brief Загрузить файл лога
+ * \param view Файл лога, поле file_name должно быть заполнено
+ */
+void load_log_view(LogView &view) {
+    view.mapped_file = std::unique_ptr<MappedFile>(new MappedFile());
+    if(!view.mapped_file->open(view.file_name)) {
+        view.is_error = true;
+        return;
+    }
+    const std::string zst_extension(".zst");
+    const bool is_zst = view.file_name.size() > zst_extension.size() &&
+        view.file_name.compare(view.file_name.size() - zst_extension.size(), zst_extension.size(), zst_extension) == 0;
+    if(!is_zst) {
+        view.data = view.mapped_file->get_data();
+        view.size = view.mapped_file->get_size();
+        return;
+    }
+    if(!decompress_zstd(view.mapped_file->get_data(), view.mapped_file->get_size(), view.buffer)) {
+        view.is_error = true;
+    }
+    view.mapped_file.reset();
+    view.data = view.buffer.data();
+    view.size = view.buffer.size();
+}
+
+/** \brief Найти значение ключа в строке JSON
+ *
+ * Быстрый поиск без полного разбора JSON. Ключ ищется вместе с кавычками и двоеточием,
+ * поэтому "timestamp" не совпадет с "send_timestamp"
+ * \param begin Начало строки
+ * \param end Конец строки
+ * \param key Ключ в виде "\"key\":"
+ * \param key_size Длина ключа
+ * \return Указатель на значение или nullptr
+ */
+inline const char *find_value(const char *begin, const char *end, const char *key, const size_t key_size) {
+    /* кавычки встречаются в строке слишком часто, поэтому ищем первую букву ключа */
+    const char *ptr = begin + 1;
+    while(ptr + key_size - 1 <= end) {
+        const char *found = (const char*)std::memchr(ptr, key[1], end - ptr);
+        if(found == nullptr || found + key_size - 1 > end) return nullptr;
+        if(std::memcmp(found - 1, key, key_size) == 0) return found + key_size - 1;
+        ptr = found + 1;
+    }
+    return nullptr;
+}
+
+template<size_t N>
+inline bool get_number(const char *begin, const char *end, const char (&key)[N], double &value) {
+    const char *ptr = find_value(begin, end, key, N - 1);
+    if(ptr == nullptr || ptr >= end) return false;
+    /* отображенный файл не заканчивается нулем, поэтому число копируется в буфер
+     * и strtod никогда не читает за пределами строки
+     */
+    char buffer[64];
+    size_t length = 0;
+    while(ptr + length < end && length < sizeof(buffer) - 1) {
+        const char c = ptr[length];
+        if(!((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E')) break;
+        buffer[length++] = c;
+    }
+    if(length == 0) return false;
+    buffer[length] = '\0';
+    char *stop = nullptr;
+    value = std::strtod(buffer, &stop);
+    return stop != buffer;
+}
+
+template<size_t N>
+inline bool get_string(const char *begin, const char *end, const char (&key)[N], std::string &value) {
+    const char *ptr = find_value(begin, end, key, N - 1);
+    if(ptr == nullptr || ptr >= end || *ptr != '"') return false;
+    ++ptr;
+    const char *stop = (const char*)std::memchr(ptr, '"', end - ptr);
+    if(stop == nullptr) return false;
+    value.assign(ptr, stop - ptr);
+    return true;
+}
+
+template<size_t N>
+inline bool check_value(const char *begin, const char *end, const char (&pattern)[N]) {
+    return find_value(begin, end, pattern, N - 1) != nullptr;
+}
+
+/** \brief Статистика результатов сделок
+ */
+class WinStats {
+public:
+    uint64_t win = 0;
+    uint64_t loss = 0;
+    uint64_t standoff = 0;
+    uint64_t error = 0;
+
+    void merge(const WinStats &other) {
+        win += other.win;
+        loss += other.loss;
+        standoff += other.standoff;
+        error += other.error;
+    }
+};
+
+/** \brief Статистика одного потока обработки
+ */
+class Stats {
+public:
+    uint64_t lines = 0;
+    uint64_t bet_open = 0;
+    uint64_t bet_close = 0;
+    uint64_t bad_lines = 0;
+    std::map<std::string, std::vector<double>> latency;         /**< Задержка открытия сделки по символам, мс */
+    std::map<std::string, std::array<WinStats, 24>> win_stats;  /**< Результаты сделок по символам и часам UTC */
+    std::vector<std::pair<double, double>> clock_offset;        /**< Метка времени и смещение времени сервера относительно ПК */
+    std::map<std::string, uint64_t> errors;                     /**< Количество ошибок по типам */
+
+    void merge(Stats &other) {
+        lines += other.lines;
+        bet_open += other.bet_open;
+        bet_close += other.bet_close;
+        bad_lines += other.bad_lines;
+        for(auto &item : other.latency) {
+            std::vector<double> &values = latency[item.first];
+            values.insert(values.end(), item.second.begin(), item.second.end());
+        }
+        for(auto &item : other.win_stats) {
+            std::array<WinStats, 24> &values = win_stats[item.first];
+            for(size_t h = 0; h < 24; ++h) values[h].merge(item.second[h]);
+        }
+        clock_offset.insert(clock_offset.end(), other.clock_offset.begin(), other.clock_offset.end());
+        for(auto &item : other.errors) {
+            errors[item.first] += item.second;
+        }
+    }
+};
+
+/** \brief Обработать строку лога
+ * \param begin Начало строки
+ * \param end Конец строки
+ * \param stats Статистика
+ * \param symbol Временная строка для имени символа
+ */
+void process_line(const char *begin, const char *end, Stats &stats, std::string &symbol) {
+    ++stats.lines;
+    if(end - begin < 2 || *begin != '{') {
+        ++stats.bad_lines;
+        return;
+    }
+    double record_timestamp = 0;
+    if(!get_number(begin, end, "\"timestamp\":", record_timestamp)) {
+        ++stats.bad_lines;
+        return;
+    }
+    if(check_value(begin, end, "\"function\":\"bet_open\"")) {
+        ++stats.bet_open;
+        double error = 0, delay = 0, opening_timestamp = 0, send_timestamp = 0;
+        get_number(begin, end, "\"error\":", error);
+        if(error != 0) {
+            ++stats.errors["bet_open error " + std::to_string((int)error)];
+            return;
+        }
+        if(!get_string(begin, end, "\"symbol\":", symbol)) return;
+        if(get_number(begin, end, "\"delay\":", delay)) {
+            stats.latency[symbol].push_back(delay * 1000.0);
+        }
+        /* сервер открывает сделку примерно в середине запроса, начало запроса записано в send_timestamp */
+        if(get_number(begin, end, "\"opening_timestamp\":", opening_timestamp) && opening_timestamp > 0) {
+            if(!get_number(begin, end, "\"send_timestamp\":", send_timestamp) || send_timestamp <= 0) {
+                send_timestamp = record_timestamp - delay;
+            }
+            const double pc_timestamp = send_timestamp + delay / 2.0;
+            stats.clock_offset.push_back(std::make_pair(pc_timestamp, opening_timestamp - pc_timestamp));
+        }
+        return;
+    }
+    if(check_value(begin, end, "\"function\":\"bet_close\"")) {
+        ++stats.bet_close;
+        double status = 0, opening_timestamp = 0;
+        if(!get_string(begin, end, "\"symbol\":", symbol)) return;
+        if(!get_number(begin, end, "\"bet_status\":", status)) return;
+        if(!get_number(begin, end, "\"opening_timestamp\":", opening_timestamp) || opening_timestamp <= 0) {
+            opening_timestamp = record_timestamp;
+        }
+        const size_t hour = (size_t)((uint64_t)(opening_timestamp / SECONDS_IN_HOUR) % 24);
+        WinStats &win_stats = stats.win_stats[symbol][hour];
+        switch((int)status) {
+        case BET_WIN:
+            ++win_stats.win;
+            break;
+        case BET_LOSS:
+            ++win_stats.loss;
+            break;
+        case BET_STANDOFF:
+            ++win_stats.standoff;
+            break;
+        default:
+            ++win_stats.error;
+            break;
+        }
+        return;
+    }
+    /* остальные логи: считаем ошибки по типам */
+    std::string error;
+    if(get_string(begin, end, "\"error\":", error)) {
+        ++stats.errors[error];
+    }
+}
+
+/** \brief Обработать фрагмент файла
+ * \param begin Начало фрагмента
+ * \param end Конец фрагмента
+ * \param stats Статистика
+ */
+void process_chunk(const char *begin, const char *end, Stats &stats) {
+    std::string symbol;
+    const char *line = begin;
+    while(line < end) {
+        const char *line_end = (const char*)std::memchr(line, '\n', end - line);
+        if(line_end == nullptr) line_end = end;
+        const char *stop = line_end;
+        if(stop > line && *(stop - 1) == '\r') --stop;
+        if(stop > line) process_line(line, stop, stats, symbol);
+        line = line_end + 1;
+    }
+}
+
+/** \brief Найти все файлы логов
+ * \param path Файл или директория
+ * \param file_list Список файлов
+ */
+void add_log_files(const std::string &path, std::vector<std::string> &file_list) {
+    struct stat path_stat;
+    if(stat(path.c_str(), &path_stat) != 0) {
+        std::cerr << "file not found: " << path << std::endl;
+        return;
+    }
+    if(!S_ISDIR(path_stat.st_mode)) {
+        file_list.push_back(path);
+        return;
+    }
+    DIR *dir = opendir(path.c_str());
+    if(dir == NULL) return;
+    std::vector<std::string> names;
+    struct dirent *entry = NULL;
+    while((entry = readdir(dir)) != NULL) {
+        const std::string name(entry->d_name);
+        const bool is_log = (name.size() > 4 && name.compare(name.size() - 4, 4, ".log") == 0) ||
+            (name.size() > 8 && name.compare(name.size() - 8, 8, ".log.zst") == 0);
+        if(is_log) names.push_back(path + "/" + name);
+    }
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+    file_list.insert(file_list.end(), names.begin(), names.end());
+}
+
+/** \brief Получить перцентиль отсортированного массива
+ */
+double get_percentile(const std::vector<double> &values, const double percent) {
+    if(values.empty()) return 0;
+    const size_t index = std::min(values.size() - 1, (size_t)(percent / 100.0 * (double)(values.size() - 1) + 0.5));
+    return values[index];
+}
+
+void print_report(Stats &stats, std::ostream &out) {
+    out << std::fixed;
+    out << "lines: " << stats.lines
+        << " bet_open: " << stats.bet_open
+        << " bet_close: " << stats.bet_close
+        << " bad lines: " << stats.bad_lines << std::endl << std::endl;
+
+    out << "fill latency, ms" << std::endl;
+    out << std::left << std::setw(12) << "symbol" << std::right
+        << std::setw(10) << "count" << std::setw(10) << "mean" << std::setw(10) << "p50"
+        << std::setw(10) << "p90" << std::setw(10) << "p99" << std::setw(10) << "max" << std::endl;
+    for(auto &item : stats.latency) {
+        std::vector<double> &values = item.second;
+        if(values.empty()) continue;
+        std::sort(values.begin(), values.end());
+        double sum = 0;
+        for(size_t i = 0; i < values.size(); ++i) sum += values[i];
+        out << std::left << std::setw(12) << item.first << std::right << std::setprecision(1)
+            << std::setw(10) << values.size()
+            << std::setw(10) << (sum / (double)values.size())
+            << std::setw(10) << get_percentile(values, 50)
+            << std::setw(10) << get_percentile(values, 90)
+            << std::setw(10) << get_percentile(values, 99)
+            << std::setw(10) << values.back() << std::endl;
+    }
+    out << std::endl;
+
+    out << "win rate by symbol and hour (UTC)" << std::endl;
+    out << std::left << std::setw(12) << "symbol" << std::right
+        << std::setw(6) << "hour" << std::setw(10) << "bets" << std::setw(10) << "win"
+        << std::setw(10) << "loss" << std::setw(10) << "standoff" << std::setw(10) << "error"
+        << std::setw(10) << "winrate" << std::endl;
+    for(auto &item : stats.win_stats) {
+        WinStats total;
+        for(size_t h = 0; h < 24; ++h) {
+            const WinStats &w = item.second[h];
+            total.merge(w);
+            const uint64_t bets = w.win + w.loss + w.standoff + w.error;
+            if(bets == 0) continue;
+            const uint64_t decided = w.win + w.loss;
+            out << std::left << std::setw(12) << item.first << std::right << std::setprecision(3)
+                << std::setw(6) << h << std::setw(10) << bets << std::setw(10) << w.win
+                << std::setw(10) << w.loss << std::setw(10) << w.standoff << std::setw(10) << w.error
+                << std::setw(10) << (decided == 0 ? 0.0 : (double)w.win / (double)decided) << std::endl;
+        }
+        const uint64_t bets = total.win + total.loss + total.standoff + total.error;
+        const uint64_t decided = total.win + total.loss;
+        out << std::left << std::setw(12) << item.first << std::right << std::setprecision(3)
+            << std::setw(6) << "all" << std::setw(10) << bets << std::setw(10) << total.win
+            << std::setw(10) << total.loss << std::setw(10) << total.standoff << std::setw(10) << total.error
+            << std::setw(10) << (decided == 0 ? 0.0 : (double)total.win / (double)decided) << std::endl;
+    }
+    out << std::endl;
+
+    out << "clock offset (server - pc), s" << std::endl;
+    std::vector<std::pair<double, double>> &offsets = stats.clock_offset;
+    std::sort(offsets.begin(), offsets.end());
+    out << std::setw(12) << "day" << std::setw(10) << "count" << std::setw(10) << "mean"
+        << std::setw(10) << "min" << std::setw(10) << "max" << std::endl;
+    size_t day_begin = 0;
+    while(day_begin < offsets.size()) {
+        const int64_t day = (int64_t)(offsets[day_begin].first / SECONDS_IN_DAY);
+        size_t day_end = day_begin;
+        double sum = 0, min_offset = offsets[day_begin].second, max_offset = offsets[day_begin].second;
+        while(day_end < offsets.size() && (int64_t)(offsets[day_end].first / SECONDS_IN_DAY) == day) {
+            const double value = offsets[day_end].second;
+            sum += value;
+            min_offset = std::min(min_offset, value);
+            max_offset = std::max(max_offset, value);
+            ++day_end;
+        }
+        const std::time_t day_time = (std::time_t)(day * (int64_t)SECONDS_IN_DAY);
+        char day_str[16] = {};
+        std::strftime(day_str, sizeof(day_str), "%Y-%m-%d", std::gmtime(&day_time));
+        out << std::setw(12) << day_str << std::setprecision(3)
+            << std::setw(10) << (day_end - day_begin)
+            << std::setw(10) << (sum / (double)(day_end - day_begin))
+            << std::setw(10) << min_offset << std::setw(10) << max_offset << std::endl;
+        day_begin = day_end;
+    }
+    /* дрейф - наклон прямой методом наименьших квадратов */
+    if(offsets.size() >= 2) {
+        const double t0 = offsets.front().first;
+        double sum_x = 0, sum_y = 0, sum_xx = 0, sum_xy = 0;
+        for(size_t i = 0; i < offsets.size(); ++i) {
+            const double x = (offsets[i].first - t0) / SECONDS_IN_DAY;
+            const double y = offsets[i].second;
+            sum_x += x;
+            sum_y += y;
+            sum_xx += x * x;
+            sum_xy += x * y;
+        }
+        const double n = (double)offsets.size();
+        const double denominator = n * sum_xx - sum_x * sum_x;
+        if(denominator > 0) {
+            out << "drift: " << std::setprecision(4) << ((n * sum_xy - sum_x * sum_y) / denominator) << " s/day" << std::endl;
+        }
+    }
+    out << std::endl;
+
+    if(!stats.errors.empty()) {
+        out << "errors" << std::endl;
+        for(auto &item : stats.errors) {
+            out << std::left << std::setw(40) << item.first << std::right << std::setw(10) << item.second << std::endl;
+        }
+    }
+}
+
+/* обработать все аргументы */
+bool process_arguments(
+    const int argc,
+    char **argv,
+    std::function<void(
+        const std::string &key,
+        const std::string &value)> f) noexcept {
+    if(argc <= 1) return false;
+    bool is_error = true;
+    for(int i = 1; i < argc; ++i) {
+        std::string key = std::string(argv[i]);
+        if(key.size() > 0 && (key[0] == '-' || key[0] == '/')) {
+            uint32_t delim_offset = 0;
+            if(key.size() > 2 && (key.substr(2) == "--") == 0) delim_offset = 1;
+            std::string value;
+            if((i + 1) < argc) value = std::string(argv[i + 1]);
+            is_error = false;
+            f(key.substr(delim_offset), value);
+        }
+    }
+    return !is_error;
+}
+
+int main(int argc, char **argv) {
+    std::cout << "intrade.bar log analyzer" << std::endl;
+    std::cout
+        << "version: " << PROGRAM_VERSION
+        << " date: " << PROGRAM_DATE
+        << std::endl << std::endl;
+
+    std::vector<std::string> paths;
+    std::string output_file;
+    uint32_t number_threads = std::max(1U, std::thread::hardware_concurrency());
+    size_t chunk_size = 16 * 1024 * 1024;
+
+    if(!process_arguments(
+            argc,
+            argv,
+            [&](
+                const std::string &key,
+                const std::string &value){
+        if(key == "path" || key == "p") {
+            paths.push_back(value);
+        } else
+        if(key == "output" || key == "o") {
+            output_file = value;
+        } else
+        if(key == "threads" || key == "t") {
+            number_threads = std::max(1, atoi(value.c_str()));
+        } else
+        if(key == "chunk_size" || key == "cs") {
+            chunk_size = (size_t)std::max(1, atoi(value.c_str())) * 1024 * 1024;
+        }
+    }) || paths.empty()) {
+        std::cerr << "Error! No parameters! Use: -path logger [-path file.log.zst] [-threads 8] [-output report.txt]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const auto start_time = std::chrono::steady_clock::now();
+
+    std::vector<std::string> file_list;
+    for(size_t i = 0; i < paths.size(); ++i) {
+        add_log_files(paths[i], file_list);
+    }
+
+    /* отображаем файлы в память, сжатые файлы распаковываем параллельно */
+    std::vector<LogView> views(file_list.size());
+    {
+        std::atomic<size_t> next_file = ATOMIC_VAR_INIT(0);
+        std::vector<std::future<void>> loaders;
+        for(uint32_t t = 0; t < number_threads; ++t) {
+            loaders.push_back(std::async(std::launch::async, [&]() {
+                while(true) {
+                    const size_t index = next_file++;
+                    if(index >= views.size()) break;
+                    views[index].file_name = file_list[index];
+                    load_log_view(views[index]);
+                }
+            }));
+        }
+        for(size_t t = 0; t < loaders.size(); ++t) loaders[t].wait();
+    }
+
+    /* делим файлы на фрагменты по границам строк */
+    std::vector<std::pair<const char*, const char*>> chunks;
+    size_t total_size = 0;
+    for(size_t i = 0; i < views.size(); ++i) {
+        if(views[i].is_error) {
+            std::cerr << "error reading file: " << views[i].file_name << std::endl;
+            continue;
+        }
+        const char *begin = views[i].data;
+        const char *end = views[i].data + views[i].size;
+        total_size += views[i].size;
+        while(begin < end) {
+            const char *stop = begin + std::min(chunk_size, (size_t)(end - begin));
+            if(stop < end) {
+                const char *line_end = (const char*)std::memchr(stop, '\n', end - stop);
+                stop = line_end == nullptr ? end : line_end + 1;
+            }
+            chunks.push_back(std::make_pair(begin, stop));
+            begin = stop;
+        }
+    }
+
+    /* обрабатываем фрагменты, каждый поток ведет свою статистику */
+    std::vector<Stats> thread_stats(number_threads);
+    {
+        std::atomic<size_t> next_chunk = ATOMIC_VAR_INIT(0);
+        std::vector<std::future<void>> workers;
+        for(uint32_t t = 0; t < number_threads; ++t) {
+            workers.push_back(std::async(std::launch::async, [&, t]() {
+                while(true) {
+                    const size_t index = next_chunk++;
+                    if(index >= chunks.size()) break;
+                    process_chunk(chunks[index].first, chunks[index].second, thread_stats[t]);
+                }
+            }));
+        }
+        for(size_t t = 0; t < workers.size(); ++t) workers[t].wait();
+    }
+
+    Stats stats;
+    for(size_t t = 0; t < thread_stats.size(); ++t) {
+        stats.merge(thread_stats[t]);
+    }
+
+    const double work_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    std::cout << "files: " << views.size()
+        << " size: " << (total_size / (1024 * 1024)) << " MB"
+        << " time: " << work_time << " s"
+        << " threads: " << number_threads << std::endl;
+
+    if(!output_file.empty()) {
+        std::ofstream output(output_file);
+        print_report(stats, output);
+    }
+    print_report(stats, std::cout);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,216 @@
+/*
+* intrade-bar-api-cpp - C ++ API client for intrade.bar
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#include <iostream>
+#include <functional>
+#include <cstdlib>
+#include <cstdio>
+#include <csignal>
+#include <dir.h>
+#include "intrade-bar-https-api.hpp"
+#include "intrade-bar-tick-backfill.hpp"
+
+#define PROGRAM_VERSION "1.0"
+#define PROGRAM_DATE    "19.10.2026"
+
+using namespace std;
+
+intrade_bar::TickBackfill *backfill_ptr = nullptr;
+
+void signal_handler_stop(int signal) {
+    if(backfill_ptr != nullptr) backfill_ptr->stop();
+}
+
+/* обработать все аргументы */
+bool process_arguments(
+    const int argc,
+    char **argv,
+    std::function<void(
+        const std::string &key,
+        const std::string &value)> f) noexcept {
+    if(argc <= 1) return false;
+    bool is_error = true;
+    for(int i = 1; i < argc; ++i) {
+        std::string key = std::string(argv[i]);
+        if(key.size() > 0 && (key[0] == '-' || key[0] == '/')) {
+            uint32_t delim_offset = 0;
+            if(key.size() > 2 && (key.substr(2) == "--") == 0) delim_offset = 1;
+            std::string value;
+            if((i + 1) < argc) value = std::string(argv[i + 1]);
+            is_error = false;
+            f(key.substr(delim_offset), value);
+        }
+    }
+    return !is_error;
+}
+
+/* разобрать дату в формате ДД.ММ.ГГГГ */
+bool parse_date(const std::string &value, xtime::timestamp_t &timestamp) {
+    int day = 0, month = 0, year = 0;
+    if(std::sscanf(value.c_str(), "%d.%d.%d", &day, &month, &year) != 3) return false;
+    timestamp = xtime::get_timestamp(day, month, year);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    std::cout << "intrade.bar tick backfill" << std::endl;
+    std::cout
+        << "version: " << PROGRAM_VERSION
+        << " date: " << PROGRAM_DATE
+        << std::endl << std::endl;
+
+    uint32_t max_threads = 8;       // максимальное количество одновременных запросов
+    uint32_t window_minutes = 60;   // длительность окна запроса, минуты
+    bool is_only_broker_supported_currency_pairs = true;
+    xtime::timestamp_t start_date = 0;
+    xtime::timestamp_t stop_date = 0;
+
+    std::string point("1.intrade.bar");
+    std::string path_archive;
+    std::string symbol_name;
+    std::string sert_file("curl-ca-bundle.crt");
+    std::string cookie_file("intrade-bar.cookie");
+    std::string file_name_bets_log("logger/intrade-bar-bets.log");
+    std::string file_name_work_log("logger/intrade-bar-https-work.log");
+    bool is_date_error = false;
+
+    if(!process_arguments(
+            argc,
+            argv,
+            [&](
+                const std::string &key,
+                const std::string &value){
+        if(key == "point") {
+            point = value;
+        } else
+        if(key == "path_archive" || key == "pa") {
+            path_archive = value;
+        } else
+        if(key == "symbol" || key == "s") {
+            symbol_name = value;
+        } else
+        if(key == "start_date" || key == "sd") {
+            if(!parse_date(value, start_date)) is_date_error = true;
+        } else
+        if(key == "stop_date" || key == "ed") {
+            if(!parse_date(value, stop_date)) is_date_error = true;
+        } else
+        if(key == "window_minutes" || key == "wm") {
+            window_minutes = std::max(1, atoi(value.c_str()));
+        } else
+        if(key == "max_threads" || key == "mt") {
+            max_threads = std::max(1, atoi(value.c_str()));
+        } else
+        if(key == "all_currency_pairs" || key == "acp") {
+            is_only_broker_supported_currency_pairs = false;
+        } else
+        if(key == "sert_file") {
+            sert_file = value;
+        } else
+        if(key == "cookie_file") {
+            cookie_file = value;
+        }
+    })) {
+        std::cerr << "Error! No parameters!" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    /* по умолчанию загружаем до последнего завершенного дня */
+    const xtime::timestamp_t last_day = xtime::get_first_timestamp_day(xtime::get_timestamp()) - xtime::SECONDS_IN_DAY;
+    if(stop_date == 0 || stop_date > last_day) stop_date = last_day;
+    if(path_archive.empty() || start_date == 0 || is_date_error || start_date > stop_date) {
+        std::cerr << "parameter error: path_archive and start_date (DD.MM.YYYY) are required" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "path archive: " << path_archive << std::endl;
+    std::cout << "dates: " << xtime::get_str_date(start_date) << " - " << xtime::get_str_date(stop_date) << std::endl;
+    std::cout << "window: " << window_minutes << " min" << std::endl << std::endl;
+
+    mkdir(path_archive.c_str());
+
+    intrade_bar::TickBackfill backfill(
+        point,
+        sert_file,
+        cookie_file,
+        file_name_bets_log,
+        file_name_work_log);
+    backfill.set_concurrency(1, max_threads, std::min(2U, max_threads));
+    backfill.set_window(window_minutes);
+    backfill.set_retry(5, 1.0, 60.0);
+
+    for(uint32_t symbol = 0; symbol < intrade_bar_common::CURRENCY_PAIRS; ++symbol) {
+        const std::string &name = intrade_bar_common::currency_pairs[symbol];
+        if(!symbol_name.empty() && symbol_name != name) continue;
+        if(symbol_name.empty() &&
+            is_only_broker_supported_currency_pairs &&
+            !intrade_bar_common::is_currency_pairs[symbol]) continue;
+        backfill.add_days(path_archive, symbol, start_date, stop_date);
+    }
+
+    backfill_ptr = &backfill;
+    std::signal(SIGINT, signal_handler_stop);
+    std::signal(SIGTERM, signal_handler_stop);
+
+    intrade_bar::TickRecorder recorder(path_archive);
+
+    /* выводим статистику загрузки раз в 10 секунд */
+    std::atomic<bool> is_finished;
+    is_finished = false;
+    std::future<void> stats_future = std::async(std::launch::async, [&]() {
+        uint32_t tick = 0;
+        while(!is_finished) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            if(++tick % 100 != 0) continue;
+            const intrade_bar::TickBackfill::Stats stats = backfill.get_stats();
+            intrade_bar_common::PrintThread{}
+                << "progress: " << (stats.completed + stats.empty + stats.failed) << "/" << stats.days
+                << ", windows: " << stats.windows
+                << ", ticks: " << stats.ticks
+                << ", retries: " << stats.retries
+                << ", ddos: " << stats.ddos
+                << ", concurrency: " << stats.limit
+                << std::endl;
+        }
+    });
+
+    const int err = backfill.run(recorder);
+    is_finished = true;
+    stats_future.wait();
+    backfill_ptr = nullptr;
+
+    const intrade_bar::TickBackfill::Stats stats = backfill.get_stats();
+    std::cout
+        << "days: " << stats.days
+        << ", with ticks: " << stats.completed
+        << ", empty: " << stats.empty
+        << ", failed: " << stats.failed << std::endl
+        << "ticks: " << stats.ticks
+        << ", overlap duplicates: " << stats.duplicates << std::endl;
+    if(err != intrade_bar_common::OK) {
+        std::cerr << "backfill error: " << err << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "ok" << std::endl;
+    return EXIT_SUCCESS;
+}
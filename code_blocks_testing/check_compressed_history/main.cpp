@@ -0,0 +1,136 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include "intrade-bar-compressed-history.hpp"
+
+using namespace intrade_bar;
+using namespace intrade_bar_common;
+
+bool is_equal(const xquotes_common::Candle &a, const xquotes_common::Candle &b) {
+    return a.open == b.open && a.high == b.high && a.low == b.low &&
+        a.close == b.close && a.volume == b.volume && a.timestamp == b.timestamp;
+}
+
+int main() {
+    std::cout << "check compressed history" << std::endl;
+    /* полгода минутных баров EURUSD */
+    const size_t number_bars = 180 * 1440;
+    const uint32_t scale = pricescale_currency_pairs[0];
+
+    std::mt19937 generator(1);
+    std::normal_distribution<double> step(0.0, 3.0);
+    std::uniform_int_distribution<int> shadow(0, 15);
+    std::uniform_int_distribution<int> volume(0, 200);
+    std::uniform_int_distribution<int> gap(0, 999);
+
+    std::vector<xquotes_common::Candle> candles;
+    int64_t price = 113000;
+    xtime::timestamp_t timestamp = 1546300800;
+    for(size_t b = 0; b < number_bars; ++b) {
+        timestamp += xtime::SECONDS_IN_MINUTE;
+        /* пропуски данных - бары с нулевыми ценами */
+        if(gap(generator) == 0) {
+            candles.push_back(xquotes_common::Candle(0, 0, 0, 0, 0, timestamp));
+            continue;
+        }
+        const int64_t open = price;
+        price += (int64_t)std::llround(step(generator));
+        const int64_t high = std::max(open, price) + shadow(generator);
+        const int64_t low = std::min(open, price) - shadow(generator);
+        candles.push_back(xquotes_common::Candle(
+            (double)open / (double)scale,
+            (double)high / (double)scale,
+            (double)low / (double)scale,
+            (double)price / (double)scale,
+            volume(generator),
+            timestamp));
+    }
+    /* бар, который нельзя перевести в тики без потерь */
+    candles[1000].close += 0.3 / (double)scale;
+
+    CompressedCandleHistory history(scale);
+    auto start = std::chrono::steady_clock::now();
+    history.append(candles.data(), candles.size());
+    auto stop = std::chrono::steady_clock::now();
+    const double append_time = std::chrono::duration<double>(stop - start).count();
+
+    /* распаковка всех блоков в буфер */
+    std::vector<xquotes_common::Candle> buffer(CompressedCandleHistory::BLOCK_BARS * 2);
+    size_t errors = 0;
+    size_t offset = 0;
+    start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < history.get_num_blocks(); ++i) {
+        const uint32_t count = history.decode_block(i, buffer.data());
+        for(uint32_t j = 0; j < count; ++j) {
+            if(!is_equal(buffer[j], candles[offset + j])) ++errors;
+        }
+        offset += count;
+    }
+    stop = std::chrono::steady_clock::now();
+    const double decode_time = std::chrono::duration<double>(stop - start).count();
+    if(offset != candles.size() || history.size() != candles.size()) ++errors;
+
+    /* доступ по смещению и по метке времени */
+    xquotes_common::Candle candle;
+    for(size_t i = 0; i < candles.size(); i += 7) {
+        if(!history.get_candle(candles.size() - i - 1, candle) || !is_equal(candle, candles[i])) ++errors;
+        if(!history.get_timestamp_candle(candles[i].timestamp, candle) || !is_equal(candle, candles[i])) ++errors;
+    }
+
+    /* замена и вставка баров в середину истории */
+    std::uniform_int_distribution<size_t> position(0, candles.size() - 1);
+    for(size_t i = 0; i < 1000; ++i) {
+        const size_t index = position(generator);
+        candles[index].close = candles[index].open;
+        candles[index].volume += 1;
+        history.update(candles[index]);
+    }
+    std::vector<xquotes_common::Candle> range;
+    history.get_candles(candles[5000].timestamp, candles[100000].timestamp, range);
+    if(range.size() != 95001) ++errors;
+    for(size_t i = 0; i < range.size() && i < 95001; ++i) {
+        if(!is_equal(range[i], candles[5000 + i])) ++errors;
+    }
+
+    /* объединение диапазона баров с блоками и добавление баров перед началом истории */
+    for(size_t i = 50000; i < 70000; ++i) candles[i].volume += 2;
+    start = std::chrono::steady_clock::now();
+    history.merge(candles.data() + 50000, 20000);
+    stop = std::chrono::steady_clock::now();
+    const double merge_time = std::chrono::duration<double>(stop - start).count();
+    std::vector<xquotes_common::Candle> old_candles;
+    for(size_t i = 1000; i > 0; --i) {
+        xquotes_common::Candle old_candle = candles[i];
+        old_candle.timestamp = candles.front().timestamp - i * xtime::SECONDS_IN_MINUTE;
+        old_candles.push_back(old_candle);
+    }
+    history.merge(old_candles.data(), old_candles.size());
+    candles.insert(candles.begin(), old_candles.begin(), old_candles.end());
+    range.clear();
+    history.get_candles(candles.front().timestamp, candles.back().timestamp, range);
+    if(range.size() != candles.size() || history.size() != candles.size()) ++errors;
+    for(size_t i = 0; i < range.size() && i < candles.size(); ++i) {
+        if(!is_equal(range[i], candles[i])) ++errors;
+    }
+
+    /* ограничение истории действует и после записи старых баров */
+    CompressedCandleHistory limited(scale);
+    limited.set_max_bars(10000);
+    limited.append(candles.data() + 20000, 20000);
+    limited.merge(candles.data(), 30000);
+    if(limited.size() < 10000 || limited.size() >= 10000 + CompressedCandleHistory::BLOCK_BARS * 2) ++errors;
+    if(limited.get_last_timestamp() != candles[39999].timestamp) ++errors;
+
+    const size_t raw_bytes = candles.size() * sizeof(xquotes_common::Candle);
+    const size_t compressed_bytes = history.get_memory_usage();
+    std::cout << "bars: " << history.size() << " blocks: " << history.get_num_blocks() << std::endl;
+    std::cout << "memory: " << raw_bytes << " -> " << compressed_bytes << " bytes (x"
+        << ((double)raw_bytes / (double)compressed_bytes) << ")" << std::endl;
+    std::cout << "append: " << (append_time * 1e9 / (double)candles.size()) << " ns/bar" << std::endl;
+    std::cout << "decode: " << (decode_time * 1e9 / (double)candles.size()) << " ns/bar" << std::endl;
+    std::cout << "merge: " << (merge_time * 1e9 / 20000.0) << " ns/bar" << std::endl;
+    std::cout << "errors: " << errors << std::endl;
+    return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include "intrade-bar-covariance-engine.hpp"
+
+using namespace intrade_bar;
+using namespace intrade_bar_common;
+
+const uint32_t WINDOW = 60;
+
+/* пересчет ковариации по всему окну */
+double naive_covariance(
+        const std::vector<std::vector<double>> &returns,
+        const uint32_t a,
+        const uint32_t b) {
+    const size_t start = returns[a].size() - WINDOW;
+    double mean_a = 0, mean_b = 0;
+    for(size_t i = start; i < returns[a].size(); ++i) {
+        mean_a += returns[a][i];
+        mean_b += returns[b][i];
+    }
+    mean_a /= (double)WINDOW;
+    mean_b /= (double)WINDOW;
+    double sum = 0;
+    for(size_t i = start; i < returns[a].size(); ++i) {
+        sum += (returns[a][i] - mean_a) * (returns[b][i] - mean_b);
+    }
+    return sum / (double)(WINDOW - 1);
+}
+
+int main() {
+    std::cout << "check covariance engine" << std::endl;
+    const size_t number_bars = 20000;
+
+    CovarianceEngine engine(WINDOW);
+    std::mt19937 generator(1);
+    std::normal_distribution<double> step(0.0, 0.0002);
+    std::array<double, CURRENCY_PAIRS> prices;
+    for(uint32_t s = 0; s < CURRENCY_PAIRS; ++s) prices[s] = 1.0 + 0.01 * s;
+
+    std::vector<std::vector<double>> returns(CURRENCY_PAIRS);
+    double engine_time = 0, naive_time = 0, max_error = 0, max_correlation_error = 0;
+    xtime::timestamp_t timestamp = 1546300800;
+    for(size_t b = 0; b < number_bars; ++b) {
+        /* общий фактор, чтобы корреляции были не нулевыми */
+        const double common = step(generator);
+        for(uint32_t s = 0; s < CURRENCY_PAIRS; ++s) {
+            const double price = prices[s] * std::exp(common + step(generator));
+            if(b > 0) returns[s].push_back(std::log(price / prices[s]));
+            prices[s] = price;
+        }
+        timestamp += xtime::SECONDS_IN_MINUTE;
+
+        auto start = std::chrono::steady_clock::now();
+        engine.update(prices, timestamp);
+        auto stop = std::chrono::steady_clock::now();
+        engine_time += std::chrono::duration<double>(stop - start).count();
+
+        /* первый бар не дает доходности, поэтому окно заполнено ровно на WINDOW доходностях */
+        if(returns[0].size() < WINDOW) {
+            if(engine.get_snapshot()->ready()) {
+                std::cout << "snapshot is ready too early" << std::endl;
+                return 1;
+            }
+            continue;
+        }
+        start = std::chrono::steady_clock::now();
+        std::shared_ptr<const CovarianceSnapshot> snapshot = engine.get_snapshot();
+        for(uint32_t i = 0; i < CURRENCY_PAIRS; ++i) {
+            for(uint32_t j = 0; j < CURRENCY_PAIRS; ++j) {
+                const double covariance = naive_covariance(returns, i, j);
+                max_error = std::max(max_error, std::abs(covariance - snapshot->get_covariance(i, j)));
+                if(i == j) continue;
+                const double correlation = covariance /
+                    std::sqrt(naive_covariance(returns, i, i) * naive_covariance(returns, j, j));
+                max_correlation_error = std::max(max_correlation_error, std::abs(correlation - snapshot->get_correlation(i, j)));
+            }
+        }
+        stop = std::chrono::steady_clock::now();
+        naive_time += std::chrono::duration<double>(stop - start).count();
+        if(!snapshot->ready() || snapshot->timestamp != timestamp) {
+            std::cout << "snapshot error" << std::endl;
+            return 1;
+        }
+    }
+    std::cout << "instruction set: " << (int)price_kernels::get_instruction_set() << std::endl;
+    std::cout << "engine: " << (engine_time * 1e9 / (double)number_bars) << " ns/bar (26 symbols)" << std::endl;
+    std::cout << "recompute window: " << (naive_time * 1e9 / (double)number_bars) << " ns/bar (26 symbols)" << std::endl;
+    std::cout << "max covariance error: " << max_error << std::endl;
+    std::cout << "max correlation error: " << max_correlation_error << std::endl;
+    return max_error < 1e-12 && max_correlation_error < 1e-9 ? 0 : 1;
+}
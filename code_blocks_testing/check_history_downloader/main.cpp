@@ -0,0 +1,81 @@
+#include <iostream>
+#include <thread>
+#include <future>
+#include <chrono>
+#include "intrade-bar-history-downloader.hpp"
+
+using namespace intrade_bar;
+
+/* Проверка повторного запуска загрузчика после stop()
+ *
+ * Точка доступа недоступна, поэтому все задачи уходят в повторные попытки
+ * и первый запуск прерывается вызовом stop(). Второй запуск без задач
+ * должен сразу завершиться, а третий - посчитать только свои задачи.
+ * Последний запуск проверяет деление длинного диапазона по лимиту баров.
+ */
+int main() {
+    std::cout << "check history downloader" << std::endl;
+    const uint32_t number_tasks = 8;
+    const xtime::timestamp_t date_start = xtime::get_first_timestamp_day(xtime::get_timestamp()) - 7 * xtime::SECONDS_IN_DAY;
+    HistoryDownloader downloader("127.0.0.1:1");
+    downloader.set_concurrency(1, 2, 2);
+    downloader.set_retry(100, 0.05, 0.2);
+    downloader.set_timeout(1);
+
+    auto add_tasks = [&]() {
+        for(uint32_t s = 0; s < number_tasks; ++s) {
+            downloader.add_task(s, date_start, date_start + xtime::SECONDS_IN_DAY - xtime::SECONDS_IN_MINUTE);
+        }
+    };
+    auto run_and_stop = [&](const uint32_t run, const uint64_t expected_tasks) -> bool {
+        std::future<int> result = std::async(std::launch::async, [&]() {
+            return downloader.run(nullptr);
+        });
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        downloader.stop();
+        if(result.wait_for(std::chrono::seconds(10)) != std::future_status::ready) {
+            std::cout << "run " << run << ": run() did not return after stop()" << std::endl;
+            return false;
+        }
+        const int err = result.get();
+        const HistoryDownloader::Stats stats = downloader.get_stats();
+        std::cout << "run " << run << ": err " << err << " tasks " << stats.tasks << " retries " << stats.retries << std::endl;
+        if(stats.tasks != expected_tasks) {
+            std::cout << "run " << run << ": expected " << expected_tasks << " tasks" << std::endl;
+            return false;
+        }
+        return true;
+    };
+
+    add_tasks();
+    if(!run_and_stop(1, number_tasks)) return 1;
+
+    /* незавершенные задачи первого запуска не должны заставлять run() ждать */
+    std::future<int> empty_run = std::async(std::launch::async, [&]() {
+        return downloader.run(nullptr);
+    });
+    if(empty_run.wait_for(std::chrono::seconds(10)) != std::future_status::ready) {
+        std::cout << "run 2: run() without tasks hangs" << std::endl;
+        downloader.stop();
+        return 1;
+    }
+    const int err = empty_run.get();
+    const HistoryDownloader::Stats stats = downloader.get_stats();
+    std::cout << "run 2: err " << err << " tasks " << stats.tasks << " retries " << stats.retries << std::endl;
+    if(err != OK || stats.tasks != 0 || stats.retries != 0) {
+        std::cout << "run 2: statistics of the previous run were not reset" << std::endl;
+        return 1;
+    }
+
+    add_tasks();
+    if(!run_and_stop(3, number_tasks)) return 1;
+
+    /* диапазон в 5 дней при лимите в 2 дня делится по границам дней на 3 задачи */
+    downloader.set_history_max_bars(2 * xtime::MINUTES_IN_DAY);
+    /* повторная попытка не должна успеть разделить задачу после ошибки */
+    downloader.set_retry(100, 5.0, 10.0);
+    downloader.add_task(0, date_start + xtime::SECONDS_IN_HOUR, date_start + 5 * xtime::SECONDS_IN_DAY - xtime::SECONDS_IN_MINUTE);
+    if(!run_and_stop(4, 3)) return 1;
+    std::cout << "ok" << std::endl;
+    return 0;
+}
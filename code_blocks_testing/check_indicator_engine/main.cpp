@@ -0,0 +1,110 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include "intrade-bar-indicator-engine.hpp"
+
+using namespace intrade_bar;
+using namespace intrade_bar_common;
+
+const uint32_t SMA_PERIOD = 20;
+const uint32_t EMA_PERIOD = 50;
+const uint32_t RSI_PERIOD = 14;
+const uint32_t BB_PERIOD = 20;
+
+/* расчет по копии массива цен, как это делают стратегии сейчас */
+double naive_sma(const std::vector<double> &prices, const uint32_t period) {
+    double sum = 0;
+    for(size_t i = prices.size() - period; i < prices.size(); ++i) sum += prices[i];
+    return sum / (double)period;
+}
+
+double naive_ema(const std::vector<double> &prices, const uint32_t period) {
+    const double alpha = 2.0 / (double)(period + 1);
+    double ema = prices[0];
+    for(size_t i = 1; i < prices.size(); ++i) ema += alpha * (prices[i] - ema);
+    return ema;
+}
+
+double naive_rsi(const std::vector<double> &prices, const uint32_t period) {
+    double gain = 0, loss = 0;
+    for(size_t i = 1; i < prices.size(); ++i) {
+        const double change = prices[i] - prices[i - 1];
+        const double divider = (double)std::min<size_t>(i, period);
+        gain += ((change > 0 ? change : 0) - gain) / divider;
+        loss += ((change < 0 ? -change : 0) - loss) / divider;
+    }
+    return gain + loss == 0 ? 50.0 : 100.0 * gain / (gain + loss);
+}
+
+double naive_bollinger_upper(const std::vector<double> &prices, const uint32_t period) {
+    const double mean = naive_sma(prices, period);
+    double variance = 0;
+    for(size_t i = prices.size() - period; i < prices.size(); ++i) {
+        variance += (prices[i] - mean) * (prices[i] - mean);
+    }
+    return mean + 2.0 * std::sqrt(variance / (double)period);
+}
+
+int main() {
+    std::cout << "check indicator engine" << std::endl;
+    const size_t number_bars = 5000;
+    const size_t ticks_per_bar = 10;
+
+    IndicatorEngine<
+        indicators::Sma<SMA_PERIOD>,
+        indicators::Ema<EMA_PERIOD>,
+        indicators::Rsi<RSI_PERIOD>,
+        indicators::Bollinger<BB_PERIOD>> engine;
+
+    std::mt19937 generator(1);
+    std::normal_distribution<double> step(0.0, 0.0002);
+    std::array<double, CURRENCY_PAIRS> prices;
+    for(uint32_t s = 0; s < CURRENCY_PAIRS; ++s) prices[s] = 1.0 + 0.01 * s;
+
+    std::vector<std::vector<double>> history(CURRENCY_PAIRS);
+    double engine_time = 0, naive_time = 0, max_error = 0;
+    for(size_t b = 0; b < number_bars; ++b) {
+        for(size_t t = 0; t < ticks_per_bar; ++t) {
+            for(uint32_t s = 0; s < CURRENCY_PAIRS; ++s) prices[s] += step(generator);
+            const bool is_closed = (t + 1) == ticks_per_bar;
+
+            auto start = std::chrono::steady_clock::now();
+            engine.update(prices, is_closed);
+            auto stop = std::chrono::steady_clock::now();
+            engine_time += std::chrono::duration<double>(stop - start).count();
+
+            /* прежний способ: копия истории и пересчет на каждом обновлении */
+            start = std::chrono::steady_clock::now();
+            double checksum = 0;
+            for(uint32_t s = 0; s < CURRENCY_PAIRS; ++s) {
+                std::vector<double> copy = history[s];
+                copy.push_back(prices[s]);
+                if(copy.size() < EMA_PERIOD) continue;
+                checksum += naive_sma(copy, SMA_PERIOD) + naive_ema(copy, EMA_PERIOD) +
+                    naive_rsi(copy, RSI_PERIOD) + naive_bollinger_upper(copy, BB_PERIOD);
+                if(t == 0 && s == 0) {
+                    max_error = std::max(max_error, std::abs(naive_sma(copy, SMA_PERIOD) - engine.get<0>(s)));
+                    max_error = std::max(max_error, std::abs(naive_ema(copy, EMA_PERIOD) - engine.get<1>(s)));
+                    max_error = std::max(max_error, std::abs(naive_rsi(copy, RSI_PERIOD) - engine.get<2>(s)) / 100.0);
+                    max_error = std::max(max_error, std::abs(naive_bollinger_upper(copy, BB_PERIOD) - engine.get<3>(s, 1)));
+                }
+            }
+            stop = std::chrono::steady_clock::now();
+            naive_time += std::chrono::duration<double>(stop - start).count();
+            if(checksum == 12345.0) std::cout << "";
+
+            if(is_closed) {
+                for(uint32_t s = 0; s < CURRENCY_PAIRS; ++s) history[s].push_back(prices[s]);
+            }
+        }
+    }
+    const double updates = (double)(number_bars * ticks_per_bar);
+    std::cout << "instruction set: " << (int)price_kernels::get_instruction_set() << std::endl;
+    std::cout << "engine: " << (engine_time * 1e9 / updates) << " ns/update (26 symbols)" << std::endl;
+    std::cout << "copy and recompute: " << (naive_time * 1e9 / updates) << " ns/update (26 symbols)" << std::endl;
+    std::cout << "max error: " << max_error << std::endl;
+    std::cout << "sequence: " << engine.get_sequence() << std::endl;
+    return max_error < 1e-9 ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <ctime>
+#include <algorithm>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include "intrade-bar-logger.hpp"
+#include "intrade-bar-logger-zstd.hpp"
+
+/** \brief Получить процессорное время процесса
+ * \return Время в секундах
+ */
+double get_process_cpu_time() {
+#ifdef _WIN32
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+    if(!GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time)) return 0;
+    ULARGE_INTEGER kernel, user;
+    kernel.LowPart = kernel_time.dwLowDateTime;
+    kernel.HighPart = kernel_time.dwHighDateTime;
+    user.LowPart = user_time.dwLowDateTime;
+    user.HighPart = user_time.dwHighDateTime;
+    return (double)(kernel.QuadPart + user.QuadPart) / 10000000.0;
+#else
+    return (double)std::clock() / (double)CLOCKS_PER_SEC;
+#endif
+}
+
+int main() {
+    std::cout << "check logger throughput" << std::endl;
+    const size_t number_threads = 4;
+    const size_t number_messages = 250000;
+    const std::vector<std::string> files = {
+        "logger/check-logger-bets.log",
+        "logger/check-logger-work.log",
+        "logger/check-logger-websocket.log",
+    };
+
+    /* сегменты по 16 МБ сжимаются в фоне, поток записи не должен замедлиться */
+    intrade_bar::Logger::set_rotation(16 * 1024 * 1024, true, 5);
+    intrade_bar::LoggerZstd::enable();
+
+    /* пишем сообщения из нескольких потоков в несколько файлов */
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for(size_t t = 0; t < number_threads; ++t) {
+        threads.push_back(std::thread([&, t]() {
+            for(size_t i = 0; i < number_messages; ++i) {
+                nlohmann::json j;
+                j["function"] = "check_logger_throughput";
+                j["thread"] = t;
+                j["index"] = i;
+                intrade_bar::Logger::log(files[i % files.size()], j);
+            }
+        }));
+    }
+    for(size_t t = 0; t < threads.size(); ++t) {
+        threads[t].join();
+    }
+    auto stop_enqueue = std::chrono::steady_clock::now();
+    intrade_bar::Logger::flush();
+    auto stop_write = std::chrono::steady_clock::now();
+
+    const double total = (double)(number_threads * number_messages);
+    const double enqueue_time = std::chrono::duration<double>(stop_enqueue - start).count();
+    const double write_time = std::chrono::duration<double>(stop_write - start).count();
+    std::cout << "messages: " << total << std::endl;
+    std::cout << "enqueue: " << (enqueue_time * 1e9 / total) << " ns/msg" << std::endl;
+    std::cout << "throughput: " << (total / write_time) << " msg/s" << std::endl;
+
+    /* события: замеряем сам вызов log_event в каждом потоке */
+    std::vector<uint16_t> file_ids;
+    for(size_t f = 0; f < files.size(); ++f) {
+        file_ids.push_back(intrade_bar::Logger::get_file_id(files[f]));
+    }
+    const uint16_t event_id = intrade_bar::Logger::register_event(
+        "check_logger_throughput_event", {"thread", "index", "price"});
+    std::vector<double> event_times(number_threads, 0);
+    std::vector<double> event_max_times(number_threads, 0);
+    std::vector<size_t> event_written(number_threads, 0);
+    threads.clear();
+    start = std::chrono::steady_clock::now();
+    for(size_t t = 0; t < number_threads; ++t) {
+        threads.push_back(std::thread([&, t]() {
+            for(size_t i = 0; i < number_messages; ++i) {
+                const auto call_start = std::chrono::steady_clock::now();
+                const bool is_written = intrade_bar::Logger::log_event(
+                    file_ids[i % file_ids.size()], event_id, (int64_t)t, (int64_t)i, 1.0 + (double)i * 1e-5);
+                const auto call_stop = std::chrono::steady_clock::now();
+                const double call_time = std::chrono::duration<double>(call_stop - call_start).count();
+                event_times[t] += call_time;
+                if(call_time > event_max_times[t]) event_max_times[t] = call_time;
+                if(is_written) ++event_written[t];
+            }
+        }));
+    }
+    for(size_t t = 0; t < threads.size(); ++t) {
+        threads[t].join();
+    }
+    intrade_bar::Logger::flush();
+    stop_write = std::chrono::steady_clock::now();
+    double event_time = 0, event_max_time = 0;
+    size_t written = 0;
+    for(size_t t = 0; t < number_threads; ++t) {
+        event_time += event_times[t];
+        event_max_time = std::max(event_max_time, event_max_times[t]);
+        written += event_written[t];
+    }
+    std::cout << "log_event call: " << (event_time * 1e9 / total) << " ns/event (max "
+        << (event_max_time * 1e9) << " ns, clock overhead included)" << std::endl;
+    std::cout << "log_event written: " << written << " dropped: " << intrade_bar::Logger::get_dropped_events() << std::endl;
+    std::cout << "log_event throughput: "
+        << (total / std::chrono::duration<double>(stop_write - start).count()) << " events/s" << std::endl;
+
+    /* проверяем, что в простое логер не занимает процессор */
+    const double idle_time = 5.0;
+    const double cpu_start = get_process_cpu_time();
+    std::this_thread::sleep_for(std::chrono::milliseconds((uint64_t)(idle_time * 1000.0)));
+    const double cpu_stop = get_process_cpu_time();
+    std::cout << "idle cpu: " << (100.0 * (cpu_stop - cpu_start) / idle_time) << " %" << std::endl;
+    return 0;
+}
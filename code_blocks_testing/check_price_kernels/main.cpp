@@ -0,0 +1,103 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <functional>
+#include "intrade-bar-price-kernels.hpp"
+
+using namespace intrade_bar_common;
+
+/** \brief Замерить время обработки массива
+ * \return Время на один бар в наносекундах
+ */
+double measure(const size_t number_candles, const size_t number_runs, std::function<void()> f) {
+    f();
+    auto start = std::chrono::steady_clock::now();
+    for(size_t r = 0; r < number_runs; ++r) {
+        f();
+    }
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(stop - start).count() * 1e9 / (double)(number_candles * number_runs);
+}
+
+int main() {
+    std::cout << "check price kernels" << std::endl;
+    const size_t number_candles = 10000;    // размер одного ответа сервера
+    const size_t number_runs = 2000;
+    const uint32_t scale = 100000;
+
+    /* случайные цены на сетке тиков, ask выше bid на 0..3 тика,
+     * часть цен ask между тиками, как бывает у FXCM
+     */
+    std::mt19937 generator(1);
+    std::uniform_int_distribution<int> step(-5, 5);
+    std::uniform_int_distribution<int> spread(0, 3);
+    std::uniform_int_distribution<int> sub_tick(0, 3);
+    price_kernels::BidAskColumns source;
+    source.resize(number_candles);
+    int64_t ticks = 110000;
+    for(size_t i = 0; i < number_candles; ++i) {
+        std::vector<double>* bid[4] = {&source.bid_open, &source.bid_high, &source.bid_low, &source.bid_close};
+        std::vector<double>* ask[4] = {&source.ask_open, &source.ask_high, &source.ask_low, &source.ask_close};
+        for(size_t k = 0; k < 4; ++k) {
+            ticks += step(generator);
+            (*bid[k])[i] = (double)ticks / (double)scale;
+            const double fraction = sub_tick(generator) == 0 ? 0.5 : 0.0;
+            (*ask[k])[i] = ((double)(ticks + spread(generator)) + fraction) / (double)scale;
+        }
+        source.timestamp[i] = 1581956700 + i * 60;
+        source.volume[i] = 100;
+    }
+
+    /* прежний цикл: среднее значение и округление через uint64_t для каждого бара */
+    std::vector<xquotes_common::Candle> reference(number_candles);
+    const double reference_time = measure(number_candles, number_runs, [&]() {
+        for(size_t i = 0; i < number_candles; ++i) {
+            reference[i].timestamp = source.timestamp[i];
+            reference[i].open = (source.bid_open[i] + source.ask_open[i]) / 2.0;
+            reference[i].high = (source.bid_high[i] + source.ask_high[i]) / 2.0;
+            reference[i].low = (source.bid_low[i] + source.ask_low[i]) / 2.0;
+            reference[i].close = (source.bid_close[i] + source.ask_close[i]) / 2.0;
+            reference[i].volume = source.volume[i];
+            reference[i].open = (double)((uint64_t)(reference[i].open * (double)scale + 0.5)) / (double)scale;
+            reference[i].high = (double)((uint64_t)(reference[i].high * (double)scale + 0.5)) / (double)scale;
+            reference[i].low = (double)((uint64_t)(reference[i].low * (double)scale + 0.5)) / (double)scale;
+            reference[i].close = (double)((uint64_t)(reference[i].close * (double)scale + 0.5)) / (double)scale;
+        }
+    });
+    std::cout << "reference loop: " << reference_time << " ns/candle" << std::endl;
+
+    const price_kernels::InstructionSet sets[] = {
+        price_kernels::InstructionSet::SCALAR,
+        price_kernels::InstructionSet::SSE4,
+        price_kernels::InstructionSet::AVX2,
+    };
+    const char *names[] = {"scalar", "sse4.2", "avx2"};
+    size_t total_errors = 0;
+    for(size_t s = 0; s < 3; ++s) {
+        if(sets[s] > price_kernels::get_instruction_set()) {
+            std::cout << names[s] << ": not supported" << std::endl;
+            continue;
+        }
+        std::vector<double> output(number_candles);
+        const double kernel_time = measure(number_candles, number_runs, [&]() {
+            price_kernels::mid_price(source.bid_close.data(), source.ask_close.data(), output.data(), number_candles, scale, sets[s]);
+        });
+        std::vector<xquotes_common::Candle> candles;
+        const double time = measure(number_candles, number_runs, [&]() {
+            price_kernels::assemble_candles(source, candles, scale, sets[s]);
+        });
+        /* результат должен совпадать с прежним циклом бит в бит */
+        size_t errors = 0;
+        for(size_t i = 0; i < number_candles; ++i) {
+            if(candles[i].open != reference[i].open || candles[i].high != reference[i].high ||
+                candles[i].low != reference[i].low || candles[i].close != reference[i].close) ++errors;
+            if(Price::from_bid_ask(source.bid_close[i], source.ask_close[i], scale).to_double() != reference[i].close) ++errors;
+        }
+        total_errors += errors;
+        std::cout << names[s] << ": " << time << " ns/candle, mid price " << kernel_time << " ns/value, errors: " << errors << std::endl;
+    }
+    std::cout << "batch is used: " << (price_kernels::is_batch_faster() ? "yes" : "no") << std::endl;
+    std::cout << "errors: " << total_errors << std::endl;
+    return total_errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <cstdio>
+#include <dir.h>
+#include "intrade-bar-tick-recorder.hpp"
+
+using namespace intrade_bar;
+using namespace intrade_bar_common;
+
+int main() {
+    std::cout << "check tick recorder" << std::endl;
+    const std::string path = "check_tick_archive";
+    const size_t number_ticks = 500000;
+    mkdir(path.c_str());
+
+    std::mt19937 generator(1);
+    std::uniform_int_distribution<uint32_t> symbol(0, CURRENCY_PAIRS - 1);
+    std::uniform_int_distribution<int> step(-3, 3);
+    std::uniform_int_distribution<int> pause(0, 50);
+    std::array<int64_t, CURRENCY_PAIRS> bid;
+    bid.fill(100000);
+
+    /* тики пишутся с переходом через границу часа */
+    const xtime::ftimestamp_t start_timestamp = xtime::get_first_timestamp_hour(xtime::get_timestamp()) - 1800;
+    /* сегменты прошлого запуска в тех же часах удаляем, иначе прочитаются и их тики */
+    for(xtime::timestamp_t hour = (xtime::timestamp_t)start_timestamp - xtime::SECONDS_IN_HOUR;
+        hour <= (xtime::timestamp_t)start_timestamp + 8 * xtime::SECONDS_IN_HOUR;
+        hour += xtime::SECONDS_IN_HOUR) {
+        const std::string segment_name = TickArchive::get_segment_name(path, hour);
+        std::remove(segment_name.c_str());
+        std::remove((segment_name + ".idx").c_str());
+    }
+    xtime::ftimestamp_t timestamp = start_timestamp;
+    std::vector<RecordedTick> ticks;
+    double write_time = 0;
+    {
+        TickRecorder recorder(path);
+        for(size_t i = 0; i < number_ticks; ++i) {
+            RecordedTick tick;
+            tick.symbol_index = symbol(generator);
+            bid[tick.symbol_index] += step(generator);
+            timestamp += 0.001 * pause(generator);
+            tick.bid = Price(bid[tick.symbol_index], pricescale_currency_pairs[tick.symbol_index]);
+            tick.ask = Price(bid[tick.symbol_index] + 7, pricescale_currency_pairs[tick.symbol_index]);
+            tick.server_timestamp = timestamp;
+            tick.local_timestamp = timestamp + 0.125;
+            ticks.push_back(tick);
+
+            auto start = std::chrono::steady_clock::now();
+            recorder.write(tick.symbol_index, tick.bid.to_double(), tick.ask.to_double(), tick.server_timestamp, tick.local_timestamp);
+            auto stop = std::chrono::steady_clock::now();
+            write_time += std::chrono::duration<double>(stop - start).count();
+        }
+        recorder.flush();
+        if(recorder.get_last_error() != OK) {
+            std::cout << "write error: " << recorder.get_last_error() << std::endl;
+            return 1;
+        }
+    }
+
+    TickArchiveReader reader(path);
+    std::vector<RecordedTick> read_ticks;
+    auto start = std::chrono::steady_clock::now();
+    const int err = reader.get_ticks(start_timestamp, timestamp, read_ticks);
+    auto stop = std::chrono::steady_clock::now();
+    const double read_time = std::chrono::duration<double>(stop - start).count();
+    if(err != OK || read_ticks.size() != ticks.size()) {
+        std::cout << "read error: " << err << " ticks: " << read_ticks.size() << std::endl;
+        return 1;
+    }
+    for(size_t i = 0; i < ticks.size(); ++i) {
+        if(ticks[i].symbol_index != read_ticks[i].symbol_index ||
+            ticks[i].bid != read_ticks[i].bid ||
+            ticks[i].ask != read_ticks[i].ask ||
+            std::abs(ticks[i].server_timestamp - read_ticks[i].server_timestamp) > 1e-6 ||
+            std::abs(ticks[i].local_timestamp - read_ticks[i].local_timestamp) > 1e-6) {
+            std::cout << "tick mismatch: " << i << std::endl;
+            return 1;
+        }
+    }
+
+    /* сбой при записи: в конце сегмента оборванный блок, после него запись продолжается */
+    const std::string segment_name = TickArchive::get_segment_name(path, (xtime::timestamp_t)timestamp);
+    {
+        std::ofstream segment(segment_name, std::ios_base::binary | std::ios_base::app);
+        TickArchive::BlockHeader header;
+        header.compressed_size = 4096;
+        header.count = 100;
+        segment.write((const char*)&header, sizeof(header));
+        const std::vector<char> data(1000, 0x55);
+        segment.write(data.data(), data.size());
+    }
+    {
+        TickRecorder recorder(path);
+        for(size_t i = 0; i < 1000; ++i) {
+            RecordedTick tick;
+            tick.symbol_index = symbol(generator);
+            timestamp += 0.001;
+            tick.bid = Price(bid[tick.symbol_index], pricescale_currency_pairs[tick.symbol_index]);
+            tick.ask = Price(bid[tick.symbol_index] + 7, pricescale_currency_pairs[tick.symbol_index]);
+            tick.server_timestamp = timestamp;
+            tick.local_timestamp = timestamp;
+            ticks.push_back(tick);
+            recorder.write(tick.symbol_index, tick.bid.to_double(), tick.ask.to_double(), tick.server_timestamp, tick.local_timestamp);
+        }
+        recorder.flush();
+    }
+    if(reader.get_ticks(start_timestamp, timestamp, read_ticks) != OK || read_ticks.size() != ticks.size()) {
+        std::cout << "read after torn block error, ticks: " << read_ticks.size() << " expected: " << ticks.size() << std::endl;
+        return 1;
+    }
+
+    std::cout << "write: " << (write_time * 1e9 / (double)number_ticks) << " ns/tick" << std::endl;
+    std::cout << "read: " << (read_time * 1e9 / (double)number_ticks) << " ns/tick" << std::endl;
+    std::cout << "ok" << std::endl;
+    return 0;
+}
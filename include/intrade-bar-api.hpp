@@ -26,7 +26,9 @@
 
 #include "intrade-bar-https-api.hpp"
 #include "intrade-bar-websocket-api-v2.hpp"
+#include "intrade-bar-timeframe-aggregator.hpp"
 #include <future>
+#include <set>
 
 namespace intrade_bar {
     using json = nlohmann::json;
@@ -40,12 +42,72 @@ namespace intrade_bar {
         enum class EventType {
             NEW_TICK,                   /**< Получен новый тик */
             HISTORICAL_DATA_RECEIVED,   /**< Получены исторические данные */
+            HISTORICAL_DATA_CORRECTED,  /**< Исторические данные отличаются от закрытого бара потока котировок */
         };
     private:
         IntradeBarHttpApi http_api;
         QuotationsStream websocket_api;
         std::future<void> callback_future;
         std::atomic<bool> is_stop_command;          /**< Команда закрытия соединения */
+        std::atomic<bool> is_instant_bar_sealing;   /**< Закрывать бары по потоку котировок, не дожидаясь исторических данных */
+        std::atomic<uint32_t> sealing_watermark;    /**< Время ожидания тиков следующей минуты, мс */
+        std::atomic<bool> is_compressed_history;    /**< Загруженная история передается в сжатую историю потока котировок */
+        std::mutex callback_mutex;                  /**< Блокировка вызова callback из разных потоков */
+
+        std::future<void> sealing_future;           /**< Поток закрытия баров по потоку котировок */
+        std::mutex sealing_mutex;
+        std::set<xtime::timestamp_t> sealing_bars;  /**< Бары, ожидающие закрытия */
+
+        /** \brief Закрытый бар, ожидающий сверки с историческими данными
+         */
+        class ReconcileBar {
+        public:
+            std::map<std::string,xquotes_common::Candle> candles;   /**< Бары потока котировок */
+            xtime::ftimestamp_t next_attempt = 0;                   /**< Время сервера следующей попытки */
+            uint32_t attempt = 0;                                   /**< Номер попытки */
+        };
+
+        std::future<void> reconcile_future;         /**< Поток сверки закрытых баров с историческими данными */
+        std::mutex reconcile_mutex;
+        std::map<xtime::timestamp_t, ReconcileBar> reconcile_bars; /**< Закрытые бары, ожидающие сверки */
+        const xtime::ftimestamp_t reconcile_delay = 1.0;       /**< Задержка первой сверки после закрытия бара, сек */
+        const xtime::ftimestamp_t reconcile_max_delay = 16.0;  /**< Максимальная пауза между попытками сверки, сек */
+        const xtime::ftimestamp_t reconcile_deadline = 180.0;  /**< Время после закрытия бара, после которого сверка прекращается, сек */
+
+        std::future<void> repair_future;            /**< Поток восстановления пропусков в данных */
+        std::atomic<double> gap_repair_stale_time;  /**< Время без тиков, после которого символ считается без данных, сек */
+        std::atomic<bool> is_gap_repair;            /**< Восстанавливать пропуски в данных */
+        std::mutex repair_start_mutex;
+
+        TimeframeAggregator timeframe_aggregator;   /**< Бары старших таймфреймов */
+        std::function<void(
+            const std::map<std::string,xquotes_common::Candle> &candles,
+            const EventType event,
+            const xtime::timestamp_t timestamp,
+            const uint32_t period)> timeframe_callback; /**< Callback баров старших таймфреймов, вызывается под callback_mutex */
+
+        /** \brief Обновить бары старших таймфреймов минутными барами события
+         * \param candles Минутные бары символов
+         * \param event Событие
+         * \param timestamp Метка времени события
+         */
+        void update_timeframes(
+                const std::map<std::string,xquotes_common::Candle> &candles,
+                const EventType event,
+                const xtime::timestamp_t timestamp) {
+            if(timeframe_aggregator.empty()) return;
+            for(auto &item : candles) {
+                auto it_symbol = currency_pairs_indx.find(item.first);
+                if(it_symbol == currency_pairs_indx.end()) continue;
+                timeframe_aggregator.update(it_symbol->second, item.second);
+            }
+            if(timeframe_callback == nullptr) return;
+            const std::vector<uint32_t> periods = timeframe_aggregator.get_periods();
+            for(size_t p = 0; p < periods.size(); ++p) {
+                const xtime::timestamp_t bar_timestamp = TimeframeAggregator::get_bar_timestamp(periods[p], timestamp);
+                timeframe_callback(timeframe_aggregator.get_candles(periods[p], bar_timestamp), event, bar_timestamp, periods[p]);
+            }
+        }
 
         /** \brief Скачать исторические данные в несколько потоков
          *
@@ -195,6 +257,371 @@ namespace intrade_bar {
             }
         }
 
+        /** \brief Получить бары всех символов из потока котировок
+         * \param timestamp Метка времени бара
+         * \return Карта баров, ключ - имя символа
+         */
+        std::map<std::string, xquotes_common::Candle> get_stream_candles(const xtime::timestamp_t timestamp) {
+            std::map<std::string, xquotes_common::Candle> candles;
+            for(uint32_t symbol_index = 0;
+                symbol_index < intrade_bar_common::CURRENCY_PAIRS;
+                ++symbol_index) {
+                candles[intrade_bar_common::currency_pairs[symbol_index]] =
+                    websocket_api.get_timestamp_candle(symbol_index, timestamp);
+            }
+            return candles;
+        }
+
+        /** \brief Ждать закрытия бара по потоку котировок
+         *
+         * Бар символа закрыт, когда пришел тик следующей минуты.
+         * Символы без тиков ждем не дольше водяного знака.
+         * \param bar_timestamp Метка времени бара
+         * \return Вернет false, если пришла команда закрытия
+         */
+        bool wait_bar_sealing(const xtime::timestamp_t bar_timestamp) {
+            const xtime::ftimestamp_t next_bar_timestamp = bar_timestamp + xtime::SECONDS_IN_MINUTE;
+            const xtime::ftimestamp_t stop_timestamp = next_bar_timestamp +
+                (xtime::ftimestamp_t)sealing_watermark / 1000.0;
+            while(!is_stop_command) {
+                bool is_sealed = true;
+                for(uint32_t symbol_index = 0;
+                    symbol_index < intrade_bar_common::CURRENCY_PAIRS;
+                    ++symbol_index) {
+                    if(!websocket_api.check_init_symbol(symbol_index)) continue;
+                    if(websocket_api.get_last_tick_timestamp(symbol_index) < next_bar_timestamp) {
+                        is_sealed = false;
+                        break;
+                    }
+                }
+                if(is_sealed) return true;
+                if(websocket_api.get_server_timestamp() >= stop_timestamp) return true;
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            return false;
+        }
+
+        /** \brief Проверить совпадение баров с точностью до пункта
+         * \param symbol_index Индекс символа
+         * \param a Первый бар
+         * \param b Второй бар
+         * \return Вернет true, если цены баров совпадают
+         */
+        static bool compare_candles(
+                const uint32_t symbol_index,
+                const xquotes_common::Candle &a,
+                const xquotes_common::Candle &b) {
+            using intrade_bar_common::get_price;
+            return  get_price(a.open, symbol_index) == get_price(b.open, symbol_index) &&
+                    get_price(a.high, symbol_index) == get_price(b.high, symbol_index) &&
+                    get_price(a.low, symbol_index) == get_price(b.low, symbol_index) &&
+                    get_price(a.close, symbol_index) == get_price(b.close, symbol_index);
+        }
+
+        /** \brief Поставить закрытый бар в очередь сверки
+         * \param bar_timestamp Метка времени бара
+         * \param sealed_candles Бары потока котировок
+         */
+        void add_reconcile_bar(
+                const xtime::timestamp_t bar_timestamp,
+                const std::map<std::string,xquotes_common::Candle> &sealed_candles) {
+            std::lock_guard<std::mutex> lock(reconcile_mutex);
+            ReconcileBar &bar = reconcile_bars[bar_timestamp];
+            bar.candles = sealed_candles;
+            bar.next_attempt = bar_timestamp + xtime::SECONDS_IN_MINUTE + reconcile_delay;
+            bar.attempt = 0;
+        }
+
+        /** \brief Запустить поток сверки закрытых баров с историческими данными
+         *
+         * Поток забирает закрытые бары, время попытки которых наступило, загружает исторические данные
+         * и вызывает событие HISTORICAL_DATA_CORRECTED, только если бары отличаются.
+         * Если запрос не удался или сервер еще не отдал бар символа, по которому были тики,
+         * сверка повторяется с удвоением паузы, пока не пройдет reconcile_deadline после закрытия бара
+         * \param callback Функция для обратного вызова
+         * \param is_merge_hist_witch_stream Флаг слияния исторических баров с барами потока котировок
+         */
+        void start_reconciliation(
+                std::function<void(
+                    const std::map<std::string,xquotes_common::Candle> &candles,
+                    const EventType event,
+                    const xtime::timestamp_t timestamp)> callback,
+                const bool is_merge_hist_witch_stream) {
+            if(reconcile_future.valid()) return;
+            reconcile_future = std::async(std::launch::async,[&, callback, is_merge_hist_witch_stream]() {
+                while(!is_stop_command) {
+                    xtime::timestamp_t bar_timestamp = 0;
+                    ReconcileBar bar;
+                    const xtime::ftimestamp_t server_timestamp = websocket_api.get_server_timestamp();
+                    {
+                        std::lock_guard<std::mutex> lock(reconcile_mutex);
+                        for(auto it = reconcile_bars.begin(); it != reconcile_bars.end(); ++it) {
+                            if(it->second.next_attempt > server_timestamp) continue;
+                            bar_timestamp = it->first;
+                            bar = it->second;
+                            reconcile_bars.erase(it);
+                            break;
+                        }
+                    }
+                    if(bar_timestamp == 0) {
+                        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                        continue;
+                    }
+
+                    const uint32_t bars = 3;
+                    std::vector<std::map<std::string,xquotes_common::Candle>> array_candles;
+                    download_historical_data(
+                        array_candles,
+                        bar_timestamp,
+                        bars,       // количество баров
+                        50,         // задержка между потоками
+                        2,          // количество попыток загрузки, дальше повторяет сверка
+                        5,          // таймаут
+                        4);         // загружаем данные в четыре потока
+                    if(is_stop_command) return;
+
+                    std::map<std::string,xquotes_common::Candle> &hist_candles = array_candles[bars-1];
+
+                    /* бар символа с тиками, которого еще нет в истории, сверяем позже */
+                    bool is_incomplete = false;
+                    for(auto &item : bar.candles) {
+                        if(item.second.close == 0) continue;
+                        auto it_hist = hist_candles.find(item.first);
+                        if(it_hist == hist_candles.end() || it_hist->second.close == 0) {
+                            is_incomplete = true;
+                            break;
+                        }
+                    }
+                    const xtime::ftimestamp_t deadline = bar_timestamp + xtime::SECONDS_IN_MINUTE + reconcile_deadline;
+                    if(is_incomplete && websocket_api.get_server_timestamp() < deadline) {
+                        const xtime::ftimestamp_t pause = std::min(
+                            reconcile_delay * (xtime::ftimestamp_t)(1 << std::min(bar.attempt, (uint32_t)16)),
+                            reconcile_max_delay);
+                        ++bar.attempt;
+                        bar.next_attempt = websocket_api.get_server_timestamp() + pause;
+                        std::lock_guard<std::mutex> lock(reconcile_mutex);
+                        reconcile_bars[bar_timestamp] = bar;
+                        continue;
+                    }
+
+                    bool is_corrected = false;
+                    std::map<std::string,xquotes_common::Candle> corrected_candles = bar.candles;
+                    for(uint32_t symbol_index = 0;
+                        symbol_index < intrade_bar_common::CURRENCY_PAIRS;
+                        ++symbol_index) {
+                        const std::string symbol_name(intrade_bar_common::currency_pairs[symbol_index]);
+                        auto it_hist = hist_candles.find(symbol_name);
+                        if(it_hist == hist_candles.end() || it_hist->second.close == 0) continue;
+                        xquotes_common::Candle &candle = corrected_candles[symbol_name];
+                        if(candle.close != 0 &&
+                            compare_candles(symbol_index, candle, it_hist->second)) continue;
+                        if(is_merge_hist_witch_stream && candle.close != 0) {
+                            /* исторический бар приоритетнее, пропуски заполняем из потока */
+                            if(it_hist->second.open == 0) it_hist->second.open = candle.open;
+                            if(it_hist->second.high == 0) it_hist->second.high = candle.high;
+                            if(it_hist->second.low == 0) it_hist->second.low = candle.low;
+                        }
+                        candle = it_hist->second;
+                        is_corrected = true;
+                    }
+                    if(is_corrected && callback != nullptr) {
+                        callback(corrected_candles, EventType::HISTORICAL_DATA_CORRECTED, bar_timestamp);
+                    }
+                }
+            });
+        }
+
+        /** \brief Запустить поток закрытия баров по потоку котировок
+         *
+         * Поток ждет тики следующей минуты или водяной знак для каждого бара из очереди sealing_bars
+         * и вызывает событие HISTORICAL_DATA_RECEIVED. Основной поток событий при этом не ждет,
+         * и NEW_TICK продолжают приходить
+         * \param callback Функция для обратного вызова
+         * \param is_merge_hist_witch_stream Флаг слияния исторических баров с барами потока котировок
+         * \param is_use_hist_downloading Флаг сверки закрытых баров с историческими данными
+         */
+        void start_bar_sealing(
+                std::function<void(
+                    const std::map<std::string,xquotes_common::Candle> &candles,
+                    const EventType event,
+                    const xtime::timestamp_t timestamp)> callback,
+                const bool is_merge_hist_witch_stream,
+                const bool is_use_hist_downloading) {
+            if(sealing_future.valid()) return;
+            sealing_future = std::async(std::launch::async,[&, callback, is_merge_hist_witch_stream, is_use_hist_downloading]() {
+                while(!is_stop_command) {
+                    xtime::timestamp_t bar_timestamp = 0;
+                    {
+                        std::lock_guard<std::mutex> lock(sealing_mutex);
+                        if(!sealing_bars.empty()) {
+                            bar_timestamp = *sealing_bars.begin();
+                            sealing_bars.erase(sealing_bars.begin());
+                        }
+                    }
+                    if(bar_timestamp == 0) {
+                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                        continue;
+                    }
+                    if(!wait_bar_sealing(bar_timestamp)) return;
+
+                    std::map<std::string,xquotes_common::Candle> sealed_candles =
+                        get_stream_candles(bar_timestamp);
+                    if(callback != nullptr) callback(
+                        sealed_candles,
+                        EventType::HISTORICAL_DATA_RECEIVED,
+                        bar_timestamp);
+
+                    if(is_use_hist_downloading) {
+                        start_reconciliation(callback, is_merge_hist_witch_stream);
+                        add_reconcile_bar(bar_timestamp, sealed_candles);
+                    }
+                }
+            });
+        }
+
+        /** \brief Проверить, идут ли торги на рынке Forex
+         *
+         * Рынок закрыт с вечера пятницы до вечера воскресенья (21:00 UTC летом, 22:00 UTC зимой),
+         * граница берется с запасом: с 21:00 UTC пятницы до 22:00 UTC воскресенья
+         * \param timestamp Метка времени UTC
+         * \return Вернет true, если торги идут
+         */
+        static bool is_trading_time(const xtime::timestamp_t timestamp) {
+            /* 1 января 1970 года - четверг, 0 - воскресенье */
+            const uint32_t weekday = (uint32_t)((timestamp / xtime::SECONDS_IN_DAY + 4) % 7);
+            const uint32_t hour = (uint32_t)((timestamp % xtime::SECONDS_IN_DAY) / xtime::SECONDS_IN_HOUR);
+            if(weekday == 6) return false;
+            if(weekday == 5 && hour >= 21) return false;
+            if(weekday == 0 && hour < 22) return false;
+            return true;
+        }
+
+        /** \brief Передать загруженные исторические данные в поток котировок
+         * \param array_candles Массив баров. Размерность: номер баров, индекс символа, бары
+         */
+        void init_stream_history(const std::vector<std::map<std::string,xquotes_common::Candle>> &array_candles) {
+            for(uint32_t symbol_index = 0;
+                symbol_index < intrade_bar_common::CURRENCY_PAIRS;
+                ++symbol_index) {
+                const std::string symbol_name(intrade_bar_common::currency_pairs[symbol_index]);
+                std::vector<xquotes_common::Candle> candles;
+                candles.reserve(array_candles.size());
+                for(size_t i = 0; i < array_candles.size(); ++i) {
+                    auto it = array_candles[i].find(symbol_name);
+                    if(it == array_candles[i].end() || it->second.close == 0) continue;
+                    candles.push_back(it->second);
+                }
+                if(candles.empty()) continue;
+                websocket_api.init_array_candles(symbol_index, candles);
+            }
+        }
+
+        /** \brief Проверить, что тиков нет ни по одному символу
+         *
+         * Так определяются праздники и другие перерывы в торгах, которые не видны по календарю
+         * \return Вернет true, если все символы без тиков дольше gap_repair_stale_time
+         */
+        bool is_market_idle() {
+            bool is_init = false;
+            for(uint32_t symbol_index = 0;
+                symbol_index < intrade_bar_common::CURRENCY_PAIRS;
+                ++symbol_index) {
+                if(!websocket_api.check_init_symbol(symbol_index)) continue;
+                is_init = true;
+                if(websocket_api.get_tick_staleness(symbol_index) < gap_repair_stale_time) return false;
+            }
+            return is_init;
+        }
+
+        /** \brief Запустить поток восстановления пропусков в данных
+         *
+         * Поток запускается всегда и обновляет общий снимок price_now, пока у какого-либо символа
+         * нет бара текущей или прошлой минуты. Основной поток событий читает только этот снимок
+         * и сетевые запросы не ждет. Если включена опция set_option_gap_repair, для символов
+         * без тиков текущий бар заполняется из снимка, закрытые бары с пропусками
+         * заменяются историческими данными.
+         */
+        void start_gap_repair() {
+            std::lock_guard<std::mutex> lock(repair_start_mutex);
+            if(repair_future.valid()) return;
+            repair_future = std::async(std::launch::async,[&]() {
+                /* задержка после закрытия бара до запроса исторических данных */
+                const xtime::ftimestamp_t history_delay = 5.0;
+                const double price_now_ttl = 1.0;
+                std::array<xtime::timestamp_t, intrade_bar_common::CURRENCY_PAIRS> last_history_repair;
+                last_history_repair.fill(0);
+                while(!is_stop_command) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+                    if(!websocket_api.connected()) continue;
+                    const xtime::ftimestamp_t server_ftimestamp = websocket_api.get_server_timestamp();
+                    const xtime::timestamp_t current_minute =
+                        xtime::get_first_timestamp_minute((xtime::timestamp_t)server_ftimestamp);
+                    /* рынок закрыт: в выходные и праздники восстанавливать нечего */
+                    if(!is_trading_time(current_minute) || is_market_idle()) continue;
+
+                    /* снимок price_now нужен основному потоку, пока есть пропуски в барах */
+                    bool is_gap = false;
+                    std::vector<uint32_t> stale_symbols;
+                    for(uint32_t symbol_index = 0;
+                        symbol_index < intrade_bar_common::CURRENCY_PAIRS;
+                        ++symbol_index) {
+                        if(!websocket_api.check_init_symbol(symbol_index)) continue;
+                        if(websocket_api.get_timestamp_candle(symbol_index, current_minute - xtime::SECONDS_IN_MINUTE).close == 0) is_gap = true;
+                        if(websocket_api.get_timestamp_candle(symbol_index, current_minute).close != 0) continue;
+                        is_gap = true;
+                        if(websocket_api.get_tick_staleness(symbol_index) < gap_repair_stale_time) continue;
+                        stale_symbols.push_back(symbol_index);
+                    }
+                    if(is_gap) {
+                        std::vector<intrade_bar::StreamTick> prices;
+                        /* текущий бар символов без тиков заполняем из price_now */
+                        if(http_api.get_price_now(prices, price_now_ttl) == OK && is_gap_repair) {
+                            for(size_t i = 0; i < prices.size(); ++i) {
+                                auto it_symbol = intrade_bar_common::currency_pairs_indx.find(prices[i].symbol);
+                                if(it_symbol == intrade_bar_common::currency_pairs_indx.end()) continue;
+                                const uint32_t symbol_index = it_symbol->second;
+                                if(std::find(stale_symbols.begin(), stale_symbols.end(), symbol_index) == stale_symbols.end()) continue;
+                                xquotes_common::Candle candle;
+                                candle.open = candle.low = candle.high = candle.close = prices[i].price;
+                                candle.timestamp = current_minute;
+                                websocket_api.repair_candle(symbol_index, candle, SOURCE_PRICE_NOW);
+                            }
+                        }
+                    }
+
+                    /* закрытый бар с пропуском заменяем историческими данными */
+                    if(!is_gap_repair) continue;
+                    if(server_ftimestamp < (current_minute + history_delay)) continue;
+                    const xtime::timestamp_t prev_minute = current_minute - xtime::SECONDS_IN_MINUTE;
+                    for(uint32_t symbol_index = 0;
+                        symbol_index < intrade_bar_common::CURRENCY_PAIRS && !is_stop_command;
+                        ++symbol_index) {
+                        if(!websocket_api.check_init_symbol(symbol_index)) continue;
+                        if(last_history_repair[symbol_index] >= prev_minute) continue;
+                        if(websocket_api.get_timestamp_candle(symbol_index, prev_minute).close != 0 &&
+                            websocket_api.get_candle_source(symbol_index, prev_minute) != SOURCE_PRICE_NOW) continue;
+                        last_history_repair[symbol_index] = prev_minute;
+
+                        std::vector<xquotes_common::Candle> candles;
+                        int err = http_api.get_historical_data(
+                            symbol_index,
+                            prev_minute - 2 * xtime::SECONDS_IN_MINUTE,
+                            prev_minute,
+                            candles,
+                            intrade_bar_common::FXCM_USE_HIST_QUOTES_BID_ASK_DIV2,
+                            intrade_bar_common::pricescale_currency_pairs[symbol_index],
+                            1,  // одна попытка, следующая будет через минуту
+                            5); // таймаут
+                        if(err != OK) continue;
+                        for(size_t i = 0; i < candles.size(); ++i) {
+                            if(candles[i].timestamp != prev_minute) continue;
+                            websocket_api.repair_candle(symbol_index, candles[i], SOURCE_HISTORY);
+                        }
+                    }
+                }
+            });
+        }
+
     public:
 
         /** \brief Конструктор класса API
@@ -210,6 +637,7 @@ namespace intrade_bar {
          * \param user_bets_log_file Файл для записи логов работы со сделками
          * \param user_work_log_file Файл для записи логов работы http клиента
          * \param user_websocket_log_file Файл для записи логов вебсокета
+         * \param user_number_io_threads Количество потоков для обработки потока котировок
          */
         IntradeBarApi(
                 const std::string user_point = "1.intrade.bar",
@@ -226,15 +654,40 @@ namespace intrade_bar {
                 const std::string &user_cookie_file = "intrade-bar.cookie",
                 const std::string &user_bets_log_file = "logger/intrade-bar-bets.log",
                 const std::string &user_work_log_file = "logger/intrade-bar-https-work.log",
-                const std::string &user_websocket_log_file = "logger/intrade-bar-websocket.log") :
+                const std::string &user_websocket_log_file = "logger/intrade-bar-websocket.log",
+                const uint32_t user_number_io_threads = 1) :
                 http_api(user_point, user_sert_file, user_cookie_file, user_bets_log_file, user_work_log_file),
-                websocket_api(user_point, user_sert_file, user_websocket_log_file) {
+                websocket_api(user_point, user_sert_file, user_websocket_log_file, user_number_io_threads) {
 
             /* установим настройки цены открытия */
             websocket_api.set_option_open_price(is_open_equal_close);
 
             /* инициализация флагов и прочих переменных */
             is_stop_command = false;
+            is_instant_bar_sealing = false;
+            sealing_watermark = 2000;
+            gap_repair_stale_time = 5.0;
+            is_gap_repair = false;
+            is_compressed_history = false;
+
+            /* callback может вызываться из потока сверки баров, поэтому вызовы сериализуются.
+             * Минутные бары всех событий также обновляют бары старших таймфреймов
+             */
+            {
+                auto user_callback = callback;
+                callback = [&, user_callback](
+                        const std::map<std::string,xquotes_common::Candle> &candles,
+                        const EventType event,
+                        const xtime::timestamp_t timestamp) {
+                    std::lock_guard<std::mutex> lock(callback_mutex);
+                    if(user_callback != nullptr) user_callback(candles, event, timestamp);
+                    update_timeframes(candles, event, timestamp);
+                };
+            }
+
+            /* снимок price_now для пропусков обновляется в отдельном потоке */
+            start_gap_repair();
+
 #if(0)
             /* ожидаем завершения подключения к потоку котировок */
             if(!websocket_api.wait()) {
@@ -270,6 +723,10 @@ namespace intrade_bar {
                     is_merge_hist_witch_stream,
                     is_use_hist_downloading]() {
                 const uint32_t standart_thread_delay = 10;
+                /* снимок price_now обновляет поток восстановления пропусков,
+                 * здесь он только читается, чтобы пропуски не задерживали события
+                 */
+                const double price_now_max_age = 2.0;
 
                 /* сначала инициализируем исторические данные
                  */
@@ -292,6 +749,11 @@ namespace intrade_bar {
                         2);      // загружаем данные в два потока
                     if(is_stop_command) return;
 
+                    /* загруженная история нужна и потоку котировок, иначе в сжатой истории
+                     * будут только бары с момента запуска программы
+                     */
+                    if(is_compressed_history) init_stream_history(array_candles);
+
                     /* далее отправляем загруженные данные в callback */
                     xtime::timestamp_t start_timestamp = init_date_timestamp - (hist_data_number_bars) * xtime::SECONDS_IN_MINUTE;
 
@@ -356,7 +818,7 @@ namespace intrade_bar {
                             std::vector<intrade_bar::StreamTick> prices;
                             std::map<std::string, xquotes_common::Candle> array_merge_candles;
                             std::map<std::string, xquotes_common::Candle> price_now_candles;
-                            if(http_api.get_price_now(prices) == OK) {
+                            if(http_api.get_price_now_cache(prices, price_now_max_age) == OK) {
                                 for(size_t i = 0; i < prices.size(); ++i) {
                                     xquotes_common::Candle candle;
                                     candle.open = candle.low = candle.high = candle.close = prices[i].price;
@@ -389,6 +851,19 @@ namespace intrade_bar {
                     }
                     last_timestamp = timestamp; // запоминаем последнюю метку времен
 
+                    /* закрываем бары по потоку котировок сразу после тиков следующей минуты,
+                     * ожидание тиков и сверка с историческими данными идут в отдельных потоках
+                     */
+                    if(is_instant_bar_sealing) {
+                        start_bar_sealing(callback, is_merge_hist_witch_stream, is_use_hist_downloading);
+                        const uint64_t current_minute = timestamp / xtime::SECONDS_IN_MINUTE;
+                        std::lock_guard<std::mutex> lock(sealing_mutex);
+                        for(; last_minute < current_minute; ++last_minute) {
+                            sealing_bars.insert(last_minute * xtime::SECONDS_IN_MINUTE);
+                        }
+                        continue;
+                    }
+
                     server_ftimestamp = websocket_api.get_last_server_timestamp(); // получаем именно последнюю метку времени сервера, а не расчитанное время
                     timestamp = (xtime::timestamp_t)(server_ftimestamp + 0.5);
                     uint64_t server_minute = timestamp / xtime::SECONDS_IN_MINUTE;
@@ -508,7 +983,7 @@ namespace intrade_bar {
                                 std::vector<intrade_bar::StreamTick> prices;
                                 std::map<std::string, xquotes_common::Candle> array_merge_candles;
                                 std::map<std::string, xquotes_common::Candle> price_now_candles;
-                                if(http_api.get_price_now(prices) == OK) {
+                                if(http_api.get_price_now_cache(prices, price_now_max_age) == OK) {
                                     for(size_t i = 0; i < prices.size(); ++i) {
                                         xquotes_common::Candle candle;
                                         candle.open = candle.low = candle.high = candle.close = prices[i].price;
@@ -562,6 +1037,42 @@ namespace intrade_bar {
                     std::cerr << "Error: ~IntradeBarApi()" << std::endl;
                 }
             }
+            if(sealing_future.valid()) {
+                try {
+                    sealing_future.wait();
+                    sealing_future.get();
+                }
+                catch(const std::exception &e) {
+                    std::cerr << "Error: ~IntradeBarApi(), what: " << e.what() << std::endl;
+                }
+                catch(...) {
+                    std::cerr << "Error: ~IntradeBarApi()" << std::endl;
+                }
+            }
+            if(reconcile_future.valid()) {
+                try {
+                    reconcile_future.wait();
+                    reconcile_future.get();
+                }
+                catch(const std::exception &e) {
+                    std::cerr << "Error: ~IntradeBarApi(), what: " << e.what() << std::endl;
+                }
+                catch(...) {
+                    std::cerr << "Error: ~IntradeBarApi()" << std::endl;
+                }
+            }
+            if(repair_future.valid()) {
+                try {
+                    repair_future.wait();
+                    repair_future.get();
+                }
+                catch(const std::exception &e) {
+                    std::cerr << "Error: ~IntradeBarApi(), what: " << e.what() << std::endl;
+                }
+                catch(...) {
+                    std::cerr << "Error: ~IntradeBarApi()" << std::endl;
+                }
+            }
         }
 
         /** \brief Возвращает состояние соединения
@@ -838,6 +1349,38 @@ namespace intrade_bar {
             return candles;
         }
 
+        /** \brief Включить построение баров старших таймфреймов
+         *
+         * Бары строятся из минутных баров, которые приходят в основной callback:
+         * исторических данных, потока котировок и исправлений историей.
+         * Метод следует вызвать сразу после создания объекта, чтобы бары строились с начала истории
+         * \param periods Периоды таймфреймов в минутах, например {5, 15, 60}
+         * \param callback Функция, которая получает бары таймфрейма после каждого события.
+         * Метка времени - начало бара таймфрейма, period - период в минутах
+         */
+        void set_timeframes(
+                const std::vector<uint32_t> &periods,
+                std::function<void(
+                    const std::map<std::string,xquotes_common::Candle> &candles,
+                    const EventType event,
+                    const xtime::timestamp_t timestamp,
+                    const uint32_t period)> callback = nullptr) {
+            std::lock_guard<std::mutex> lock(callback_mutex);
+            timeframe_aggregator.set_periods(periods);
+            timeframe_callback = callback;
+        }
+
+        /** \brief Получить бары таймфрейма всех валютных пар по метке времени
+         * \param period Период таймфрейма в минутах, заданный в set_timeframes
+         * \param timestamp Метка времени внутри бара
+         * \return Массив баров символов, у которых есть данные
+         */
+        inline std::map<std::string,xquotes_common::Candle> get_candles(
+                const uint32_t period,
+                const xtime::timestamp_t timestamp) {
+            return timeframe_aggregator.get_candles(period, timestamp);
+        }
+
         /** \brief Получить смещение метки времени ПК
          * \return Смещение метки времени ПК
          */
@@ -874,6 +1417,81 @@ namespace intrade_bar {
             websocket_api.set_option_open_price(is_enable);
         }
 
+        /** \brief Установить опцию сжатой истории баров
+         *
+         * В потоке котировок несжатыми остаются последние hot_bars баров,
+         * более старые бары хранятся блоками в сжатом виде, что позволяет держать
+         * месяцы минутных баров по всем символам.
+         * Исторические данные, загруженные при запуске (user_number_bars баров), тоже попадают
+         * в поток котировок, поэтому опцию нужно установить сразу после создания объекта,
+         * а глубину истории задать параметром user_number_bars
+         * \param hot_bars Количество несжатых последних баров, 0 - сжатие отключено
+         * \param max_bars Максимальное количество баров в сжатой истории, 0 - без ограничения
+         */
+        inline void set_option_compressed_history(const uint32_t hot_bars, const size_t max_bars = 0) {
+            websocket_api.set_option_compressed_history(hot_bars, max_bars);
+            is_compressed_history = hot_bars != 0;
+        }
+
+        /** \brief Получить бары символа из потока котировок в диапазоне меток времени
+         * \param symbol_index Индекс символа
+         * \param start Начальная метка времени
+         * \param stop Конечная метка времени (включительно)
+         * \param candles Массив, в конец которого будут добавлены бары
+         * \return Количество добавленных баров
+         */
+        inline size_t get_candles(
+                const size_t symbol_index,
+                const xtime::timestamp_t start,
+                const xtime::timestamp_t stop,
+                std::vector<xquotes_common::Candle> &candles) {
+            return websocket_api.get_candles(symbol_index, start, stop, candles);
+        }
+
+        /** \brief Установить опцию мгновенного закрытия баров
+         *
+         * Если опция установлена, бар закрывается по потоку котировок, как только
+         * по всем символам пришли тики следующей минуты или прошло время водяного знака.
+         * Событие HISTORICAL_DATA_RECEIVED вызывается сразу. Если включена загрузка исторических данных,
+         * бары сверяются с историей в отдельном потоке и при расхождении вызывается событие HISTORICAL_DATA_CORRECTED
+         * \param is_enable Если указать true, бары будут закрываться по потоку котировок
+         * \param watermark Время ожидания тиков следующей минуты в миллисекундах
+         */
+        inline void set_option_instant_bar_sealing(const bool is_enable, const uint32_t watermark = 2000) {
+            sealing_watermark = watermark;
+            is_instant_bar_sealing = is_enable;
+        }
+
+        /** \brief Установить время без тиков, после которого данные символа восстанавливаются
+         * \param seconds Время в секундах
+         */
+        inline void set_gap_repair_stale_time(const double seconds) {
+            gap_repair_stale_time = seconds;
+        }
+
+        /** \brief Установить опцию восстановления пропусков в данных
+         *
+         * Если опция установлена, текущий бар символов без тиков заполняется из price_now,
+         * а закрытые бары с пропусками заменяются историческими данными.
+         * Вне торгового времени и когда тиков нет ни по одному символу, запросы не делаются.
+         * По умолчанию опция выключена
+         * \param is_enable Если указать true, пропуски будут восстанавливаться
+         */
+        inline void set_option_gap_repair(const bool is_enable) {
+            is_gap_repair = is_enable;
+        }
+
+        /** \brief Получить источник бара
+         * \param symbol_index Индекс символа
+         * \param timestamp Метка времени бара
+         * \return Источник бара: поток котировок, price_now или исторические данные
+         */
+        inline CandleSource get_candle_source(
+                const size_t symbol_index,
+                const xtime::timestamp_t timestamp) {
+            return websocket_api.get_candle_source(symbol_index, timestamp);
+        }
+
         /** \brief Установить задержку между открытием сделок
          * \param delay Задержка между открытием сделок
          */
@@ -0,0 +1,426 @@
+/*
+* intrade-bar-api-cpp - C ++ API client for intrade.bar
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef INTRADE_BAR_CANDLE_STORE_HPP_INCLUDED
+#define INTRADE_BAR_CANDLE_STORE_HPP_INCLUDED
+
+#include <intrade-bar-common.hpp>
+#include <xquotes_common.hpp>
+#include <xtime.hpp>
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
+#include <climits>
+#include <cmath>
+#include <sys/stat.h>
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace intrade_bar {
+
+    /** \brief Хранилище минутных баров одного символа в колоночном формате
+     *
+     * Файл состоит из заголовка и блоков по одному дню. Блок дня содержит
+     * колонки open, high, low, close (int32, цена в тиках, умноженная на pricescale)
+     * и volume (uint32), по 1440 значений в каждой. Пропуск бара отмечается значением NULL_PRICE.
+     * Блоки идут подряд без пропусков, поэтому адрес бара вычисляется по метке времени за O(1),
+     * а файл читается через отображение в память без разбора и распаковки.
+     */
+    class CandleStore {
+    public:
+
+        /// Колонки блока дня
+        enum ColumnType {
+            COLUMN_OPEN = 0,
+            COLUMN_HIGH = 1,
+            COLUMN_LOW = 2,
+            COLUMN_CLOSE = 3,
+            COLUMN_VOLUME = 4,
+            COLUMNS = 5,
+        };
+
+        static const int32_t NULL_PRICE = INT32_MIN;                    /**< Значение цены для пропущенного бара */
+        static const uint32_t VERSION = 1;
+        static const size_t COLUMN_SIZE = xtime::MINUTES_IN_DAY * sizeof(int32_t);
+        static const size_t BLOCK_SIZE = COLUMNS * COLUMN_SIZE;         /**< Размер блока одного дня, байт */
+
+        /** \brief Заголовок файла
+         */
+        struct Header {
+            char magic[4];              /**< Сигнатура IBCS */
+            uint32_t version;
+            uint32_t pricescale;        /**< Множитель цены */
+            uint32_t reserved0;
+            int64_t first_day;          /**< Номер первого дня (дни от начала эпохи) */
+            uint8_t reserved[40];
+        };
+        static_assert(sizeof(Header) == 64, "CandleStore::Header must be 64 bytes");
+
+    private:
+        std::string file_name;
+        uint32_t pricescale = 100000;
+        int64_t first_day = 0;
+        uint64_t number_days = 0;
+        bool is_header = false;
+
+#       if defined(_WIN32) || defined(_WIN64)
+        HANDLE file_handle = INVALID_HANDLE_VALUE;
+        HANDLE mapping_handle = NULL;
+#       else
+        int file_descriptor = -1;
+#       endif
+        const char *data = nullptr;
+        size_t data_size = 0;
+        bool is_mapping_outdated = true;
+
+        void unmap() {
+#           if defined(_WIN32) || defined(_WIN64)
+            if(data != nullptr) UnmapViewOfFile(data);
+            if(mapping_handle != NULL) CloseHandle(mapping_handle);
+            if(file_handle != INVALID_HANDLE_VALUE) CloseHandle(file_handle);
+            mapping_handle = NULL;
+            file_handle = INVALID_HANDLE_VALUE;
+#           else
+            if(data != nullptr) munmap((void*)data, data_size);
+            if(file_descriptor >= 0) ::close(file_descriptor);
+            file_descriptor = -1;
+#           endif
+            data = nullptr;
+            data_size = 0;
+        }
+
+        /** \brief Отобразить файл в память, если файл изменился
+         * \return Вернет true, если данные доступны
+         */
+        bool map() {
+            if(!is_mapping_outdated) return data != nullptr;
+            unmap();
+            is_mapping_outdated = false;
+#           if defined(_WIN32) || defined(_WIN64)
+            file_handle = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+            if(file_handle == INVALID_HANDLE_VALUE) return false;
+            LARGE_INTEGER file_size;
+            if(!GetFileSizeEx(file_handle, &file_size) || file_size.QuadPart < (LONGLONG)sizeof(Header)) {
+                unmap();
+                return false;
+            }
+            mapping_handle = CreateFileMappingA(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+            if(mapping_handle == NULL) {
+                unmap();
+                return false;
+            }
+            data = (const char*)MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+            data_size = (size_t)file_size.QuadPart;
+#           else
+            file_descriptor = ::open(file_name.c_str(), O_RDONLY);
+            if(file_descriptor < 0) return false;
+            struct stat file_stat;
+            if(fstat(file_descriptor, &file_stat) != 0 || file_stat.st_size < (off_t)sizeof(Header)) {
+                unmap();
+                return false;
+            }
+            void *ptr = mmap(NULL, (size_t)file_stat.st_size, PROT_READ, MAP_SHARED, file_descriptor, 0);
+            if(ptr == MAP_FAILED) {
+                unmap();
+                return false;
+            }
+            data = (const char*)ptr;
+            data_size = (size_t)file_stat.st_size;
+#           endif
+            if(data == nullptr || !read_header((const Header*)data)) {
+                unmap();
+                return false;
+            }
+            number_days = (data_size - sizeof(Header)) / BLOCK_SIZE;
+            return true;
+        }
+
+        bool read_header(const Header *header) {
+            if(std::memcmp(header->magic, "IBCS", 4) != 0 || header->version != VERSION) return false;
+            pricescale = header->pricescale;
+            first_day = header->first_day;
+            is_header = true;
+            return true;
+        }
+
+        /** \brief Прочитать заголовок и размер файла без отображения в память
+         */
+        bool load_header() {
+            if(is_header) return true;
+            std::ifstream file(file_name, std::ios::binary);
+            if(!file) return false;
+            Header header;
+            if(!file.read((char*)&header, sizeof(Header))) return false;
+            if(!read_header(&header)) return false;
+            file.seekg(0, std::ios::end);
+            number_days = ((uint64_t)file.tellg() - sizeof(Header)) / BLOCK_SIZE;
+            return true;
+        }
+
+        static void fill_null_block(std::vector<char> &block) {
+            block.assign(BLOCK_SIZE, 0);
+            int32_t *values = (int32_t*)block.data();
+            for(size_t i = 0; i < COLUMN_VOLUME * xtime::MINUTES_IN_DAY; ++i) {
+                values[i] = NULL_PRICE;
+            }
+        }
+
+        /** \brief Переписать файл так, чтобы он начинался с более раннего дня
+         *
+         * Новый файл записывается во временный файл, который затем заменяет основной,
+         * поэтому при сбое на диске остается либо старая, либо новая версия
+         */
+        int prepend_days(const int64_t new_first_day) {
+            const uint64_t offset_days = (uint64_t)(first_day - new_first_day);
+            const std::string temp_file_name = file_name + ".tmp";
+            {
+                std::ifstream old_file(file_name, std::ios::binary);
+                if(!old_file) return intrade_bar_common::STRANGE_PROGRAM_BEHAVIOR;
+                old_file.seekg(sizeof(Header), std::ios::beg);
+                std::ofstream file(temp_file_name, std::ios::binary | std::ios::trunc);
+                if(!file) return intrade_bar_common::STRANGE_PROGRAM_BEHAVIOR;
+                Header header = make_header(new_first_day);
+                file.write((const char*)&header, sizeof(Header));
+                std::vector<char> block;
+                fill_null_block(block);
+                for(uint64_t d = 0; d < offset_days; ++d) {
+                    file.write(block.data(), block.size());
+                }
+                /* старые дни копируем по одному блоку, чтобы не читать весь файл в память */
+                for(uint64_t d = 0; d < number_days; ++d) {
+                    if(!old_file.read(block.data(), block.size())) return intrade_bar_common::STRANGE_PROGRAM_BEHAVIOR;
+                    file.write(block.data(), block.size());
+                }
+                file.flush();
+                if(!file) return intrade_bar_common::STRANGE_PROGRAM_BEHAVIOR;
+            }
+            /* отображенный в память файл нельзя заменить */
+            unmap();
+            is_mapping_outdated = true;
+#           if defined(_WIN32) || defined(_WIN64)
+            if(!MoveFileExA(temp_file_name.c_str(), file_name.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+                return intrade_bar_common::STRANGE_PROGRAM_BEHAVIOR;
+            }
+#           else
+            if(std::rename(temp_file_name.c_str(), file_name.c_str()) != 0) {
+                return intrade_bar_common::STRANGE_PROGRAM_BEHAVIOR;
+            }
+#           endif
+            first_day = new_first_day;
+            number_days += offset_days;
+            return intrade_bar_common::OK;
+        }
+
+        Header make_header(const int64_t day) const {
+            Header header;
+            std::memset(&header, 0, sizeof(Header));
+            std::memcpy(header.magic, "IBCS", 4);
+            header.version = VERSION;
+            header.pricescale = pricescale;
+            header.first_day = day;
+            return header;
+        }
+
+        inline int32_t to_ticks(const double price) const {
+            return (int32_t)intrade_bar_common::Price::from_double(price, pricescale).ticks;
+        }
+
+        inline double to_price(const int32_t ticks) const {
+            return (double)ticks / (double)pricescale;
+        }
+
+    public:
+
+        /** \brief Конструктор хранилища
+         * \param user_file_name Имя файла
+         * \param user_pricescale Множитель цены для нового файла. У существующего файла берется из заголовка
+         */
+        CandleStore(const std::string &user_file_name, const uint32_t user_pricescale = 100000) :
+            file_name(user_file_name), pricescale(user_pricescale) {
+            load_header();
+        }
+
+        CandleStore(const CandleStore&) = delete;
+        CandleStore &operator=(const CandleStore&) = delete;
+
+        ~CandleStore() {
+            unmap();
+        }
+
+        /** \brief Получить множитель цены
+         */
+        inline uint32_t get_pricescale() const {
+            return pricescale;
+        }
+
+        /** \brief Записать бары одного дня
+         *
+         * Интерфейс совпадает с QuotesHistory::write_candles. Бары с нулевой ценой закрытия считаются пропуском
+         * \param candles Бары дня, индекс - минута дня
+         * \param timestamp Метка времени начала дня
+         * \return Код ошибки, 0 если ошибок нет
+         */
+        int write_candles(
+                const std::array<xquotes_common::Candle, xtime::MINUTES_IN_DAY> &candles,
+                const xtime::timestamp_t timestamp) {
+            const int64_t day = (int64_t)(timestamp / xtime::SECONDS_IN_DAY);
+            std::vector<char> block;
+            fill_null_block(block);
+            int32_t *columns = (int32_t*)block.data();
+            for(uint32_t m = 0; m < xtime::MINUTES_IN_DAY; ++m) {
+                if(candles[m].close == 0) continue;
+                columns[COLUMN_OPEN * xtime::MINUTES_IN_DAY + m] = to_ticks(candles[m].open);
+                columns[COLUMN_HIGH * xtime::MINUTES_IN_DAY + m] = to_ticks(candles[m].high);
+                columns[COLUMN_LOW * xtime::MINUTES_IN_DAY + m] = to_ticks(candles[m].low);
+                columns[COLUMN_CLOSE * xtime::MINUTES_IN_DAY + m] = to_ticks(candles[m].close);
+                ((uint32_t*)columns)[COLUMN_VOLUME * xtime::MINUTES_IN_DAY + m] = (uint32_t)(candles[m].volume + 0.5);
+            }
+
+            if(!load_header()) {
+                /* новый файл начинается с записываемого дня */
+                std::ofstream file(file_name, std::ios::binary | std::ios::trunc);
+                if(!file) return intrade_bar_common::STRANGE_PROGRAM_BEHAVIOR;
+                Header header = make_header(day);
+                file.write((const char*)&header, sizeof(Header));
+                if(!file) return intrade_bar_common::STRANGE_PROGRAM_BEHAVIOR;
+                first_day = day;
+                number_days = 0;
+                is_header = true;
+            } else
+            if(day < first_day) {
+                const int err = prepend_days(day);
+                if(err != intrade_bar_common::OK) return err;
+            }
+
+            /* дни между концом файла и записываемым днем заполняем пропусками */
+            const uint64_t index = (uint64_t)(day - first_day);
+            std::fstream file(file_name, std::ios::binary | std::ios::in | std::ios::out);
+            if(!file) return intrade_bar_common::STRANGE_PROGRAM_BEHAVIOR;
+            if(index > number_days) {
+                std::vector<char> null_block;
+                fill_null_block(null_block);
+                file.seekp(sizeof(Header) + number_days * BLOCK_SIZE, std::ios::beg);
+                for(uint64_t d = number_days; d < index; ++d) {
+                    file.write(null_block.data(), null_block.size());
+                }
+            }
+            file.seekp(sizeof(Header) + index * BLOCK_SIZE, std::ios::beg);
+            file.write(block.data(), block.size());
+            file.flush();
+            if(!file) return intrade_bar_common::STRANGE_PROGRAM_BEHAVIOR;
+            number_days = std::max(number_days, index + 1);
+            is_mapping_outdated = true;
+            return intrade_bar_common::OK;
+        }
+
+        /** \brief Получить колонку одного дня без копирования
+         *
+         * Указатель действителен до следующей записи в хранилище
+         * \param column Колонка (COLUMN_OPEN, COLUMN_CLOSE и т.д.)
+         * \param timestamp Метка времени внутри дня
+         * \return Указатель на 1440 значений или nullptr, если дня нет в файле
+         */
+        const int32_t *get_column(const ColumnType column, const xtime::timestamp_t timestamp) {
+            if(column >= COLUMNS || !map()) return nullptr;
+            const int64_t day = (int64_t)(timestamp / xtime::SECONDS_IN_DAY);
+            if(day < first_day || (uint64_t)(day - first_day) >= number_days) return nullptr;
+            return (const int32_t*)(data + sizeof(Header) + (uint64_t)(day - first_day) * BLOCK_SIZE + column * COLUMN_SIZE);
+        }
+
+        /** \brief Получить цену бара в тиках
+         * \param column Колонка цены
+         * \param timestamp Метка времени бара
+         * \return Цена в тиках или NULL_PRICE
+         */
+        inline int32_t get_ticks(const ColumnType column, const xtime::timestamp_t timestamp) {
+            const int32_t *values = get_column(column, timestamp);
+            if(values == nullptr) return NULL_PRICE;
+            return values[xtime::get_minute_day(timestamp)];
+        }
+
+        /** \brief Получить бар
+         * \param candle Бар
+         * \param timestamp Метка времени бара
+         * \return Код ошибки, DATA_NOT_AVAILABLE для пропуска
+         */
+        int get_candle(xquotes_common::Candle &candle, const xtime::timestamp_t timestamp) {
+            const int32_t *block = get_column(COLUMN_OPEN, timestamp);
+            if(block == nullptr) return intrade_bar_common::DATA_NOT_AVAILABLE;
+            const uint32_t m = xtime::get_minute_day(timestamp);
+            if(block[COLUMN_CLOSE * xtime::MINUTES_IN_DAY + m] == NULL_PRICE) return intrade_bar_common::DATA_NOT_AVAILABLE;
+            candle.open = to_price(block[COLUMN_OPEN * xtime::MINUTES_IN_DAY + m]);
+            candle.high = to_price(block[COLUMN_HIGH * xtime::MINUTES_IN_DAY + m]);
+            candle.low = to_price(block[COLUMN_LOW * xtime::MINUTES_IN_DAY + m]);
+            candle.close = to_price(block[COLUMN_CLOSE * xtime::MINUTES_IN_DAY + m]);
+            candle.volume = ((const uint32_t*)block)[COLUMN_VOLUME * xtime::MINUTES_IN_DAY + m];
+            candle.timestamp = xtime::get_first_timestamp_minute(timestamp);
+            return intrade_bar_common::OK;
+        }
+
+        /** \brief Получить бары одного дня
+         *
+         * Интерфейс совпадает с QuotesHistory::get_candles, пропуски остаются пустыми барами
+         * \param candles Бары дня
+         * \param timestamp Метка времени внутри дня
+         * \return Код ошибки, DATA_NOT_AVAILABLE если дня нет или в нем нет баров
+         */
+        int get_candles(
+                std::array<xquotes_common::Candle, xtime::MINUTES_IN_DAY> &candles,
+                const xtime::timestamp_t timestamp) {
+            candles.fill(xquotes_common::Candle());
+            const xtime::timestamp_t day_timestamp = xtime::get_first_timestamp_day(timestamp);
+            bool is_data = false;
+            for(uint32_t m = 0; m < xtime::MINUTES_IN_DAY; ++m) {
+                if(get_candle(candles[m], day_timestamp + m * xtime::SECONDS_IN_MINUTE) == intrade_bar_common::OK) {
+                    is_data = true;
+                }
+            }
+            return is_data ? intrade_bar_common::OK : intrade_bar_common::DATA_NOT_AVAILABLE;
+        }
+
+        /** \brief Получить диапазон дней в файле
+         * \param min_timestamp Метка времени начала первого дня
+         * \param max_timestamp Метка времени начала последнего дня
+         * \return Код ошибки, DATA_NOT_AVAILABLE если файл пуст
+         */
+        int get_min_max_day_timestamp(xtime::timestamp_t &min_timestamp, xtime::timestamp_t &max_timestamp) {
+            if(!map() || number_days == 0) return intrade_bar_common::DATA_NOT_AVAILABLE;
+            min_timestamp = (xtime::timestamp_t)first_day * xtime::SECONDS_IN_DAY;
+            max_timestamp = (xtime::timestamp_t)(first_day + number_days - 1) * xtime::SECONDS_IN_DAY;
+            return intrade_bar_common::OK;
+        }
+    };
+}
+
+#endif // INTRADE_BAR_CANDLE_STORE_HPP_INCLUDED
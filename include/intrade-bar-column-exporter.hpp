@@ -0,0 +1,433 @@
+/*
+* intrade-bar-api-cpp - C ++ API client for intrade.bar
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef INTRADE_BAR_COLUMN_EXPORTER_HPP_INCLUDED
+#define INTRADE_BAR_COLUMN_EXPORTER_HPP_INCLUDED
+
+#include <intrade-bar-common.hpp>
+#include <xquotes_common.hpp>
+#include <xtime.hpp>
+#include <nlohmann/json.hpp>
+#include <array>
+#include <vector>
+#include <map>
+#include <string>
+#include <fstream>
+#include <cstdio>
+#include <cstdint>
+#include <sys/stat.h>
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace intrade_bar {
+
+    /** \brief Экспорт минутных баров символа в колоночные файлы
+     *
+     * Для символа создается директория с файлами колонок timestamp.bin (int64, секунды UTC),
+     * open.bin, high.bin, low.bin, close.bin, volume.bin (float64), все в порядке байтов little-endian,
+     * и файл schema.json с описанием колонок и количеством строк. Пропущенные бары не записываются.
+     * Колонки читаются без библиотеки xquotes, например numpy.fromfile(path, dtype='<f8', count=rows).
+     *
+     * Экспорт дописывает дни в конец колонок. Для каждого экспортированного дня схема хранит первую строку
+     * и контрольную сумму баров. При следующем запуске колонки отрезаются до первого дня, бары которого
+     * изменились в хранилище, и экспорт продолжается с этого дня, поэтому перезаписанные дни не теряются.
+     * Схема сохраняется атомарно после записи колонок, лишние строки после сбоя отрезаются при открытии.
+     */
+    class ColumnExporter {
+    public:
+        using json = nlohmann::json;
+
+        static const uint32_t VERSION = 2;
+        static const uint32_t COLUMNS = 6;
+
+    private:
+        std::string path;
+        std::string symbol_name;
+        uint32_t pricescale = 1;
+
+        /// Экспортированный день
+        struct ExportedDay {
+            uint64_t row = 0;                   /**< Первая строка дня */
+            uint64_t checksum = 0;              /**< Контрольная сумма баров дня */
+        };
+
+        uint64_t rows = 0;
+        std::map<xtime::timestamp_t, ExportedDay> exported_days;   /**< Дни, у которых есть строки в колонках */
+        xtime::timestamp_t first_timestamp = 0;
+        xtime::timestamp_t last_timestamp = 0;
+        xtime::timestamp_t last_day = 0;        /**< Последний экспортированный день */
+        bool is_open = false;
+
+        std::array<std::ofstream, COLUMNS> files;
+        std::vector<int64_t> timestamp_column;
+        std::array<std::vector<double>, COLUMNS - 1> price_columns;
+
+        static const std::array<std::string, COLUMNS> &get_column_names() {
+            static const std::array<std::string, COLUMNS> names = {
+                "timestamp", "open", "high", "low", "close", "volume"
+            };
+            return names;
+        }
+
+        inline std::string get_file_name(const uint32_t column) const {
+            return path + "/" + get_column_names()[column] + ".bin";
+        }
+
+        static void create_directory(const std::string &name) {
+#           if defined(_WIN32) || defined(_WIN64)
+            CreateDirectoryA(name.c_str(), NULL);
+#           else
+            mkdir(name.c_str(), 0755);
+#           endif
+        }
+
+        static bool truncate_file(const std::string &file_name, const uint64_t size) {
+#           if defined(_WIN32) || defined(_WIN64)
+            HANDLE handle = CreateFileA(
+                file_name.c_str(), GENERIC_WRITE, 0, NULL,
+                OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+            if(handle == INVALID_HANDLE_VALUE) return false;
+            LARGE_INTEGER offset;
+            offset.QuadPart = (LONGLONG)size;
+            const bool is_ok = SetFilePointerEx(handle, offset, NULL, FILE_BEGIN) && SetEndOfFile(handle);
+            CloseHandle(handle);
+            return is_ok;
+#           else
+            {
+                std::ofstream file(file_name, std::ios_base::binary | std::ios_base::app);
+                if(!file) return false;
+            }
+            return ::truncate(file_name.c_str(), (off_t)size) == 0;
+#           endif
+        }
+
+        int load_schema() {
+            std::ifstream file(path + "/schema.json");
+            if(!file) return intrade_bar_common::DATA_NOT_AVAILABLE;
+            try {
+                json j;
+                file >> j;
+                const uint32_t version = j.value("version", (uint32_t)0);
+                /* в схеме старой версии нет контрольных сумм дней, экспорт начинается заново */
+                if(version != 0 && version < VERSION) return intrade_bar_common::DATA_NOT_AVAILABLE;
+                if(version != VERSION) return intrade_bar_common::INVALID_ARGUMENT;
+                if(j.value("pricescale", (uint32_t)0) != pricescale) return intrade_bar_common::INVALID_ARGUMENT;
+                rows = j.value("rows", (uint64_t)0);
+                first_timestamp = j.value("first_timestamp", (xtime::timestamp_t)0);
+                last_timestamp = j.value("last_timestamp", (xtime::timestamp_t)0);
+                last_day = j.value("last_day", (xtime::timestamp_t)0);
+                exported_days.clear();
+                if(j.find("days") != j.end()) {
+                    for(const auto &item : j["days"]) {
+                        ExportedDay exported_day;
+                        exported_day.row = item.at(1).get<uint64_t>();
+                        exported_day.checksum = item.at(2).get<uint64_t>();
+                        if(exported_day.row >= rows) continue;
+                        exported_days[item.at(0).get<xtime::timestamp_t>()] = exported_day;
+                    }
+                }
+            }
+            catch(...) {
+                return intrade_bar_common::JSON_PARSER_ERROR;
+            }
+            return intrade_bar_common::OK;
+        }
+
+        int save_schema() {
+            json j;
+            j["format"] = "intrade-bar-columns";
+            j["version"] = VERSION;
+            j["symbol"] = symbol_name;
+            j["pricescale"] = pricescale;
+            j["byte_order"] = "little";
+            j["rows"] = rows;
+            j["first_timestamp"] = first_timestamp;
+            j["last_timestamp"] = last_timestamp;
+            j["last_day"] = last_day;
+            json days = json::array();
+            for(const auto &item : exported_days) {
+                days.push_back(json::array({item.first, item.second.row, item.second.checksum}));
+            }
+            j["days"] = days;
+            json columns = json::array();
+            for(uint32_t c = 0; c < COLUMNS; ++c) {
+                json column;
+                column["name"] = get_column_names()[c];
+                column["type"] = c == 0 ? "int64" : "float64";
+                column["file"] = get_column_names()[c] + ".bin";
+                if(c == 0) column["unit"] = "s";
+                columns.push_back(column);
+            }
+            j["columns"] = columns;
+
+            const std::string file_name = path + "/schema.json";
+            const std::string temp_file_name = file_name + ".tmp";
+            {
+                std::ofstream file(temp_file_name, std::ios::trunc);
+                if(!file) return intrade_bar_common::STRANGE_PROGRAM_BEHAVIOR;
+                file << j.dump(4);
+                file.flush();
+                if(!file) return intrade_bar_common::STRANGE_PROGRAM_BEHAVIOR;
+            }
+#           if defined(_WIN32) || defined(_WIN64)
+            if(!MoveFileExA(temp_file_name.c_str(), file_name.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+                return intrade_bar_common::STRANGE_PROGRAM_BEHAVIOR;
+            }
+#           else
+            if(std::rename(temp_file_name.c_str(), file_name.c_str()) != 0) {
+                return intrade_bar_common::STRANGE_PROGRAM_BEHAVIOR;
+            }
+#           endif
+            return intrade_bar_common::OK;
+        }
+
+        /** \brief Отрезать колонки до количества строк
+         */
+        int truncate_columns(const uint64_t number_rows) {
+            for(uint32_t c = 0; c < COLUMNS; ++c) {
+                if(files[c].is_open()) files[c].close();
+                if(!truncate_file(get_file_name(c), number_rows * sizeof(double))) {
+                    return intrade_bar_common::STRANGE_PROGRAM_BEHAVIOR;
+                }
+                files[c].open(get_file_name(c), std::ios_base::binary | std::ios_base::app);
+                if(!files[c]) return intrade_bar_common::STRANGE_PROGRAM_BEHAVIOR;
+            }
+            return intrade_bar_common::OK;
+        }
+
+        /** \brief Прочитать метку времени строки
+         */
+        xtime::timestamp_t read_timestamp(const uint64_t row) const {
+            std::ifstream file(get_file_name(0), std::ios_base::binary);
+            int64_t value = 0;
+            file.seekg(row * sizeof(int64_t));
+            if(!file.read((char*)&value, sizeof(value))) return 0;
+            return (xtime::timestamp_t)value;
+        }
+
+        /** \brief Посчитать контрольную сумму баров дня
+         *
+         * Учитываются только бары, которые попадают в колонки (FNV-1a по минуте и ценам)
+         * \return Контрольная сумма или 0, если у дня нет баров
+         */
+        static uint64_t get_checksum(const std::array<xquotes_common::Candle, xtime::MINUTES_IN_DAY> &candles) {
+            uint64_t hash = 14695981039346656037ULL;
+            bool is_empty = true;
+            for(uint32_t m = 0; m < xtime::MINUTES_IN_DAY; ++m) {
+                const xquotes_common::Candle &candle = candles[m];
+                if(candle.close == 0 || candle.timestamp == 0) continue;
+                is_empty = false;
+                const double values[] = {(double)m, candle.open, candle.high, candle.low, candle.close, candle.volume};
+                const unsigned char *data = (const unsigned char*)values;
+                for(size_t i = 0; i < sizeof(values); ++i) {
+                    hash ^= data[i];
+                    hash *= 1099511628211ULL;
+                }
+            }
+            if(is_empty) return 0;
+            return hash == 0 ? 1 : hash;
+        }
+
+        /** \brief Отрезать колонки до первой строки дня
+         *
+         * Строки этого дня и всех следующих дней отбрасываются
+         * \param day Метка времени дня
+         * \return Код ошибки
+         */
+        int rewind_to_day(const xtime::timestamp_t day) {
+            auto it = exported_days.lower_bound(day);
+            if(it == exported_days.end()) return intrade_bar_common::OK;
+            rows = it->second.row;
+            exported_days.erase(it, exported_days.end());
+            const int err = truncate_columns(rows);
+            if(err != intrade_bar_common::OK) return err;
+            if(rows == 0) first_timestamp = last_timestamp = 0;
+            else last_timestamp = read_timestamp(rows - 1);
+            return intrade_bar_common::OK;
+        }
+
+    public:
+
+        /** \brief Конструктор экспорта
+         * \param path_export Директория экспорта, для символа создается поддиректория
+         * \param user_symbol_name Имя символа
+         * \param user_pricescale Множитель цены символа
+         */
+        ColumnExporter(
+                const std::string &path_export,
+                const std::string &user_symbol_name,
+                const uint32_t user_pricescale) :
+                path(path_export + "/" + user_symbol_name),
+                symbol_name(user_symbol_name),
+                pricescale(user_pricescale) {
+            timestamp_column.reserve(xtime::MINUTES_IN_DAY);
+            for(auto &column : price_columns) column.reserve(xtime::MINUTES_IN_DAY);
+        }
+
+        ColumnExporter(const ColumnExporter&) = delete;
+        ColumnExporter &operator=(const ColumnExporter&) = delete;
+
+        ~ColumnExporter() {
+            if(is_open) commit();
+        }
+
+        /** \brief Открыть экспорт символа
+         *
+         * Колонки отрезаются по схеме: строки, записанные после последнего сохранения схемы, отбрасываются
+         * \return Код ошибки
+         */
+        int open() {
+            create_directory(path);
+            const int err = load_schema();
+            if(err == intrade_bar_common::DATA_NOT_AVAILABLE) {
+                rows = 0;
+                first_timestamp = last_timestamp = last_day = 0;
+                exported_days.clear();
+            } else
+            if(err != intrade_bar_common::OK) return err;
+            const int err_truncate = truncate_columns(rows);
+            if(err_truncate != intrade_bar_common::OK) return err_truncate;
+            is_open = true;
+            return intrade_bar_common::OK;
+        }
+
+        /** \brief Получить последний экспортированный день
+         * \return Метка времени дня или 0, если экспорт пуст
+         */
+        inline xtime::timestamp_t get_next_day() const {
+            return last_day;
+        }
+
+        inline uint64_t get_rows() const {
+            return rows;
+        }
+
+        /** \brief Добавить день
+         *
+         * Если день уже экспортирован или раньше последнего экспортированного, колонки сначала
+         * отрезаются до первой строки этого дня, то есть этот день и все следующие записываются заново
+         * \param candles Бары дня
+         * \param timestamp Метка времени дня
+         * \return Код ошибки
+         */
+        int append_day(
+                const std::array<xquotes_common::Candle, xtime::MINUTES_IN_DAY> &candles,
+                const xtime::timestamp_t timestamp) {
+            if(!is_open) return intrade_bar_common::DATA_NOT_AVAILABLE;
+            const xtime::timestamp_t day = xtime::get_first_timestamp_day(timestamp);
+            const int err = rewind_to_day(day);
+            if(err != intrade_bar_common::OK) return err;
+
+            timestamp_column.clear();
+            for(auto &column : price_columns) column.clear();
+            for(uint32_t m = 0; m < xtime::MINUTES_IN_DAY; ++m) {
+                const xquotes_common::Candle &candle = candles[m];
+                if(candle.close == 0 || candle.timestamp == 0) continue;
+                timestamp_column.push_back((int64_t)(day + m * xtime::SECONDS_IN_MINUTE));
+                price_columns[0].push_back(candle.open);
+                price_columns[1].push_back(candle.high);
+                price_columns[2].push_back(candle.low);
+                price_columns[3].push_back(candle.close);
+                price_columns[4].push_back(candle.volume);
+            }
+
+            last_day = day;
+            if(timestamp_column.empty()) return intrade_bar_common::OK;
+            ExportedDay exported_day;
+            exported_day.row = rows;
+            exported_day.checksum = get_checksum(candles);
+            exported_days[day] = exported_day;
+            files[0].write((const char*)timestamp_column.data(), timestamp_column.size() * sizeof(int64_t));
+            for(uint32_t c = 1; c < COLUMNS; ++c) {
+                files[c].write((const char*)price_columns[c - 1].data(), price_columns[c - 1].size() * sizeof(double));
+            }
+            rows += timestamp_column.size();
+            if(first_timestamp == 0) first_timestamp = timestamp_column.front();
+            last_timestamp = timestamp_column.back();
+            return intrade_bar_common::OK;
+        }
+
+        /** \brief Записать колонки на диск и сохранить схему
+         * \return Код ошибки
+         */
+        int commit() {
+            if(!is_open) return intrade_bar_common::DATA_NOT_AVAILABLE;
+            for(uint32_t c = 0; c < COLUMNS; ++c) {
+                files[c].flush();
+                if(!files[c]) return intrade_bar_common::STRANGE_PROGRAM_BEHAVIOR;
+            }
+            return save_schema();
+        }
+
+        /** \brief Экспортировать хранилище котировок
+         *
+         * Дни читаются по одному, поэтому память не зависит от размера хранилища.
+         * Контрольная сумма каждого дня хранилища сравнивается с экспортированной, колонки отрезаются
+         * до первого изменившегося (добавленного, перезаписанного или удаленного) дня и экспорт продолжается с него.
+         * Схема сохраняется каждые commit_days записанных дней
+         * \param hist Хранилище с методами get_min_max_day_timestamp и get_candles (например, QuotesHistory или CandleStore)
+         * \param commit_days Период сохранения схемы в днях
+         * \return Код ошибки
+         */
+        template<class HIST>
+        int export_history(HIST &hist, const uint32_t commit_days = 64) {
+            if(!is_open) {
+                const int err = open();
+                if(err != intrade_bar_common::OK) return err;
+            }
+            xtime::timestamp_t min_timestamp = 0, max_timestamp = 0;
+            if(hist.get_min_max_day_timestamp(min_timestamp, max_timestamp) != intrade_bar_common::OK) {
+                return intrade_bar_common::DATA_NOT_AVAILABLE;
+            }
+            min_timestamp = xtime::get_first_timestamp_day(min_timestamp);
+            max_timestamp = xtime::get_first_timestamp_day(max_timestamp);
+            if(!exported_days.empty()) {
+                min_timestamp = std::min(min_timestamp, exported_days.begin()->first);
+                max_timestamp = std::max(max_timestamp, exported_days.rbegin()->first);
+            }
+            std::array<xquotes_common::Candle, xtime::MINUTES_IN_DAY> candles;
+            uint32_t days = 0;
+            for(xtime::timestamp_t t = min_timestamp; t <= max_timestamp; t += xtime::SECONDS_IN_DAY) {
+                /* день без данных считаем пустым, чтобы удаленный из хранилища день тоже отрезался */
+                if(hist.get_candles(candles, t) != intrade_bar_common::OK) {
+                    candles.fill(xquotes_common::Candle());
+                }
+                /* после отрезания колонок следующих дней в списке нет, и они записываются заново */
+                auto it = exported_days.find(t);
+                const uint64_t exported_checksum = it == exported_days.end() ? 0 : it->second.checksum;
+                if(get_checksum(candles) == exported_checksum) continue;
+                const int err = append_day(candles, t);
+                if(err != intrade_bar_common::OK) return err;
+                if(++days % commit_days != 0) continue;
+                const int err_commit = commit();
+                if(err_commit != intrade_bar_common::OK) return err_commit;
+            }
+            return commit();
+        }
+    };
+}
+
+#endif // INTRADE_BAR_COLUMN_EXPORTER_HPP_INCLUDED
@@ -37,6 +37,8 @@
 #include <sstream>
 #include <thread>
 #include <cstring>
+#include <cstdint>
+#include <cmath>
 #include <xtime.hpp>
 
 namespace intrade_bar_common {
@@ -148,6 +150,90 @@ namespace intrade_bar_common {
          * (валютные пары с JPY имеют множитель 1000)
          */
 
+    /** \brief Цена в целых тиках
+     *
+     * Цена хранится как целое число тиков вместе с множителем символа (pricescale),
+     * поэтому сравнение цен точное, а в double цена переводится только на выходе
+     */
+    class Price {
+    public:
+        int64_t ticks = 0;      /**< Цена, умноженная на множитель */
+        uint32_t scale = 1;     /**< Множитель цены */
+
+        Price() {};
+
+        Price(const int64_t user_ticks, const uint32_t user_scale) :
+            ticks(user_ticks), scale(user_scale) {
+        }
+
+        /** \brief Получить цену из числа с плавающей точкой
+         * \param value Цена
+         * \param scale Множитель цены
+         */
+        static inline Price from_double(const double value, const uint32_t scale) {
+            return Price((int64_t)std::llround(value * (double)scale), scale);
+        }
+
+        /** \brief Получить среднюю цену (bid + ask)/2
+         *
+         * Округление такое же, как в потоках котировок и хранилищах котировок:
+         * floor((bid + ask)/2 * scale + 0.5) для double, поэтому цены совпадают с уже записанными барами
+         * \param bid Цена bid
+         * \param ask Цена ask
+         * \param scale Множитель цены
+         */
+        static inline Price from_bid_ask(const double bid, const double ask, const uint32_t scale) {
+            const double price = (bid + ask) / 2.0;
+            return Price((int64_t)std::floor(price * (double)scale + 0.5), scale);
+        }
+
+        inline double to_double() const {
+            return (double)ticks / (double)scale;
+        }
+
+        /** \brief Разница цен в тиках
+         *
+         * Цены должны иметь одинаковый множитель
+         */
+        inline int64_t operator - (const Price &other) const {
+            return ticks - other.ticks;
+        }
+
+        inline bool operator == (const Price &other) const {
+            if(scale == other.scale) return ticks == other.ticks;
+            return ticks * other.scale == other.ticks * scale;
+        }
+
+        inline bool operator != (const Price &other) const {
+            return !(*this == other);
+        }
+
+        inline bool operator < (const Price &other) const {
+            if(scale == other.scale) return ticks < other.ticks;
+            return ticks * other.scale < other.ticks * scale;
+        }
+
+        inline bool operator > (const Price &other) const {
+            return other < *this;
+        }
+
+        inline bool operator <= (const Price &other) const {
+            return !(other < *this);
+        }
+
+        inline bool operator >= (const Price &other) const {
+            return !(*this < other);
+        }
+    };
+
+    /** \brief Получить цену символа в тиках
+     * \param value Цена
+     * \param symbol_index Номер символа
+     */
+    inline Price get_price(const double value, const uint32_t symbol_index) {
+        return Price::from_double(value, pricescale_currency_pairs[symbol_index]);
+    }
+
     static const std::array<uint32_t, CURRENCY_PAIRS>
         precision_currency_pairs = {
         5,3,5,5,
@@ -199,6 +285,13 @@ namespace intrade_bar_common {
         PUT = -1,   ///< Сделка на понижение
     };
 
+    /// Источник данных бара
+    enum CandleSource {
+        SOURCE_STREAM = 0,      ///< Бар построен по потоку котировок
+        SOURCE_PRICE_NOW = 1,   ///< Бар восстановлен по текущей цене price_now
+        SOURCE_HISTORY = 2,     ///< Бар восстановлен по историческим данным
+    };
+
     /// Варианты состояния ошибок
     enum ErrorType {
         OK = 0,                             ///< Ошибки нет
@@ -261,6 +354,7 @@ namespace intrade_bar_common {
 	public:
 		std::string symbol;
 		double price = 0;
+		Price fixed_price;          /**< Цена (bid + ask)/2 в тиках */
 		double bid = 0;
 		double ask = 0;
 		xtime::ftimestamp_t timestamp = 0;
@@ -0,0 +1,616 @@
+/*
+* intrade-bar-api-cpp - C ++ API client for intrade.bar
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef INTRADE_BAR_COMPRESSED_HISTORY_HPP_INCLUDED
+#define INTRADE_BAR_COMPRESSED_HISTORY_HPP_INCLUDED
+
+#include <intrade-bar-common.hpp>
+#include <xtime.hpp>
+#include <xquotes_common.hpp>
+#include <algorithm>
+#include <vector>
+#include <array>
+#include <limits>
+#include <cmath>
+
+namespace intrade_bar {
+
+    /** \brief Сжатая история минутных баров одного символа
+     *
+     * Бары хранятся блоками по BLOCK_BARS штук. Цены переводятся в целые тики (pricescale символа),
+     * в блоке записываются разности: шаг метки времени, изменение цены закрытия,
+     * разрыв открытия с прошлым закрытием и тени high/low от тела бара.
+     * Каждый столбец упаковывается по своей ширине в битах от минимума блока,
+     * поэтому минутный бар занимает обычно 3-5 байт вместо 48 байт Candle.
+     * Бары с нулевыми ценами (пропуски данных, выходные) отмечаются флагом
+     * и не увеличивают ширину столбцов цены.
+     * Если бар не переводится в тики без потерь, блок хранится как есть.
+     * Класс не потокобезопасный, блокировку выполняет владелец.
+     */
+    class CompressedCandleHistory {
+    public:
+        static const uint32_t BLOCK_BARS = 256;     /**< Количество баров в блоке */
+
+    private:
+        enum {
+            COLUMN_TIME = 0,
+            COLUMN_CLOSE,
+            COLUMN_OPEN,
+            COLUMN_HIGH,
+            COLUMN_LOW,
+            COLUMN_VOLUME,
+            COLUMN_EMPTY,
+            COLUMNS,
+        };
+
+        class Block {
+        public:
+            xtime::timestamp_t first_timestamp = 0;
+            xtime::timestamp_t last_timestamp = 0;
+            int64_t first_close = 0;                        /**< Цена закрытия первого бара в тиках */
+            uint32_t count = 0;                             /**< Количество баров */
+            std::array<int64_t, COLUMNS> base;              /**< Минимум столбца */
+            std::array<uint8_t, COLUMNS> bits;              /**< Ширина значения столбца в битах */
+            std::vector<uint64_t> words;                    /**< Упакованные столбцы */
+            std::vector<xquotes_common::Candle> raw;        /**< Бары блока, который нельзя сжать без потерь */
+
+            Block() {
+                base.fill(0);
+                bits.fill(0);
+            }
+        };
+
+        std::vector<Block> blocks;
+        uint32_t scale = 1;
+        size_t num_candles = 0;
+        size_t max_candles = 0;
+
+        size_t cache_block = std::numeric_limits<size_t>::max();
+        std::vector<xquotes_common::Candle> cache;   /**< Последний распакованный блок */
+
+        static inline uint8_t get_bit_width(const uint64_t value) {
+            uint8_t width = 0;
+            uint64_t temp = value;
+            while(temp != 0) {
+                ++width;
+                temp >>= 1;
+            }
+            return width;
+        }
+
+        static inline void write_bits(
+                std::vector<uint64_t> &words,
+                const uint64_t position,
+                const uint64_t value,
+                const uint8_t width) {
+            if(width == 0) return;
+            const size_t index = position >> 6;
+            const uint32_t offset = position & 63;
+            words[index] |= value << offset;
+            if(offset + width > 64) words[index + 1] |= value >> (64 - offset);
+        }
+
+        static inline uint64_t read_bits(
+                const uint64_t *words,
+                const uint64_t position,
+                const uint8_t width) {
+            if(width == 0) return 0;
+            const size_t index = position >> 6;
+            const uint32_t offset = position & 63;
+            uint64_t value = words[index] >> offset;
+            if(offset + width > 64) value |= words[index + 1] << (64 - offset);
+            if(width < 64) value &= (((uint64_t)1) << width) - 1;
+            return value;
+        }
+
+        inline bool to_ticks(const double value, int64_t &ticks) const {
+            if(!std::isfinite(value) || std::abs(value) * (double)scale > 1.0e15) return false;
+            ticks = std::llround(value * (double)scale);
+            return (double)ticks / (double)scale == value;
+        }
+
+        /** \brief Сжать бары в блок
+         */
+        void encode_block(const xquotes_common::Candle *candles, const uint32_t count, Block &block) const {
+            block = Block();
+            block.count = count;
+            block.first_timestamp = candles[0].timestamp;
+            block.last_timestamp = candles[count - 1].timestamp;
+
+            std::array<std::vector<int64_t>, COLUMNS> columns;
+            for(uint32_t c = 0; c < COLUMNS; ++c) columns[c].assign(count, 0);
+            bool is_exact = true;
+            bool is_first_close = false;
+            int64_t prev_close = 0;
+            for(uint32_t i = 0; i < count && is_exact; ++i) {
+                const xquotes_common::Candle &candle = candles[i];
+                int64_t open = 0, high = 0, low = 0, close = 0, volume = 0;
+                if(!to_ticks(candle.open, open) ||
+                    !to_ticks(candle.high, high) ||
+                    !to_ticks(candle.low, low) ||
+                    !to_ticks(candle.close, close) ||
+                    !std::isfinite(candle.volume) ||
+                    std::abs(candle.volume) > 1.0e15 ||
+                    (double)std::llround(candle.volume) != candle.volume) {
+                    is_exact = false;
+                    break;
+                }
+                volume = std::llround(candle.volume);
+                columns[COLUMN_TIME][i] = i == 0 ? 0 : (int64_t)(candle.timestamp - candles[i - 1].timestamp);
+                columns[COLUMN_VOLUME][i] = volume;
+                /* пропуск данных не меняет цену закрытия, от которой считаются разности */
+                if(open == 0 && high == 0 && low == 0 && close == 0) {
+                    columns[COLUMN_EMPTY][i] = 1;
+                    continue;
+                }
+                if(!is_first_close) {
+                    block.first_close = close;
+                    prev_close = close;
+                    is_first_close = true;
+                }
+                columns[COLUMN_CLOSE][i] = close - prev_close;
+                columns[COLUMN_OPEN][i] = open - prev_close;
+                columns[COLUMN_HIGH][i] = high - std::max(open, close);
+                columns[COLUMN_LOW][i] = std::min(open, close) - low;
+                prev_close = close;
+            }
+            if(!is_exact) {
+                block.raw.assign(candles, candles + count);
+                return;
+            }
+
+            uint64_t total_bits = 0;
+            for(uint32_t c = 0; c < COLUMNS; ++c) {
+                const auto minmax = std::minmax_element(columns[c].begin(), columns[c].end());
+                block.base[c] = *minmax.first;
+                block.bits[c] = get_bit_width((uint64_t)*minmax.second - (uint64_t)*minmax.first);
+                total_bits += (uint64_t)block.bits[c] * count;
+            }
+            block.words.assign((total_bits + 63) / 64, 0);
+            uint64_t position = 0;
+            for(uint32_t c = 0; c < COLUMNS; ++c) {
+                const uint8_t width = block.bits[c];
+                const uint64_t base = (uint64_t)block.base[c];
+                for(uint32_t i = 0; i < count; ++i) {
+                    write_bits(block.words, position, (uint64_t)columns[c][i] - base, width);
+                    position += width;
+                }
+            }
+        }
+
+        /** \brief Распаковать блок в буфер вызывающей стороны
+         */
+        void decode_block(const Block &block, xquotes_common::Candle *candles) const {
+            if(!block.raw.empty()) {
+                std::copy(block.raw.begin(), block.raw.end(), candles);
+                return;
+            }
+            const uint32_t count = block.count;
+            const uint64_t *words = block.words.data();
+            const double price_scale = (double)scale;
+            uint64_t position = 0;
+
+            /* столбцы читаются по очереди, в каждом цикле одна операция на бар */
+            xtime::timestamp_t timestamp = block.first_timestamp;
+            uint8_t width = block.bits[COLUMN_TIME];
+            uint64_t base = (uint64_t)block.base[COLUMN_TIME];
+            for(uint32_t i = 0; i < count; ++i) {
+                timestamp += (xtime::timestamp_t)(int64_t)(read_bits(words, position, width) + base);
+                position += width;
+                candles[i].timestamp = timestamp;
+            }
+
+            std::array<int64_t, BLOCK_BARS * 2> temp_close;
+            std::vector<int64_t> long_close;
+            int64_t *close = temp_close.data();
+            if(count > temp_close.size()) {
+                long_close.resize(count);
+                close = long_close.data();
+            }
+
+            int64_t value = block.first_close;
+            width = block.bits[COLUMN_CLOSE];
+            base = (uint64_t)block.base[COLUMN_CLOSE];
+            for(uint32_t i = 0; i < count; ++i) {
+                value += (int64_t)(read_bits(words, position, width) + base);
+                position += width;
+                close[i] = value;
+            }
+
+            /* open считается от закрытия предыдущего непустого бара */
+            width = block.bits[COLUMN_OPEN];
+            base = (uint64_t)block.base[COLUMN_OPEN];
+            int64_t prev_close = block.first_close;
+            for(uint32_t i = 0; i < count; ++i) {
+                const int64_t open = prev_close + (int64_t)(read_bits(words, position, width) + base);
+                position += width;
+                prev_close = close[i];
+                candles[i].open = (double)open / price_scale;
+                candles[i].close = (double)close[i] / price_scale;
+                /* пока храним тело бара в тиках в полях high и low */
+                candles[i].high = (double)std::max(open, close[i]);
+                candles[i].low = (double)std::min(open, close[i]);
+            }
+
+            width = block.bits[COLUMN_HIGH];
+            base = (uint64_t)block.base[COLUMN_HIGH];
+            for(uint32_t i = 0; i < count; ++i) {
+                const int64_t high = (int64_t)candles[i].high + (int64_t)(read_bits(words, position, width) + base);
+                position += width;
+                candles[i].high = (double)high / price_scale;
+            }
+
+            width = block.bits[COLUMN_LOW];
+            base = (uint64_t)block.base[COLUMN_LOW];
+            for(uint32_t i = 0; i < count; ++i) {
+                const int64_t low = (int64_t)candles[i].low - (int64_t)(read_bits(words, position, width) + base);
+                position += width;
+                candles[i].low = (double)low / price_scale;
+            }
+
+            width = block.bits[COLUMN_VOLUME];
+            base = (uint64_t)block.base[COLUMN_VOLUME];
+            for(uint32_t i = 0; i < count; ++i) {
+                candles[i].volume = (double)(int64_t)(read_bits(words, position, width) + base);
+                position += width;
+            }
+
+            width = block.bits[COLUMN_EMPTY];
+            if(width == 0) return;
+            base = (uint64_t)block.base[COLUMN_EMPTY];
+            for(uint32_t i = 0; i < count; ++i) {
+                const bool is_empty = (read_bits(words, position, width) + base) != 0;
+                position += width;
+                if(!is_empty) continue;
+                candles[i].open = 0;
+                candles[i].high = 0;
+                candles[i].low = 0;
+                candles[i].close = 0;
+            }
+        }
+
+        /** \brief Получить распакованный блок через кэш
+         */
+        const std::vector<xquotes_common::Candle> &get_cached_block(const size_t index) {
+            if(cache_block != index) {
+                cache.resize(blocks[index].count);
+                decode_block(blocks[index], cache.data());
+                cache_block = index;
+            }
+            return cache;
+        }
+
+        /** \brief Найти блок, который может содержать метку времени
+         * \return Индекс блока или blocks.size(), если метка раньше первого блока
+         */
+        size_t find_block(const xtime::timestamp_t timestamp) const {
+            auto it = std::upper_bound(blocks.begin(), blocks.end(), timestamp,
+                [](const xtime::timestamp_t t, const Block &b) {
+                return t < b.first_timestamp;
+            });
+            if(it == blocks.begin()) return blocks.size();
+            return (size_t)(it - blocks.begin()) - 1;
+        }
+
+        /** \brief Пересжать блок из массива баров, большой блок делится на части
+         */
+        void replace_block(const size_t index, const std::vector<xquotes_common::Candle> &candles) {
+            cache_block = std::numeric_limits<size_t>::max();
+            num_candles -= blocks[index].count;
+            blocks.erase(blocks.begin() + index);
+            std::vector<Block> new_blocks;
+            size_t offset = 0;
+            while(offset < candles.size()) {
+                size_t count = std::min((size_t)BLOCK_BARS, candles.size() - offset);
+                /* не оставляем маленький хвост */
+                if(candles.size() - offset - count < BLOCK_BARS / 2) count = candles.size() - offset;
+                new_blocks.push_back(Block());
+                encode_block(candles.data() + offset, (uint32_t)count, new_blocks.back());
+                offset += count;
+            }
+            blocks.insert(blocks.begin() + index, new_blocks.begin(), new_blocks.end());
+            num_candles += candles.size();
+        }
+
+        /** \brief Объединить бары с блоками истории
+         *
+         * Бары идут по возрастанию метки времени и не новее последнего бара истории.
+         * Каждый затронутый блок распаковывается и пересжимается один раз
+         */
+        void merge_blocks(const xquotes_common::Candle *candles, const size_t count) {
+            std::vector<xquotes_common::Candle> temp;
+            std::vector<xquotes_common::Candle> merged;
+            size_t offset = 0;
+            while(offset < count) {
+                size_t index = find_block(candles[offset].timestamp);
+                if(index == blocks.size()) index = 0;
+                /* в блок попадают бары до начала следующего блока */
+                size_t end = count;
+                if(index + 1 < blocks.size()) {
+                    end = (size_t)(std::lower_bound(candles + offset, candles + count, blocks[index + 1].first_timestamp,
+                        [](const xquotes_common::Candle &c, const xtime::timestamp_t t) {
+                        return c.timestamp < t;
+                    }) - candles);
+                }
+                temp.resize(blocks[index].count);
+                decode_block(blocks[index], temp.data());
+                merged.clear();
+                merged.reserve(temp.size() + end - offset);
+                size_t i = 0;
+                for(size_t j = offset; i < temp.size() || j < end;) {
+                    if(j == end || (i < temp.size() && temp[i].timestamp < candles[j].timestamp)) {
+                        merged.push_back(temp[i++]);
+                        continue;
+                    }
+                    /* бар с такой же меткой времени заменяется */
+                    if(i < temp.size() && temp[i].timestamp == candles[j].timestamp) ++i;
+                    if(!merged.empty() && merged.back().timestamp == candles[j].timestamp) merged.back() = candles[j];
+                    else merged.push_back(candles[j]);
+                    ++j;
+                }
+                replace_block(index, merged);
+                offset = end;
+            }
+        }
+
+        /** \brief Удалить старые блоки сверх ограничения
+         */
+        void trim() {
+            if(max_candles == 0) return;
+            size_t erase_blocks = 0;
+            while(erase_blocks < blocks.size() &&
+                num_candles - blocks[erase_blocks].count >= max_candles) {
+                num_candles -= blocks[erase_blocks].count;
+                ++erase_blocks;
+            }
+            if(erase_blocks == 0) return;
+            blocks.erase(blocks.begin(), blocks.begin() + erase_blocks);
+            cache_block = std::numeric_limits<size_t>::max();
+        }
+
+    public:
+
+        /** \brief Конструктор сжатой истории
+         * \param user_scale Множитель цены символа (pricescale)
+         */
+        CompressedCandleHistory(const uint32_t user_scale = 1) :
+            scale(user_scale == 0 ? 1 : user_scale) {
+        }
+
+        /** \brief Ограничить количество хранимых баров
+         *
+         * Старые бары удаляются целыми блоками, поэтому баров может остаться чуть больше
+         * \param max_bars Количество баров, 0 - без ограничения
+         */
+        void set_max_bars(const size_t max_bars) {
+            max_candles = max_bars;
+            trim();
+        }
+
+        /** \brief Записать бары в историю
+         *
+         * Бары должны идти по возрастанию метки времени. Бары не новее последнего бара истории
+         * объединяются с блоками (бар с такой же меткой времени заменяется), каждый затронутый блок
+         * пересжимается один раз. Остальные бары добавляются в конец истории
+         * \param candles Указатель на массив баров
+         * \param count Количество баров
+         */
+        void merge(const xquotes_common::Candle *candles, const size_t count) {
+            size_t offset = 0;
+            if(!blocks.empty()) {
+                offset = (size_t)(std::upper_bound(candles, candles + count, blocks.back().last_timestamp,
+                    [](const xtime::timestamp_t t, const xquotes_common::Candle &c) {
+                    return t < c.timestamp;
+                }) - candles);
+                merge_blocks(candles, offset);
+            }
+            if(offset == count) {
+                trim();
+                return;
+            }
+
+            /* неполный последний блок дополняем до BLOCK_BARS */
+            if(!blocks.empty() && blocks.back().count < BLOCK_BARS) {
+                const size_t index = blocks.size() - 1;
+                std::vector<xquotes_common::Candle> temp(blocks[index].count);
+                decode_block(blocks[index], temp.data());
+                const size_t add = std::min((size_t)(BLOCK_BARS - blocks[index].count), count - offset);
+                temp.insert(temp.end(), candles + offset, candles + offset + add);
+                offset += add;
+                cache_block = std::numeric_limits<size_t>::max();
+                num_candles -= blocks[index].count;
+                encode_block(temp.data(), (uint32_t)temp.size(), blocks[index]);
+                num_candles += temp.size();
+            }
+            while(offset < count) {
+                const size_t add = std::min((size_t)BLOCK_BARS, count - offset);
+                blocks.push_back(Block());
+                encode_block(candles + offset, (uint32_t)add, blocks.back());
+                num_candles += add;
+                offset += add;
+            }
+            trim();
+        }
+
+        /** \brief Добавить бары в конец истории
+         *
+         * Бары должны идти по возрастанию метки времени.
+         * Бары не новее последнего бара истории записываются как в merge()
+         * \param candles Указатель на массив баров
+         * \param count Количество баров
+         */
+        inline void append(const xquotes_common::Candle *candles, const size_t count) {
+            merge(candles, count);
+        }
+
+        /** \brief Записать бар в историю
+         *
+         * Бар с такой же меткой времени заменяется, иначе бар вставляется на свое место
+         * \param candle Бар
+         */
+        inline void update(const xquotes_common::Candle &candle) {
+            merge(&candle, 1);
+        }
+
+        /** \brief Получить бар по смещению от последнего бара истории
+         * \param offset Смещение, 0 - последний бар
+         * \param candle Бар
+         * \return вернет true, если бар есть
+         */
+        bool get_candle(const size_t offset, xquotes_common::Candle &candle) {
+            if(offset >= num_candles) return false;
+            size_t skip = offset;
+            size_t index = blocks.size();
+            while(index > 0) {
+                --index;
+                if(skip < blocks[index].count) break;
+                skip -= blocks[index].count;
+            }
+            const std::vector<xquotes_common::Candle> &block = get_cached_block(index);
+            candle = block[block.size() - skip - 1];
+            return true;
+        }
+
+        /** \brief Получить бар по метке времени
+         * \param timestamp Метка времени начала бара
+         * \param candle Бар
+         * \return вернет true, если бар есть
+         */
+        bool get_timestamp_candle(const xtime::timestamp_t timestamp, xquotes_common::Candle &candle) {
+            const size_t index = find_block(timestamp);
+            if(index == blocks.size() || timestamp > blocks[index].last_timestamp) return false;
+            const std::vector<xquotes_common::Candle> &block = get_cached_block(index);
+            auto it = std::lower_bound(block.begin(), block.end(), timestamp,
+                [](const xquotes_common::Candle &c, const xtime::timestamp_t t) {
+                return c.timestamp < t;
+            });
+            if(it == block.end() || it->timestamp != timestamp) return false;
+            candle = *it;
+            return true;
+        }
+
+        /** \brief Получить бары в диапазоне меток времени
+         * \param start Начальная метка времени
+         * \param stop Конечная метка времени (включительно)
+         * \param candles Массив, в конец которого будут добавлены бары
+         * \return Количество добавленных баров
+         */
+        size_t get_candles(
+                const xtime::timestamp_t start,
+                const xtime::timestamp_t stop,
+                std::vector<xquotes_common::Candle> &candles) const {
+            if(blocks.empty() || start > stop) return 0;
+            size_t index = find_block(start);
+            if(index == blocks.size()) index = 0;
+            const size_t old_size = candles.size();
+            for(; index < blocks.size() && blocks[index].first_timestamp <= stop; ++index) {
+                const Block &block = blocks[index];
+                if(block.last_timestamp < start) continue;
+                const size_t offset = candles.size();
+                candles.resize(offset + block.count);
+                decode_block(block, candles.data() + offset);
+                /* убираем бары вне диапазона на краях */
+                auto first = std::lower_bound(candles.begin() + offset, candles.end(), start,
+                    [](const xquotes_common::Candle &c, const xtime::timestamp_t t) {
+                    return c.timestamp < t;
+                });
+                candles.erase(candles.begin() + offset, first);
+                auto last = std::upper_bound(candles.begin() + offset, candles.end(), stop,
+                    [](const xtime::timestamp_t t, const xquotes_common::Candle &c) {
+                    return t < c.timestamp;
+                });
+                candles.erase(last, candles.end());
+            }
+            return candles.size() - old_size;
+        }
+
+        /** \brief Получить количество блоков
+         */
+        inline size_t get_num_blocks() const {
+            return blocks.size();
+        }
+
+        /** \brief Получить количество баров в блоке
+         * \param index Индекс блока
+         */
+        inline uint32_t get_block_size(const size_t index) const {
+            return blocks[index].count;
+        }
+
+        /** \brief Распаковать блок в буфер вызывающей стороны
+         * \param index Индекс блока
+         * \param candles Буфер размером не меньше get_block_size(index)
+         * \return Количество баров
+         */
+        inline uint32_t decode_block(const size_t index, xquotes_common::Candle *candles) const {
+            decode_block(blocks[index], candles);
+            return blocks[index].count;
+        }
+
+        /** \brief Получить количество баров
+         */
+        inline size_t size() const {
+            return num_candles;
+        }
+
+        inline bool empty() const {
+            return num_candles == 0;
+        }
+
+        /** \brief Получить метку времени первого бара
+         */
+        inline xtime::timestamp_t get_first_timestamp() const {
+            return blocks.empty() ? 0 : blocks.front().first_timestamp;
+        }
+
+        /** \brief Получить метку времени последнего бара
+         */
+        inline xtime::timestamp_t get_last_timestamp() const {
+            return blocks.empty() ? 0 : blocks.back().last_timestamp;
+        }
+
+        /** \brief Получить объем занятой памяти в байтах
+         */
+        size_t get_memory_usage() const {
+            size_t bytes = sizeof(CompressedCandleHistory) +
+                blocks.capacity() * sizeof(Block) +
+                cache.capacity() * sizeof(xquotes_common::Candle);
+            for(size_t i = 0; i < blocks.size(); ++i) {
+                bytes += blocks[i].words.capacity() * sizeof(uint64_t);
+                bytes += blocks[i].raw.capacity() * sizeof(xquotes_common::Candle);
+            }
+            return bytes;
+        }
+
+        /** \brief Очистить историю
+         */
+        void clear() {
+            blocks.clear();
+            cache.clear();
+            cache_block = std::numeric_limits<size_t>::max();
+            num_candles = 0;
+        }
+    };
+}
+
+#endif // INTRADE_BAR_COMPRESSED_HISTORY_HPP_INCLUDED
@@ -0,0 +1,270 @@
+/*
+* intrade-bar-api-cpp - C ++ API client for intrade.bar
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef INTRADE_BAR_COVARIANCE_ENGINE_HPP_INCLUDED
+#define INTRADE_BAR_COVARIANCE_ENGINE_HPP_INCLUDED
+
+#include <intrade-bar-common.hpp>
+#include <intrade-bar-indicator-engine.hpp>
+#include <xquotes_common.hpp>
+#include <memory>
+#include <vector>
+#include <array>
+#include <map>
+#include <limits>
+#include <cmath>
+
+namespace intrade_bar {
+
+    /** \brief Снимок скользящей ковариации доходностей символов
+     *
+     * Снимок не меняется после публикации, его можно читать из любого потока
+     */
+    class CovarianceSnapshot {
+    public:
+        static const uint32_t SYMBOLS = intrade_bar_common::CURRENCY_PAIRS;
+
+        std::array<std::array<double, SYMBOLS>, SYMBOLS> covariance;    /**< Выборочная ковариация логарифмических доходностей */
+        std::array<std::array<double, SYMBOLS>, SYMBOLS> correlation;   /**< Корреляция, NaN если у символа нет движения цены */
+        std::array<double, SYMBOLS> mean;                               /**< Средняя доходность */
+        xtime::timestamp_t timestamp = 0;                               /**< Метка времени последнего бара */
+        uint32_t window = 0;                                            /**< Размер окна в барах */
+        uint32_t bars = 0;                                              /**< Количество баров в окне */
+
+        /** \brief Проверить, заполнено ли окно
+         */
+        inline bool ready() const {
+            return bars >= window && window > 1;
+        }
+
+        inline double get_covariance(const uint32_t a, const uint32_t b) const {
+            return covariance[a][b];
+        }
+
+        inline double get_correlation(const uint32_t a, const uint32_t b) const {
+            return correlation[a][b];
+        }
+    };
+
+    /** \brief Скользящая ковариация минутных логарифмических доходностей всех символов
+     *
+     * На каждый закрытый бар суммы и попарные произведения доходностей обновляются
+     * добавлением нового и вычитанием выпавшего из окна бара - O(n^2) на бар, без пересчета окна.
+     * Строка матрицы обновляется циклом по 32 дорожкам, который векторизуется (AVX2 выбирается при запуске).
+     * Раз в окно суммы пересчитываются заново, чтобы не накапливалась ошибка округления.
+     * Обновление вызывается одним потоком, например из callback IntradeBarApi по событию
+     * HISTORICAL_DATA_RECEIVED, поэтому разогрев идет по уже загружаемой истории.
+     */
+    class CovarianceEngine {
+    public:
+        static const uint32_t SYMBOLS = intrade_bar_common::CURRENCY_PAIRS;
+        static const uint32_t LANES = indicators::LANES;
+        using LaneArray = indicators::LaneArray;
+
+    private:
+        const uint32_t window;
+        std::vector<LaneArray> returns;                 /**< Кольцевой буфер доходностей окна */
+        uint32_t pos = 0;
+        uint32_t bars = 0;
+        LaneArray sum;                                  /**< Сумма доходностей окна */
+        std::array<LaneArray, SYMBOLS> cross;           /**< Суммы попарных произведений доходностей */
+        LaneArray last_price;
+        xtime::timestamp_t last_timestamp = 0;
+        std::shared_ptr<const CovarianceSnapshot> snapshot;
+        const intrade_bar_common::price_kernels::InstructionSet instruction_set;
+
+        static void clear(LaneArray &lanes) {
+            indicators::fill_lanes(lanes, 0);
+        }
+
+        /** \brief Добавить доходности бара и убрать выпавший бар
+         */
+        inline void accumulate(const LaneArray &value, const LaneArray &old) {
+            for(uint32_t l = 0; l < LANES; ++l) {
+                sum.v[l] += value.v[l] - old.v[l];
+            }
+            for(uint32_t i = 0; i < SYMBOLS; ++i) {
+                const double a = value.v[i];
+                const double b = old.v[i];
+                LaneArray &row = cross[i];
+                for(uint32_t l = 0; l < LANES; ++l) {
+                    row.v[l] += a * value.v[l] - b * old.v[l];
+                }
+            }
+        }
+
+        /** \brief Пересчитать суммы по окну
+         */
+        inline void recalculate() {
+            clear(sum);
+            for(uint32_t i = 0; i < SYMBOLS; ++i) clear(cross[i]);
+            const uint32_t size = std::min(bars, window);
+            for(uint32_t k = 0; k < size; ++k) {
+                const LaneArray &value = returns[k];
+                for(uint32_t l = 0; l < LANES; ++l) sum.v[l] += value.v[l];
+                for(uint32_t i = 0; i < SYMBOLS; ++i) {
+                    const double a = value.v[i];
+                    LaneArray &row = cross[i];
+                    for(uint32_t l = 0; l < LANES; ++l) {
+                        row.v[l] += a * value.v[l];
+                    }
+                }
+            }
+        }
+
+        inline void add_bar(const LaneArray &value, const bool is_recalculate) {
+            LaneArray &slot = returns[pos];
+            if(is_recalculate) {
+                slot = value;
+                recalculate();
+            } else {
+                accumulate(value, slot);
+                slot = value;
+            }
+        }
+
+#       ifdef INTRADE_BAR_PRICE_KERNELS_X86
+        __attribute__((target("avx2"), flatten))
+        void add_bar_avx2(const LaneArray &value, const bool is_recalculate) {
+            add_bar(value, is_recalculate);
+        }
+
+        __attribute__((flatten))
+        void add_bar_default(const LaneArray &value, const bool is_recalculate) {
+            add_bar(value, is_recalculate);
+        }
+#       else
+        void add_bar_default(const LaneArray &value, const bool is_recalculate) {
+            add_bar(value, is_recalculate);
+        }
+#       endif
+
+        /** \brief Построить и опубликовать снимок
+         */
+        void publish(const xtime::timestamp_t timestamp) {
+            std::shared_ptr<CovarianceSnapshot> next = std::make_shared<CovarianceSnapshot>();
+            const double nan = std::numeric_limits<double>::quiet_NaN();
+            const uint32_t size = std::min(bars, window);
+            next->timestamp = timestamp;
+            next->window = window;
+            next->bars = size;
+            for(uint32_t i = 0; i < SYMBOLS; ++i) {
+                next->mean[i] = size == 0 ? 0.0 : sum.v[i] / (double)size;
+            }
+            for(uint32_t i = 0; i < SYMBOLS; ++i) {
+                for(uint32_t j = 0; j < SYMBOLS; ++j) {
+                    next->covariance[i][j] = size < 2 ? nan :
+                        (cross[i].v[j] - sum.v[i] * sum.v[j] / (double)size) / (double)(size - 1);
+                }
+            }
+            for(uint32_t i = 0; i < SYMBOLS; ++i) {
+                for(uint32_t j = 0; j < SYMBOLS; ++j) {
+                    const double variance = next->covariance[i][i] * next->covariance[j][j];
+                    next->correlation[i][j] = variance > 0 ? next->covariance[i][j] / std::sqrt(variance) : nan;
+                }
+            }
+            std::atomic_store(&snapshot, std::shared_ptr<const CovarianceSnapshot>(next));
+        }
+
+    public:
+
+        /** \brief Конструктор движка
+         * \param user_window Размер окна в барах, не меньше 2
+         */
+        CovarianceEngine(const uint32_t user_window = 60) :
+                window(std::max<uint32_t>(user_window, 2)),
+                returns(window),
+                snapshot(std::make_shared<CovarianceSnapshot>()),
+                instruction_set(intrade_bar_common::price_kernels::get_instruction_set()) {
+            for(uint32_t k = 0; k < window; ++k) clear(returns[k]);
+            clear(sum);
+            clear(last_price);
+            for(uint32_t i = 0; i < SYMBOLS; ++i) clear(cross[i]);
+        }
+
+        CovarianceEngine(const CovarianceEngine&) = delete;
+        CovarianceEngine &operator=(const CovarianceEngine&) = delete;
+
+        /** \brief Добавить закрытый бар
+         *
+         * Символы без бара получают нулевую доходность. Бары с меткой времени не новее последнего пропускаются.
+         * Первый бар только запоминает цены: без прошлой цены доходности нет, и строка в окно не добавляется
+         * \param prices Цены закрытия по индексам символов, 0 если бара нет
+         * \param timestamp Метка времени бара
+         */
+        void update(const std::array<double, SYMBOLS> &prices, const xtime::timestamp_t timestamp) {
+            if(timestamp <= last_timestamp) return;
+            last_timestamp = timestamp;
+            bool is_previous_price = false;
+            for(uint32_t i = 0; i < SYMBOLS; ++i) {
+                if(last_price.v[i] > 0) is_previous_price = true;
+            }
+            LaneArray value;
+            clear(value);
+            for(uint32_t i = 0; i < SYMBOLS; ++i) {
+                if(prices[i] <= 0) continue;
+                if(last_price.v[i] > 0) value.v[i] = std::log(prices[i] / last_price.v[i]);
+                last_price.v[i] = prices[i];
+            }
+            if(!is_previous_price) return;
+            ++bars;
+            const bool is_recalculate = pos == window - 1;
+#           ifdef INTRADE_BAR_PRICE_KERNELS_X86
+            if(instruction_set == intrade_bar_common::price_kernels::InstructionSet::AVX2) add_bar_avx2(value, is_recalculate);
+            else add_bar_default(value, is_recalculate);
+#           else
+            add_bar_default(value, is_recalculate);
+#           endif
+            pos = (pos + 1) % window;
+            publish(timestamp);
+        }
+
+        /** \brief Добавить закрытые бары из callback IntradeBarApi
+         * \param candles Бары символов
+         * \param timestamp Метка времени бара
+         */
+        void update(const std::map<std::string, xquotes_common::Candle> &candles, const xtime::timestamp_t timestamp) {
+            std::array<double, SYMBOLS> prices;
+            prices.fill(0);
+            for(auto &item : candles) {
+                auto it = intrade_bar_common::currency_pairs_indx.find(item.first);
+                if(it == intrade_bar_common::currency_pairs_indx.end()) continue;
+                prices[it->second] = item.second.close;
+            }
+            update(prices, timestamp);
+        }
+
+        /** \brief Получить последний снимок
+         * \return Неизменяемый снимок матриц ковариации и корреляции
+         */
+        inline std::shared_ptr<const CovarianceSnapshot> get_snapshot() const {
+            return std::atomic_load(&snapshot);
+        }
+
+        inline uint32_t get_window() const {
+            return window;
+        }
+    };
+}
+
+#endif // INTRADE_BAR_COVARIANCE_ENGINE_HPP_INCLUDED
@@ -0,0 +1,908 @@
+/*
+* intrade-bar-api-cpp - C ++ API client for intrade.bar
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef INTRADE_BAR_HISTORY_DOWNLOADER_HPP_INCLUDED
+#define INTRADE_BAR_HISTORY_DOWNLOADER_HPP_INCLUDED
+
+#include "intrade-bar-https-api.hpp"
+#include <xtime.hpp>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+#include <future>
+#include <chrono>
+#include <random>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <functional>
+#include <cmath>
+
+namespace intrade_bar {
+
+    /** \brief Ограничение количества одновременных запросов по алгоритму AIMD
+     *
+     * Лимит растет на единицу за "окно" успешных ответов (аддитивное увеличение)
+     * и уменьшается в разы при ошибках, DDoS-GUARD или росте задержки ответа
+     * (мультипликативное уменьшение). Уменьшение происходит не чаще одного раза
+     * за время ответа, чтобы одна волна ошибок не обрушила лимит до минимума.
+     */
+    class AimdConcurrency {
+    private:
+        std::mutex limit_mutex;
+        std::condition_variable limit_cv;
+        double limit = 2;
+        double min_limit = 1;
+        double max_limit = 8;
+        uint32_t in_flight = 0;
+        double baseline_latency = 0;        /**< Задержка ответа без перегрузки, с */
+        double last_decrease = 0;           /**< Время последнего уменьшения лимита */
+        double latency_factor = 3.0;        /**< Во сколько раз задержка должна превысить базовую, чтобы считаться перегрузкой */
+
+        static double get_time() {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        void decrease(const double factor, const double latency) {
+            const double now = get_time();
+            const double cooldown = std::max(latency, baseline_latency);
+            if((now - last_decrease) < cooldown) return;
+            last_decrease = now;
+            limit = std::max(min_limit, limit * factor);
+        }
+
+    public:
+
+        AimdConcurrency() {};
+
+        /** \brief Настроить ограничение
+         * \param user_min_limit Минимальное количество одновременных запросов
+         * \param user_max_limit Максимальное количество одновременных запросов
+         * \param user_initial_limit Начальное количество одновременных запросов
+         */
+        void set_limits(const uint32_t user_min_limit, const uint32_t user_max_limit, const uint32_t user_initial_limit) {
+            std::lock_guard<std::mutex> lock(limit_mutex);
+            min_limit = std::max(1U, user_min_limit);
+            max_limit = std::max((uint32_t)min_limit, user_max_limit);
+            limit = std::min(max_limit, std::max(min_limit, (double)user_initial_limit));
+            limit_cv.notify_all();
+        }
+
+        /** \brief Занять место для запроса
+         *
+         * Метод ждет, пока количество запросов не станет меньше лимита
+         * \param is_stop Флаг остановки
+         */
+        void acquire(const std::atomic<bool> &is_stop) {
+            std::unique_lock<std::mutex> lock(limit_mutex);
+            limit_cv.wait(lock, [&]() {
+                return is_stop || (double)in_flight < std::floor(limit);
+            });
+            ++in_flight;
+        }
+
+        /** \brief Освободить место запроса
+         */
+        void release() {
+            std::lock_guard<std::mutex> lock(limit_mutex);
+            if(in_flight > 0) --in_flight;
+            limit_cv.notify_all();
+        }
+
+        /** \brief Учесть успешный ответ
+         * \param latency Задержка ответа, с
+         */
+        void on_success(const double latency) {
+            std::lock_guard<std::mutex> lock(limit_mutex);
+            if(baseline_latency == 0 || latency < baseline_latency) baseline_latency = latency;
+            else baseline_latency += (latency - baseline_latency) * 0.01;
+            if(latency > baseline_latency * latency_factor) {
+                /* сервер начал отвечать медленнее, это ранний признак перегрузки */
+                decrease(0.9, latency);
+            } else {
+                limit = std::min(max_limit, limit + 1.0 / limit);
+            }
+            limit_cv.notify_all();
+        }
+
+        /** \brief Учесть перегрузку сервера (ошибка или DDoS-GUARD)
+         * \param latency Задержка ответа, с
+         */
+        void on_overload(const double latency) {
+            std::lock_guard<std::mutex> lock(limit_mutex);
+            decrease(0.5, latency);
+        }
+
+        /** \brief Разбудить все ожидающие потоки
+         */
+        void notify_all() {
+            std::lock_guard<std::mutex> lock(limit_mutex);
+            limit_cv.notify_all();
+        }
+
+        /** \brief Получить текущий лимит
+         * \return Количество одновременных запросов
+         */
+        double get_limit() {
+            std::lock_guard<std::mutex> lock(limit_mutex);
+            return limit;
+        }
+    };
+
+    /** \brief Ограниченная очередь между стадиями конвейера
+     *
+     * Если очередь заполнена, предыдущая стадия ждет, поэтому быстрая загрузка
+     * не может накопить в памяти неограниченное количество ответов
+     */
+    template<class T>
+    class PipelineQueue {
+    private:
+        std::mutex mutex;
+        std::condition_variable push_cv;
+        std::condition_variable pop_cv;
+        std::deque<T> items;
+        size_t capacity = 16;
+        bool is_closed = false;
+
+    public:
+
+        PipelineQueue() {};
+
+        /** \brief Установить размер очереди
+         * \param user_capacity Максимальное количество элементов
+         */
+        void set_capacity(const size_t user_capacity) {
+            std::lock_guard<std::mutex> lock(mutex);
+            capacity = std::max((size_t)1, user_capacity);
+            push_cv.notify_all();
+        }
+
+        /** \brief Добавить элемент, ожидая свободного места
+         * \param item Элемент
+         * \return Вернет false, если очередь закрыта
+         */
+        bool push(T &&item) {
+            std::unique_lock<std::mutex> lock(mutex);
+            push_cv.wait(lock, [&]() {
+                return is_closed || items.size() < capacity;
+            });
+            if(is_closed) return false;
+            items.push_back(std::move(item));
+            pop_cv.notify_one();
+            return true;
+        }
+
+        /** \brief Извлечь элемент, ожидая его появления
+         * \param item Элемент
+         * \return Вернет false, если очередь закрыта и пуста
+         */
+        bool pop(T &item) {
+            std::unique_lock<std::mutex> lock(mutex);
+            pop_cv.wait(lock, [&]() {
+                return is_closed || !items.empty();
+            });
+            if(items.empty()) return false;
+            item = std::move(items.front());
+            items.pop_front();
+            push_cv.notify_one();
+            return true;
+        }
+
+        /** \brief Закрыть очередь
+         *
+         * Оставшиеся элементы можно извлечь, новые добавить нельзя
+         */
+        void close() {
+            std::lock_guard<std::mutex> lock(mutex);
+            is_closed = true;
+            push_cv.notify_all();
+            pop_cv.notify_all();
+        }
+
+        /** \brief Открыть очередь заново и очистить ее
+         */
+        void reset() {
+            std::lock_guard<std::mutex> lock(mutex);
+            is_closed = false;
+            items.clear();
+        }
+
+        /** \brief Получить количество элементов
+         */
+        size_t size() {
+            std::lock_guard<std::mutex> lock(mutex);
+            return items.size();
+        }
+    };
+
+    /** \brief Загрузчик исторических данных
+     *
+     * Каждая пара (символ, диапазон дат) - отдельная задача. Задачи распределяются по
+     * очередям потоков, освободившийся поток забирает задачи из чужих очередей
+     * (work stealing). Количество одновременных запросов подбирается алгоритмом AIMD.
+     * Неудачные задачи откладываются с экспоненциальной задержкой со случайным
+     * разбросом, при этом поток не спит, а берет следующую задачу.
+     *
+     * Загрузка, разбор ответа и запись выполняются конвейером из трех стадий
+     * с ограниченными очередями между ними: пока одни потоки ждут ответа сервера,
+     * другие разбирают JSON и записывают данные. Записью каждого символа
+     * занимается один и тот же поток.
+     */
+    class HistoryDownloader {
+    public:
+
+        /** \brief Статистика загрузки
+         */
+        class Stats {
+        public:
+            uint64_t tasks = 0;         /**< Всего задач */
+            uint64_t completed = 0;     /**< Успешно завершено */
+            uint64_t empty = 0;         /**< Задач без данных */
+            uint64_t failed = 0;        /**< Задач с ошибкой после всех попыток */
+            uint64_t retries = 0;       /**< Повторных попыток */
+            uint64_t ddos = 0;          /**< Ответов DDoS-GUARD */
+            double limit = 0;           /**< Текущий лимит одновременных запросов */
+            double fetch_load = 0;      /**< Загрузка стадии запросов, от 0 до 1 */
+            double decode_load = 0;     /**< Загрузка стадии разбора ответов, от 0 до 1 */
+            double persist_load = 0;    /**< Загрузка стадии записи, от 0 до 1 */
+            size_t decode_queue = 0;    /**< Ответов в очереди на разбор */
+            size_t persist_queue = 0;   /**< Диапазонов в очередях на запись */
+        };
+
+        /** \brief Функция для обработки загруженных баров
+         *
+         * Для каждого символа вызывается всегда из одного и того же потока записи.
+         * Для диапазона без данных массив баров будет пустым.
+         * Если функция вернет код ошибки, задача будет повторена позже.
+         */
+        using CandlesCallback = std::function<int(
+            const uint32_t symbol_index,
+            const xtime::timestamp_t date_start,
+            const xtime::timestamp_t date_stop,
+            const std::vector<xquotes_common::Candle> &candles)>;
+
+    private:
+
+        /** \brief Задача загрузки
+         */
+        class Task {
+        public:
+            uint32_t symbol_index = 0;
+            xtime::timestamp_t date_start = 0;
+            xtime::timestamp_t date_stop = 0;
+            uint32_t attempt = 0;
+            double ready_time = 0;      /**< Время, раньше которого задачу не надо повторять */
+            bool is_remainder = false;  /**< Остаток диапазона после ответа, который мог быть обрезан */
+        };
+
+        /** \brief Ответ сервера, ожидающий разбора
+         */
+        class FetchedItem {
+        public:
+            Task task;
+            std::string response;
+        };
+
+        /** \brief Бары, ожидающие записи
+         */
+        class DecodedItem {
+        public:
+            Task task;
+            std::vector<xquotes_common::Candle> candles;
+        };
+
+        /** \brief Очередь задач потока
+         */
+        class TaskQueue {
+        public:
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        std::string point;
+        std::string sert_file;
+        std::string cookie_file;
+        std::string file_name_bets_log;
+        std::string file_name_work_log;
+
+        uint32_t number_workers = 8;
+        uint32_t number_decoders = 1;       /**< Потоков разбора ответов */
+        uint32_t number_writers = 2;        /**< Потоков записи */
+        size_t queue_capacity = 16;         /**< Размер очередей между стадиями */
+        std::atomic<uint32_t> history_max_bars = ATOMIC_VAR_INIT(10000);   /**< Максимум баров в одном ответе сервера */
+        uint32_t max_attempts = 5;
+        uint32_t empty_attempts = 2;        /**< Попыток для дней без данных */
+        uint32_t request_timeout = 10;
+        uint32_t hist_type = FXCM_USE_HIST_QUOTES_BID_ASK_DIV2;
+        double backoff_base = 1.0;
+        double backoff_max = 60.0;
+
+        std::vector<Task> new_tasks;        /**< Задачи, добавленные до запуска */
+        std::vector<std::unique_ptr<TaskQueue>> queues;
+        std::mutex delayed_mutex;
+        std::condition_variable delayed_cv;
+        std::vector<Task> delayed;          /**< Отложенные задачи, куча по времени готовности */
+        std::atomic<uint64_t> pending_tasks = ATOMIC_VAR_INIT(0);
+        std::atomic<bool> is_stop = ATOMIC_VAR_INIT(false);
+
+        PipelineQueue<FetchedItem> decode_queue;
+        std::vector<std::unique_ptr<PipelineQueue<DecodedItem>>> persist_queues;  /**< Очереди потоков записи */
+        std::mutex persist_queues_mutex;    /**< Защищает список очередей записи от изменения в run() */
+
+        AimdConcurrency concurrency;
+
+        std::atomic<uint64_t> stats_tasks = ATOMIC_VAR_INIT(0);
+        std::atomic<uint64_t> stats_completed = ATOMIC_VAR_INIT(0);
+        std::atomic<uint64_t> stats_empty = ATOMIC_VAR_INIT(0);
+        std::atomic<uint64_t> stats_failed = ATOMIC_VAR_INIT(0);
+        std::atomic<uint64_t> stats_retries = ATOMIC_VAR_INIT(0);
+        std::atomic<uint64_t> stats_ddos = ATOMIC_VAR_INIT(0);
+        std::atomic<uint64_t> fetch_busy_us = ATOMIC_VAR_INIT(0);       /**< Время работы стадии запросов, мкс */
+        std::atomic<uint64_t> decode_busy_us = ATOMIC_VAR_INIT(0);      /**< Время работы стадии разбора, мкс */
+        std::atomic<uint64_t> persist_busy_us = ATOMIC_VAR_INIT(0);     /**< Время работы стадии записи, мкс */
+        std::atomic<double> run_start_time = ATOMIC_VAR_INIT(0.0);
+        std::atomic<double> run_stop_time = ATOMIC_VAR_INIT(0.0);
+
+        static double get_time() {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        static bool compare_ready_time(const Task &a, const Task &b) {
+            return a.ready_time > b.ready_time;
+        }
+
+        /** \brief Завершить задачу
+         */
+        void finish_task() {
+            if(--pending_tasks == 0) {
+                std::lock_guard<std::mutex> lock(delayed_mutex);
+                delayed_cv.notify_all();
+            }
+        }
+
+        /** \brief Отложить задачу
+         * \param task Задача
+         * \param rng Генератор случайных чисел потока
+         */
+        void delay_task(Task &task, std::mt19937 &rng) {
+            ++task.attempt;
+            ++stats_retries;
+            /* экспоненциальная задержка со случайным разбросом, чтобы повторы не шли волной,
+             * после первой неудачи задержка равна backoff_base
+             */
+            const double backoff = std::min(backoff_max, backoff_base * (double)(1ULL << std::min(task.attempt - 1, 16U)));
+            std::uniform_real_distribution<double> jitter(0.5, 1.5);
+            task.ready_time = get_time() + backoff * jitter(rng);
+            std::lock_guard<std::mutex> lock(delayed_mutex);
+            delayed.push_back(task);
+            std::push_heap(delayed.begin(), delayed.end(), compare_ready_time);
+            delayed_cv.notify_all();
+        }
+
+        /** \brief Повторить задачу или завершить ее с ошибкой
+         * \param task Задача
+         * \param rng Генератор случайных чисел потока
+         */
+        void retry_task(Task &task, std::mt19937 &rng) {
+            if((task.attempt + 1) < max_attempts) {
+                delay_task(task, rng);
+                return;
+            }
+            ++stats_failed;
+            finish_task();
+        }
+
+        /** \brief Добавить новую задачу во время загрузки
+         * \param task Задача
+         */
+        void add_running_task(const Task &task) {
+            ++pending_tasks;
+            ++stats_tasks;
+            std::lock_guard<std::mutex> lock(delayed_mutex);
+            delayed.push_back(task);
+            std::push_heap(delayed.begin(), delayed.end(), compare_ready_time);
+            delayed_cv.notify_all();
+        }
+
+        /** \brief Передать диапазон на запись
+         * \param item Бары диапазона
+         */
+        void push_persist(DecodedItem &&item) {
+            const uint32_t symbol_index = item.task.symbol_index;
+            persist_queues[symbol_index % persist_queues.size()]->push(std::move(item));
+        }
+
+        /** \brief Обработать диапазон без данных
+         * \param task Задача
+         * \param rng Генератор случайных чисел потока
+         */
+        void on_empty_task(Task &task, std::mt19937 &rng) {
+            /* дни без данных проверяем несколько раз, ответ мог быть пустым из-за сбоя.
+             * Пустой остаток после непустого ответа - обычный конец данных, его не перепроверяем
+             */
+            if(!task.is_remainder && (task.attempt + 1) < empty_attempts) {
+                delay_task(task, rng);
+                return;
+            }
+            DecodedItem item;
+            item.task = task;
+            push_persist(std::move(item));
+        }
+
+        /** \brief Получить задачу
+         * \param worker Номер потока
+         * \param task Задача
+         * \return Вернет false, если задач больше нет
+         */
+        bool get_task(const uint32_t worker, Task &task) {
+            while(!is_stop) {
+                /* сначала своя очередь, затем чужие */
+                for(uint32_t k = 0; k < queues.size(); ++k) {
+                    TaskQueue &queue = *queues[(worker + k) % queues.size()];
+                    std::lock_guard<std::mutex> lock(queue.mutex);
+                    if(queue.tasks.empty()) continue;
+                    if(k == 0) {
+                        task = queue.tasks.front();
+                        queue.tasks.pop_front();
+                    } else {
+                        task = queue.tasks.back();
+                        queue.tasks.pop_back();
+                    }
+                    return true;
+                }
+                /* затем отложенные задачи, время которых пришло */
+                std::unique_lock<std::mutex> lock(delayed_mutex);
+                if(pending_tasks == 0) return false;
+                const double now = get_time();
+                if(!delayed.empty() && delayed.front().ready_time <= now) {
+                    std::pop_heap(delayed.begin(), delayed.end(), compare_ready_time);
+                    task = delayed.back();
+                    delayed.pop_back();
+                    return true;
+                }
+                const double wait_time = delayed.empty() ? 0.1 : std::min(0.1, delayed.front().ready_time - now);
+                delayed_cv.wait_for(lock, std::chrono::microseconds((uint64_t)(wait_time * 1000000.0) + 1));
+            }
+            return false;
+        }
+
+        /** \brief Сбросить состояние прошлого запуска
+         *
+         * После stop() в очередях и среди отложенных задач остаются незавершенные
+         * задачи, а счетчик pending_tasks не равен нулю. Без сброса следующий
+         * run() ждал бы их бесконечно, а статистика смешивала бы запуски.
+         */
+        void reset_run_state() {
+            {
+                std::lock_guard<std::mutex> lock(delayed_mutex);
+                delayed.clear();
+            }
+            pending_tasks = 0;
+            stats_tasks = 0;
+            stats_completed = 0;
+            stats_empty = 0;
+            stats_failed = 0;
+            stats_retries = 0;
+            stats_ddos = 0;
+            fetch_busy_us = 0;
+            decode_busy_us = 0;
+            persist_busy_us = 0;
+        }
+
+        void close_persist_queues() {
+            std::lock_guard<std::mutex> lock(persist_queues_mutex);
+            for(size_t w = 0; w < persist_queues.size(); ++w) {
+                persist_queues[w]->close();
+            }
+        }
+
+        static uint64_t get_busy_us(const double start_time) {
+            return (uint64_t)((get_time() - start_time) * 1000000.0);
+        }
+
+        /** \brief Поток загрузки (первая стадия конвейера)
+         * \param worker Номер потока
+         */
+        void run_fetch_worker(const uint32_t worker) {
+            IntradeBarHttpApi api(
+                point,
+                sert_file,
+                cookie_file,
+                file_name_bets_log,
+                file_name_work_log);
+            api.set_history_max_bars(history_max_bars);
+            std::mt19937 rng(std::random_device{}() ^ (worker * 0x9E3779B9U));
+            Task task;
+            while(get_task(worker, task)) {
+                concurrency.acquire(is_stop);
+                if(is_stop) {
+                    concurrency.release();
+                    break;
+                }
+                const double start_time = get_time();
+                FetchedItem item;
+                const int err = api.fetch_historical_data(
+                    task.symbol_index,
+                    task.date_start,
+                    task.date_stop,
+                    item.response,
+                    1,
+                    request_timeout);
+                const double latency = get_time() - start_time;
+                concurrency.release();
+                fetch_busy_us += get_busy_us(start_time);
+
+                if(err == OK || err == DATA_NOT_AVAILABLE) {
+                    concurrency.on_success(latency);
+                } else {
+                    if(err == DDOS_GUARD_DETECTED) ++stats_ddos;
+                    concurrency.on_overload(latency);
+                }
+
+                if(err == OK) {
+                    item.task = task;
+                    decode_queue.push(std::move(item));
+                    continue;
+                }
+                if(err == DATA_NOT_AVAILABLE) {
+                    on_empty_task(task, rng);
+                    continue;
+                }
+                /* диапазон в несколько дней, который не удалось загрузить повторно, делим пополам
+                 * по границе дня: вторая половина выполнится раньше первой, и части одного дня
+                 * записывались бы в обратном порядке
+                 */
+                if(err != DDOS_GUARD_DETECTED &&
+                    task.attempt > 0 &&
+                    (task.date_stop - task.date_start) >= xtime::SECONDS_IN_DAY) {
+                    xtime::timestamp_t middle = xtime::get_first_timestamp_day(
+                        task.date_start + (task.date_stop - task.date_start) / 2);
+                    if(middle <= task.date_start) middle += xtime::SECONDS_IN_DAY;
+                    if(middle <= task.date_stop) {
+                        Task second_task = task;
+                        second_task.date_start = middle;
+                        task.date_stop = middle - xtime::SECONDS_IN_MINUTE;
+                        add_running_task(second_task);
+                    }
+                }
+                retry_task(task, rng);
+            }
+        }
+
+        /** \brief Поток разбора ответов (вторая стадия конвейера)
+         * \param decoder Номер потока
+         */
+        void run_decode_worker(const uint32_t decoder) {
+            std::mt19937 rng(std::random_device{}() ^ (decoder * 0x85EBCA6BU));
+            FetchedItem item;
+            while(decode_queue.pop(item)) {
+                const double start_time = get_time();
+                DecodedItem decoded;
+                decoded.task = item.task;
+                const int err = IntradeBarHttpApi::parse_historical_data(
+                    item.response,
+                    decoded.candles,
+                    hist_type,
+                    pricescale_currency_pairs[item.task.symbol_index]);
+                decode_busy_us += get_busy_us(start_time);
+                if(is_stop) continue;
+
+                if(err == DATA_NOT_AVAILABLE) {
+                    on_empty_task(item.task, rng);
+                    continue;
+                }
+                if(err != OK) {
+                    retry_task(item.task, rng);
+                    continue;
+                }
+
+                /* последний бар раньше конца диапазона: ответ мог быть обрезан сервером,
+                 * причем лимит сервера может отличаться от history_max_bars,
+                 * поэтому остаток диапазона загружаем отдельной задачей при любом количестве баров
+                 */
+                const xtime::timestamp_t last_timestamp = decoded.candles.back().timestamp;
+                if(last_timestamp >= decoded.task.date_start && last_timestamp < decoded.task.date_stop) {
+                    Task remainder;
+                    remainder.symbol_index = decoded.task.symbol_index;
+                    remainder.date_start = last_timestamp + xtime::SECONDS_IN_MINUTE;
+                    remainder.date_stop = decoded.task.date_stop;
+                    remainder.is_remainder = true;
+                    add_running_task(remainder);
+                    decoded.task.date_stop = last_timestamp;
+                }
+                push_persist(std::move(decoded));
+            }
+        }
+
+        /** \brief Поток записи (третья стадия конвейера)
+         * \param writer Номер потока
+         * \param callback Функция для обработки баров
+         */
+        void run_persist_worker(const uint32_t writer, const CandlesCallback &callback) {
+            std::mt19937 rng(std::random_device{}() ^ (writer * 0xC2B2AE35U));
+            DecodedItem item;
+            while(persist_queues[writer]->pop(item)) {
+                if(is_stop) continue;
+                const double start_time = get_time();
+                const int err = callback == nullptr ? OK : callback(
+                    item.task.symbol_index,
+                    item.task.date_start,
+                    item.task.date_stop,
+                    item.candles);
+                persist_busy_us += get_busy_us(start_time);
+                if(err == OK) {
+                    if(item.candles.empty()) ++stats_empty;
+                    else ++stats_completed;
+                    finish_task();
+                    continue;
+                }
+                retry_task(item.task, rng);
+            }
+        }
+
+    public:
+
+        /** \brief Конструктор загрузчика
+         * \param user_point Точка доступа к брокерку
+         * \param user_sert_file Файл-сертификат
+         * \param user_cookie_file Файл для записи cookie
+         * \param user_file_name_bets_log Файл для записи логов работы со сделками
+         * \param user_file_name_work_log Файл для записи логов работы http клиента
+         */
+        HistoryDownloader(
+                const std::string &user_point = "1.intrade.bar",
+                const std::string &user_sert_file = "curl-ca-bundle.crt",
+                const std::string &user_cookie_file = "intrade-bar.cookie",
+                const std::string &user_file_name_bets_log = "logger/intrade-bar-bets.log",
+                const std::string &user_file_name_work_log = "logger/intrade-bar-https-work.log") :
+                point(user_point),
+                sert_file(user_sert_file),
+                cookie_file(user_cookie_file),
+                file_name_bets_log(user_file_name_bets_log),
+                file_name_work_log(user_file_name_work_log) {
+            set_concurrency(1, 8, 2);
+        };
+
+        ~HistoryDownloader() {
+            stop();
+        }
+
+        /** \brief Установить количество одновременных запросов
+         * \param min_limit Минимальное количество
+         * \param max_limit Максимальное количество, равно числу потоков
+         * \param initial_limit Начальное количество
+         */
+        void set_concurrency(const uint32_t min_limit, const uint32_t max_limit, const uint32_t initial_limit) {
+            number_workers = std::max(1U, max_limit);
+            concurrency.set_limits(min_limit, max_limit, initial_limit);
+        }
+
+        /** \brief Настроить стадии разбора и записи
+         * \param decoders Количество потоков разбора ответов
+         * \param writers Количество потоков записи (символ всегда записывает один поток)
+         * \param capacity Размер очередей между стадиями
+         */
+        void set_pipeline(const uint32_t decoders, const uint32_t writers, const size_t capacity) {
+            number_decoders = std::max(1U, decoders);
+            number_writers = std::max(1U, writers);
+            queue_capacity = std::max((size_t)1, capacity);
+        }
+
+        /** \brief Установить параметры повторных попыток
+         * \param user_max_attempts Максимальное количество попыток загрузки
+         * \param user_backoff_base Задержка после первой неудачной попытки, с
+         * \param user_backoff_max Максимальная задержка, с
+         */
+        void set_retry(const uint32_t user_max_attempts, const double user_backoff_base, const double user_backoff_max) {
+            max_attempts = std::max(1U, user_max_attempts);
+            backoff_base = user_backoff_base;
+            backoff_max = user_backoff_max;
+        }
+
+        /** \brief Установить тип цены
+         * \param user_hist_type Тип цены (FXCM_USE_HIST_QUOTES_BID_ASK_DIV2 и т.д.)
+         */
+        void set_hist_type(const uint32_t user_hist_type) {
+            hist_type = user_hist_type;
+        }
+
+        /** \brief Установить максимальное количество баров в одном ответе сервера
+         *
+         * Диапазоны длиннее лимита заранее делятся по границам дней,
+         * если в лимит помещается хотя бы один день
+         * \param max_bars Максимальное количество баров
+         */
+        void set_history_max_bars(const uint32_t max_bars) {
+            history_max_bars = std::max(2U, max_bars);
+        }
+
+        /** \brief Установить время ожидания ответа
+         * \param timeout Время ожидания, с
+         */
+        void set_timeout(const uint32_t timeout) {
+            request_timeout = timeout;
+        }
+
+        /** \brief Добавить задачу загрузки
+         *
+         * Задачи выполняются при вызове run()
+         * \param symbol_index Индекс символа
+         * \param date_start Метка времени начала
+         * \param date_stop Метка времени конца
+         */
+        void add_task(
+                const uint32_t symbol_index,
+                const xtime::timestamp_t date_start,
+                const xtime::timestamp_t date_stop) {
+            if(symbol_index >= CURRENCY_PAIRS || date_stop < date_start) return;
+            Task task;
+            task.symbol_index = symbol_index;
+            task.date_start = date_start;
+            task.date_stop = date_stop;
+            new_tasks.push_back(task);
+        }
+
+        /** \brief Выполнить все задачи
+         *
+         * Метод блокирует вызывающий поток до завершения всех задач.
+         * Статистика считается заново для каждого запуска.
+         * \param callback Функция для обработки баров
+         * \return Код ошибки, OK если все задачи выполнены
+         */
+        int run(const CandlesCallback &callback) {
+            is_stop = false;
+            /* задачи, не завершенные прошлым запуском из-за stop(), отбрасываются */
+            reset_run_state();
+            /* задачи одного символа попадают в одну очередь потока, чтобы потоки реже работали с одним файлом */
+            queues.clear();
+            for(uint32_t w = 0; w < number_workers; ++w) {
+                queues.push_back(std::unique_ptr<TaskQueue>(new TaskQueue()));
+            }
+            /* диапазон больше лимита сервера делим по границам дней заранее, чтобы не ждать обрезанного ответа */
+            const uint32_t max_bars = history_max_bars;
+            const xtime::timestamp_t days_per_request = max_bars / xtime::MINUTES_IN_DAY;
+            size_t number_tasks = 0;
+            for(size_t i = 0; i < new_tasks.size(); ++i) {
+                Task task = new_tasks[i];
+                std::deque<Task> &tasks = queues[task.symbol_index % queues.size()]->tasks;
+                while(days_per_request > 0 &&
+                    ((task.date_stop - task.date_start) / xtime::SECONDS_IN_MINUTE + 1) > max_bars) {
+                    Task part = task;
+                    part.date_stop = xtime::get_first_timestamp_day(task.date_start) +
+                        days_per_request * xtime::SECONDS_IN_DAY - xtime::SECONDS_IN_MINUTE;
+                    tasks.push_back(part);
+                    ++number_tasks;
+                    task.date_start = part.date_stop + xtime::SECONDS_IN_MINUTE;
+                }
+                tasks.push_back(task);
+                ++number_tasks;
+            }
+            pending_tasks += number_tasks;
+            stats_tasks += number_tasks;
+            new_tasks.clear();
+
+            decode_queue.reset();
+            decode_queue.set_capacity(queue_capacity);
+            {
+                std::lock_guard<std::mutex> lock(persist_queues_mutex);
+                persist_queues.clear();
+                for(uint32_t w = 0; w < number_writers; ++w) {
+                    persist_queues.push_back(std::unique_ptr<PipelineQueue<DecodedItem>>(new PipelineQueue<DecodedItem>()));
+                    persist_queues.back()->set_capacity(queue_capacity);
+                }
+            }
+            run_stop_time = 0.0;
+            run_start_time = get_time();
+
+            auto wait_stage = [](std::vector<std::future<void>> &stage) {
+                for(size_t w = 0; w < stage.size(); ++w) {
+                    try {
+                        stage[w].get();
+                    }
+                    catch(const std::exception &e) {
+                        std::cerr << "intrade.bar api: error in HistoryDownloader::run(), what: " << e.what() << std::endl;
+                    }
+                    catch(...) {
+                        std::cerr << "intrade.bar api: error in HistoryDownloader::run()" << std::endl;
+                    }
+                }
+            };
+
+            std::vector<std::future<void>> writers;
+            for(uint32_t w = 0; w < number_writers; ++w) {
+                writers.push_back(std::async(std::launch::async, [&, w]() {
+                    run_persist_worker(w, callback);
+                }));
+            }
+            std::vector<std::future<void>> decoders;
+            for(uint32_t w = 0; w < number_decoders; ++w) {
+                decoders.push_back(std::async(std::launch::async, [&, w]() {
+                    run_decode_worker(w);
+                }));
+            }
+            std::vector<std::future<void>> workers;
+            for(uint32_t w = 0; w < queues.size(); ++w) {
+                workers.push_back(std::async(std::launch::async, [&, w]() {
+                    run_fetch_worker(w);
+                }));
+            }
+
+            /* потоки загрузки завершатся, когда все задачи пройдут конвейер или будет вызван stop() */
+            wait_stage(workers);
+            decode_queue.close();
+            wait_stage(decoders);
+            close_persist_queues();
+            wait_stage(writers);
+            run_stop_time = get_time();
+
+            if(stats_failed > 0 || pending_tasks > 0) return DATA_NOT_AVAILABLE;
+            return OK;
+        }
+
+        /** \brief Остановить загрузку
+         *
+         * Незавершенные задачи будут отброшены при следующем вызове run()
+         */
+        void stop() {
+            is_stop = true;
+            concurrency.notify_all();
+            decode_queue.close();
+            close_persist_queues();
+            std::lock_guard<std::mutex> lock(delayed_mutex);
+            delayed_cv.notify_all();
+        }
+
+        /** \brief Получить статистику загрузки
+         * \return Статистика
+         */
+        Stats get_stats() {
+            Stats stats;
+            stats.tasks = stats_tasks;
+            stats.completed = stats_completed;
+            stats.empty = stats_empty;
+            stats.failed = stats_failed;
+            stats.retries = stats_retries;
+            stats.ddos = stats_ddos;
+            stats.limit = concurrency.get_limit();
+
+            const double start_time = run_start_time;
+            const double stop_time = run_stop_time == 0.0 ? get_time() : (double)run_stop_time;
+            const double elapsed_us = start_time == 0.0 ? 0.0 : (stop_time - start_time) * 1000000.0;
+            if(elapsed_us > 0) {
+                stats.fetch_load = (double)fetch_busy_us / (elapsed_us * number_workers);
+                stats.decode_load = (double)decode_busy_us / (elapsed_us * number_decoders);
+                stats.persist_load = (double)persist_busy_us / (elapsed_us * number_writers);
+            }
+            stats.decode_queue = decode_queue.size();
+            std::lock_guard<std::mutex> lock(persist_queues_mutex);
+            for(size_t w = 0; w < persist_queues.size(); ++w) {
+                stats.persist_queue += persist_queues[w]->size();
+            }
+            return stats;
+        }
+    };
+}
+
+#endif // INTRADE_BAR_HISTORY_DOWNLOADER_HPP_INCLUDED
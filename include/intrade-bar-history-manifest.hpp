@@ -0,0 +1,298 @@
+/*
+* intrade-bar-api-cpp - C ++ API client for intrade.bar
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef INTRADE_BAR_HISTORY_MANIFEST_HPP_INCLUDED
+#define INTRADE_BAR_HISTORY_MANIFEST_HPP_INCLUDED
+
+#include <intrade-bar-common.hpp>
+#include <xtime.hpp>
+#include <nlohmann/json.hpp>
+#include <fstream>
+#include <string>
+#include <map>
+#include <cstdio>
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#endif
+
+namespace intrade_bar {
+
+    /** \brief Манифест полноты хранилища котировок одного символа
+     *
+     * Хранит интервалы полностью загруженных дней, интервалы дней без данных
+     * (выходные и праздники) и для неполных дней - метку времени последнего загруженного бара.
+     * Манифест записывается во временный файл, который затем заменяет основной,
+     * поэтому при сбое на диске остается либо старая, либо новая версия.
+     * Манифест обновляется после write_candles: если запись прервется между ними,
+     * день будет загружен повторно, но никогда не будет ошибочно считаться полным.
+     */
+    class HistoryManifest {
+    public:
+        using json = nlohmann::json;
+
+    private:
+        std::string file_name;
+        std::map<xtime::timestamp_t, xtime::timestamp_t> complete_days;    /**< Интервалы полных дней [начало, конец] */
+        std::map<xtime::timestamp_t, xtime::timestamp_t> empty_days;       /**< Интервалы дней без данных [начало, конец] */
+        std::map<xtime::timestamp_t, xtime::timestamp_t> partial_days;     /**< Метка последнего бара неполного дня */
+        xtime::timestamp_t start_date = 0;                                  /**< Найденная начальная дата котировок символа */
+
+        /** \brief Найти интервал, содержащий день
+         */
+        static std::map<xtime::timestamp_t, xtime::timestamp_t>::const_iterator find_interval(
+                const std::map<xtime::timestamp_t, xtime::timestamp_t> &intervals,
+                const xtime::timestamp_t day) {
+            auto it = intervals.upper_bound(day);
+            if(it == intervals.begin()) return intervals.end();
+            --it;
+            if(day <= it->second) return it;
+            return intervals.end();
+        }
+
+        /** \brief Добавить день в набор интервалов и объединить соседние интервалы
+         */
+        static void insert_day(
+                std::map<xtime::timestamp_t, xtime::timestamp_t> &intervals,
+                const xtime::timestamp_t day) {
+            if(find_interval(intervals, day) != intervals.end()) return;
+            xtime::timestamp_t first = day;
+            xtime::timestamp_t last = day;
+            auto next = intervals.find(day + xtime::SECONDS_IN_DAY);
+            if(next != intervals.end()) {
+                last = next->second;
+                intervals.erase(next);
+            }
+            auto prev = intervals.upper_bound(day);
+            if(prev != intervals.begin()) {
+                --prev;
+                if(prev->second + xtime::SECONDS_IN_DAY == day) {
+                    prev->second = last;
+                    return;
+                }
+            }
+            intervals[first] = last;
+        }
+
+        /** \brief Удалить день из набора интервалов
+         */
+        static void erase_day(
+                std::map<xtime::timestamp_t, xtime::timestamp_t> &intervals,
+                const xtime::timestamp_t day) {
+            auto it = find_interval(intervals, day);
+            if(it == intervals.end()) return;
+            const xtime::timestamp_t first = it->first;
+            const xtime::timestamp_t last = it->second;
+            intervals.erase(it);
+            if(first < day) intervals[first] = day - xtime::SECONDS_IN_DAY;
+            if(day < last) intervals[day + xtime::SECONDS_IN_DAY] = last;
+        }
+
+        static json intervals_to_json(const std::map<xtime::timestamp_t, xtime::timestamp_t> &intervals) {
+            json j = json::array();
+            for(auto &item : intervals) {
+                j.push_back(json::array({item.first, item.second}));
+            }
+            return j;
+        }
+
+        static void json_to_intervals(const json &j, std::map<xtime::timestamp_t, xtime::timestamp_t> &intervals) {
+            intervals.clear();
+            if(!j.is_array()) return;
+            for(auto &item : j) {
+                intervals[item[0].get<xtime::timestamp_t>()] = item[1].get<xtime::timestamp_t>();
+            }
+        }
+
+    public:
+
+        /** \brief Конструктор манифеста
+         * \param user_file_name Имя файла манифеста
+         */
+        HistoryManifest(const std::string &user_file_name) :
+            file_name(user_file_name) {
+        }
+
+        /** \brief Загрузить манифест
+         * \return Код ошибки, DATA_NOT_AVAILABLE если файла нет
+         */
+        int load() {
+            std::ifstream file(file_name);
+            if(!file) return intrade_bar_common::DATA_NOT_AVAILABLE;
+            try {
+                json j;
+                file >> j;
+                json_to_intervals(j["complete"], complete_days);
+                json_to_intervals(j["empty"], empty_days);
+                json_to_intervals(j["partial"], partial_days);
+                start_date = j.value("start_date", (xtime::timestamp_t)0);
+            }
+            catch(...) {
+                complete_days.clear();
+                empty_days.clear();
+                partial_days.clear();
+                start_date = 0;
+                return intrade_bar_common::JSON_PARSER_ERROR;
+            }
+            return intrade_bar_common::OK;
+        }
+
+        /** \brief Атомарно сохранить манифест
+         * \return Код ошибки, 0 если ошибок нет
+         */
+        int save() {
+            json j;
+            j["complete"] = intervals_to_json(complete_days);
+            j["empty"] = intervals_to_json(empty_days);
+            j["partial"] = intervals_to_json(partial_days);
+            if(start_date != 0) j["start_date"] = start_date;
+
+            const std::string temp_file_name = file_name + ".tmp";
+            {
+                std::ofstream file(temp_file_name, std::ios::trunc);
+                if(!file) return intrade_bar_common::STRANGE_PROGRAM_BEHAVIOR;
+                file << j.dump();
+                file.flush();
+                if(!file) return intrade_bar_common::STRANGE_PROGRAM_BEHAVIOR;
+            }
+#           if defined(_WIN32) || defined(_WIN64)
+            if(!MoveFileExA(temp_file_name.c_str(), file_name.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+                return intrade_bar_common::STRANGE_PROGRAM_BEHAVIOR;
+            }
+#           else
+            if(std::rename(temp_file_name.c_str(), file_name.c_str()) != 0) {
+                return intrade_bar_common::STRANGE_PROGRAM_BEHAVIOR;
+            }
+#           endif
+            return intrade_bar_common::OK;
+        }
+
+        /** \brief Проверить, пуст ли манифест
+         */
+        inline bool empty() const {
+            return complete_days.empty() && empty_days.empty() && partial_days.empty();
+        }
+
+        /** \brief Получить начальную дату котировок символа
+         * \return Метка времени начала дня или 0, если дата не искалась
+         */
+        inline xtime::timestamp_t get_start_date() const {
+            return start_date;
+        }
+
+        /** \brief Запомнить начальную дату котировок символа
+         * \param timestamp Метка времени начала дня
+         */
+        inline void set_start_date(const xtime::timestamp_t timestamp) {
+            start_date = xtime::get_first_timestamp_day(timestamp);
+        }
+
+        /** \brief Получить первый день, известный манифесту
+         * \return Метка времени начала дня или 0, если манифест пуст
+         */
+        xtime::timestamp_t get_first_day() const {
+            xtime::timestamp_t first_day = 0;
+            if(!complete_days.empty()) first_day = complete_days.begin()->first;
+            if(!empty_days.empty() && (first_day == 0 || empty_days.begin()->first < first_day)) {
+                first_day = empty_days.begin()->first;
+            }
+            if(!partial_days.empty() && (first_day == 0 || partial_days.begin()->first < first_day)) {
+                first_day = partial_days.begin()->first;
+            }
+            return first_day;
+        }
+
+        /** \brief Проверить, загружен ли день полностью
+         * \param timestamp Метка времени внутри дня
+         */
+        inline bool is_complete(const xtime::timestamp_t timestamp) const {
+            return find_interval(complete_days, xtime::get_first_timestamp_day(timestamp)) != complete_days.end();
+        }
+
+        /** \brief Проверить, известно ли, что у дня нет данных
+         * \param timestamp Метка времени внутри дня
+         */
+        inline bool is_empty(const xtime::timestamp_t timestamp) const {
+            return find_interval(empty_days, xtime::get_first_timestamp_day(timestamp)) != empty_days.end();
+        }
+
+        /** \brief Проверить, нужно ли загружать день
+         * \param timestamp Метка времени внутри дня
+         */
+        inline bool is_done(const xtime::timestamp_t timestamp) const {
+            return is_complete(timestamp) || is_empty(timestamp);
+        }
+
+        /** \brief Получить метку времени последнего загруженного бара неполного дня
+         * \param timestamp Метка времени внутри дня
+         * \return Метка времени бара или 0, если день не загружался
+         */
+        inline xtime::timestamp_t get_watermark(const xtime::timestamp_t timestamp) const {
+            auto it = partial_days.find(xtime::get_first_timestamp_day(timestamp));
+            if(it == partial_days.end()) return 0;
+            return it->second;
+        }
+
+        /** \brief Отметить день как полностью загруженный
+         * \param timestamp Метка времени внутри дня
+         */
+        void set_complete(const xtime::timestamp_t timestamp) {
+            const xtime::timestamp_t day = xtime::get_first_timestamp_day(timestamp);
+            partial_days.erase(day);
+            erase_day(empty_days, day);
+            insert_day(complete_days, day);
+        }
+
+        /** \brief Отметить день как день без данных
+         * \param timestamp Метка времени внутри дня
+         */
+        void set_empty(const xtime::timestamp_t timestamp) {
+            const xtime::timestamp_t day = xtime::get_first_timestamp_day(timestamp);
+            partial_days.erase(day);
+            erase_day(complete_days, day);
+            insert_day(empty_days, day);
+        }
+
+        /** \brief Запомнить последний загруженный бар неполного дня
+         * \param timestamp Метка времени последнего бара
+         */
+        void set_watermark(const xtime::timestamp_t timestamp) {
+            const xtime::timestamp_t day = xtime::get_first_timestamp_day(timestamp);
+            erase_day(complete_days, day);
+            erase_day(empty_days, day);
+            xtime::timestamp_t &watermark = partial_days[day];
+            if(timestamp > watermark) watermark = timestamp;
+        }
+
+        /** \brief Забыть состояние дня, чтобы загрузить его заново
+         * \param timestamp Метка времени внутри дня
+         */
+        void reset(const xtime::timestamp_t timestamp) {
+            const xtime::timestamp_t day = xtime::get_first_timestamp_day(timestamp);
+            partial_days.erase(day);
+            erase_day(complete_days, day);
+            erase_day(empty_days, day);
+        }
+    };
+}
+
+#endif // INTRADE_BAR_HISTORY_MANIFEST_HPP_INCLUDED
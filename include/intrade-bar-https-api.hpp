@@ -26,6 +26,7 @@
 
 #include <intrade-bar-common.hpp>
 #include <intrade-bar-logger.hpp>
+#include <intrade-bar-price-kernels.hpp>
 #include <xquotes_common.hpp>
 #include <curl/curl.h>
 #include <xtime.hpp>
@@ -34,6 +35,8 @@
 #include <thread>
 #include <mutex>
 #include <atomic>
+#include <future>
+#include <algorithm>
 #include <array>
 #include <map>
 #include "utf8.h" // http://utfcpp.sourceforge.net/
@@ -84,6 +87,8 @@ namespace intrade_bar {
             double payout = 0;                          /**< Процент выплат */
             double open_price = 0;
             double close_price = 0;
+            Price fixed_open_price;                     /**< Цена входа в тиках символа */
+            Price fixed_close_price;                    /**< Цена выхода в тиках символа */
             bool is_demo_account = false;               /**< Флаг демо аккаунта */
             bool is_rub_currency = false;               /**< Флаг рублевого счета */
             BetStatus bet_status = BetStatus::UNKNOWN_STATE;
@@ -141,9 +146,35 @@ namespace intrade_bar {
         std::string cookie_file = "intrade-bar.cookie"; /**< Файл cookie */
         std::string file_name_bets_log = "logger/intrade-bar-bets.log";
         std::string file_name_work_log = "logger/intrade-bar-https-work.log";
+        uint16_t bets_log_file_id = 0;      /**< Номер файла логов сделок для событий */
+        uint16_t bet_open_event_id = 0;     /**< Номер события открытия сделки */
+        uint16_t bet_close_event_id = 0;    /**< Номер события закрытия сделки */
+
+        /** \brief Зарегистрировать события лога сделок
+         */
+        void init_bets_log_events() {
+            bets_log_file_id = intrade_bar::Logger::get_file_id(file_name_bets_log);
+            bet_open_event_id = intrade_bar::Logger::register_event(
+                "bet_open",
+                {"api_bet_id", "broker_bet_id", "symbol", "contract_type", "bo_type",
+                "duration", "amount", "open_price", "delay", "error",
+                "send_timestamp", "opening_timestamp", "demo"});
+            bet_close_event_id = intrade_bar::Logger::register_event(
+                "bet_close",
+                {"api_bet_id", "broker_bet_id", "symbol", "contract_type", "bet_status",
+                "amount", "profit", "payout", "open_price", "close_price",
+                "opening_timestamp", "closing_timestamp", "error", "demo"});
+        }
 
         std::atomic<double> offset_ftimestamp = ATOMIC_VAR_INIT(0.0);
 
+        std::atomic<uint32_t> history_max_bars = ATOMIC_VAR_INIT(10000);    /**< Максимум баров в одном ответе сервера */
+
+        std::mutex price_now_cache_mutex;                   /**< Блокировка снимка цен price_now */
+        std::mutex price_now_request_mutex;                 /**< Только один запрос price_now одновременно */
+        std::vector<StreamTick> price_now_cache;            /**< Последний снимок цен price_now */
+        xtime::ftimestamp_t price_now_cache_timestamp = 0;  /**< Время ПК получения снимка цен */
+
         char error_buffer[CURL_ERROR_SIZE];
 
         static const int POST_STANDART_TIME_OUT = 10;   /**< Время ожидания ответа сервера для разных запросов */
@@ -1146,6 +1177,23 @@ namespace intrade_bar {
                         std::this_thread::sleep_for(std::chrono::milliseconds((uint32_t)((double)repeated_bet_attempts_delay * 1000.0d)));
                     }
 
+                    intrade_bar::Logger::log_event(
+                        bets_log_file_id,
+                        bet_open_event_id,
+                        api_bet_id,
+                        id_deal,
+                        symbol,
+                        contract_type,
+                        (int)bo_type,
+                        duration,
+                        amount,
+                        open_price,
+                        delay,
+                        err_bo,
+                        start_timestamp,
+                        open_timestamp,
+                        is_demo_account ? 1 : 0);
+
                     /* вызываем функцию для отправки неопределенного состояни */
                     if(callback != nullptr) callback(new_bet);
 
@@ -1168,6 +1216,7 @@ namespace intrade_bar {
                                 it_bet->second.broker_bet_id = id_deal;
                                 it_bet->second.bet_status = BetStatus::OPENING_ERROR;
                                 it_bet->second.open_price = open_price;
+                                it_bet->second.fixed_open_price = get_price(open_price, symbol_index);
                             }
                         }
 
@@ -1179,6 +1228,7 @@ namespace intrade_bar {
                         new_bet.contract_type = contract_type;
                         new_bet.duration = duration;
                         new_bet.open_price = open_price;
+                        new_bet.fixed_open_price = get_price(open_price, symbol_index);
                         new_bet.is_demo_account = is_demo_account;
                         new_bet.is_rub_currency = is_rub_currency;
                         new_bet.symbol_name = symbol;
@@ -1251,7 +1301,10 @@ namespace intrade_bar {
                             /* уменьшаем счетчик бинарных опционов */
                             bets_counter -= 1;
 
-                            const int diff_price = (int)(((price - open_price) * 100000.0d) + 0.5d);
+                            /* ничья определяется по ценам в тиках символа, у пар с JPY множитель 1000 */
+                            const Price fixed_open_price = get_price(open_price, symbol_index);
+                            const Price fixed_close_price = get_price(price, symbol_index);
+                            const bool is_standoff = is_use_standoff && fixed_close_price == fixed_open_price;
 
                             /* обновляем состояние сделки в массиве сделок */
                             {
@@ -1259,12 +1312,13 @@ namespace intrade_bar {
                                 auto it_bet = map_bets.find(api_bet_id);
                                 if(it_bet != map_bets.end()) {
                                     if(err != OK) it_bet->second.bet_status = BetStatus::CHECK_ERROR;
-                                    else if(is_use_standoff && diff_price == 0) it_bet->second.bet_status = BetStatus::STANDOFF; // price == open_price
+                                    else if(is_standoff) it_bet->second.bet_status = BetStatus::STANDOFF;
                                     else if(profit > 0) it_bet->second.bet_status = BetStatus::WIN;
                                     else it_bet->second.bet_status = BetStatus::LOSS;
                                     it_bet->second.profit = profit;
                                     it_bet->second.payout = amount == 0 ? 0 : profit/amount;
                                     it_bet->second.close_price = price;
+                                    it_bet->second.fixed_close_price = fixed_close_price;
                                     it_bet->second.amount = amount;
                                 }
                             }
@@ -1279,13 +1333,15 @@ namespace intrade_bar {
                             new_bet.payout = amount == 0 ? 0 : profit/amount;
                             new_bet.api_bet_id = api_bet_id;
                             if(err != OK) new_bet.bet_status = BetStatus::CHECK_ERROR;
-                            else if(is_use_standoff && diff_price == 0) new_bet.bet_status = BetStatus::STANDOFF; // price == open_price
+                            else if(is_standoff) new_bet.bet_status = BetStatus::STANDOFF;
                             else if(profit > 0) new_bet.bet_status = BetStatus::WIN;
                             else new_bet.bet_status = BetStatus::LOSS;
                             new_bet.contract_type = contract_type;
                             new_bet.duration = duration;
                             new_bet.close_price = price;
                             new_bet.open_price = open_price;
+                            new_bet.fixed_close_price = fixed_close_price;
+                            new_bet.fixed_open_price = fixed_open_price;
                             new_bet.is_demo_account = is_demo_account;
                             new_bet.is_rub_currency = is_rub_currency;
                             new_bet.symbol_name = symbol;
@@ -1298,6 +1354,25 @@ namespace intrade_bar {
                             }
                             new_bet.broker_bet_id = id_deal;
                             new_bet.bo_type = bo_type;
+
+                            intrade_bar::Logger::log_event(
+                                bets_log_file_id,
+                                bet_close_event_id,
+                                api_bet_id,
+                                id_deal,
+                                symbol,
+                                contract_type,
+                                (int)new_bet.bet_status,
+                                amount,
+                                profit,
+                                new_bet.payout,
+                                open_price,
+                                price,
+                                open_timestamp,
+                                new_bet.closing_timestamp,
+                                err,
+                                is_demo_account ? 1 : 0);
+
                             if(callback != nullptr) callback(new_bet);
 
                             /* логируем ошибку, если невозможно узнать результат опциона */
@@ -1434,13 +1509,8 @@ namespace intrade_bar {
                     tick.ask = el.value()["ask"];
                     tick.bid = el.value()["bid"];
                     tick.timestamp = el.value()["Updates"];
-                    tick.price = (tick.bid + tick.ask) / 2.0d;
-                    /* округляем цену */
-                    tick.price = (double)(((uint64_t)((tick.price *
-                            (double)pricescale_currency_pairs[it->second])
-                            + 0.5d)) /
-                            (double)pricescale_currency_pairs[it->second]);
-
+                    tick.fixed_price = Price::from_bid_ask(tick.bid, tick.ask, pricescale_currency_pairs[it->second]);
+                    tick.price = tick.fixed_price.to_double();
 
                     tick.precision = precision_currency_pairs[it->second];
                     temp.push_back(tick);
@@ -1453,6 +1523,44 @@ namespace intrade_bar {
             return OK;
         }
 
+        /** \brief Получить текущее значение цен с использованием общего снимка
+         *
+         * Все вызывающие используют один снимок цен, пока он не старше ttl.
+         * Если снимок устарел, запрос делает только один поток, остальные ждут его результат
+         * \param prices Массив цен
+         * \param ttl Время жизни снимка в секундах
+         * \return Код ошибки
+         */
+        int get_price_now(std::vector<StreamTick> &prices, const double ttl) {
+            if(get_price_now_cache(prices, ttl) == OK) return OK;
+            std::lock_guard<std::mutex> request_lock(price_now_request_mutex);
+            /* пока ждали, снимок мог обновить другой поток */
+            if(get_price_now_cache(prices, ttl) == OK) return OK;
+            std::vector<StreamTick> temp;
+            int err = get_price_now(temp);
+            if(err != OK) return err;
+            {
+                std::lock_guard<std::mutex> lock(price_now_cache_mutex);
+                price_now_cache = temp;
+                price_now_cache_timestamp = xtime::get_ftimestamp();
+            }
+            prices = temp;
+            return OK;
+        }
+
+        /** \brief Получить снимок цен price_now без запроса к серверу
+         * \param prices Массив цен
+         * \param max_age Максимальный возраст снимка в секундах
+         * \return Код ошибки, DATA_NOT_AVAILABLE если снимка нет или он устарел
+         */
+        int get_price_now_cache(std::vector<StreamTick> &prices, const double max_age) {
+            std::lock_guard<std::mutex> lock(price_now_cache_mutex);
+            if(price_now_cache.empty() ||
+                (xtime::get_ftimestamp() - price_now_cache_timestamp) > max_age) return DATA_NOT_AVAILABLE;
+            prices = price_now_cache;
+            return OK;
+        }
+
         /** \brief Получить параметры торговли
          * \param symbol_index Индекс символа
          * \param pricescale Множитель цены
@@ -1484,7 +1592,10 @@ namespace intrade_bar {
             return OK;
         }
 
-        /** \brief Получить исторические данные минутного графика
+        /** \brief Получить исторические данные минутного графика одним запросом
+         *
+         * Сервер отдает не более history_max_bars баров за запрос,
+         * для произвольных диапазонов используйте get_historical_data
          * \param symbol_index  Индекс символа
          * \param date_start    Дата начала
          * \param date_stop     Дата окончания
@@ -1495,7 +1606,7 @@ namespace intrade_bar {
          * \param timeout       Время ожидания
          * \return Код ошибки, 0 если ошибок нет
          */
-        int get_historical_data(
+        int request_historical_data(
                 const uint32_t symbol_index,
                 const xtime::timestamp_t date_start,
                 const xtime::timestamp_t date_stop,
@@ -1504,6 +1615,30 @@ namespace intrade_bar {
                 const uint32_t pricescale = 100000,
                 const uint32_t attempts = 5,
                 const uint32_t timeout = 10) {
+            std::string response;
+            const int err = fetch_historical_data(symbol_index, date_start, date_stop, response, attempts, timeout);
+            if(err != OK) return err;
+            return parse_historical_data(response, candles, hist_type, pricescale);
+        }
+
+        /** \brief Загрузить ответ сервера с историческими данными без разбора
+         *
+         * Позволяет разнести загрузку и разбор ответа по разным потокам
+         * \param symbol_index  Индекс символа
+         * \param date_start    Дата начала
+         * \param date_stop     Дата окончания
+         * \param response      Ответ сервера
+         * \param attempts      Количество попыток
+         * \param timeout       Время ожидания
+         * \return Код ошибки, 0 если ошибок нет
+         */
+        int fetch_historical_data(
+                const uint32_t symbol_index,
+                const xtime::timestamp_t date_start,
+                const xtime::timestamp_t date_stop,
+                std::string &response,
+                const uint32_t attempts = 5,
+                const uint32_t timeout = 10) {
             // https://intrade.bar/getHistory.php?symbol=EUR/USD&resolution=1&from=1582491336&to=158251731
             // std::string url("https://intrade.bar/fxhistory/?symbol=");
             std::string url("https://"+ point + "/fxhis/?symbol=");
@@ -1519,12 +1654,12 @@ namespace intrade_bar {
             const std::string executed_false("\"executed\":false");
             const std::string executed_true("\"executed\":true");
 
-            std::string response;
+            response.clear();
 
             /* пробуем загрузить исторические данные несколько раз подряд */
             int err = OK;
             for(uint32_t a = 0; a < attempts; ++a) {
-                int err = get_request(
+                err = get_request(
                     url,
                     body,
                     http_headers_quotes_history,
@@ -1550,15 +1685,31 @@ namespace intrade_bar {
                     return DDOS_GUARD_DETECTED;
                 }
 
-                /* ждем секунду умножить на количество попыток */
+                /* ждем перед следующей попыткой, после последней попытки ждать незачем */
                 //std::this_thread::sleep_for(std::chrono::milliseconds(1000 * (a + 1)));
-                std::this_thread::sleep_for(std::chrono::milliseconds(4000));
+                if((a + 1) < attempts) std::this_thread::sleep_for(std::chrono::milliseconds(4000));
             }
 
             if(err != OK) return err;
             if(response.size() == 0) return DATA_NOT_AVAILABLE;
             if(is_request_future_shutdown) return DATA_NOT_AVAILABLE;
+            return OK;
+        }
 
+        /** \brief Разобрать ответ сервера с историческими данными
+         * \param response      Ответ сервера
+         * \param candles       Массив баров (полученные значения)
+         * \param hist_type     Тип цены
+         * \param pricescale    Множитель цены
+         * \return Код ошибки, 0 если ошибок нет
+         */
+        static int parse_historical_data(
+                const std::string &response,
+                std::vector<xquotes_common::Candle> &candles,
+                const uint32_t hist_type = FXCM_USE_HIST_QUOTES_BID_ASK_DIV2,
+                const uint32_t pricescale = 100000) {
+            candles.clear();
+            if(response.size() == 0) return DATA_NOT_AVAILABLE;
             try {
                 json j = json::parse(response);
                 std::string str_err = j["response"]["error"];
@@ -1575,37 +1726,38 @@ namespace intrade_bar {
                  * Example: [1575416400,1477.18,1477.16,1477.32,1477.16,1477.54,1477.48,1477.73,1477.41,108]
 				 * {"response":{"error":"","executed":true},"instrument_id":"AUD\/USD","period_id":"m1","candles":[[1581956700,0.67163,0.67179,0.6718,0.67163,0.67165,0.67181,0.67181,0.67165,95],[1581956760,0.67179,0.67174,0.6718,0.67172,0.67181,0.67175,0.67182,0.67173,43],[1581956820,0.67174,0.67173,0.67175,0.67172,0.67175,0.67175,0.67176,0.67172,14],[1581956880,0.67173,0.67173,0.67173,0.67171,0.67175,0.67174,0.67175,0.67174,5],[1581956940,0.67173,0.67181,0.67181,0.67172,0.67174,0.67182,0.67183,0.67173,37],[1581957000,0.67181,0.67173,0.67183,0.67172,0.67182,0.67175,0.671851,0.67175,68],[1581957060,0.67173,0.67172,0.67173,0.67171,0.67175,0.67173,0.67175,0.67173,7],[1581957120,0.67172,0.67172,0.67173,0.67172,0.67173,0.67174,0.67175,0.67173,9],[1581957180,0.67172,0.67171,0.67172,0.67169,0.67174,0.67173,0.67175,0.6717,30],[1581957240,0.67171,0.67174,0.67176,0.67171,0.67173,0.67176,0.67178,0.67173,30],[1581957300,0.67174,0.67174,0.67175,0.67174,0.67176,0.67174,0.67176,0.67174,10],[1581957360,0.67174,0.67174,0.67174,0.67173,0.67174,0.67175,0.67175,0.67174,14],[1581957420,0.67174,0.67174,0.67174,0.67173,0.67175,0.67176,0.67176,0.67175,13],[1581957480,0.67174,0.67174,0.67174,0.67173,0.67176,0.67176,0.67176,0.67175,6],[1581957540,0.67174,0.67173,0.67174,0.67173,0.67176,0.67175,0.67176,0.67174,8],[1581957600,0.67173,0.67173,0.67174,0.67172,0.67175,0.67175,0.67176,0.67172,33],[1581957660,0.67173,0.67163,0.67173,0.67162,0.67175,0.67164,0.67175,0.671631,66],[1581957720,0.67163,0.67162,0.67164,0.6716,0.67164,0.67165,0.67165,0.67161,47],[1581957780,0.67162,0.67164,0.67165,0.67162,0.67165,0.67166,0.67166,0.67164,15],[1581957840,0.67164,0.67179,0.6718,0.67164,0.67166,0.671801,0.67181,0.67166,87],[1581957900,0.67179,0.67173,0.67179,0.67172,0.671801,0.67174,0.671801,0.67174,26],[1581957960,0.67173,0.6718,0.6718,0.67172,0.67174,0.67181,0.67181,0.67174,24],[1581958020,0.6718,0.67183,0.67183,0.6718,0.67181,0.67184,0.67184,0.67181,16],[1581958080,0.67183,0.67185,0.67185,0.67183,0.67184,0.67186,0.67186,0.67184,6],[1581958140,0.67185,0.67184,0.67185,0.67183,0.67186,0.67186,0.67187,0.67184,19],[1581958200,0.67184,0.67184,0.67186,0.67181,0.67186,0.671851,0.67187,0.67183,30],[1581958260,0.67184,0.67185,0.67186,0.67184,0.671851,0.67186,0.67187,0.671851,16],[1581958320,0.67185,0.67186,0.67186,0.67183,0.67186,0.67187,0.67187,0.67184,24],[1581958380,0.67186,0.67185,0.67193,0.67185,0.67187,0.67187,0.67194,0.67187,53],[1581958440,0.67185,0.67191,0.67192,0.67185,0.67187,0.67192,0.67193,0.67187,40],[1581958500,0.67191,0.67192,0.67193,0.67191,0.67192,0.67193,0.67194,0.67191,28],[1581958560,0.67192,0.6719,0.67192,0.67189,0.67193,0.67192,0.67193,0.6719,31],[1581958620,0.6719,0.67193,0.67195,0.6719,0.67192,0.67196,0.67196,0.67192,31],[1581958680,0.67193,0.67192,0.67195,0.67191,0.67196,0.67194,0.67196,0.67193,28],[1581958740,0.67192,0.67194,0.67194,0.67191,0.67194,0.67194,0.67194,0.67193,32],[1581958800,0.67194,0.67195,0.67195,0.67193,0.67194,0.67192,0.67196,0.67192,15],[1581958860,0.67195,0.67196,0.67197,0.67192,0.67192,0.67198,0.67199,0.67191,32],[1581958920,0.67196,0.67193,0.67197,0.67193,0.67198,0.67196,0.67199,0.67195,17],[1581958980,0.67193,0.67203,0.67204,0.67193,0.67196,0.67205,0.67206,0.67195,54],[1581959040,0.67203,0.67203,0.67205,0.67203,0.67205,0.67205,0.67206,0.67205,7],[1581959100,0.67203,0.67198,0.67205,0.67198,0.67205,0.67201,0.67206,0.67201,16],[1581959160,0.67198,0.67204,0.67204,0.67197,0.67201,0.67206,0.67206,0.67199,20],[1581959220,0.67204,0.67204,0.67208,0.67203,0.67206,0.67206,0.6721,0.67205,44],[1581959280,0.67204,0.67205,0.67208,0.67204,0.67206,0.67207,0.67209,0.67206,61],[1581959340,0.67205,0.67203,0.67207,0.67203,0.67207,0.67205,0.67209,0.67204,26],[1581959400,0.67203,0.67183,0.67203,0.67183,0.67205,0.67184,0.67205,0.67184,47],[1581959460,0.67183,0.67187,0.67188,0.67183,0.67184,0.67189,0.67191,0.67184,57],[1581959580,0.67187,0.67182,0.67188,0.67182,0.67189,0.67183,0.6719,0.67183,18],[1581959640,0.67182,0.67182,0.67183,0.67182,0.67183,0.67183,0.67184,0.67183,8],[1581959700,0.67182,0.67178,0.67183,0.67176,0.67183,0.67179,0.67183,0.67177,18],[1581959760,0.67178,0.67173,0.67178,0.67172,0.67179,0.67173,0.67179,0.67173,44],[1581959820,0.67173,0.67177,0.67178,0.67172,0.67173,0.67179,0.671801,0.67173,28],[1581959880,0.67177,0.67171,0.67178,0.67171,0.67179,0.67173,0.67179,0.67173,17],[1581959940,0.67171,0.67171,0.67173,0.6717,0.67173,0.67173,0.67173,0.67172,12],[1581960000,0.67171,0.67167,0.67171,0.67167,0.67173,0.6717,0.67173,0.67169,11],[1581960060,0.67167,0.67168,0.67168,0.67166,0.6717,0.67169,0.6717,0.67168,7],[1581960120,0.67168,0.67165,0.67169,0.67163,0.67169,0.67167,0.6717,0.67165,32],[1581960180,0.67165,0.67169,0.67169,0.67165,0.67167,0.6717,0.67171,0.67167,17],[1581960240,0.67169,0.67164,0.67169,0.67164,0.6717,0.67166,0.67171,0.67165,16],[1581960300,0.67164,0.67165,0.67165,0.67164,0.67166,0.67167,0.67167,0.67164,8],[1581960360,0.67165,0.67165,0.67167,0.67164,0.67167,0.67167,0.67168,0.67166,28],[1581960420,0.67165,0.67164,0.67165,0.67163,0.67167,0.67166,0.67167,0.67165,7],[1581960480,0.67164,0.67173,0.67173,0.67164,0.67166,0.67174,0.67174,0.67166,16],[1581960540,0.67173,0.6718,0.67181,0.67173,0.67174,0.671801,0.671801,0.67174,25],[1581960600,0.6718,0.67179,0.6718,0.67179,0.671801,0.671801,0.67181,0.671801,5],[1581960660,0.67179,0.6718,0.6718,0.67179,0.671801,0.67181,0.67181,0.671801,6],[1581960720,0.6718,0.6717,0.67181,0.67169,0.67181,0.67172,0.67182,0.67169,31],[1581960780,0.6717,0.6717,0.67171,0.67169,0.67172,0.67172,0.67172,0.6717,12],[1581960840,0.6717,0.6717,0.67171,0.67168,0.67172,0.67171,0.67172,0.67169,11],[1581960900,0.6717,0.67166,0.6717,0.67166,0.67171,0.67167,0.67171,0.67166,16],[1581960960,0.67166,0.6717,0.6717,0.67166,0.67167,0.67171,0.67171,0.67167,13],[1581961020,0.6717,0.67169,0.6717,0.67169,0.67171,0.6717,0.67171,0.6717,8],[1581961080,0.67169,0.67171,0.67172,0.67169,0.6717,0.67172,0.67172,0.6717,10],[1581961140,0.67171,0.67163,0.67172,0.67163,0.67172,0.67165,0.67172,0.67164,26],[1581961200,0.67163,0.6717,0.6717,0.67159,0.67165,0.67171,0.67171,0.67161,31],[1581961260,0.6717,0.6717,0.6717,0.67169,0.67171,0.67172,0.67172,0.67171,7],[1581961320,0.6717,0.6717,0.67171,0.6717,0.67172,0.67172,0.67172,0.67171,8],[1581961380,0.6717,0.67172,0.67172,0.6717,0.67172,0.67173,0.67173,0.67172,5],[1581961620,0.67172,0.67182,0.67182,0.67172,0.67173,0.67183,0.67183,0.67173,25],[1581961680,0.67182,0.67181,0.67182,0.67181,0.67183,0.67183,0.67184,0.67183,5],[1581961740,0.67181,0.67182,0.67182,0.67181,0.67183,0.67184,0.67184,0.67183,2],[1581961860,0.67182,0.67183,0.67184,0.67182,0.67184,0.67186,0.67186,0.67184,7],[1581961920,0.67183,0.67182,0.67183,0.67182,0.67186,0.671851,0.67186,0.671851,2],[1581961980,0.67182,0.67183,0.67184,0.67182,0.671851,0.671851,0.671851,0.671851,3],[1581962040,0.67183,0.67184,0.67184,0.67183,0.671851,0.67186,0.67186,0.671851,1],[1581962100,0.67184,0.67177,0.67184,0.67175,0.67186,0.67179,0.67186,0.67177,35],[1581962160,0.67177,0.67178,0.67178,0.67168,0.67179,0.67179,0.671801,0.6717,47],[1581962220,0.67178,0.67174,0.67179,0.67174,0.67179,0.67175,0.671801,0.67175,20],[1581962280,0.67174,0.67177,0.67178,0.67173,0.67175,0.67178,0.67178,0.67175,51],[1581962340,0.67177,0.67176,0.67181,0.67176,0.67178,0.67179,0.67182,0.67178,42],[1581962400,0.67176,0.67178,0.67179,0.67176,0.67179,0.671801,0.671801,0.67178,24],[1581962460,0.67178,0.67175,0.67178,0.67175,0.671801,0.67178,0.671801,0.67178,25],[1581962520,0.67175,0.67177,0.67178,0.67175,0.67178,0.67179,0.671801,0.67178,24],[1581962580,0.67177,0.67181,0.67181,0.67177,0.67179,0.671801,0.67182,0.67178,20],[1581962640,0.67181,0.67178,0.67181,0.67178,0.671801,0.67178,0.671801,0.67178,11],[1581962700,0.67178,0.67176,0.6718,0.67174,0.67178,0.67177,0.67179,0.67177,16],[1581962760,0.67176,0.67175,0.67176,0.67175,0.67177,0.67177,0.67177,0.67175,11],[1581962820,0.67175,0.67176,0.67178,0.67175,0.67177,0.67176,0.67179,0.67175,22],[1581962880,0.67176,0.67176,0.67177,0.67176,0.67176,0.67176,0.67178,0.67176,14],[1581962940,0.67176,0.67179,0.6718,0.67176,0.67176,0.67179,0.671801,0.67176,13],[1581963000,0.67179,0.67179,0.6718,0.67179,0.67179,0.67179,0.67179,0.67179,2],[1581963060,0.67179,0.67181,0.67181,0.67179,0.67179,0.671801,0.67182,0.67178,11],[1581963120,0.67181,0.6718,0.67181,0.6718,0.671801,0.67179,0.671801,0.67179,2],[1581963240,0.6718,0.67178,0.6718,0.67178,0.67179,0.67178,0.67182,0.67178,13],[1581963300,0.67178,0.67178,0.67179,0.67178,0.67178,0.67178,0.67178,0.67178,4],[1581963360,0.67178,0.67176,0.67178,0.67176,0.67178,0.67178,0.67178,0.67178,2],[1581963420,0.67176,0.67171,0.67176,0.6717,0.67178,0.67173,0.67178,0.67173,21],[1581963480,0.67171,0.6717,0.67171,0.6717,0.67173,0.67173,0.67173,0.67173,3],[1581963600,0.6717,0.6717,0.6717,0.67168,0.67173,0.67173,0.67174,0.6717,22],[1581963660,0.6717,0.6717,0.6717,0.67169,0.67173,0.67173,0.67174,0.67173,4],[1581963840,0.6717,0.67169,0.6717,0.67168,0.67173,0.67172,0.67174,0.6717,22],[1581963900,0.67169,0.6717,0.6717,0.67169,0.67172,0.67173,0.67174,0.67172,5],[1581964020,0.6717,0.67171,0.67171,0.6717,0.67173,0.67173,0.67175,0.67173,14],[1581964080,0.67171,0.6717,0.67171,0.6717,0.67173,0.67173,0.67175,0.67172,21],[1581964140,0.6717,0.67169,0.67171,0.67169,0.67173,0.67171,0.67174,0.67171,20],[1581964200,0.67169,0.67168,0.67169,0.67167,0.67171,0.67171,0.67172,0.6717,6],[1581964260,0.67168,0.67168,0.67169,0.67168,0.67171,0.67171,0.67172,0.67171,5],[1581964320,0.67168,0.6717,0.6717,0.67168,0.67171,0.67172,0.67174,0.67171,13],[1581964380,0.6717,0.67169,0.6717,0.67169,0.67172,0.67172,0.67173,0.67172,8],[1581964440,0.67169,0.6717,0.6717,0.67169,0.67172,0.67172,0.67173,0.67172,12],[1581964560,0.6717,0.67171,0.67171,0.6717,0.67172,0.67174,0.67174,0.67172,20],[1581964620,0.67171,0.6717,0.67171,0.6717,0.67174,0.67175,0.67175,0.67173,8],[1581964680,0.6717,0.67172,0.67172,0.6717,0.67175,0.67174,0.67175,0.67172,16],[1581964740,0.67172,0.67172,0.67172,0.6717,0.67174,0.67175,0.67175,0.67173,16],[1581964800,0.67172,0.67171,0.67172,0.67171,0.67175,0.67173,0.67175,0.67173,12],[1581964860,0.67171,0.67171,0.67172,0.6717,0.67173,0.67174,0.67175,0.67173,9],[1581964920,0.67171,0.67172,0.67172,0.67171,0.67174,0.67174,0.67175,0.67173,5],[1581965100,0.67172,0.67172,0.67172,0.67171,0.67174,0.67175,0.67176,0.67173,29],[1581965340,0.67172,0.67174,0.67174,0.67172,0.67175,0.67175,0.67177,0.67174,28],[1581965460,0.67174,0.67174,0.67174,0.67173,0.67175,0.67176,0.67177,0.67175,11],[1581965580,0.67174,0.6718,0.6718,0.67174,0.67176,0.67181,0.67182,0.67174,34],[1581965640,0.6718,0.67196,0.67197,0.6718,0.67181,0.67197,0.67198,0.67181,56],[1581965700,0.67196,0.67194,0.67196,0.67194,0.67197,0.67197,0.67197,0.67197,10],[1581965760,0.67194,0.67189,0.67195,0.67189,0.67197,0.67192,0.67197,0.67192,13],[1581965820,0.67189,0.67188,0.67189,0.67187,0.67192,0.6719,0.67192,0.6719,14],[1581965880,0.67188,0.67183,0.67188,0.67183,0.6719,0.67188,0.6719,0.67188,19],[1581966000,0.67183,0.67183,0.67186,0.67182,0.67188,0.671851,0.6719,0.671851,33],[1581966060,0.67183,0.67176,0.67183,0.67176,0.671851,0.67179,0.671851,0.67179,21],[1581966120,0.67176,0.67176,0.67178,0.67176,0.67179,0.67178,0.671801,0.67178,6],[1581966180,0.67176,0.67176,0.67176,0.67175,0.67178,0.67178,0.67178,0.67177,8],[1581966240,0.67176,0.67166,0.67176,0.67164,0.67178,0.6717,0.67178,0.67167,58],[1581966300,0.67166,0.67164,0.67167,0.67164,0.6717,0.67165,0.6717,0.67165,22],[1581966360,0.67164,0.67163,0.67164,0.67162,0.67165,0.67165,0.67166,0.67165,7],[1581966420,0.67163,0.67162,0.67163,0.67161,0.67165,0.67165,0.67166,0.671631,19],[1581966480,0.67162,0.67155,0.67162,0.67155,0.67165,0.67157,0.67166,0.67157,29],[1581966540,0.67155,0.67156,0.67158,0.67154,0.67157,0.671581,0.671581,0.67156,14],[1581966600,0.67156,0.67157,0.67158,0.67156,0.671581,0.67159,0.6716,0.67157,15],[1581966660,0.67157,0.67158,0.67159,0.67157,0.67159,0.6716,0.67161,0.67159,38],[1581966720,0.67158,0.67158,0.67159,0.67158,0.6716,0.67161,0.67161,0.67159,7],[1581966780,0.67158,0.67162,0.67163,0.67157,0.67161,0.67164,0.67165,0.67161,14],[1581966900,0.67162,0.67161,0.67162,0.67161,0.67164,0.671631,0.67164,0.671631,4],[1581967020,0.67161,0.67162,0.67162,0.67161,0.671631,0.67165,0.67165,0.671631,10],[1581967080,0.67162,0.67162,0.67162,0.67161,0.67165,0.67165,0.67165,0.67164,5],[1581967140,0.67162,0.67161,0.67162,0.67161,0.67165,0.67164,0.67165,0.67164,3],[1581967200,0.67161,0.67162,0.67163,0.67161,0.67164,0.67164,0.67165,0.67164,8],[1581967260,0.67162,0.6716,0.67162,0.6716,0.67164,0.671631,0.67165,0.671631,12],[1581967320,0.6716,0.67161,0.67161,0.67159,0.671631,0.67165,0.67165,0.671631,11],[1581967380,0.67161,0.6716,0.67162,0.6716,0.67165,0.671631,0.67165,0.671631,4],[1581967440,0.6716,0.67162,0.67162,0.6716,0.671631,0.67165,0.67165,0.671631,15],[1581967500,0.67162,0.67161,0.67162,0.67161,0.67165,0.67165,0.67165,0.67165,1],[1581967560,0.67161,0.6716,0.67162,0.6716,0.67165,0.67164,0.67165,0.671631,8],[1581967620,0.6716,0.67159,0.6716,0.67159,0.67164,0.67164,0.67164,0.671631,5],[1581967680,0.67159,0.6716,0.67161,0.67159,0.67164,0.671631,0.67164,0.67162,10],[1581967740,0.6716,0.67159,0.6716,0.67158,0.671631,0.671631,0.671631,0.67162,10],[1581967860,0.67159,0.67161,0.67161,0.67158,0.671631,0.671631,0.671631,0.67162,14],[1581967920,0.67161,0.67162,0.67162,0.67161,0.671631,0.67164,0.67164,0.67162,6],[1581967980,0.67162,0.6716,0.67162,0.67159,0.67164,0.67162,0.67164,0.67162,22],[1581968040,0.6716,0.6716,0.6716,0.67159,0.67162,0.67162,0.67162,0.67161,16],[1581968100,0.6716,0.6716,0.67161,0.67159,0.67162,0.67162,0.67162,0.67162,10],[1581968160,0.6716,0.67161,0.67161,0.67159,0.67162,0.67162,0.671631,0.67162,15],[1581968220,0.67161,0.6716,0.67161,0.6716,0.67162,0.67162,0.671631,0.67162,13],[1581968280,0.6716,0.67165,0.67167,0.6716,0.67162,0.67167,0.67168,0.67162,31],[1581968340,0.67165,0.67166,0.67167,0.67164,0.67167,0.6717,0.6717,0.67167,28],[1581968400,0.67166,0.67168,0.67168,0.67165,0.6717,0.67171,0.67171,0.67169,16],[1581968460,0.67168,0.67167,0.67168,0.67167,0.67171,0.6717,0.67171,0.6717,2],[1581968520,0.67167,0.67167,0.67167,0.67166,0.6717,0.67171,0.67171,0.67169,12],[1581968580,0.67167,0.67167,0.67169,0.67167,0.67171,0.67172,0.67172,0.67171,6],[1581968640,0.67167,0.67167,0.67168,0.67167,0.67172,0.67171,0.67172,0.67171,6],[1581968760,0.67167,0.67167,0.67168,0.67167,0.67171,0.67171,0.67172,0.6717,8],[1581968820,0.67167,0.67165,0.67167,0.67164,0.67171,0.67168,0.67171,0.67167,26],[1581968880,0.67165,0.67165,0.67167,0.67165,0.67168,0.67168,0.6717,0.67168,11],[1581968940,0.67165,0.67165,0.67165,0.67163,0.67168,0.67168,0.67168,0.67166,18],[1581969000,0.67165,0.67165,0.67166,0.67164,0.67168,0.67168,0.67169,0.67168,8],[1581969060,0.67165,0.67166,0.67167,0.67164,0.67168,0.67169,0.67169,0.67167,18],[1581969180,0.67166,0.67166,0.67167,0.67165,0.67169,0.67169,0.6717,0.67167,14],[1581969240,0.67166,0.67167,0.67167,0.67166,0.67169,0.67169,0.67169,0.67168,3],[1581969300,0.67167,0.67167,0.67167,0.67166,0.67169,0.67169,0.6717,0.67168,11],[1581969360,0.67167,0.67168,0.67168,0.67167,0.67169,0.67172,0.67172,0.67169,6],[1581969420,0.67168,0.67166,0.67168,0.67165,0.67172,0.67169,0.67172,0.67167,19],[1581969480,0.67166,0.67165,0.67166,0.67161,0.67169,0.67169,0.67169,0.67164,33],[1581969540,0.67165,0.67166,0.67167,0.67165,0.67169,0.67169,0.6717,0.67168,10],[1581969600,0.67166,0.67167,0.67168,0.67162,0.67169,0.67171,0.67171,0.671631,39],[1581969660,0.67167,0.67167,0.67168,0.67167,0.67171,0.6717,0.67172,0.6717,12],[1581969720,0.67167,0.67167,0.67168,0.67167,0.6717,0.67171,0.67171,0.6717,5],[1581969780,0.67167,0.67175,0.67175,0.67167,0.67171,0.67177,0.67177,0.6717,22],[1581969840,0.67175,0.67178,0.6718,0.67175,0.67177,0.67182,0.67184,0.67177,36],[1581969900,0.67178,0.67181,0.67182,0.67178,0.67182,0.671851,0.671851,0.67181,16],[1581969960,0.67181,0.6718,0.67182,0.6718,0.671851,0.671851,0.671851,0.67184,10],[1581970020,0.6718,0.67181,0.67181,0.6718,0.671851,0.671851,0.67186,0.67184,8],[1581970080,0.67181,0.6718,0.67181,0.6718,0.671851,0.67183,0.671851,0.67183,2],[1581970140,0.6718,0.67177,0.67181,0.67175,0.67183,0.67181,0.67183,0.67178,28],[1581970200,0.67177,0.6718,0.6718,0.67177,0.67181,0.67182,0.67183,0.67179,22],[1581970260,0.6718,0.67179,0.6718,0.67179,0.67182,0.67182,0.67183,0.67181,7],[1581970320,0.67179,0.67165,0.67179,0.67165,0.67182,0.67168,0.67182,0.67168,34],[1581970380,0.67165,0.6717,0.6717,0.67162,0.67168,0.67173,0.67174,0.671631,39],[1581970560,0.6717,0.6717,0.67171,0.6717,0.67173,0.67174,0.67176,0.67173,18],[1581970620,0.6717,0.67168,0.6717,0.67166,0.67174,0.67171,0.67174,0.67169,14],[1581970680,0.67168,0.67167,0.67168,0.67167,0.67171,0.67171,0.67171,0.67171,1],[1581970740,0.67167,0.67168,0.67168,0.67167,0.67171,0.67171,0.67172,0.67171,3],[1581970800,0.67168,0.67168,0.67168,0.67166,0.67171,0.67171,0.67171,0.6717,5],[1581970860,0.67168,0.67167,0.67168,0.67165,0.67171,0.6717,0.67171,0.67169,18],[1581970920,0.67167,0.67168,0.67168,0.67166,0.6717,0.67171,0.67172,0.6717,12],[1581970980,0.67168,0.67169,0.67169,0.67168,0.67171,0.67172,0.67172,0.67171,9],[1581971040,0.67169,0.6717,0.67171,0.67168,0.67172,0.67173,0.67173,0.67171,11],[1581971100,0.6717,0.67172,0.67173,0.67169,0.67173,0.67177,0.67178,0.67173,19],[1581971160,0.67172,0.67176,0.67178,0.67172,0.67177,0.67181,0.67181,0.67175,31],[1581971220,0.67176,0.67176,0.6718,0.67174,0.67181,0.671801,0.67182,0.67177,41],[1581971280,0.67176,0.67176,0.67177,0.67176,0.671801,0.67181,0.67181,0.671801,5],[1581971340,0.67176,0.67177,0.67177,0.67176,0.67181,0.67181,0.67181,0.671801,4],[1581971400,0.67177,0.67171,0.67177,0.67171,0.67181,0.67176,0.67181,0.67176,14],[1581971460,0.67171,0.67172,0.67172,0.67171,0.67176,0.67176,0.67177,0.67176,8],[1581971520,0.67172,0.67172,0.67172,0.67171,0.67176,0.67177,0.67177,0.67176,12],[1581971580,0.67172,0.67171,0.67172,0.67168,0.67177,0.67175,0.67177,0.67171,32],[1581971640,0.67171,0.67171,0.67172,0.67171,0.67175,0.67176,0.67177,0.67175,15],[1581971700,0.67171,0.67172,0.67172,0.67168,0.67176,0.67177,0.67177,0.67171,28],[1581971760,0.67172,0.6717,0.67172,0.67165,0.67177,0.67174,0.67177,0.67166,70],[1581971820,0.6717,0.67168,0.67171,0.67163,0.67174,0.67174,0.67177,0.67169,34],[1581971880,0.67168,0.67169,0.6717,0.67168,0.67174,0.67173,0.67175,0.67173,9],[1581971940,0.67169,0.67169,0.6717,0.67168,0.67173,0.67173,0.67176,0.67173,44],[1581972000,0.67169,0.6717,0.6717,0.67168,0.67173,0.67175,0.67176,0.67172,22],[1581972060,0.6717,0.67174,0.67174,0.67169,0.67175,0.67179,0.67179,0.67174,38],[1581972120,0.67174,0.67173,0.67174,0.67172,0.67179,0.67178,0.67179,0.67177,12],[1581972180,0.67173,0.67173,0.67173,0.67172,0.67178,0.67178,0.67178,0.67177,8],[1581972240,0.67173,0.67172,0.67175,0.67169,0.67178,0.67177,0.671801,0.67176,34],[1581972300,0.67172,0.67174,0.67174,0.67169,0.67177,0.67179,0.67179,0.67175,26],[1581972360,0.67174,0.67174,0.67175,0.67173,0.67179,0.67179,0.671801,0.67178,11],[1581972420,0.67174,0.67174,0.67175,0.67174,0.67179,0.67179,0.671801,0.67178,5],[1581972480,0.67174,0.67174,0.67174,0.67172,0.67179,0.67179,0.671801,0.67175,17],[1581972540,0.67174,0.67174,0.67174,0.67172,0.67179,0.67179,0.671801,0.67176,25],[1581972600,0.67174,0.67173,0.67174,0.67173,0.67179,0.67178,0.67179,0.67178,4],[1581972660,0.67173,0.67173,0.67174,0.67172,0.67178,0.67179,0.67179,0.67176,15],[1581972720,0.67173,0.67174,0.67177,0.67171,0.67179,0.67182,0.67182,0.67178,27],[1581972780,0.67174,0.67175,0.67176,0.67174,0.67182,0.67181,0.67182,0.671801,14],[1581972840,0.67175,0.67173,0.67176,0.67173,0.67181,0.67178,0.67182,0.67178,17],[1581972900,0.67173,0.67172,0.67174,0.67172,0.67178,0.67178,0.67179,0.67177,9],[1581972960,0.67172,0.67171,0.67173,0.67169,0.67178,0.67176,0.67179,0.67174,31],[1581973020,0.67171,0.67172,0.67173,0.6717,0.67176,0.67178,0.67178,0.67176,10],[1581973140,0.67172,0.67172,0.67172,0.67167,0.67178,0.67178,0.67178,0.67173,27],[1581973200,0.67172,0.6717,0.67172,0.67167,0.67178,0.6717,0.67179,0.6717,30],[1581973260,0.6717,0.67169,0.6717,0.67165,0.6717,0.6717,0.6717,0.6717,11],[1581973320,0.67169,0.6715,0.67169,0.67144,0.6717,0.67155,0.6717,0.67153,74],[1581973380,0.6715,0.67153,0.67154,0.67146,0.67155,0.67159,0.67161,0.67154,43],[1581973440,0.67153,0.67155,0.67162,0.67152,0.67159,0.671581,0.67166,0.671581,28],[1581973560,0.67155,0.67152,0.67155,0.67135,0.671581,0.67155,0.67159,0.67138,105],[1581973620,0.67152,0.67155,0.67156,0.67152,0.67155,0.67157,0.6716,0.67155,19],[1581973680,0.67155,0.67156,0.67157,0.67153,0.67157,0.6716,0.6716,0.67155,29],[1581973740,0.67156,0.67156,0.67156,0.67154,0.6716,0.67159,0.6716,0.67159,12],[1581973800,0.67156,0.67158,0.67159,0.67155,0.67159,0.67162,0.67162,0.671581,19],[1581973860,0.67158,0.67138,0.67158,0.67136,0.67162,0.671411,0.67164,0.6714,35],[1581973920,0.67138,0.67133,0.67139,0.67132,0.671411,0.67138,0.67143,0.67137,37],[1581973980,0.67133,0.67139,0.67139,0.67133,0.67138,0.67142,0.67142,0.67138,18],[1581974040,0.67139,0.67133,0.67142,0.67133,0.67142,0.67139,0.67147,0.67139,19],[1581974100,0.67133,0.67132,0.67142,0.67132,0.67139,0.67137,0.67143,0.67135,89],[1581974160,0.67132,0.67138,0.67138,0.67131,0.67137,0.67138,0.6714,0.67135,49],[1581974220,0.67138,0.6714,0.67141,0.67136,0.67138,0.671411,0.67142,0.67138,40],[1581974280,0.6714,0.6714,0.67142,0.67138,0.671411,0.6714,0.67143,0.67139,21],[1581974340,0.6714,0.67142,0.67142,0.6714,0.6714,0.67142,0.67143,0.6714,18],[1581974400,0.67142,0.67141,0.67142,0.67138,0.67142,0.671411,0.67143,0.67139,31],[1581974460,0.67141,0.67139,0.67142,0.67138,0.671411,0.6714,0.67144,0.67138,19],[1581974520,0.67139,0.67137,0.6714,0.67137,0.6714,0.67139,0.671411,0.67138,32],[1581974580,0.67137,0.67138,0.6714,0.67136,0.67139,0.67139,0.671411,0.67138,17],[1581974640,0.67138,0.67137,0.67143,0.67135,0.67139,0.67138,0.67142,0.67137,78],[1581974700,0.67137,0.67136,0.67142,0.67133,0.67138,0.67136,0.67142,0.67135,59],[1581974760,0.67136,0.67135,0.67136,0.67135,0.67136,0.67136,0.67137,0.67135,20],[1581974820,0.67135,0.67138,0.67138,0.67134,0.67136,0.67139,0.6714,0.67135,25],[1581974880,0.67138,0.67137,0.67138,0.67135,0.67139,0.67138,0.67139,0.67137,27],[1581974940,0.67137,0.67137,0.67139,0.67136,0.67138,0.67138,0.67142,0.67138,63],[1581975000,0.67137,0.67138,0.67139,0.67135,0.67138,0.67139,0.67142,0.67137,88],[1581975060,0.67138,0.67138,0.67139,0.67135,0.67139,0.671411,0.671411,0.67138,51],[1581975120,0.67138,0.67137,0.67138,0.67136,0.671411,0.67138,0.671411,0.67137,62],[1581975180,0.67137,0.67136,0.67138,0.67134,0.67138,0.67138,0.67139,0.67137,61],[1581975240,0.67136,0.67137,0.67138,0.67135,0.67138,0.6714,0.67143,0.67137,52],[1581975300,0.67137,0.67135,0.67137,0.67131,0.6714,0.67136,0.6714,0.67135,29],[1581975360,0.67135,0.67131,0.67135,0.67127,0.67136,0.67132,0.67137,0.67129,59],[1581975420,0.67131,0.6713,0.67133,0.67128,0.67132,0.67133,0.67137,0.6713,49],[1581975480,0.6713,0.6713,0.67131,0.67128,0.67133,0.67134,0.67134,0.67132,16],[1581975540,0.6713,0.67132,0.67132,0.6713,0.67134,0.67134,0.67134,0.67134,4],[1581975600,0.67132,0.67131,0.67132,0.67131,0.67134,0.67134,0.67134,0.67134,3],[1581975660,0.67131,0.67131,0.67131,0.6713,0.67134,0.67134,0.67134,0.67134,2],[1581975720,0.67131,0.6713,0.67132,0.67129,0.67134,0.67134,0.67134,0.67133,19],[1581975780,0.6713,0.67131,0.67132,0.67129,0.67134,0.67134,0.67134,0.67133,31],[1581975840,0.67131,0.67132,0.67132,0.67131,0.67134,0.67134,0.67134,0.67134,3],[1581975900,0.67132,0.67132,0.67133,0.67127,0.67134,0.67137,0.67138,0.67133,35],[1581975960,0.67132,0.6713,0.67134,0.67128,0.67137,0.67133,0.67139,0.67133,186],[1581976020,0.6713,0.6713,0.67133,0.67115,0.67133,0.67134,0.67138,0.671191,179],[1581976080,0.6713,0.6713,0.67134,0.67126,0.67134,0.67134,0.67143,0.67133,50],[1581976140,0.6713,0.6713,0.67134,0.67126,0.67134,0.67135,0.67138,0.67132,39],[1581976200,0.6713,0.67125,0.6713,0.67115,0.67135,0.67129,0.67136,0.671191,81],[1581976260,0.67125,0.67129,0.67132,0.67121,0.67129,0.67134,0.67138,0.67128,34],[1581976320,0.67129,0.67131,0.67132,0.67129,0.67134,0.67135,0.67136,0.67133,16],[1581976380,0.67131,0.67132,0.67132,0.67123,0.67135,0.67137,0.67144,0.67134,19],[1581976440,0.67132,0.67132,0.67132,0.67125,0.67137,0.67137,0.67137,0.67135,9],[1581976500,0.67132,0.67129,0.67132,0.67124,0.67137,0.67134,0.67138,0.67133,10],[1581976560,0.67129,0.67126,0.67132,0.67123,0.67134,0.67133,0.671411,0.67133,32],[1581976620,0.67126,0.67131,0.67132,0.67122,0.67133,0.67136,0.67137,0.67133,16],[1581976680,0.67131,0.67128,0.67137,0.67128,0.67136,0.67138,0.67151,0.67136,45],[1581976740,0.67128,0.6713,0.6713,0.67128,0.67138,0.671411,0.67149,0.67138,46],[1581976980,0.6713,0.6713,0.6713,0.67127,0.671411,0.67137,0.67145,0.67137,9],[1581977040,0.6713,0.67131,0.67131,0.6713,0.67137,0.67137,0.67137,0.67137,1],[1581977100,0.67131,0.67132,0.67132,0.67129,0.67137,0.67137,0.67142,0.67137,9],[1581977160,0.67132,0.67145,0.67148,0.67129,0.67137,0.67152,0.67155,0.67137,38],[1581977220,0.67145,0.67143,0.67145,0.67141,0.67152,0.6715,0.67153,0.67149,37],[1581977340,0.67143,0.67145,0.67146,0.67142,0.6715,0.67151,0.67154,0.67149,48],[1581977400,0.67145,0.67135,0.67146,0.67135,0.67151,0.67151,0.67153,0.67145,103],[1581977460,0.67135,0.67134,0.67135,0.67134,0.67151,0.67149,0.67151,0.67149,13],[1581977520,0.67134,0.6713,0.67139,0.6713,0.67149,0.671411,0.67151,0.671411,33],[1581977580,0.6713,0.67132,0.67133,0.6713,0.671411,0.67144,0.6715,0.6714,34],[1581977640,0.67132,0.67129,0.67132,0.67129,0.67144,0.671411,0.67144,0.671411,9],[1581977700,0.67129,0.67135,0.67135,0.67129,0.671411,0.6715,0.6715,0.671411,8],[1581977760,0.67135,0.67135,0.67136,0.6713,0.6715,0.67144,0.6715,0.67144,25],[1581977820,0.67135,0.67134,0.67136,0.67129,0.67144,0.67148,0.67148,0.67136,9],[1581977880,0.67134,0.67134,0.67137,0.67129,0.67148,0.67149,0.67149,0.67143,16],[1581977940,0.67134,0.67136,0.67137,0.6713,0.67149,0.67149,0.6715,0.67143,10],[1581978000,0.67136,0.6713,0.67137,0.67129,0.67149,0.67144,0.67151,0.67139,82],[1581978060,0.6713,0.67133,0.67134,0.67129,0.67144,0.67144,0.6715,0.6714,43],[1581978120,0.67133,0.67137,0.67137,0.6713,0.67144,0.6715,0.67153,0.67144,17],[1581978180,0.67137,0.67133,0.67137,0.67131,0.6715,0.67138,0.67152,0.67138,13],[1581978360,0.67133,0.67134,0.67135,0.67133,0.67138,0.67139,0.67139,0.67138,6],[1581978420,0.67134,0.67133,0.67134,0.67133,0.67139,0.67139,0.67139,0.67139,11],[1581978480,0.67133,0.67125,0.67134,0.67121,0.67139,0.67138,0.67142,0.67126,33],[1581978540,0.67125,0.67129,0.6713,0.67121,0.67138,0.67135,0.67139,0.67129,109],[1581978600,0.67129,0.67126,0.6713,0.67121,0.67135,0.67135,0.67136,0.67126,78],[1581978660,0.67126,0.67127,0.67132,0.67123,0.67135,0.67134,0.67144,0.67128,95],[1581978720,0.67127,0.67133,0.67134,0.67124,0.67134,0.67142,0.67144,0.67134,37],[1581978780,0.67133,0.67132,0.67134,0.67127,0.67142,0.67143,0.67143,0.67134,24],[1581978840,0.67132,0.67128,0.67133,0.67128,0.67143,0.67142,0.67143,0.67135,8],[1581978900,0.67128,0.67128,0.6713,0.67128,0.67142,0.671411,0.67142,0.67138,5],[1581978960,0.67128,0.67128,0.67129,0.67128,0.671411,0.671411,0.671411,0.671411,2],[1581979020,0.67128,0.6713,0.6713,0.67128,0.671411,0.67142,0.67142,0.671411,4],[1581979080,0.6713,0.67133,0.67139,0.67126,0.67142,0.67143,0.67144,0.67135,87],[1581979140,0.67133,0.67134,0.67137,0.67133,0.67143,0.6714,0.67145,0.67138,33],[1581979200,0.67134,0.67135,0.67138,0.67134,0.6714,0.6714,0.67146,0.67138,46],[1581979260,0.67135,0.67136,0.67138,0.67134,0.6714,0.6714,0.67146,0.67139,65],[1581979320,0.67136,0.67136,0.67137,0.67136,0.6714,0.6714,0.6714,0.6714,2],[1581979500,0.67136,0.67133,0.67136,0.67132,0.6714,0.6714,0.67145,0.67139,39],[1581979560,0.67133,0.67134,0.67134,0.67133,0.6714,0.6714,0.67143,0.67139,19],[1581979620,0.67134,0.67133,0.67139,0.67132,0.6714,0.6714,0.67145,0.67138,94],[1581979680,0.67133,0.67132,0.67136,0.67132,0.6714,0.6714,0.671411,0.67137,28],[1581979740,0.67132,0.67132,0.67136,0.67131,0.6714,0.6714,0.671411,0.67139,14],[1581979800,0.67132,0.67136,0.67137,0.67132,0.6714,0.671411,0.67142,0.6714,25],[1581979860,0.67136,0.67134,0.67136,0.67132,0.671411,0.6714,0.67142,0.67139,18],[1581979920,0.67134,0.67137,0.67138,0.67132,0.6714,0.67142,0.67144,0.67139,33],[1581979980,0.67137,0.67137,0.67142,0.67134,0.67142,0.671411,0.67145,0.6714,58],[1581980040,0.67137,0.67145,0.67152,0.67132,0.671411,0.67156,0.67177,0.671411,83],[1581980100,0.67145,0.67145,0.67145,0.67143,0.67156,0.67155,0.67156,0.67155,12],[1581980160,0.67145,0.67134,0.67145,0.67134,0.67155,0.67138,0.67156,0.67136,47],[1581980220,0.67134,0.6712,0.67136,0.67117,0.67138,0.671241,0.6714,0.671241,285],[1581980280,0.6712,0.67119,0.67125,0.67119,0.671241,0.67123,0.6713,0.67122,78],[1581980340,0.67119,0.67123,0.67127,0.67118,0.67123,0.67126,0.67132,0.67123,133],[1581980400,0.67123,0.67125,0.67138,0.67117,0.67126,0.67129,0.671411,0.67122,240],[1581980460,0.67125,0.67133,0.67133,0.67123,0.67129,0.67136,0.67137,0.67126,40],[1581980520,0.67133,0.67123,0.67135,0.67121,0.67136,0.67125,0.67139,0.67125,70],[1581980580,0.67123,0.6712,0.67124,0.67115,0.67125,0.67122,0.67126,0.67118,70],[1581980640,0.6712,0.67118,0.6712,0.67112,0.67122,0.67126,0.67126,0.67116,99],[1581980700,0.67118,0.67126,0.67135,0.67118,0.67126,0.6713,0.67139,0.67122,117],[1581980760,0.67126,0.67115,0.67127,0.67115,0.6713,0.671191,0.6713,0.671191,50],[1581980820,0.67115,0.67106,0.67116,0.67102,0.671191,0.67109,0.6712,0.67105,86],[1581980880,0.67106,0.671,0.67108,0.67092,0.67109,0.67105,0.67112,0.67096,123],[1581980940,0.671,0.67107,0.67108,0.671,0.67105,0.67112,0.67113,0.67105,51],[1581981000,0.67107,0.67116,0.67117,0.67107,0.67112,0.6712,0.67121,0.6711,24],[1581981060,0.67116,0.67111,0.67116,0.67111,0.6712,0.67115,0.6712,0.67114,12],[1581981120,0.67111,0.67119,0.67119,0.67111,0.67115,0.67122,0.67123,0.67114,25],[1581981180,0.67119,0.67122,0.67124,0.67119,0.67122,0.67127,0.67128,0.67122,22],[1581981240,0.67122,0.67128,0.6713,0.67122,0.67127,0.67131,0.67131,0.67127,19],[1581981300,0.67128,0.67131,0.67131,0.67124,0.67131,0.67134,0.67135,0.67127,134],[1581981360,0.67131,0.67129,0.67132,0.67129,0.67134,0.67132,0.67135,0.67132,79],[1581981420,0.67129,0.67122,0.67133,0.67122,0.67132,0.67126,0.67136,0.67126,139],[1581981480,0.67122,0.67128,0.67129,0.67122,0.67126,0.67131,0.67131,0.67126,30],[1581981540,0.67128,0.67128,0.67132,0.67126,0.67131,0.67132,0.67134,0.6713,61],[1581981600,0.67128,0.67107,0.67128,0.67107,0.67132,0.6711,0.67132,0.6711,116],[1581981660,0.67107,0.67098,0.67107,0.67092,0.6711,0.671,0.67111,0.67095,155],[1581981720,0.67098,0.67084,0.67099,0.67084,0.671,0.67087,0.67103,0.67087,109],[1581981780,0.67084,0.67076,0.67084,0.6707,0.67087,0.670801,0.67088,0.67072,95],[1581981840,0.67076,0.67075,0.67077,0.67071,0.670801,0.67077,0.670801,0.67076,73],[1581981900,0.67075,0.67078,0.67078,0.67072,0.67077,0.670801,0.67081,0.67075,42],[1581981960,0.67078,0.67078,0.67079,0.67074,0.670801,0.670801,0.67082,0.67076,31],[1581982020,0.67078,0.67077,0.67082,0.67077,0.670801,0.67081,0.67086,0.67079,44],[1581982080,0.67077,0.67083,0.67083,0.67077,0.67081,0.67086,0.67087,0.67081,45],[1581982140,0.67083,0.67098,0.67098,0.67083,0.67086,0.671,0.67101,0.67086,80],[1581982200,0.67098,0.67098,0.67099,0.67096,0.671,0.67101,0.671021,0.67099,57],[1581982260,0.67098,0.67098,0.671,0.67097,0.67101,0.67101,0.67101,0.67099,16],[1581982320,0.67098,0.67092,0.67098,0.67089,0.67101,0.67095,0.67101,0.67092,77],[1581982380,0.67092,0.67093,0.67096,0.67091,0.67095,0.67096,0.67099,0.67094,42],[1581982440,0.67093,0.67094,0.67097,0.67091,0.67096,0.670971,0.67098,0.67095,57],[1581982500,0.67094,0.67094,0.67098,0.67093,0.670971,0.67095,0.67099,0.67095,46],[1581982560,0.67094,0.67095,0.67097,0.67092,0.67095,0.670971,0.67099,0.67093,71],[1581982620,0.67095,0.67094,0.67099,0.67093,0.670971,0.67096,0.67101,0.67096,68]]}
                  */
+                if(hist_type == FXCM_USE_HIST_QUOTES_BID_ASK_DIV2 && !price_kernels::is_batch_faster()) {
+                    /* Для цен intrade.bar без AVX2 обычный цикл по барам быстрее раскладки по колонкам */
+                    for(size_t i = 0; i < array_size; ++i) {
+                        const json &item = (*it_candles)[i];
+                        candles[i].timestamp = item[0];
+                        candles[i].open = Price::from_bid_ask(item[1], item[5], pricescale).to_double();
+                        candles[i].close = Price::from_bid_ask(item[2], item[6], pricescale).to_double();
+                        candles[i].high = Price::from_bid_ask(item[3], item[7], pricescale).to_double();
+                        candles[i].low = Price::from_bid_ask(item[4], item[8], pricescale).to_double();
+                        candles[i].volume = item[9];
+                    }
+                } else
                 if(hist_type == FXCM_USE_HIST_QUOTES_BID_ASK_DIV2) {
-                    /* Для цен intrade.bar */
+                    /* Для цен intrade.bar: сначала раскладываем бары по колонкам,
+                     * затем средние цены считаются пакетно для всего ответа
+                     */
+                    price_kernels::BidAskColumns columns;
+                    columns.resize(array_size);
                     for(size_t i = 0; i < array_size; ++i) {
-                        candles[i].timestamp = (*it_candles)[i][0];
-                        const double bid_open = (*it_candles)[i][1];
-                        const double bid_close = (*it_candles)[i][2];
-                        const double bid_high = (*it_candles)[i][3];
-                        const double bid_low = (*it_candles)[i][4];
-                        const double ask_open = (*it_candles)[i][5];
-                        const double ask_close = (*it_candles)[i][6];
-                        const double ask_high = (*it_candles)[i][7];
-                        const double ask_low = (*it_candles)[i][8];
-                        candles[i].open = (bid_open + ask_open) / 2.0d;
-                        candles[i].high = (bid_high + ask_high) / 2.0d;
-                        candles[i].low = (bid_low + ask_low) / 2.0d;
-                        candles[i].close = (bid_close + ask_close) / 2.0d;
-                        candles[i].volume = (*it_candles)[i][9];
-                        /* округлим цены */
-                        candles[i].open =
-                            (double)((uint64_t)(candles[i].open *
-                            (double)pricescale + 0.5d)) / (double)pricescale;
-                        candles[i].high =
-                            (double)((uint64_t)(candles[i].high *
-                            (double)pricescale + 0.5d)) / (double)pricescale;
-                        candles[i].low =
-                            (double)((uint64_t)(candles[i].low *
-                            (double)pricescale + 0.5d)) / (double)pricescale;
-                        candles[i].close =
-                            (double)((uint64_t)(candles[i].close *
-                            (double)pricescale + 0.5d)) / (double)pricescale;
+                        const json &item = (*it_candles)[i];
+                        columns.timestamp[i] = item[0];
+                        columns.bid_open[i] = item[1];
+                        columns.bid_close[i] = item[2];
+                        columns.bid_high[i] = item[3];
+                        columns.bid_low[i] = item[4];
+                        columns.ask_open[i] = item[5];
+                        columns.ask_close[i] = item[6];
+                        columns.ask_high[i] = item[7];
+                        columns.ask_low[i] = item[8];
+                        columns.volume[i] = item[9];
                     }
+                    price_kernels::assemble_candles(columns, candles, pricescale);
                 } else
                 if(hist_type == FXCM_USE_HIST_QUOTES_BID) {
                     for(size_t i = 0; i < array_size; ++i) {
@@ -1629,17 +1781,17 @@ namespace intrade_bar {
                 }
             }
             catch(json::parse_error &e) {
-                std::cerr << "IntradeBarHttpApi::get_historical_data, json parser error: " << std::string(e.what()) << std::endl;
+                std::cerr << "IntradeBarHttpApi::parse_historical_data, json parser error: " << std::string(e.what()) << std::endl;
                 std::cerr << "response " << response << std::endl;
                 return JSON_PARSER_ERROR;
             }
             catch(std::exception e) {
-                std::cerr << "IntradeBarHttpApi::get_historical_data, json parser error: " << std::string(e.what()) << std::endl;
+                std::cerr << "IntradeBarHttpApi::parse_historical_data, json parser error: " << std::string(e.what()) << std::endl;
                 std::cerr << "response " << response << std::endl;
                 return JSON_PARSER_ERROR;
             }
             catch(...) {
-                std::cerr << "IntradeBarHttpApi::get_historical_data, json parser error" << std::endl;
+                std::cerr << "IntradeBarHttpApi::parse_historical_data, json parser error" << std::endl;
                 std::cerr << "response " << response << std::endl;
                 return JSON_PARSER_ERROR;
             }
@@ -1647,101 +1799,296 @@ namespace intrade_bar {
             return OK;
         }
 
+        /** \brief Получить исторические данные минутного графика
+         *
+         * Диапазон любой длины разбивается на окна, которые сервер отдает одним запросом.
+         * Если последний бар ответа раньше конца окна (ответ мог быть обрезан сервером при любом количестве баров),
+         * оставшаяся часть окна загружается следующим запросом.
+         * Если сервер вернул ошибку, окно делится пополам и половины загружаются отдельно.
+         * Размер окна хранится только на время вызова: он уменьшается после ошибки сервера или обрезанного ответа
+         * и растет вдвое после каждого полного ответа до history_max_bars баров.
+         * Ошибка сети (например, таймаут) окно не делит, после всех попыток запроса возвращается код ошибки.
+         * Короткие диапазоны загружаются одним запросом, как и раньше
+         * \param symbol_index  Индекс символа
+         * \param date_start    Дата начала
+         * \param date_stop     Дата окончания
+         * \param candles       Массив баров (полученные значения)
+         * \param hist_type     Тип цены
+         * \param pricescale    Множитель цены (зависит от количества знаков после запятой, обычно 100000 или 1000
+         * \param attempts      Количество попыток каждого запроса
+         * \param timeout       Время ожидания
+         * \return Код ошибки, 0 если ошибок нет
+         */
+        int get_historical_data(
+                const uint32_t symbol_index,
+                const xtime::timestamp_t date_start,
+                const xtime::timestamp_t date_stop,
+                std::vector<xquotes_common::Candle> &candles,
+                const uint32_t hist_type = FXCM_USE_HIST_QUOTES_BID_ASK_DIV2,
+                const uint32_t pricescale = 100000,
+                const uint32_t attempts = 5,
+                const uint32_t timeout = 10) {
+            if(date_stop < date_start) return INVALID_ARGUMENT;
+            const xtime::timestamp_t max_window = (xtime::timestamp_t)(history_max_bars - 1) * xtime::SECONDS_IN_MINUTE;
+            /* окна обрабатываются по порядку: стек содержит окна в обратном порядке */
+            std::vector<std::pair<xtime::timestamp_t, xtime::timestamp_t>> windows;
+            if((date_stop - date_start) <= max_window) {
+                const int err = request_historical_data(symbol_index, date_start, date_stop, candles, hist_type, pricescale, attempts, timeout);
+                if(err != OK || candles.empty()) return err;
+                /* сервер мог обрезать ответ по своему лимиту, он может быть меньше history_max_bars */
+                const xtime::timestamp_t last_timestamp = candles.back().timestamp;
+                if(last_timestamp < date_start || last_timestamp >= date_stop) return OK;
+                windows.push_back(std::make_pair(last_timestamp + xtime::SECONDS_IN_MINUTE, date_stop));
+            } else {
+                candles.clear();
+                windows.push_back(std::make_pair(date_start, date_stop));
+            }
+            xtime::timestamp_t window_size = max_window;
+            std::vector<xquotes_common::Candle> window_candles;
+            while(!windows.empty()) {
+                if(is_request_future_shutdown) return DATA_NOT_AVAILABLE;
+                std::pair<xtime::timestamp_t, xtime::timestamp_t> window = windows.back();
+                windows.pop_back();
+
+                /* окно больше допустимого делим на части */
+                if((window.second - window.first) > window_size) {
+                    const xtime::timestamp_t first_stop = window.first + window_size;
+                    windows.push_back(std::make_pair(first_stop + xtime::SECONDS_IN_MINUTE, window.second));
+                    windows.push_back(std::make_pair(window.first, first_stop));
+                    continue;
+                }
+
+                window_candles.clear();
+                const int err = request_historical_data(
+                    symbol_index,
+                    window.first,
+                    window.second,
+                    window_candles,
+                    hist_type,
+                    pricescale,
+                    attempts,
+                    timeout);
+                if(err == OK) {
+                    candles.insert(candles.end(), window_candles.begin(), window_candles.end());
+                    /* последний бар раньше конца окна: ответ мог быть обрезан, догружаем остаток.
+                     * Количество баров не проверяем, лимит сервера может отличаться от history_max_bars,
+                     * а остаток без данных просто вернет DATA_NOT_AVAILABLE
+                     */
+                    const xtime::timestamp_t last_timestamp = window_candles.back().timestamp;
+                    if(last_timestamp >= window.first && last_timestamp < window.second) {
+                        windows.push_back(std::make_pair(last_timestamp + xtime::SECONDS_IN_MINUTE, window.second));
+                        /* следующие окна не больше того, что сервер отдал */
+                        window_size = std::min(window_size, std::max(
+                            (xtime::timestamp_t)xtime::SECONDS_IN_HOUR,
+                            last_timestamp - window.first));
+                    } else {
+                        window_size = std::min(max_window, window_size * 2);
+                    }
+                    continue;
+                }
+                /* нет данных (выходные), это не ошибка */
+                if(err == DATA_NOT_AVAILABLE) continue;
+                /* при защите от DDoS деление окна только увеличит число запросов */
+                if(err == DDOS_GUARD_DETECTED) return err;
+                /* ошибка сети не зависит от размера окна, все попытки запроса уже сделаны */
+                if(err > 0 && err != CURLE_HTTP_RETURNED_ERROR) return err;
+                if((window.second - window.first) < 2 * xtime::SECONDS_IN_MINUTE) return err;
+
+                /* делим окно пополам и уменьшаем окно для следующих запросов этого вызова */
+                const xtime::timestamp_t middle = xtime::get_first_timestamp_minute(window.first + (window.second - window.first) / 2);
+                windows.push_back(std::make_pair(middle + xtime::SECONDS_IN_MINUTE, window.second));
+                windows.push_back(std::make_pair(window.first, middle));
+                window_size = std::max((xtime::timestamp_t)xtime::SECONDS_IN_HOUR, window_size / 2);
+            }
+            if(candles.size() == 0) return DATA_NOT_AVAILABLE;
+            return OK;
+        }
+
+        /** \brief Разложить бары по дням
+         *
+         * Массивы дней подходят для QuotesHistory::write_candles
+         * \param candles Массив баров
+         * \param days Бары внутри дня по метке времени начала дня
+         */
+        static void group_candles_by_day(
+                const std::vector<xquotes_common::Candle> &candles,
+                std::map<xtime::timestamp_t, std::array<xquotes_common::Candle, xtime::MINUTES_IN_DAY>> &days) {
+            for(size_t i = 0; i < candles.size(); ++i) {
+                const xtime::timestamp_t day = xtime::get_first_timestamp_day(candles[i].timestamp);
+                days[day][xtime::get_minute_day(candles[i].timestamp)] = candles[i];
+            }
+        }
+
+        /** \brief Получить максимальное количество баров в одном ответе сервера
+         */
+        inline uint32_t get_history_max_bars() {
+            return history_max_bars;
+        }
+
+        /** \brief Установить ограничения запроса исторических данных
+         * \param max_bars Максимальное количество баров, которое сервер отдает за один запрос
+         */
+        inline void set_history_max_bars(const uint32_t max_bars) {
+            history_max_bars = std::max(2U, max_bars);
+        }
+
         /** \brief Поиск начальной даты котировок
          *
-         * Данный метод производит бинарный поиск начальной даты
-         * исторических данных котировок символа
+         * Поиск идет по неделям: каждая проба проверяет наличие данных со вторника по четверг,
+         * поэтому выходные и одиночные праздники не дают ложного ответа "данных нет".
+         * За один раунд выполняется max_probes запросов одновременно, и интервал поиска
+         * сужается в (max_probes + 1) раз. Если в start_date_timestamp передана примерная дата,
+         * первый раунд проверяет недели вокруг нее с удваивающимся шагом.
+         * Затем одновременно проверяются дни от четверга предыдущей недели до пятницы найденной
          * \param symbol_index Индекс символа
-         * \param start_date_timestamp Метка времени начала дня
+         * \param start_date_timestamp Метка времени начала дня. На входе - примерная дата или 0
          * \param f лямбда-функция для обратного вызова
+         * \param max_probes Количество одновременных запросов
          * \return код ошибки
          */
         int search_start_date_quotes(
                 const uint32_t symbol_index,
                 xtime::timestamp_t &start_date_timestamp,
-                std::function<void(const uint32_t day)> f = nullptr) {
-            const uint32_t all_days = xtime::get_day(xtime::get_timestamp());
-            uint32_t stop_day = all_days; // конечный день поиска
-            uint32_t start_day = 0; // начальный день поиска
-            uint32_t day = all_days/2;
-            uint32_t day_counter = 0;
-
-            std::vector<xquotes_common::Candle> candles;
-            while(true) {
-                bool is_found = false;
-                /* проверяем наличие данных */
-                const int32_t min_day = day >= 10 ? (day - 10) : 0;
-                for(int32_t d = day; d > min_day; --d) {
-                    int err_hist = get_historical_data(
-                            symbol_index,
-                            d*xtime::SECONDS_IN_DAY + xtime::SECONDS_IN_HOUR*11,
-                            d*xtime::SECONDS_IN_DAY + xtime::SECONDS_IN_HOUR*13,
-                            candles,
-                            FXCM_USE_HIST_QUOTES_BID_ASK_DIV2,
-                            100000,
-                            2,
-                            2);
-                    //std::cout << "!symbol: "
-                    //        << intrade_bar_common::currency_pairs[symbol_index]
-                    //        << " start date: "
-                    //        << xtime::get_str_date(d * xtime::SECONDS_IN_DAY)
-                    //        << " err " << err_hist << std::endl;
-                    if(err_hist == intrade_bar_common::OK) {
-                        day = d;
-                        if(f != nullptr) f(day);
-                        is_found = true;
-                        ++day_counter;
-                        break;
-                    }
+                std::function<void(const uint32_t day)> f = nullptr,
+                const uint32_t max_probes = 8) {
+            const uint32_t probes = std::max(1U, max_probes);
+            const uint32_t max_rounds = 64;
+            /* неделя w начинается с понедельника 7*w - 3 дня от начала эпохи */
+            auto get_monday = [](const int64_t week) -> int64_t {
+                return 7 * week - 3;
+            };
+
+            /* проверить наличие данных в интервале, 1 - есть, 0 - нет, -1 - ошибка запроса */
+            auto probe = [&](const xtime::timestamp_t date_start, const xtime::timestamp_t date_stop) -> int {
+                std::vector<xquotes_common::Candle> candles;
+                for(uint32_t a = 0; a < 2; ++a) {
+                    const int err = request_historical_data(
+                        symbol_index,
+                        date_start,
+                        date_stop,
+                        candles,
+                        FXCM_USE_HIST_QUOTES_BID_ASK_DIV2,
+                        pricescale_currency_pairs[symbol_index],
+                        1,
+                        5);
+                    if(err == OK) return 1;
+                    if(err == DATA_NOT_AVAILABLE) return 0;
+                    if(is_request_future_shutdown) break;
+                }
+                return -1;
+            };
+
+            /* выполнить пробы одновременно */
+            auto run_probes = [&](
+                    const std::vector<std::pair<xtime::timestamp_t, xtime::timestamp_t>> &intervals,
+                    std::vector<int> &results) {
+                std::vector<std::future<int>> futures;
+                for(size_t i = 0; i < intervals.size(); ++i) {
+                    futures.push_back(std::async(std::launch::async, [&, i]() {
+                        return probe(intervals[i].first, intervals[i].second);
+                    }));
+                }
+                results.resize(intervals.size());
+                for(size_t i = 0; i < futures.size(); ++i) {
+                    results[i] = futures[i].get();
                 }
+            };
+
+            const int64_t current_day = xtime::get_day(xtime::get_timestamp());
+            const int64_t last_week = (current_day + 3) / 7 - 1;  // последняя полная неделя
+            if(last_week < 1) return DATA_NOT_AVAILABLE;
+
+            /* известные результаты проб по неделям */
+            std::map<int64_t, bool> known;
+            int64_t low = 0;            // неделя без данных (начало эпохи)
+            int64_t high = last_week;   // неделя с данными (проверяется в первом раунде)
+
+            std::vector<int64_t> weeks;
+            weeks.push_back(last_week);
+            if(start_date_timestamp != 0) {
+                const int64_t hint_week = ((int64_t)xtime::get_day(start_date_timestamp) + 3) / 7;
+                for(int64_t step = 1; weeks.size() < probes && step < last_week; step *= 4) {
+                    if((hint_week - step) > low && (hint_week - step) < high) weeks.push_back(hint_week - step);
+                    if(weeks.size() >= probes) break;
+                    if((hint_week + step - 1) > low && (hint_week + step - 1) < high) weeks.push_back(hint_week + step - 1);
+                }
+            }
 
-                if(!is_found) {
-                    const uint32_t max_day = (day + 10) <= all_days ?
-                        (day + 10) : all_days;
-                    for(uint32_t d = day; d < max_day; ++d) {
-                        int err_hist = get_historical_data(
-                                symbol_index,
-                                d*xtime::SECONDS_IN_DAY + xtime::SECONDS_IN_HOUR*11,
-                                d*xtime::SECONDS_IN_DAY + xtime::SECONDS_IN_HOUR*13,
-                                candles,
-                                FXCM_USE_HIST_QUOTES_BID_ASK_DIV2,
-                                100000,
-                                2,
-                                2);
-                        //std::cout << "!!symbol: "
-                        //    << intrade_bar_common::currency_pairs[symbol_index]
-                        //    << " start date: "
-                        //    << xtime::get_str_date(d * xtime::SECONDS_IN_DAY)
-                        //    << " err " << err_hist << std::endl;
-                        if(err_hist == intrade_bar_common::OK) {
-                            day = d;
-                            if(f != nullptr) f(day);
-                            is_found = true;
-                            ++day_counter;
-                            break;
-                        }
+            for(uint32_t round = 0; round < max_rounds; ++round) {
+                std::sort(weeks.begin(), weeks.end());
+                weeks.erase(std::unique(weeks.begin(), weeks.end()), weeks.end());
+                std::vector<std::pair<xtime::timestamp_t, xtime::timestamp_t>> intervals;
+                for(size_t i = 0; i < weeks.size(); ++i) {
+                    const xtime::timestamp_t tuesday = (get_monday(weeks[i]) + 1) * xtime::SECONDS_IN_DAY;
+                    intervals.push_back(std::make_pair(
+                        tuesday + 12 * xtime::SECONDS_IN_HOUR,
+                        tuesday + 2 * xtime::SECONDS_IN_DAY + 12 * xtime::SECONDS_IN_HOUR - xtime::SECONDS_IN_MINUTE));
+                }
+                std::vector<int> results;
+                run_probes(intervals, results);
+                if(is_request_future_shutdown) return DATA_NOT_AVAILABLE;
+                for(size_t i = 0; i < weeks.size(); ++i) {
+                    if(results[i] >= 0) known[weeks[i]] = results[i] == 1;
+                }
+                if(known.find(last_week) == known.end()) continue;
+                if(!known[last_week]) return DATA_NOT_AVAILABLE;
+
+                /* самая ранняя неделя с данными и ближайшая к ней неделя без данных */
+                high = last_week;
+                for(auto &item : known) {
+                    if(item.second) {
+                        high = item.first;
+                        break;
                     }
                 }
-
-                if(!is_found) {
-                    if(start_day == day) {
-                        start_date_timestamp = xtime::SECONDS_IN_DAY * day;
-                        if(day_counter > 0) return intrade_bar_common::OK;
-                        return intrade_bar_common::DATA_NOT_AVAILABLE;
+                low = 0;
+                for(auto &item : known) {
+                    if(item.first >= high) break;
+                    if(!item.second) low = item.first;
+                }
+                if(f != nullptr) f(get_monday(high));
+                if((high - low) <= 1) break;
+
+                /* равномерно делим интервал между low и high */
+                weeks.clear();
+                for(uint32_t k = 1; k <= probes; ++k) {
+                    const int64_t week = low + ((high - low) * k) / (probes + 1);
+                    if(week > low && week < high) weeks.push_back(week);
+                }
+                if(weeks.empty()) weeks.push_back(low + 1);
+            }
+            if((high - low) > 1) return DATA_NOT_AVAILABLE;
+
+            /* уточняем день: данные могут начаться с четверга предыдущей недели
+             * (после пробного интервала) до пятницы найденной недели
+             */
+            const int64_t first_day = std::max((int64_t)0, get_monday(high) - 4);
+            const int64_t last_day = get_monday(high) + 4;
+            for(uint32_t round = 0; round < max_rounds; ++round) {
+                std::vector<std::pair<xtime::timestamp_t, xtime::timestamp_t>> intervals;
+                for(int64_t day = first_day; day <= last_day; ++day) {
+                    intervals.push_back(std::make_pair(
+                        day * xtime::SECONDS_IN_DAY,
+                        (day + 1) * xtime::SECONDS_IN_DAY - xtime::SECONDS_IN_MINUTE));
+                }
+                std::vector<int> results;
+                run_probes(intervals, results);
+                if(is_request_future_shutdown) return DATA_NOT_AVAILABLE;
+                bool is_error = false;
+                for(size_t i = 0; i < results.size(); ++i) {
+                    if(results[i] < 0) {
+                        is_error = true;
+                        break;
                     }
-                    start_day = day;
-                } else {
-                    if(stop_day == day) {
-                        start_date_timestamp = xtime::SECONDS_IN_DAY * day;
-                        if(day_counter > 0) return intrade_bar_common::OK;
-                        return intrade_bar_common::DATA_NOT_AVAILABLE;
+                    if(results[i] == 1) {
+                        start_date_timestamp = (first_day + i) * xtime::SECONDS_IN_DAY;
+                        if(f != nullptr) f(first_day + i);
+                        return OK;
                     }
-                    stop_day = day;
                 }
-                day = (start_day + stop_day) / 2;
-                if(f != nullptr) f(day);
+                if(!is_error) break;
             }
-            return intrade_bar_common::DATA_NOT_AVAILABLE;
+            return DATA_NOT_AVAILABLE;
         }
 
         /** \brief Получить тиковые данные
@@ -1762,6 +2109,13 @@ namespace intrade_bar {
             const xtime::timestamp_t date_time_end = date_time + offset_time;
             xtime::DateTime iDateTime(date_time + GMT_OFFSET);
             xtime::DateTime iDateTimeEnd(date_time_end + GMT_OFFSET);
+            /* запрос задается одной датой, поэтому конец ровно в полночь следующих суток сервера
+             * передается как 24:00, иначе последняя минута суток не попадет в ответ
+             */
+            const bool is_end_of_day =
+                date_time_end > date_time &&
+                xtime::get_first_timestamp_day(date_time_end + GMT_OFFSET) == (date_time_end + GMT_OFFSET) &&
+                (date_time_end - date_time) <= xtime::SECONDS_IN_DAY;
             const std::string url_quotes = "https://"+ point + "/quotes";
             const std::string body_quotes =
                 "option=" + currency_pairs[symbol_ind] +
@@ -1770,7 +2124,7 @@ namespace intrade_bar {
                 "-" + std::to_string(iDateTime.day) +
                 "&time1=" + std::to_string(iDateTime.hour) +
                 ":" + std::to_string(iDateTime.minute) +
-                "&time2=" + std::to_string(iDateTimeEnd.hour) +
+                "&time2=" + (is_end_of_day ? std::string("24") : std::to_string(iDateTimeEnd.hour)) +
                 ":" + std::to_string(iDateTimeEnd.minute) +
                 "&name_method=data_tick_load";
             std::string response_quotes;
@@ -2100,6 +2454,7 @@ namespace intrade_bar {
             point = user_point;
             sert_file = user_sert_file;
             cookie_file = user_cookie_file;
+            init_bets_log_events();
             init_profile_state();
             init_all_http_headers();
         };
@@ -2135,6 +2490,7 @@ namespace intrade_bar {
                     << "intrade.bar api: json error in IntradeBarHttpApi"
                     << std::endl;
             }
+            init_bets_log_events();
             init_profile_state();
             init_all_http_headers();
             connect(j);
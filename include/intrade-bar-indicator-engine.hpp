@@ -0,0 +1,506 @@
+/*
+* intrade-bar-api-cpp - C ++ API client for intrade.bar
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef INTRADE_BAR_INDICATOR_ENGINE_HPP_INCLUDED
+#define INTRADE_BAR_INDICATOR_ENGINE_HPP_INCLUDED
+
+#include <intrade-bar-common.hpp>
+#include <intrade-bar-price-kernels.hpp>
+#include <xquotes_common.hpp>
+#include <atomic>
+#include <array>
+#include <map>
+#include <tuple>
+#include <limits>
+#include <cmath>
+#include <cstring>
+
+namespace intrade_bar {
+
+    /** \brief Индикаторы для IndicatorEngine
+     *
+     * Состояние индикатора хранится по колонкам: каждая величина - массив из LANES значений,
+     * по одному на символ. Все символы обновляются одним циклом по массиву, который компилятор
+     * превращает в SIMD инструкции. Индикатор не хранит копий баров, кроме окна своего периода.
+     */
+    namespace indicators {
+
+        const uint32_t LANES = 32;  /**< Число дорожек: CURRENCY_PAIRS, округленное до кратного 4 (AVX2) */
+        static_assert(LANES >= intrade_bar_common::CURRENCY_PAIRS, "LANES must cover all symbols");
+
+        /// Значения всех символов
+        struct alignas(32) LaneArray {
+            double v[LANES];
+        };
+
+        /** \brief Данные обновления, общие для всех индикаторов
+         */
+        class LaneInput {
+        public:
+            LaneArray price;    /**< Цена закрытия бара, у символов без тика - последняя известная цена */
+            LaneArray bars;     /**< Количество баров с данными с учетом текущего */
+            LaneArray first;    /**< Маска: 1, если у символа еще нет закрытых баров, иначе 0 */
+        };
+
+        inline void fill_lanes(LaneArray &lanes, const double value) {
+            for(uint32_t l = 0; l < LANES; ++l) lanes.v[l] = value;
+        }
+
+        /* Циклы по дорожкам записаны без ветвлений: условия дают маску 0 или 1, а значения
+         * смешиваются умножением. Тернарный оператор над вычисленными значениями компилятор
+         * не векторизует, пока действует -ftrapping-math (по умолчанию)
+         */
+
+        /** \brief Маска условия: 1.0 или 0.0
+         */
+        inline double mask(const bool condition) {
+            return condition ? 1.0 : 0.0;
+        }
+
+        /** \brief Выбрать a при маске 1 или b при маске 0 без потери точности
+         */
+        inline double blend(const double m, const double a, const double b) {
+            return m * a + (1.0 - m) * b;
+        }
+
+        /** \brief Добавка, которая превращает значение в NaN, пока индикатор не готов
+         */
+        inline double ready(const bool is_ready) {
+            return is_ready ? 0.0 : std::numeric_limits<double>::quiet_NaN();
+        }
+
+        /** \brief max(x, 0) без ветвления
+         */
+        inline double positive(const double x) {
+            return 0.5 * (x + std::fabs(x));
+        }
+
+        /** \brief Простая скользящая средняя
+         */
+        template<uint32_t PERIOD>
+        class Sma {
+        public:
+            static_assert(PERIOD > 0, "PERIOD must be greater than zero");
+            static const uint32_t OUTPUTS = 1;
+
+        private:
+            LaneArray window[PERIOD];   /**< Окно закрытых баров */
+            LaneArray sum;
+            uint32_t pos = 0;
+
+        public:
+            Sma() {
+                for(uint32_t i = 0; i < PERIOD; ++i) fill_lanes(window[i], 0);
+                fill_lanes(sum, 0);
+            }
+
+            /** \brief Обновить индикатор
+             * \param input Цены и количество баров
+             * \param is_closed Бар закрыт. Для формирующегося бара состояние не меняется
+             * \param output Значения индикатора, NaN пока окно не заполнено
+             */
+            inline void update(const LaneInput &input, const bool is_closed, LaneArray *output) {
+                const LaneArray &oldest = window[pos];
+                for(uint32_t l = 0; l < LANES; ++l) {
+                    const double value = sum.v[l] - oldest.v[l] + input.price.v[l];
+                    output[0].v[l] = value / (double)PERIOD + ready(input.bars.v[l] >= PERIOD);
+                }
+                if(!is_closed) return;
+                for(uint32_t l = 0; l < LANES; ++l) {
+                    sum.v[l] += input.price.v[l] - window[pos].v[l];
+                    window[pos].v[l] = input.price.v[l];
+                }
+                pos = (pos + 1) % PERIOD;
+                /* раз в период сумма пересчитывается, чтобы не накапливалась ошибка округления */
+                if(pos == 0) {
+                    fill_lanes(sum, 0);
+                    for(uint32_t i = 0; i < PERIOD; ++i) {
+                        for(uint32_t l = 0; l < LANES; ++l) sum.v[l] += window[i].v[l];
+                    }
+                }
+            }
+        };
+
+        /** \brief Экспоненциальная скользящая средняя
+         */
+        template<uint32_t PERIOD>
+        class Ema {
+        public:
+            static_assert(PERIOD > 0, "PERIOD must be greater than zero");
+            static const uint32_t OUTPUTS = 1;
+
+        private:
+            LaneArray ema;
+
+        public:
+            Ema() {
+                fill_lanes(ema, 0);
+            }
+
+            inline void update(const LaneInput &input, const bool is_closed, LaneArray *output) {
+                const double alpha = 2.0 / (double)(PERIOD + 1);
+                LaneArray value;
+                for(uint32_t l = 0; l < LANES; ++l) {
+                    const double next = ema.v[l] + alpha * (input.price.v[l] - ema.v[l]);
+                    /* первый бар символа задает начальное значение */
+                    value.v[l] = blend(input.first.v[l], input.price.v[l], next);
+                    output[0].v[l] = value.v[l] + ready(input.bars.v[l] >= PERIOD);
+                }
+                if(is_closed) ema = value;
+            }
+        };
+
+        /** \brief Индекс относительной силы (сглаживание Уайлдера)
+         *
+         * Первые PERIOD изменений цены усредняются простым средним
+         */
+        template<uint32_t PERIOD>
+        class Rsi {
+        public:
+            static_assert(PERIOD > 0, "PERIOD must be greater than zero");
+            static const uint32_t OUTPUTS = 1;
+
+        private:
+            LaneArray avg_gain;
+            LaneArray avg_loss;
+            LaneArray prev_price;
+
+        public:
+            Rsi() {
+                fill_lanes(avg_gain, 0);
+                fill_lanes(avg_loss, 0);
+                fill_lanes(prev_price, 0);
+            }
+
+            inline void update(const LaneInput &input, const bool is_closed, LaneArray *output) {
+                LaneArray g, s;
+                for(uint32_t l = 0; l < LANES; ++l) {
+                    const double n = input.bars.v[l];
+                    const double next = 1.0 - input.first.v[l];
+                    const double change = next * (input.price.v[l] - prev_price.v[l]);
+                    const double gain = positive(change);
+                    const double loss = positive(-change);
+                    /* делитель min(n - 1, PERIOD), но не меньше 1 */
+                    double divider = n - 1.0;
+                    divider -= positive(divider - (double)PERIOD);
+                    divider += positive(1.0 - divider);
+                    g.v[l] = next * (avg_gain.v[l] + (gain - avg_gain.v[l]) / divider);
+                    s.v[l] = next * (avg_loss.v[l] + (loss - avg_loss.v[l]) / divider);
+                    const double total = g.v[l] + s.v[l];
+                    const double is_flat = mask(total == 0);
+                    const double value = blend(is_flat, 50.0, 100.0 * g.v[l] / (total + is_flat));
+                    output[0].v[l] = value + ready(n > PERIOD);
+                }
+                if(!is_closed) return;
+                avg_gain = g;
+                avg_loss = s;
+                prev_price = input.price;
+            }
+        };
+
+        /** \brief Полосы Боллинджера
+         *
+         * Выходы: средняя линия, верхняя и нижняя полосы.
+         * Суммы считаются по ценам, смещенным на первую цену символа, чтобы дисперсия не терялась в округлении
+         * \tparam PERIOD Период
+         * \tparam DEVIATION_X10 Ширина полос в стандартных отклонениях, умноженная на 10
+         */
+        template<uint32_t PERIOD, uint32_t DEVIATION_X10 = 20>
+        class Bollinger {
+        public:
+            static_assert(PERIOD > 0, "PERIOD must be greater than zero");
+            static const uint32_t OUTPUTS = 3;
+
+        private:
+            LaneArray window[PERIOD];   /**< Окно смещенных цен закрытых баров */
+            LaneArray sum;
+            LaneArray sum_sq;
+            LaneArray shift;
+            uint32_t pos = 0;
+
+        public:
+            Bollinger() {
+                for(uint32_t i = 0; i < PERIOD; ++i) fill_lanes(window[i], 0);
+                fill_lanes(sum, 0);
+                fill_lanes(sum_sq, 0);
+                fill_lanes(shift, 0);
+            }
+
+            inline void update(const LaneInput &input, const bool is_closed, LaneArray *output) {
+                const double deviation = (double)DEVIATION_X10 / 10.0;
+                const LaneArray &oldest = window[pos];
+                LaneArray mean, sd;
+                for(uint32_t l = 0; l < LANES; ++l) {
+                    /* до первого закрытого бара окно пустое, смещение берется из текущей цены */
+                    shift.v[l] = blend(input.first.v[l], input.price.v[l], shift.v[l]);
+                    const double y = input.price.v[l] - shift.v[l];
+                    mean.v[l] = (sum.v[l] - oldest.v[l] + y) / (double)PERIOD;
+                    const double mean_sq = (sum_sq.v[l] - oldest.v[l] * oldest.v[l] + y * y) / (double)PERIOD;
+                    const double variance = mean_sq - mean.v[l] * mean.v[l];
+                    sd.v[l] = positive(variance);
+                }
+                /* sqrt с проверкой errno не векторизуется, поэтому вынесен в отдельный цикл */
+                for(uint32_t l = 0; l < LANES; ++l) {
+                    sd.v[l] = std::sqrt(sd.v[l]);
+                }
+                for(uint32_t l = 0; l < LANES; ++l) {
+                    const double is_ready = ready(input.bars.v[l] >= PERIOD);
+                    output[0].v[l] = shift.v[l] + mean.v[l] + is_ready;
+                    output[1].v[l] = shift.v[l] + mean.v[l] + deviation * sd.v[l] + is_ready;
+                    output[2].v[l] = shift.v[l] + mean.v[l] - deviation * sd.v[l] + is_ready;
+                }
+                if(!is_closed) return;
+                for(uint32_t l = 0; l < LANES; ++l) {
+                    const double y = input.price.v[l] - shift.v[l];
+                    const double old = window[pos].v[l];
+                    sum.v[l] += y - old;
+                    sum_sq.v[l] += y * y - old * old;
+                    window[pos].v[l] = y;
+                }
+                pos = (pos + 1) % PERIOD;
+                if(pos == 0) {
+                    fill_lanes(sum, 0);
+                    fill_lanes(sum_sq, 0);
+                    for(uint32_t i = 0; i < PERIOD; ++i) {
+                        for(uint32_t l = 0; l < LANES; ++l) {
+                            sum.v[l] += window[i].v[l];
+                            sum_sq.v[l] += window[i].v[l] * window[i].v[l];
+                        }
+                    }
+                }
+            }
+        };
+
+        /* вспомогательные шаблоны для списка индикаторов (C++11) */
+        template<class... INDICATORS>
+        struct OutputCount;
+
+        template<>
+        struct OutputCount<> {
+            static const uint32_t value = 0;
+        };
+
+        template<class FIRST, class... REST>
+        struct OutputCount<FIRST, REST...> {
+            static const uint32_t value = FIRST::OUTPUTS + OutputCount<REST...>::value;
+        };
+
+        template<size_t INDEX, class... INDICATORS>
+        struct OutputOffset;
+
+        template<class FIRST, class... REST>
+        struct OutputOffset<0, FIRST, REST...> {
+            static const uint32_t value = 0;
+        };
+
+        template<size_t INDEX, class FIRST, class... REST>
+        struct OutputOffset<INDEX, FIRST, REST...> {
+            static const uint32_t value = FIRST::OUTPUTS + OutputOffset<INDEX - 1, REST...>::value;
+        };
+
+        template<size_t INDEX, size_t SIZE>
+        struct UpdateAll {
+            template<class TUPLE>
+            static inline void update(TUPLE &items, const LaneInput &input, const bool is_closed, LaneArray *output) {
+                typedef typename std::tuple_element<INDEX, TUPLE>::type Indicator;
+                std::get<INDEX>(items).update(input, is_closed, output);
+                UpdateAll<INDEX + 1, SIZE>::update(items, input, is_closed, output + Indicator::OUTPUTS);
+            }
+        };
+
+        template<size_t SIZE>
+        struct UpdateAll<SIZE, SIZE> {
+            template<class TUPLE>
+            static inline void update(TUPLE &, const LaneInput &, const bool, LaneArray *) {}
+        };
+    }
+
+    /** \brief Движок индикаторов для всех символов
+     *
+     * Набор индикаторов задается при компиляции, например
+     * IndicatorEngine<indicators::Sma<20>, indicators::Ema<50>, indicators::Rsi<14>, indicators::Bollinger<20>>.
+     * Метод update вызывается одним потоком на каждый закрытый бар (is_closed = true)
+     * и, при необходимости, на каждое обновление формирующегося бара (is_closed = false).
+     * Чтение отдельного значения через get не блокируется и не ждет писателя.
+     * Согласованный снимок всех значений (get_snapshot) повторяет чтение, если оно совпало с обновлением.
+     */
+    template<class... INDICATORS>
+    class IndicatorEngine {
+    public:
+        static const uint32_t OUTPUTS = indicators::OutputCount<INDICATORS...>::value;
+        static_assert(OUTPUTS > 0, "IndicatorEngine needs at least one indicator");
+        using LaneArray = indicators::LaneArray;
+
+        /// Снимок значений всех индикаторов
+        class Snapshot {
+        public:
+            std::array<LaneArray, OUTPUTS> values;
+            uint64_t sequence = 0;      /**< Номер обновления */
+        };
+
+    private:
+        std::tuple<INDICATORS...> items;
+        indicators::LaneInput input;
+        LaneArray last_price;           /**< Последняя цена символа */
+        LaneArray closed_bars;          /**< Количество закрытых баров с данными */
+        std::array<LaneArray, OUTPUTS> values;
+
+        std::array<std::array<std::atomic<double>, indicators::LANES>, OUTPUTS> published;
+        std::atomic<uint64_t> sequence;
+        const intrade_bar_common::price_kernels::InstructionSet instruction_set;
+
+        inline void calculate(const bool is_closed) {
+            indicators::UpdateAll<0, sizeof...(INDICATORS)>::update(items, input, is_closed, values.data());
+        }
+
+#       ifdef INTRADE_BAR_PRICE_KERNELS_X86
+        /* тело всех индикаторов встраивается и векторизуется под AVX2 */
+        __attribute__((target("avx2"), flatten))
+        void calculate_avx2(const bool is_closed) {
+            calculate(is_closed);
+        }
+
+        __attribute__((flatten))
+        void calculate_default(const bool is_closed) {
+            calculate(is_closed);
+        }
+#       else
+        void calculate_default(const bool is_closed) {
+            calculate(is_closed);
+        }
+#       endif
+
+        void publish() {
+            sequence.fetch_add(1, std::memory_order_acq_rel);
+            for(uint32_t o = 0; o < OUTPUTS; ++o) {
+                for(uint32_t l = 0; l < intrade_bar_common::CURRENCY_PAIRS; ++l) {
+                    published[o][l].store(values[o].v[l], std::memory_order_relaxed);
+                }
+            }
+            sequence.fetch_add(1, std::memory_order_release);
+        }
+
+    public:
+
+        IndicatorEngine() :
+                sequence(0),
+                instruction_set(intrade_bar_common::price_kernels::get_instruction_set()) {
+            indicators::fill_lanes(last_price, 0);
+            indicators::fill_lanes(closed_bars, 0);
+            const double nan = std::numeric_limits<double>::quiet_NaN();
+            for(uint32_t o = 0; o < OUTPUTS; ++o) {
+                indicators::fill_lanes(values[o], nan);
+                for(uint32_t l = 0; l < indicators::LANES; ++l) {
+                    published[o][l].store(nan, std::memory_order_relaxed);
+                }
+            }
+        }
+
+        IndicatorEngine(const IndicatorEngine&) = delete;
+        IndicatorEngine &operator=(const IndicatorEngine&) = delete;
+
+        /** \brief Обновить индикаторы всех символов
+         * \param prices Цены закрытия по индексам символов. Ноль означает, что у символа нет нового бара
+         * \param is_closed Бар закрыт. Обновления формирующегося бара не меняют состояние индикаторов
+         */
+        void update(const std::array<double, intrade_bar_common::CURRENCY_PAIRS> &prices, const bool is_closed) {
+            for(uint32_t l = 0; l < intrade_bar_common::CURRENCY_PAIRS; ++l) {
+                const double price = prices[l] != 0 ? prices[l] : last_price.v[l];
+                input.price.v[l] = price;
+                input.bars.v[l] = price != 0 ? closed_bars.v[l] + 1.0 : 0.0;
+                input.first.v[l] = input.bars.v[l] <= 1.0 ? 1.0 : 0.0;
+                if(is_closed) {
+                    last_price.v[l] = price;
+                    closed_bars.v[l] = input.bars.v[l];
+                }
+            }
+            for(uint32_t l = intrade_bar_common::CURRENCY_PAIRS; l < indicators::LANES; ++l) {
+                input.price.v[l] = 0;
+                input.bars.v[l] = 0;
+                input.first.v[l] = 1.0;
+            }
+#           ifdef INTRADE_BAR_PRICE_KERNELS_X86
+            if(instruction_set == intrade_bar_common::price_kernels::InstructionSet::AVX2) calculate_avx2(is_closed);
+            else calculate_default(is_closed);
+#           else
+            calculate_default(is_closed);
+#           endif
+            publish();
+        }
+
+        /** \brief Обновить индикаторы барами из callback IntradeBarApi
+         * \param candles Бары символов
+         * \param is_closed Бар закрыт (HISTORICAL_DATA_RECEIVED) или формируется (NEW_TICK)
+         */
+        void update(const std::map<std::string, xquotes_common::Candle> &candles, const bool is_closed) {
+            std::array<double, intrade_bar_common::CURRENCY_PAIRS> prices;
+            prices.fill(0);
+            for(auto &item : candles) {
+                auto it = intrade_bar_common::currency_pairs_indx.find(item.first);
+                if(it == intrade_bar_common::currency_pairs_indx.end()) continue;
+                prices[it->second] = item.second.close;
+            }
+            update(prices, is_closed);
+        }
+
+        /** \brief Получить значение индикатора
+         * \tparam INDEX Номер индикатора в списке шаблона
+         * \param symbol_index Номер символа
+         * \param output Номер выхода индикатора (для Bollinger: 0 - средняя, 1 - верхняя, 2 - нижняя)
+         * \return Значение или NaN, если данных еще недостаточно
+         */
+        template<size_t INDEX>
+        inline double get(const uint32_t symbol_index, const uint32_t output = 0) const {
+            const uint32_t offset = indicators::OutputOffset<INDEX, INDICATORS...>::value;
+            return published[offset + output][symbol_index].load(std::memory_order_relaxed);
+        }
+
+        /** \brief Получить согласованный снимок значений всех индикаторов
+         * \param snapshot Снимок, значения выходов индикаторов идут в порядке списка шаблона
+         */
+        void get_snapshot(Snapshot &snapshot) const {
+            while(true) {
+                const uint64_t start = sequence.load(std::memory_order_acquire);
+                if(start & 1) continue;
+                for(uint32_t o = 0; o < OUTPUTS; ++o) {
+                    for(uint32_t l = 0; l < indicators::LANES; ++l) {
+                        snapshot.values[o].v[l] = published[o][l].load(std::memory_order_relaxed);
+                    }
+                }
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if(sequence.load(std::memory_order_relaxed) == start) {
+                    snapshot.sequence = start / 2;
+                    return;
+                }
+            }
+        }
+
+        /** \brief Получить количество обновлений
+         */
+        inline uint64_t get_sequence() const {
+            return sequence.load(std::memory_order_acquire) / 2;
+        }
+    };
+}
+
+#endif // INTRADE_BAR_INDICATOR_ENGINE_HPP_INCLUDED
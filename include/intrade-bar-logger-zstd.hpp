@@ -0,0 +1,108 @@
+/*
+* intrade-bar-api-cpp - C ++ API client for intrade.bar
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef INTRADE_BAR_LOGGER_ZSTD_HPP_INCLUDED
+#define INTRADE_BAR_LOGGER_ZSTD_HPP_INCLUDED
+
+#include <intrade-bar-logger.hpp>
+#include <fstream>
+#include <vector>
+#include "zstd.h"
+
+namespace intrade_bar {
+
+    /** \brief Сжатие сегментов логов при помощи zstd
+     *
+     * Вынесено в отдельный файл, чтобы программы без сжатия логов
+     * не требовали библиотеку zstd. Пример:
+     * intrade_bar::Logger::set_rotation(64 * 1024 * 1024, true, 30);
+     * intrade_bar::LoggerZstd::enable();
+     */
+    class LoggerZstd {
+    public:
+
+        /** \brief Сжать файл
+         * \param file_name Имя исходного файла
+         * \param compressed_file_name Имя сжатого файла
+         * \param level Уровень сжатия
+         * \return Вернет true, если файл сжат
+         */
+        static bool compress_file(
+                const std::string &file_name,
+                const std::string &compressed_file_name,
+                const int level = 3) {
+            std::ifstream input(file_name, std::ios_base::binary);
+            if(!input) return false;
+            std::ofstream output(compressed_file_name, std::ios_base::binary | std::ios_base::trunc);
+            if(!output) return false;
+
+            ZSTD_CCtx *cctx = ZSTD_createCCtx();
+            if(cctx == NULL) return false;
+            ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level);
+            ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, 1);
+
+            std::vector<char> buffer_in(ZSTD_CStreamInSize());
+            std::vector<char> buffer_out(ZSTD_CStreamOutSize());
+            bool is_error = false;
+            bool is_last = false;
+            while(!is_last && !is_error) {
+                input.read(buffer_in.data(), buffer_in.size());
+                const size_t read_size = input.gcount();
+                if(input.bad()) {
+                    is_error = true;
+                    break;
+                }
+                is_last = input.eof();
+                const ZSTD_EndDirective mode = is_last ? ZSTD_e_end : ZSTD_e_continue;
+                ZSTD_inBuffer zstd_input = {buffer_in.data(), read_size, 0};
+                bool is_finished = false;
+                while(!is_finished) {
+                    ZSTD_outBuffer zstd_output = {buffer_out.data(), buffer_out.size(), 0};
+                    const size_t remaining = ZSTD_compressStream2(cctx, &zstd_output, &zstd_input, mode);
+                    if(ZSTD_isError(remaining)) {
+                        is_error = true;
+                        break;
+                    }
+                    output.write(buffer_out.data(), zstd_output.pos);
+                    is_finished = is_last ? (remaining == 0) : (zstd_input.pos == zstd_input.size);
+                }
+            }
+            ZSTD_freeCCtx(cctx);
+            output.close();
+            return !is_error && !output.fail();
+        }
+
+        /** \brief Включить сжатие закрытых сегментов логов
+         * \param level Уровень сжатия
+         */
+        static void enable(const int level = 3) {
+            Logger::set_compressor([level](
+                    const std::string &file_name,
+                    const std::string &compressed_file_name) -> bool {
+                return compress_file(file_name, compressed_file_name, level);
+            });
+        }
+    };
+}
+
+#endif // INTRADE_BAR_LOGGER_ZSTD_HPP_INCLUDED
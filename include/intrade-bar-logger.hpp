@@ -6,37 +6,258 @@
 #include <sstream>
 #include <map>
 #include <queue>
+#include <deque>
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
 #include <mutex>
+#include <condition_variable>
 #include <atomic>
 #include <thread>
 #include <future>
+#include <chrono>
 #include <csignal>
+#include <cstdio>
+#include <cctype>
 #include <dir.h>
+#include <dirent.h>
+#include <sys/stat.h>
 #include <nlohmann/json.hpp>
 #include <xtime.hpp>
 #include <intrade-bar-common.hpp>
+#include "utf8.h"
 
 namespace intrade_bar {
+
+    /// Уровни важности сообщений логера
+    enum LogSeverity {
+        LOG_LEVEL_DEBUG = 0,    ///< Отладочное сообщение
+        LOG_LEVEL_INFO = 1,     ///< Информационное сообщение
+        LOG_LEVEL_WARNING = 2,  ///< Предупреждение
+        LOG_LEVEL_ERROR = 3,    ///< Ошибка
+        LOG_LEVEL_CRITICAL = 4, ///< Критическая ошибка
+    };
+
     /** \brief Класс логера
+     *
+     * Все файлы обслуживает один фоновый поток. Поток спит на условной переменной,
+     * пока нет сообщений, забирает сообщения пачками и записывает их в файл
+     * одной операцией (групповая запись). Сообщения с важностью не ниже
+     * уровня сброса записываются на диск сразу после обработки пачки.
+     *
+     * Для горячих путей есть события (log_event): каждый поток пишет компактную
+     * двоичную запись в свой кольцевой буфер без блокировок и выделения памяти,
+     * а преобразование в JSON делает фоновый поток.
+     *
+     * Файлы могут разбиваться на сегменты по размеру или по суткам UTC (set_rotation).
+     * Закрытые сегменты сжимает и удаляет отдельный поток, поэтому поток записи
+     * никогда не ждет сжатия.
      */
     class Logger {
     private:
         using json = nlohmann::json;
         static inline std::atomic<double> offset_ftimestamp = ATOMIC_VAR_INIT(0.0);
-        /** \brief
+
+        static const size_t WRITE_BUFFER_SIZE = 64 * 1024;  /**< Размер буфера записи, после которого буфер записывается в файл */
+        static const uint32_t GROUP_COMMIT_DELAY = 100;     /**< Максимальное время хранения сообщений в буфере записи, мс */
+
+        static const uint32_t EVENT_BUFFER_SIZE = 256 * 1024;   /**< Размер кольцевого буфера событий одного потока */
+        static const uint32_t EVENT_MAX_ARGS = 15;              /**< Максимальное количество аргументов события */
+        static const uint32_t EVENT_MAX_STRING = 16 * 1024;     /**< Строки длиннее будут обрезаны */
+        static const uint16_t EVENT_PADDING = 0xFFFF;           /**< Запись-заполнитель в конце кольцевого буфера */
+        static const uint16_t EVENT_MAX_EVENTS = 1024;          /**< Максимальное количество зарегистрированных событий */
+
+        /// Типы аргументов событий
+        enum EventArgType {
+            EVENT_ARG_INT = 1,
+            EVENT_ARG_DOUBLE = 2,
+            EVENT_ARG_STRING = 3,
+        };
+
+        /** \brief Заголовок двоичной записи события
+         */
+        class EventHeader {
+        public:
+            uint32_t size = 0;                  /**< Размер записи вместе с заголовком, кратен 8 */
+            uint16_t event_id = 0;
+            uint16_t file_id = 0;
+            double timestamp = 0;
+            uint8_t num_args = 0;
+            uint8_t types[EVENT_MAX_ARGS] = {};
+        };
+
+        /** \brief Описание события
+         */
+        class EventInfo {
+        public:
+            std::string name;                   /**< Имя, записывается в поле function */
+            std::vector<std::string> arg_names; /**< Имена аргументов */
+            uint8_t severity = LOG_LEVEL_INFO;
+        };
+
+        /** \brief Кольцевой буфер событий одного потока
+         *
+         * Один производитель (поток, которому принадлежит буфер) и один потребитель (фоновый поток)
+         */
+        class EventBuffer {
+        public:
+            std::vector<uint8_t> buffer;
+            std::atomic<uint64_t> head = ATOMIC_VAR_INIT(0);    /**< Позиция записи, меняет производитель */
+            std::atomic<uint64_t> tail = ATOMIC_VAR_INIT(0);    /**< Позиция чтения, меняет фоновый поток */
+            std::atomic<uint64_t> dropped = ATOMIC_VAR_INIT(0); /**< Количество событий, не поместившихся в буфер */
+            std::atomic<bool> is_closed = ATOMIC_VAR_INIT(false);
+
+            EventBuffer() : buffer(EVENT_BUFFER_SIZE) {};
+        };
+
+        /** \brief Владелец буфера событий потока
+         */
+        class EventBufferHolder {
+        public:
+            std::shared_ptr<EventBuffer> ptr;
+            ~EventBufferHolder() {
+                if(ptr) ptr->is_closed = true;
+            }
+        };
+
+        /** \brief Разделить имя файла на основу и расширение
+         * \param file_name Имя файла
+         * \param stem Имя файла без расширения
+         * \param extension Расширение вместе с точкой
+         */
+        static void split_file_name(const std::string &file_name, std::string &stem, std::string &extension) {
+            const std::size_t dot_pos = file_name.find_last_of('.');
+            const std::size_t slash_pos = file_name.find_last_of("/\\");
+            if(dot_pos != std::string::npos && (slash_pos == std::string::npos || dot_pos > slash_pos)) {
+                stem = file_name.substr(0, dot_pos);
+                extension = file_name.substr(dot_pos);
+            } else {
+                stem = file_name;
+                extension.clear();
+            }
+        }
+
+        /** \brief Проверить наличие файла
+         * \param file_name Имя файла
+         * \return Вернет true, если файл существует
+         */
+        static bool check_file(const std::string &file_name) {
+            struct stat file_stat;
+            return stat(file_name.c_str(), &file_stat) == 0;
+        }
+
+        static inline size_t align_event_size(const size_t size) {
+            return (size + 7) & ~((size_t)7);
+        }
+
+        template<class T>
+        static inline typename std::enable_if<std::is_arithmetic<T>::value, size_t>::type
+                get_event_arg_size(const T &) {
+            return 8;
+        }
+
+        static inline size_t get_event_arg_size(const std::string &arg) {
+            return 8 + align_event_size(std::min(arg.size(), (size_t)EVENT_MAX_STRING));
+        }
+
+        static inline size_t get_event_arg_size(const char *arg) {
+            return 8 + align_event_size(std::min(std::strlen(arg), (size_t)EVENT_MAX_STRING));
+        }
+
+        static inline size_t get_event_args_size() {
+            return 0;
+        }
+
+        template<class T, class... ARGS>
+        static inline size_t get_event_args_size(const T &arg, const ARGS&... args) {
+            return get_event_arg_size(arg) + get_event_args_size(args...);
+        }
+
+        template<class T>
+        static inline typename std::enable_if<std::is_integral<T>::value, size_t>::type
+                write_event_arg(uint8_t *ptr, uint8_t &type, const T &arg) {
+            const int64_t value = (int64_t)arg;
+            std::memcpy(ptr, &value, sizeof(value));
+            type = EVENT_ARG_INT;
+            return 8;
+        }
+
+        template<class T>
+        static inline typename std::enable_if<std::is_floating_point<T>::value, size_t>::type
+                write_event_arg(uint8_t *ptr, uint8_t &type, const T &arg) {
+            const double value = (double)arg;
+            std::memcpy(ptr, &value, sizeof(value));
+            type = EVENT_ARG_DOUBLE;
+            return 8;
+        }
+
+        static inline size_t write_event_string(uint8_t *ptr, uint8_t &type, const char *data, size_t length) {
+            if(length > EVENT_MAX_STRING) length = EVENT_MAX_STRING;
+            const uint32_t value = (uint32_t)length;
+            std::memcpy(ptr, &value, sizeof(value));
+            std::memcpy(ptr + 8, data, length);
+            type = EVENT_ARG_STRING;
+            return 8 + align_event_size(length);
+        }
+
+        static inline size_t write_event_arg(uint8_t *ptr, uint8_t &type, const std::string &arg) {
+            return write_event_string(ptr, type, arg.data(), arg.size());
+        }
+
+        static inline size_t write_event_arg(uint8_t *ptr, uint8_t &type, const char *arg) {
+            return write_event_string(ptr, type, arg, std::strlen(arg));
+        }
+
+        static inline void write_event_args(uint8_t *, EventHeader &, const uint8_t) {}
+
+        template<class T, class... ARGS>
+        static inline void write_event_args(
+                uint8_t *ptr,
+                EventHeader &header,
+                const uint8_t index,
+                const T &arg,
+                const ARGS&... args) {
+            ptr += write_event_arg(ptr, header.types[index], arg);
+            write_event_args(ptr, header, index + 1, args...);
+        }
+
+        class Backend;
+
+    public:
+
+        /** \brief Поток записи в файл
          */
         class FileStream {
         private:
+            friend class Backend;
+
+            /** \brief Сообщение в очереди
+             */
+            class Record {
+            public:
+                std::string message;
+                json obj;
+                bool is_json = false;
+                xtime::ftimestamp_t timestamp = 0;
+                uint8_t severity = LOG_LEVEL_INFO;
+                Record() {};
+            };
+
+            std::string file_name;
             std::ofstream file;
-            std::queue<std::pair<std::ostringstream, xtime::ftimestamp_t>> queue_ostringstream;
-            std::queue<std::pair<std::string, xtime::ftimestamp_t>> queue_string;
-            std::queue<std::pair<json, xtime::ftimestamp_t>> queue_json;
+            std::vector<Record> queue;      /**< Очередь сообщений от производителей */
+            std::vector<Record> batch;      /**< Пачка сообщений, которую обрабатывает фоновый поток */
+            std::string write_buffer;       /**< Буфер групповой записи */
             std::mutex queue_mutex;
-            //std::thread file_thread;
-            std::future<void> file_future;
-            std::atomic<bool> is_init;
-            std::atomic<bool> is_stop;
-            //std::atomic<bool> is_check_stop;
+            uint16_t file_id = 0;
+            bool is_open = false;
+            bool is_open_error = false;
+            bool is_flush_request = false;  /**< Фоновый поток записал событие, требующее сброса на диск */
+            xtime::ftimestamp_t last_commit = 0;
+            uint64_t file_size = 0;                 /**< Размер текущего сегмента */
+            xtime::timestamp_t last_write = 0;      /**< Время последней записи в текущий сегмент */
 
             /** \brief Разобрать путь на составляющие
              *
@@ -87,159 +308,607 @@ namespace intrade_bar {
                 }
             }
 
+            /** \brief Преобразовать сообщение в строку JSON
+             * \param record Сообщение
+             */
+            void format(const Record &record) {
+                try {
+                    json j;
+                    j["date"] = xtime::get_str_date_time_ms(record.timestamp);
+                    j["timestamp"] = record.timestamp;
+                    if(!record.is_json) j["message"] = record.message;
+                    else j["message"] = record.obj;
+                    write_buffer += j.dump();
+                    write_buffer += "\n";
+                }
+                catch(const json::parse_error& e) {
+                    std::ostringstream os;
+                    os << "{\"logger_error\":\"json::parse_error\",\"message\":\"" << e.what()
+                       << "\",\"exception_id\":\"" << e.id << "\"}";
+                    write_buffer += os.str();
+                    write_buffer += "\n";
+                }
+                catch(json::out_of_range& e) {
+                    std::ostringstream os;
+                    os << "{\"logger_error\":\"json::out_of_range\",\"message\":\"" << e.what()
+                       << "\",\"exception_id\":\"" << e.id << "\"}";
+                    write_buffer += os.str();
+                    write_buffer += "\n";
+                }
+                catch(json::type_error& e) {
+                    std::ostringstream os;
+                    os << "{\"logger_error\":\"json::type_error\",\"message\":\"" << e.what()
+                       << "\",\"exception_id\":\"" << e.id << "\"}";
+                    write_buffer += os.str();
+                    write_buffer += "\n";
+                }
+                catch(...) {
+                    write_buffer += "{\"logger_error\":\"logger_unknown_error\",\"message\":\"logger_unknown_error\"}\n";
+                }
+            }
+
+            /** \brief Записать буфер в файл
+             * \param is_flush Сбросить данные на диск
+             */
+            void commit(const bool is_flush) {
+                last_commit = xtime::get_ftimestamp();
+                if(!file) {
+                    write_buffer.clear();
+                    return;
+                }
+                if(write_buffer.size() > 0) {
+                    const xtime::timestamp_t timestamp = (xtime::timestamp_t)(xtime::get_ftimestamp() + offset_ftimestamp);
+                    if(check_rotation(timestamp)) {
+                        rotate();
+                        if(!file) {
+                            write_buffer.clear();
+                            return;
+                        }
+                    }
+                    file.write(write_buffer.data(), write_buffer.size());
+                    file_size += write_buffer.size();
+                    last_write = timestamp;
+                    write_buffer.clear();
+                }
+                if(is_flush) file.flush();
+            }
+
+            /** \brief Проверить, нужно ли начать новый сегмент
+             * \param timestamp Текущее время
+             * \return Вернет true, если текущий сегмент надо закрыть
+             */
+            bool check_rotation(const xtime::timestamp_t timestamp) {
+                if(file_size == 0) return false;
+                const uint64_t max_file_size = Logger::backend.rotation_max_file_size;
+                if(max_file_size > 0 && (file_size + write_buffer.size()) > max_file_size) return true;
+                if(Logger::backend.is_rotation_daily &&
+                    (timestamp / xtime::SECONDS_IN_DAY) != (last_write / xtime::SECONDS_IN_DAY)) return true;
+                return false;
+            }
+
+            /** \brief Получить имя закрытого сегмента
+             *
+             * Имя содержит время последней записи в сегмент, например
+             * logger/intrade-bar-bets.20200410-235959-000.log
+             * \return Имя файла сегмента
+             */
+            std::string get_segment_name() {
+                std::string stem, extension;
+                split_file_name(file_name, stem, extension);
+                xtime::DateTime date_time(last_write);
+                char date_str[32] = {};
+                std::snprintf(date_str, sizeof(date_str), "%.4d%.2d%.2d-%.2d%.2d%.2d",
+                    (int)date_time.year, (int)date_time.month, (int)date_time.day,
+                    (int)date_time.hour, (int)date_time.minute, (int)date_time.second);
+                for(uint32_t n = 0;; ++n) {
+                    char index_str[16] = {};
+                    std::snprintf(index_str, sizeof(index_str), "-%.3u", n);
+                    const std::string name = stem + "." + date_str + index_str + extension;
+                    if(!check_file(name) && !check_file(name + ".zst")) return name;
+                }
+            }
+
+            /** \brief Закрыть текущий сегмент и открыть новый файл
+             */
+            void rotate() {
+                file.close();
+                is_open = false;
+                const std::string segment_name = get_segment_name();
+                const bool is_renamed = std::rename(file_name.c_str(), segment_name.c_str()) == 0;
+                if(is_renamed) Logger::backend.add_segment(segment_name, file_name);
+                file.clear();
+                open();
+                /* файл занят другим процессом, следующая попытка после записи еще одного сегмента */
+                if(!is_renamed) file_size = 0;
+            }
+
+            /** \brief Открыть файл, если он еще не открыт
+             */
+            void open() {
+                if(is_open || is_open_error) return;
+                create_directory(file_name);
+                /* размер и время записи уже существующего файла нужны для разбиения на сегменты */
+                struct stat file_stat;
+                if(stat(file_name.c_str(), &file_stat) == 0) {
+                    file_size = file_stat.st_size;
+                    last_write = file_stat.st_mtime;
+                } else {
+                    file_size = 0;
+                    last_write = (xtime::timestamp_t)(xtime::get_ftimestamp() + offset_ftimestamp);
+                }
+                file.open(file_name, std::ios_base::app);
+                if(!file) is_open_error = true;
+                else is_open = true;
+                write_buffer.reserve(WRITE_BUFFER_SIZE * 2);
+                last_commit = xtime::get_ftimestamp();
+            }
+
+            /** \brief Обработать очередь сообщений
+             *
+             * Метод вызывается только из фонового потока
+             * \param flush_severity Уровень важности, при котором данные сразу сбрасываются на диск
+             * \param is_force_commit Записать буфер независимо от его размера
+             * \return Вернет true, если в буфере остались данные
+             */
+            bool process(const uint8_t flush_severity, const bool is_force_commit) {
+                {
+                    std::lock_guard<std::mutex> lock(queue_mutex);
+                    batch.swap(queue);
+                }
+                if(!batch.empty()) open();
+                bool is_flush = is_flush_request;
+                is_flush_request = false;
+                for(size_t i = 0; i < batch.size(); ++i) {
+                    format(batch[i]);
+                    if(batch[i].severity >= flush_severity) is_flush = true;
+                    if(write_buffer.size() >= WRITE_BUFFER_SIZE) commit(false);
+                }
+                batch.clear();
+                if(is_flush || is_force_commit ||
+                    (write_buffer.size() > 0 &&
+                    (xtime::get_ftimestamp() - last_commit) * 1000.0 >= GROUP_COMMIT_DELAY)) {
+                    commit(true);
+                }
+                return write_buffer.size() > 0;
+            }
+
+            /** \brief Добавить сообщение в очередь
+             * \param record Сообщение
+             */
+            inline void push(Record &&record) {
+                {
+                    std::lock_guard<std::mutex> lock(queue_mutex);
+                    queue.push_back(std::move(record));
+                }
+                Logger::backend.notify();
+            }
+
         public:
-            FileStream() {
-                is_init = false;
-                is_stop = false;
-                //is_check_stop = false;
+            FileStream() {};
+
+            /** \brief Получить номер файла для log_event()
+             * \return Номер файла
+             */
+            inline uint16_t get_file_id() const {
+                return file_id;
+            }
+
+            ~FileStream() {
+                if(file) {
+                    commit(true);
+                    file.close();
+                }
             };
 
-            /** \brief Инициализировать поток записи в файл
-             * \param file_name Имя файла
+            template<class T>
+            FileStream& operator << (T const &data) {
+                Record record;
+                std::ostringstream os;
+                os << data;
+                record.message = os.str();
+                record.timestamp = xtime::get_ftimestamp() + offset_ftimestamp;
+                push(std::move(record));
+                return *this;
+            }
+
+            void write(const std::string &message, const uint8_t severity = LOG_LEVEL_INFO) {
+                Record record;
+                record.message = message;
+                record.timestamp = xtime::get_ftimestamp() + offset_ftimestamp;
+                record.severity = severity;
+                push(std::move(record));
+            }
+
+            void write(const json &obj, const uint8_t severity = LOG_LEVEL_INFO) {
+                Record record;
+                record.obj = obj;
+                record.is_json = true;
+                record.timestamp = xtime::get_ftimestamp() + offset_ftimestamp;
+                record.severity = severity;
+                push(std::move(record));
+            }
+        };
+
+    private:
+
+        /** \brief Фоновый поток записи всех файлов
+         */
+        class Backend {
+        private:
+            std::mutex files_mutex;
+            std::map<std::string, FileStream> files;
+            std::vector<FileStream*> files_list;    /**< Список файлов для фонового потока */
+
+            std::mutex events_mutex;
+            std::array<EventInfo, EVENT_MAX_EVENTS> events;    /**< Описания событий. Таблица не перемещается, запись не меняется после публикации */
+            std::map<std::string, uint16_t> events_indx;
+            std::atomic<uint32_t> events_size = ATOMIC_VAR_INIT(0); /**< Количество опубликованных событий */
+
+            std::mutex event_buffers_mutex;
+            std::vector<std::shared_ptr<EventBuffer>> event_buffers;
+
+            std::thread segments_thread;            /**< Поток сжатия и удаления закрытых сегментов */
+            std::mutex segments_mutex;
+            std::condition_variable segments_cv;
+            std::deque<std::pair<std::string, std::string>> segments;  /**< Закрытые сегменты и имена их файлов */
+            std::function<bool(const std::string &, const std::string &)> compressor;
+            bool is_segments_stop = false;
+
+            /** \brief Удалить старые сегменты файла
+             * \param file_name Имя файла лога
+             */
+            void apply_retention(const std::string &file_name) {
+                const uint32_t retention = rotation_retention;
+                if(retention == 0) return;
+                std::string stem, extension;
+                split_file_name(file_name, stem, extension);
+                std::string dir_name = ".";
+                std::string prefix = stem;
+                const std::size_t slash_pos = stem.find_last_of("/\\");
+                if(slash_pos != std::string::npos) {
+                    dir_name = stem.substr(0, slash_pos);
+                    prefix = stem.substr(slash_pos + 1);
+                }
+                prefix += ".";
+                DIR *dir = opendir(dir_name.c_str());
+                if(dir == NULL) return;
+                std::vector<std::string> names;
+                struct dirent *entry = NULL;
+                while((entry = readdir(dir)) != NULL) {
+                    const std::string name(entry->d_name);
+                    if(name.size() <= prefix.size() + extension.size()) continue;
+                    if(name.compare(0, prefix.size(), prefix) != 0) continue;
+                    if(!std::isdigit((unsigned char)name[prefix.size()])) continue;
+                    const std::string zst_extension = extension + ".zst";
+                    const bool is_plain = name.compare(name.size() - extension.size(), extension.size(), extension) == 0;
+                    const bool is_zst = name.size() > zst_extension.size() &&
+                        name.compare(name.size() - zst_extension.size(), zst_extension.size(), zst_extension) == 0;
+                    if(is_plain || is_zst) names.push_back(name);
+                }
+                closedir(dir);
+                if(names.size() <= retention) return;
+                /* имена сегментов начинаются с даты, поэтому сортировка по имени - это сортировка по времени */
+                std::sort(names.begin(), names.end());
+                for(size_t i = 0; i < (names.size() - retention); ++i) {
+                    std::remove((dir_name + "/" + names[i]).c_str());
+                }
+            }
+
+            /** \brief Поток сжатия и удаления закрытых сегментов
              */
-            void init(const std::string &file_name) {
-                if(is_init) return;
-                is_init = true;
-                //file_thread = std::thread([&,file_name] {
-                file_future = std::async(std::launch::async,[&, file_name]() {
-                    create_directory(file_name);
-                    file.open(file_name, std::ios_base::app);
-                    if(!file) {
-                        //is_check_stop = true;
-                        return;
+            void run_segments() {
+                while(true) {
+                    std::pair<std::string, std::string> segment;
+                    std::function<bool(const std::string &, const std::string &)> segment_compressor;
+                    {
+                        std::unique_lock<std::mutex> lock(segments_mutex);
+                        segments_cv.wait(lock, [&]() {
+                            return !segments.empty() || is_segments_stop;
+                        });
+                        if(segments.empty()) break;
+                        segment = segments.front();
+                        segments.pop_front();
+                        segment_compressor = compressor;
                     }
-                    std::string temp_str;           // Временная строка
-                    json temp_json;
-                    bool is_json = false;
-                    xtime::ftimestamp_t ftimestamp; // Метка времени сообщения
-                    while(true) {
-                        if(!file) break;
-                        {
-                            std::lock_guard<std::mutex> lock(queue_mutex);
-                            if(queue_ostringstream.empty() &&
-                                queue_string.empty() &&
-                                queue_json.empty()) {
-                                if(is_stop) {
-                                    file.close();
-                                    break;
-                                }
-                                std::this_thread::yield();
-                                continue;
-                            }
-                            is_json = false;
-                            if(!queue_ostringstream.empty()) {
-                                temp_str = queue_ostringstream.front().first.str();
-                                ftimestamp = queue_ostringstream.front().second;
-                                queue_ostringstream.pop();
-                            } else
-                            if(!queue_string.empty()) {
-                                temp_str = queue_string.front().first;
-                                ftimestamp = queue_string.front().second;
-                                queue_string.pop();
-                            } else
-                            if(!queue_json.empty()) {
-                                temp_json = queue_json.front().first;
-                                ftimestamp = queue_json.front().second;
-                                queue_json.pop();
-                                is_json = true;
-                            }
-                        }
+                    if(segment_compressor) {
+                        const std::string compressed_name = segment.first + ".zst";
+                        bool is_compressed = false;
                         try {
-                            json j;
-                            j["date"] = xtime::get_str_date_time_ms(ftimestamp);
-                            j["timestamp"] = ftimestamp;
-                            if(!is_json) j["message"] = temp_str;
-                            else j["message"] = temp_json;
-                            temp_str = j.dump();
-                            temp_str += "\n";
-                        }
-                        catch(const json::parse_error& e) {
-                            std::ostringstream os;
-                            os << "{\"logger_error\":\"json::parse_error\",\"message\":\"" << e.what()
-                               << "\",\"exception_id\":\"" << e.id << "\"}";
-                            temp_str = os.str();
-                            temp_str += "\n";
-                        }
-                        catch(json::out_of_range& e) {
-                            std::ostringstream os;
-                            os << "{\"logger_error\":\"json::out_of_range\",\"message\":\"" << e.what()
-                               << "\",\"exception_id\":\"" << e.id << "\"}";
-                            temp_str = os.str();
-                            temp_str += "\n";
+                            is_compressed = segment_compressor(segment.first, compressed_name);
                         }
-                        catch(json::type_error& e) {
-                            std::ostringstream os;
-                            os << "{\"logger_error\":\"json::type_error\",\"message\":\"" << e.what()
-                               << "\",\"exception_id\":\"" << e.id << "\"}";
-                            temp_str = os.str();
-                            temp_str += "\n";
-                        }
-                        catch(...) {
-                            temp_str = "{\"logger_error\":\"logger_unknown_error\",\"message\":\"logger_unknown_error\"}\n";
+                        catch(...) {}
+                        if(is_compressed) std::remove(segment.first.c_str());
+                        else std::remove(compressed_name.c_str());
+                    }
+                    apply_retention(segment.second);
+                }
+            }
+
+            /** \brief Исправить строку UTF-8
+             * \param str Строка
+             */
+            static void fix_utf8_string(std::string& str) {
+                std::string temp;
+                utf8::replace_invalid(str.begin(), str.end(), back_inserter(temp));
+                str = temp;
+            }
+
+            /** \brief Преобразовать двоичную запись события в строку JSON
+             * \param data Запись события
+             * \param list Список файлов
+             */
+            void format_event(const uint8_t *data, const std::vector<FileStream*> &list) {
+                EventHeader header;
+                std::memcpy(&header, data, sizeof(EventHeader));
+                /* описание события опубликовано до записи его номера, поэтому читается без блокировки */
+                if(header.file_id >= list.size() ||
+                    header.event_id >= events_size.load(std::memory_order_acquire)) return;
+                const EventInfo &info = events[header.event_id];
+                FileStream &stream = *list[header.file_id];
+                stream.open();
+                const uint8_t *ptr = data + sizeof(EventHeader);
+                try {
+                    json message;
+                    message["function"] = info.name;
+                    for(uint8_t i = 0; i < header.num_args; ++i) {
+                        const std::string arg_name = i < info.arg_names.size() ?
+                            info.arg_names[i] : ("arg" + std::to_string(i));
+                        if(header.types[i] == EVENT_ARG_INT) {
+                            int64_t value = 0;
+                            std::memcpy(&value, ptr, sizeof(value));
+                            message[arg_name] = value;
+                            ptr += 8;
+                        } else
+                        if(header.types[i] == EVENT_ARG_DOUBLE) {
+                            double value = 0;
+                            std::memcpy(&value, ptr, sizeof(value));
+                            message[arg_name] = value;
+                            ptr += 8;
+                        } else
+                        if(header.types[i] == EVENT_ARG_STRING) {
+                            uint32_t length = 0;
+                            std::memcpy(&length, ptr, sizeof(length));
+                            std::string value((const char*)(ptr + 8), length);
+                            fix_utf8_string(value);
+                            message[arg_name] = value;
+                            ptr += 8 + align_event_size(length);
                         }
-                        if(!file) break;
-                        file << temp_str;
-                        //file.flush();
                     }
-                    //is_check_stop = true;
-                });
-                //file_thread.detach();
+                    json j;
+                    j["date"] = xtime::get_str_date_time_ms(header.timestamp);
+                    j["timestamp"] = header.timestamp;
+                    j["message"] = message;
+                    stream.write_buffer += j.dump();
+                    stream.write_buffer += "\n";
+                }
+                catch(...) {
+                    stream.write_buffer += "{\"logger_error\":\"logger_event_error\",\"message\":\"logger_event_error\"}\n";
+                }
+                if(info.severity >= flush_severity) stream.is_flush_request = true;
+                if(stream.write_buffer.size() >= WRITE_BUFFER_SIZE) stream.commit(false);
             }
 
-            ~FileStream() {
-                is_stop = true; // посылаем сигнал остановиться потоку
-                /* Существует проблема с циклом yield().
-                 * Если поток, вызывающий деструктор, имеет более высокий приоритет, чем завершаемый поток,
-                 * то ваш проект может вечно жить в однопроцессорной системе.
-                 * Даже в многоядерной системе может быть большая задержка.
-                 * https://coderoad.ru/7927773
-                 */
-#if(0)
-                while(!is_check_stop) {
-                    //std::this_thread::yield();
+            /** \brief Забрать события из кольцевых буферов всех потоков
+             * \param list Список файлов
+             */
+            void drain_events(const std::vector<FileStream*> &list) {
+                std::vector<std::shared_ptr<EventBuffer>> buffers;
+                {
+                    std::lock_guard<std::mutex> lock(event_buffers_mutex);
+                    buffers = event_buffers;
                 }
-#endif
-                if(file_future.valid()) {
-                    try {
-                        file_future.wait();
-                        file_future.get();
+                for(size_t b = 0; b < buffers.size(); ++b) {
+                    EventBuffer &ring = *buffers[b];
+                    const bool is_closed = ring.is_closed;
+                    uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+                    const uint64_t head = ring.head.load(std::memory_order_acquire);
+                    while(tail < head) {
+                        const uint8_t *data = ring.buffer.data() + (tail % EVENT_BUFFER_SIZE);
+                        uint32_t size = 0;
+                        uint16_t event_id = 0;
+                        std::memcpy(&size, data, sizeof(size));
+                        std::memcpy(&event_id, data + sizeof(size), sizeof(event_id));
+                        if(event_id != EVENT_PADDING) format_event(data, list);
+                        tail += size;
+                    }
+                    ring.tail.store(tail, std::memory_order_release);
+                    dropped_events += ring.dropped.exchange(0);
+                    /* поток завершился и все события записаны */
+                    if(is_closed) {
+                        std::lock_guard<std::mutex> lock(event_buffers_mutex);
+                        auto it = std::find(event_buffers.begin(), event_buffers.end(), buffers[b]);
+                        if(it != event_buffers.end()) event_buffers.erase(it);
+                    }
+                }
+            }
+
+            std::thread backend_thread;
+            std::mutex backend_mutex;
+            std::condition_variable backend_cv;
+            std::condition_variable flush_cv;
+            std::atomic<bool> is_pending = ATOMIC_VAR_INIT(false);  /**< Есть новые сообщения */
+            std::atomic<bool> is_sleeping = ATOMIC_VAR_INIT(false); /**< Фоновый поток ждет на backend_cv */
+            std::atomic<bool> is_stop = ATOMIC_VAR_INIT(false);
+            uint64_t flush_request = 0;     /**< Номер запроса на сброс буферов */
+            uint64_t flush_done = 0;        /**< Номер выполненного запроса на сброс буферов */
+
+            void run() {
+                std::vector<FileStream*> list;
+                bool is_buffered = false;
+                while(true) {
+                    uint64_t flush_id = 0;
+                    bool is_exit = false;
+                    {
+                        std::unique_lock<std::mutex> lock(backend_mutex);
+                        auto predicate = [&]() {
+                            return is_pending || is_stop || flush_request != flush_done;
+                        };
+                        /* флаг ожидания ставится до проверки is_pending в predicate,
+                         * поэтому производитель, увидевший is_sleeping == false, не может потерять пробуждение
+                         */
+                        is_sleeping = true;
+                        /* если в буферах остались данные, ждем не дольше времени групповой записи */
+                        if(is_buffered) {
+                            backend_cv.wait_for(lock, std::chrono::milliseconds(GROUP_COMMIT_DELAY), predicate);
+                        } else {
+                            backend_cv.wait(lock, predicate);
+                        }
+                        is_sleeping = false;
+                        /* обмен, а не запись: так видны все события, записанные до установки флага */
+                        is_pending.exchange(false);
+                        flush_id = flush_request;
+                        is_exit = is_stop;
                     }
-                    catch(const std::exception &e) {
-                        std::cerr << "Error: ~FileStream(), what: " << e.what() << std::endl;
+                    {
+                        std::lock_guard<std::mutex> lock(files_mutex);
+                        list = files_list;
                     }
-                    catch(...) {
-                        std::cerr << "Error: ~FileStream()" << std::endl;
+                    drain_events(list);
+                    const bool is_force_commit = is_exit || flush_id != flush_done;
+                    is_buffered = false;
+                    for(size_t i = 0; i < list.size(); ++i) {
+                        if(list[i]->process(flush_severity, is_force_commit)) is_buffered = true;
                     }
+                    if(flush_id != flush_done) {
+                        std::lock_guard<std::mutex> lock(backend_mutex);
+                        flush_done = flush_id;
+                        flush_cv.notify_all();
+                    }
+                    if(is_exit && !is_pending) break;
                 }
-                if(file) file.close();
-            };
+            }
 
-            template<class T>
-            FileStream& operator << (T const &data) {
-                xtime::ftimestamp_t ftimestamp = xtime::get_ftimestamp() +
-                    offset_ftimestamp;
-                std::lock_guard<std::mutex> lock(queue_mutex);
-                queue_ostringstream.push(std::make_pair(std::ostringstream(data), ftimestamp));
-                return *this;
+        public:
+            std::atomic<uint8_t> flush_severity = ATOMIC_VAR_INIT((uint8_t)LOG_LEVEL_ERROR);
+            std::atomic<uint64_t> dropped_events = ATOMIC_VAR_INIT(0);  /**< Количество отброшенных событий */
+            std::atomic<uint64_t> rotation_max_file_size = ATOMIC_VAR_INIT(0);  /**< Размер сегмента, 0 - без ограничения */
+            std::atomic<bool> is_rotation_daily = ATOMIC_VAR_INIT(false);       /**< Начинать новый сегмент в начале суток UTC */
+            std::atomic<uint32_t> rotation_retention = ATOMIC_VAR_INIT(0);      /**< Количество хранимых сегментов, 0 - хранить все */
+
+            Backend() {};
+
+            ~Backend() {
+                {
+                    std::lock_guard<std::mutex> lock(backend_mutex);
+                    is_stop = true;
+                    backend_cv.notify_one();
+                }
+                if(backend_thread.joinable()) backend_thread.join();
+                /* поток сегментов завершится, когда сожмет все закрытые сегменты */
+                {
+                    std::lock_guard<std::mutex> lock(segments_mutex);
+                    is_segments_stop = true;
+                    segments_cv.notify_one();
+                }
+                if(segments_thread.joinable()) segments_thread.join();
             }
 
-            void write(const std::string &message) {
-                xtime::ftimestamp_t ftimestamp = xtime::get_ftimestamp() +
-                    offset_ftimestamp;
-                std::lock_guard<std::mutex> lock(queue_mutex);
-                queue_string.push(std::make_pair(message, ftimestamp));
+            /** \brief Передать закрытый сегмент на сжатие
+             * \param segment_name Имя сегмента
+             * \param file_name Имя файла лога
+             */
+            void add_segment(const std::string &segment_name, const std::string &file_name) {
+                std::lock_guard<std::mutex> lock(segments_mutex);
+                if(!segments_thread.joinable()) {
+                    segments_thread = std::thread(&Backend::run_segments, this);
+                }
+                segments.push_back(std::make_pair(segment_name, file_name));
+                segments_cv.notify_one();
+            }
+
+            /** \brief Установить функцию сжатия сегментов
+             * \param user_compressor Функция сжатия
+             */
+            void set_compressor(std::function<bool(const std::string &, const std::string &)> user_compressor) {
+                std::lock_guard<std::mutex> lock(segments_mutex);
+                compressor = user_compressor;
+            }
+
+            /** \brief Получить поток записи в файл
+             * \param file_name Имя файла
+             * \return Поток записи в файл
+             */
+            FileStream &get_file(const std::string &file_name) {
+                std::lock_guard<std::mutex> lock(files_mutex);
+                auto it = files.find(file_name);
+                if(it != files.end()) return it->second;
+                FileStream &stream = files[file_name];
+                stream.file_name = file_name;
+                stream.file_id = files_list.size();
+                files_list.push_back(&stream);
+                if(!backend_thread.joinable()) {
+                    backend_thread = std::thread([&]() {
+                        run();
+                    });
+                }
+                return stream;
+            }
+
+            /** \brief Зарегистрировать событие
+             * \param name Имя события
+             * \param arg_names Имена аргументов
+             * \param severity Уровень важности
+             * \return Номер события
+             */
+            uint16_t register_event(
+                    const std::string &name,
+                    const std::vector<std::string> &arg_names,
+                    const LogSeverity severity) {
+                std::lock_guard<std::mutex> lock(events_mutex);
+                auto it = events_indx.find(name);
+                if(it != events_indx.end()) return it->second;
+                const uint32_t event_id = events_size.load(std::memory_order_relaxed);
+                /* таблица заполнена, записи с таким номером фоновый поток пропустит */
+                if(event_id >= EVENT_MAX_EVENTS) return EVENT_MAX_EVENTS;
+                EventInfo &info = events[event_id];
+                info.name = name;
+                info.arg_names = arg_names;
+                info.severity = (uint8_t)severity;
+                events_indx[name] = (uint16_t)event_id;
+                events_size.store(event_id + 1, std::memory_order_release);
+                return (uint16_t)event_id;
+            }
+
+            /** \brief Получить буфер событий текущего потока
+             * \return Буфер событий
+             */
+            EventBuffer &get_event_buffer() {
+                static thread_local EventBufferHolder holder;
+                if(!holder.ptr) {
+                    holder.ptr = std::make_shared<EventBuffer>();
+                    std::lock_guard<std::mutex> lock(event_buffers_mutex);
+                    event_buffers.push_back(holder.ptr);
+                }
+                return *holder.ptr;
             }
 
-            void write(const json &obj) {
-                xtime::ftimestamp_t ftimestamp = xtime::get_ftimestamp() +
-                    offset_ftimestamp;
-                std::lock_guard<std::mutex> lock(queue_mutex);
-                queue_json.push(std::make_pair(obj, ftimestamp));
+            /** \brief Разбудить фоновый поток
+             *
+             * Блокировка берется, только если фоновый поток спит. Пока он работает,
+             * достаточно флага is_pending: поток проверит его перед следующим ожиданием
+             */
+            inline void notify() {
+                if(is_pending.exchange(true)) return;
+                if(!is_sleeping.load()) return;
+                std::lock_guard<std::mutex> lock(backend_mutex);
+                backend_cv.notify_one();
+            }
+
+            /** \brief Записать все сообщения на диск и дождаться завершения записи
+             */
+            void flush() {
+                std::unique_lock<std::mutex> lock(backend_mutex);
+                if(!backend_thread.joinable()) return;
+                const uint64_t flush_id = ++flush_request;
+                backend_cv.notify_one();
+                flush_cv.wait(lock, [&]() {
+                    return flush_done >= flush_id || is_stop;
+                });
             }
         };
 
-        static inline std::mutex files_mutex;
-        static inline std::map<std::string, FileStream> files;
+        static inline Backend backend;
+
     public:
 
         /** \brief Установить смещение метки времени
@@ -249,45 +918,164 @@ namespace intrade_bar {
             offset_ftimestamp = offset;
         }
 
+        /** \brief Установить уровень важности для сброса на диск
+         *
+         * Сообщения с важностью не ниже указанной записываются на диск сразу,
+         * остальные - групповой записью не реже одного раза в GROUP_COMMIT_DELAY мс
+         * \param severity Уровень важности
+         */
+        inline static void set_flush_severity(const LogSeverity severity) {
+            backend.flush_severity = (uint8_t)severity;
+        }
+
+        /** \brief Настроить разбиение файлов на сегменты
+         *
+         * Закрытый сегмент переименовывается в файл с датой последней записи в имени,
+         * например logger/intrade-bar-bets.20200410-235959-000.log, после чего
+         * сжимается (см. set_compressor) и удаляется в отдельном потоке
+         * \param max_file_size Максимальный размер сегмента в байтах, 0 - без ограничения
+         * \param is_daily Начинать новый сегмент в начале суток UTC
+         * \param retention Количество хранимых сегментов каждого файла, 0 - хранить все
+         */
+        inline static void set_rotation(
+                const uint64_t max_file_size,
+                const bool is_daily = true,
+                const uint32_t retention = 0) {
+            backend.rotation_max_file_size = max_file_size;
+            backend.is_rotation_daily = is_daily;
+            backend.rotation_retention = retention;
+        }
+
+        /** \brief Установить функцию сжатия закрытых сегментов
+         *
+         * Функция вызывается из потока сегментов и должна вернуть true при успешном сжатии,
+         * после чего исходный сегмент удаляется. Сжатие zstd подключается через intrade-bar-logger-zstd.hpp
+         * \param compressor Функция сжатия (имя сегмента, имя сжатого файла)
+         */
+        inline static void set_compressor(std::function<bool(const std::string &, const std::string &)> compressor) {
+            backend.set_compressor(compressor);
+        }
+
+        /** \brief Записать все сообщения на диск
+         *
+         * Метод ждет, пока фоновый поток не запишет все сообщения, полученные до вызова
+         */
+        inline static void flush() {
+            backend.flush();
+        }
+
+        /** \brief Зарегистрировать событие
+         *
+         * Повторная регистрация события с тем же именем вернет тот же номер.
+         * Можно зарегистрировать не более 1024 событий, записи событий сверх этого числа не пишутся
+         * \param name Имя события, записывается в поле function
+         * \param arg_names Имена аргументов события
+         * \param severity Уровень важности
+         * \return Номер события для log_event()
+         */
+        inline static uint16_t register_event(
+                const std::string &name,
+                const std::vector<std::string> &arg_names,
+                const LogSeverity severity = LOG_LEVEL_INFO) {
+            return backend.register_event(name, arg_names, severity);
+        }
+
+        /** \brief Получить номер файла для log_event()
+         * \param file_name Имя файла
+         * \return Номер файла
+         */
+        inline static uint16_t get_file_id(const std::string &file_name) {
+            return backend.get_file(file_name).get_file_id();
+        }
+
+        /** \brief Записать событие
+         *
+         * Метод пишет двоичную запись в кольцевой буфер текущего потока без блокировок
+         * и выделения памяти. Аргументы: целые числа, числа с плавающей точкой и строки.
+         * Если буфер заполнен, событие отбрасывается.
+         * \param file_id Номер файла, см. get_file_id()
+         * \param event_id Номер события, см. register_event()
+         * \param args Аргументы события
+         * \return Вернет true, если событие записано в буфер
+         */
+        template<class... ARGS>
+        inline static bool log_event(
+                const uint16_t file_id,
+                const uint16_t event_id,
+                const ARGS&... args) {
+            static_assert(sizeof...(ARGS) <= EVENT_MAX_ARGS, "too many event arguments");
+            EventBuffer &ring = backend.get_event_buffer();
+            const uint64_t size = align_event_size(sizeof(EventHeader) + get_event_args_size(args...));
+            uint64_t head = ring.head.load(std::memory_order_relaxed);
+            const uint64_t tail = ring.tail.load(std::memory_order_acquire);
+            const uint64_t contiguous = EVENT_BUFFER_SIZE - (head % EVENT_BUFFER_SIZE);
+            const uint64_t required = size + (contiguous < size ? contiguous : 0);
+            if((EVENT_BUFFER_SIZE - (head - tail)) < required) {
+                ++ring.dropped;
+                return false;
+            }
+            if(contiguous < size) {
+                /* запись не помещается до конца буфера, заполняем остаток */
+                EventHeader padding;
+                padding.size = contiguous;
+                padding.event_id = EVENT_PADDING;
+                std::memcpy(ring.buffer.data() + (head % EVENT_BUFFER_SIZE), &padding, sizeof(uint32_t) + sizeof(uint16_t));
+                head += contiguous;
+            }
+            uint8_t *data = ring.buffer.data() + (head % EVENT_BUFFER_SIZE);
+            EventHeader header;
+            header.size = size;
+            header.event_id = event_id;
+            header.file_id = file_id;
+            header.timestamp = xtime::get_ftimestamp() + offset_ftimestamp;
+            header.num_args = sizeof...(ARGS);
+            write_event_args(data + sizeof(EventHeader), header, 0, args...);
+            std::memcpy(data, &header, sizeof(EventHeader));
+            ring.head.store(head + size, std::memory_order_release);
+            backend.notify();
+            return true;
+        }
+
+        /** \brief Получить количество отброшенных событий
+         *
+         * События отбрасываются, если фоновый поток не успевает освобождать буфер потока
+         * \return Количество событий, отброшенных с момента запуска
+         */
+        inline static uint64_t get_dropped_events() {
+            return backend.dropped_events;
+        }
+
         /** \brief Записать лог
          * \param file_name Имя файла
          */
         inline static FileStream& log(const std::string &file_name) {
-            if(files.find(file_name) == files.end()) {
-               std::lock_guard<std::mutex> lock(files_mutex);
-                files[file_name].init(file_name);
-            }
-            return files[file_name];
+            return backend.get_file(file_name);
         }
 
         /** \brief Записать лог
          * \param file_name Имя файла
          * \param message Строковое сообщение
+         * \param severity Уровень важности
          */
         inline static void log(
                 const std::string &file_name,
-                const std::string &message) {
+                const std::string &message,
+                const LogSeverity severity = LOG_LEVEL_INFO) {
             if(file_name.size() == 0) return;
-            if(files.find(file_name) == files.end()) {
-                std::lock_guard<std::mutex> lock(files_mutex);
-                files[file_name].init(file_name);
-            }
-            files[file_name].write(message);
+            backend.get_file(file_name).write(message, severity);
         }
 
         /** \brief Записать лог
          * \param file_name Имя файла
          * \param obj Объект JSON
+         * \param severity Уровень важности
          */
         inline static void log(
                 const std::string &file_name,
-                const json &obj) {
+                const json &obj,
+                const LogSeverity severity = LOG_LEVEL_INFO) {
             if(file_name.size() == 0) return;
-            if(files.find(file_name) == files.end()) {
-                std::lock_guard<std::mutex> lock(files_mutex);
-                files[file_name].init(file_name);
-            }
-            files[file_name].write(obj);
+            backend.get_file(file_name).write(obj, severity);
         }
 
         /** \brief Записать лог
@@ -298,10 +1086,7 @@ namespace intrade_bar {
                 const std::string &file_name,
                 const intrade_bar_common::BinaryOption &bo) {
             if(file_name.size() == 0) return;
-            if(files.find(file_name) == files.end()) {
-                std::lock_guard<std::mutex> lock(files_mutex);
-                files[file_name].init(file_name);
-            }
+            backend.get_file(file_name);
         }
     };
 }
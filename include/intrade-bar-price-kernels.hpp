@@ -0,0 +1,235 @@
+/*
+* intrade-bar-api-cpp - C ++ API client for intrade.bar
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef INTRADE_BAR_PRICE_KERNELS_HPP_INCLUDED
+#define INTRADE_BAR_PRICE_KERNELS_HPP_INCLUDED
+
+#include <intrade-bar-common.hpp>
+#include <xquotes_common.hpp>
+#include <vector>
+#include <cstddef>
+#include <cmath>
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define INTRADE_BAR_PRICE_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+namespace intrade_bar_common {
+
+    /** \brief Пакетная обработка цен
+     *
+     * Средняя цена (bid + ask)/2 с округлением до множителя символа для целых массивов.
+     * Результат совпадает с Price::from_bid_ask(bid, ask, scale).to_double() для положительных цен.
+     * Версии AVX2 и SSE4.2 собираются атрибутом target, поэтому не нужны отдельные флаги компилятора,
+     * а выбор версии делается один раз при первом вызове по возможностям процессора.
+     * Раскладка ответа по колонкам окупается только с AVX2, см. is_batch_faster().
+     */
+    namespace price_kernels {
+
+        /// Набор инструкций, используемый ядрами
+        enum class InstructionSet {
+            SCALAR,
+            SSE4,
+            AVX2,
+        };
+
+        /** \brief Колонки исторических данных bid/ask
+         *
+         * Формат совпадает с порядком полей баров FXCM
+         */
+        class BidAskColumns {
+        public:
+            std::vector<xtime::timestamp_t> timestamp;
+            std::vector<double> bid_open;
+            std::vector<double> bid_close;
+            std::vector<double> bid_high;
+            std::vector<double> bid_low;
+            std::vector<double> ask_open;
+            std::vector<double> ask_close;
+            std::vector<double> ask_high;
+            std::vector<double> ask_low;
+            std::vector<double> volume;
+
+            void resize(const size_t size) {
+                timestamp.resize(size);
+                bid_open.resize(size);
+                bid_close.resize(size);
+                bid_high.resize(size);
+                bid_low.resize(size);
+                ask_open.resize(size);
+                ask_close.resize(size);
+                ask_high.resize(size);
+                ask_low.resize(size);
+                volume.resize(size);
+            }
+
+            inline size_t size() const {
+                return timestamp.size();
+            }
+        };
+
+        /* все версии считают floor((bid + ask)/2 * scale + 0.5) с теми же операциями double в том же порядке,
+         * для положительных цен floor совпадает с приведением к целому, поэтому результаты версий совпадают
+         */
+        inline void mid_price_scalar(
+                const double *bid,
+                const double *ask,
+                double *output,
+                const size_t size,
+                const uint32_t scale) {
+            const double d_scale = (double)scale;
+            for(size_t i = 0; i < size; ++i) {
+                const double price = (bid[i] + ask[i]) / 2.0;
+                output[i] = (double)((int64_t)(price * d_scale + 0.5)) / d_scale;
+            }
+        }
+
+#       ifdef INTRADE_BAR_PRICE_KERNELS_X86
+        __attribute__((target("sse4.2")))
+        inline void mid_price_sse4(
+                const double *bid,
+                const double *ask,
+                double *output,
+                const size_t size,
+                const uint32_t scale) {
+            const __m128d v_scale = _mm_set1_pd((double)scale);
+            const __m128d v_half = _mm_set1_pd(0.5);
+            size_t i = 0;
+            for(; i + 2 <= size; i += 2) {
+                const __m128d price = _mm_mul_pd(_mm_add_pd(_mm_loadu_pd(bid + i), _mm_loadu_pd(ask + i)), v_half);
+                const __m128d ticks = _mm_floor_pd(_mm_add_pd(_mm_mul_pd(price, v_scale), v_half));
+                _mm_storeu_pd(output + i, _mm_div_pd(ticks, v_scale));
+            }
+            mid_price_scalar(bid + i, ask + i, output + i, size - i, scale);
+        }
+
+        __attribute__((target("avx2")))
+        inline void mid_price_avx2(
+                const double *bid,
+                const double *ask,
+                double *output,
+                const size_t size,
+                const uint32_t scale) {
+            const __m256d v_scale = _mm256_set1_pd((double)scale);
+            const __m256d v_half = _mm256_set1_pd(0.5);
+            size_t i = 0;
+            for(; i + 4 <= size; i += 4) {
+                const __m256d price = _mm256_mul_pd(_mm256_add_pd(_mm256_loadu_pd(bid + i), _mm256_loadu_pd(ask + i)), v_half);
+                const __m256d ticks = _mm256_floor_pd(_mm256_add_pd(_mm256_mul_pd(price, v_scale), v_half));
+                _mm256_storeu_pd(output + i, _mm256_div_pd(ticks, v_scale));
+            }
+            mid_price_scalar(bid + i, ask + i, output + i, size - i, scale);
+        }
+#       endif
+
+        /** \brief Определить набор инструкций процессора
+         */
+        inline InstructionSet detect_instruction_set() {
+#           ifdef INTRADE_BAR_PRICE_KERNELS_X86
+            __builtin_cpu_init();
+            if(__builtin_cpu_supports("avx2")) return InstructionSet::AVX2;
+            if(__builtin_cpu_supports("sse4.2")) return InstructionSet::SSE4;
+#           endif
+            return InstructionSet::SCALAR;
+        }
+
+        /** \brief Получить набор инструкций, выбранный для ядер
+         */
+        inline InstructionSet get_instruction_set() {
+            static const InstructionSet instruction_set = detect_instruction_set();
+            return instruction_set;
+        }
+
+        /** \brief Проверить, что пакетная обработка быстрее обычного цикла по барам
+         *
+         * Без AVX2 раскладка по колонкам стоит дороже, чем выигрыш от SSE4.2
+         */
+        inline bool is_batch_faster() {
+            return get_instruction_set() == InstructionSet::AVX2;
+        }
+
+        /** \brief Посчитать среднюю цену (bid + ask)/2 для массива
+         * \param bid Цены bid
+         * \param ask Цены ask
+         * \param output Округленные средние цены
+         * \param size Количество цен
+         * \param scale Множитель цены
+         * \param instruction_set Набор инструкций
+         */
+        inline void mid_price(
+                const double *bid,
+                const double *ask,
+                double *output,
+                const size_t size,
+                const uint32_t scale,
+                const InstructionSet instruction_set = get_instruction_set()) {
+            switch(instruction_set) {
+#           ifdef INTRADE_BAR_PRICE_KERNELS_X86
+            case InstructionSet::AVX2:
+                mid_price_avx2(bid, ask, output, size, scale);
+                return;
+            case InstructionSet::SSE4:
+                mid_price_sse4(bid, ask, output, size, scale);
+                return;
+#           endif
+            default:
+                mid_price_scalar(bid, ask, output, size, scale);
+                return;
+            }
+        }
+
+        /** \brief Собрать бары (bid + ask)/2 из колонок bid/ask
+         * \param columns Колонки исторических данных
+         * \param candles Массив баров
+         * \param scale Множитель цены
+         * \param instruction_set Набор инструкций
+         */
+        inline void assemble_candles(
+                const BidAskColumns &columns,
+                std::vector<xquotes_common::Candle> &candles,
+                const uint32_t scale,
+                const InstructionSet instruction_set = get_instruction_set()) {
+            const size_t size = columns.size();
+            std::vector<double> prices(4 * size);
+            double *open = prices.data();
+            double *high = open + size;
+            double *low = high + size;
+            double *close = low + size;
+            mid_price(columns.bid_open.data(), columns.ask_open.data(), open, size, scale, instruction_set);
+            mid_price(columns.bid_high.data(), columns.ask_high.data(), high, size, scale, instruction_set);
+            mid_price(columns.bid_low.data(), columns.ask_low.data(), low, size, scale, instruction_set);
+            mid_price(columns.bid_close.data(), columns.ask_close.data(), close, size, scale, instruction_set);
+            candles.resize(size);
+            for(size_t i = 0; i < size; ++i) {
+                candles[i].open = open[i];
+                candles[i].high = high[i];
+                candles[i].low = low[i];
+                candles[i].close = close[i];
+                candles[i].volume = columns.volume[i];
+                candles[i].timestamp = columns.timestamp[i];
+            }
+        }
+    }
+}
+
+#endif // INTRADE_BAR_PRICE_KERNELS_HPP_INCLUDED
@@ -0,0 +1,529 @@
+/*
+* intrade-bar-api-cpp - C ++ API client for intrade.bar
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef INTRADE_BAR_TICK_BACKFILL_HPP_INCLUDED
+#define INTRADE_BAR_TICK_BACKFILL_HPP_INCLUDED
+
+#include "intrade-bar-history-downloader.hpp"
+#include "intrade-bar-history-manifest.hpp"
+#include "intrade-bar-tick-recorder.hpp"
+#include <xtime.hpp>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <future>
+#include <chrono>
+#include <random>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <map>
+#include <tuple>
+
+namespace intrade_bar {
+
+    /** \brief Загрузка тиковой истории через get_quotes
+     *
+     * Каждый день символа делится на окна, которые принимает запрос /quotes:
+     * окно задается датой и временем начала и конца в часовом поясе сервера (GMT+3),
+     * поэтому окно не может переходить через полночь GMT+3, последнее окно суток
+     * запрашивается до полуночи включительно. Соседние окна запрашиваются
+     * с перекрытием в минуту, чтобы не потерять тики на границе, а при сборке дня
+     * из каждого окна берутся только тики его собственного диапазона.
+     *
+     * Окна загружаются параллельно, количество одновременных запросов подбирается AimdConcurrency,
+     * как и в загрузчике баров. Собранный день записывается в архив тиков TickRecorder,
+     * а в манифест символа (*SYMBOL*.ticks.json) день отмечается только после записи на диск.
+     * Перед записью день отмечается в манифесте как начатый: если запись прервалась,
+     * при повторной загрузке дня уже записанные тики отбрасываются.
+     * У исторических тиков есть только одна цена, она записывается и как bid, и как ask,
+     * а время получения тика совпадает со временем сервера.
+     */
+    class TickBackfill {
+    public:
+
+        /** \brief Статистика загрузки
+         */
+        class Stats {
+        public:
+            uint64_t days = 0;          /**< Всего дней */
+            uint64_t completed = 0;     /**< Записано дней с данными */
+            uint64_t empty = 0;         /**< Дней без данных */
+            uint64_t failed = 0;        /**< Дней с ошибкой */
+            uint64_t windows = 0;       /**< Загружено окон */
+            uint64_t retries = 0;       /**< Повторных запросов */
+            uint64_t ddos = 0;          /**< Ответов DDoS-GUARD */
+            uint64_t ticks = 0;         /**< Записано тиков */
+            uint64_t duplicates = 0;    /**< Тиков, отброшенных на перекрытии окон или уже записанных в архив */
+            double limit = 0;           /**< Текущий лимит одновременных запросов */
+        };
+
+        static const int64_t GMT_OFFSET = 3 * xtime::SECONDS_IN_HOUR;   /**< Часовой пояс времени запроса /quotes */
+
+    private:
+
+        /** \brief Окно загрузки
+         */
+        class Window {
+        public:
+            size_t job = 0;                 /**< Номер дня символа */
+            size_t index = 0;               /**< Номер окна внутри дня */
+            xtime::timestamp_t begin = 0;   /**< Начало диапазона окна */
+            xtime::timestamp_t end = 0;     /**< Конец диапазона окна (не включая) */
+            uint32_t attempt = 0;
+            double ready_time = 0;
+        };
+
+        /** \brief День символа
+         */
+        class Job {
+        public:
+            uint32_t symbol_index = 0;
+            xtime::timestamp_t day = 0;
+            std::vector<std::vector<RecordedTick>> windows;
+            size_t remaining = 0;
+            bool is_failed = false;
+        };
+
+        std::string point;
+        std::string sert_file;
+        std::string cookie_file;
+        std::string file_name_bets_log;
+        std::string file_name_work_log;
+
+        uint32_t number_workers = 8;
+        uint32_t window_minutes = 60;
+        uint32_t max_attempts = 5;
+        double backoff_base = 1.0;
+        double backoff_max = 60.0;
+
+        std::mutex windows_mutex;
+        std::deque<Window> windows;
+        std::vector<Job> jobs;
+        std::mutex persist_mutex;
+        std::array<std::shared_ptr<HistoryManifest>, CURRENCY_PAIRS> manifests;
+
+        AimdConcurrency concurrency;
+        std::atomic<bool> is_stop = ATOMIC_VAR_INIT(false);
+
+        std::atomic<uint64_t> stats_days = ATOMIC_VAR_INIT(0);
+        std::atomic<uint64_t> stats_completed = ATOMIC_VAR_INIT(0);
+        std::atomic<uint64_t> stats_empty = ATOMIC_VAR_INIT(0);
+        std::atomic<uint64_t> stats_failed = ATOMIC_VAR_INIT(0);
+        std::atomic<uint64_t> stats_windows = ATOMIC_VAR_INIT(0);
+        std::atomic<uint64_t> stats_retries = ATOMIC_VAR_INIT(0);
+        std::atomic<uint64_t> stats_ddos = ATOMIC_VAR_INIT(0);
+        std::atomic<uint64_t> stats_ticks = ATOMIC_VAR_INIT(0);
+        std::atomic<uint64_t> stats_duplicates = ATOMIC_VAR_INIT(0);
+
+        static double get_time() {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        /** \brief Получить начало следующих суток по времени сервера
+         */
+        static inline xtime::timestamp_t get_next_server_day(const xtime::timestamp_t timestamp) {
+            return xtime::get_first_timestamp_day(timestamp + GMT_OFFSET) + xtime::SECONDS_IN_DAY - GMT_OFFSET;
+        }
+
+        /** \brief Убрать тики, которые уже есть в архиве
+         *
+         * Нужно для дня, запись которого прервалась между записью тиков и манифеста
+         * \param path Директория архива
+         * \param job День символа
+         * \param ticks Тики дня
+         */
+        void remove_recorded_ticks(const std::string &path, const Job &job, std::vector<RecordedTick> &ticks) {
+            /* в одну секунду может быть несколько одинаковых тиков, поэтому считаем их количество */
+            std::map<std::tuple<int64_t, int64_t, int64_t>, uint32_t> recorded;
+            TickArchiveReader reader(path);
+            reader.for_each(
+                    (xtime::ftimestamp_t)job.day,
+                    (xtime::ftimestamp_t)(job.day + xtime::SECONDS_IN_DAY) - 0.000001,
+                    [&](const RecordedTick &tick) -> bool {
+                if(tick.symbol_index != job.symbol_index) return true;
+                ++recorded[std::make_tuple(TickArchive::to_microseconds(tick.server_timestamp), tick.bid.ticks, tick.ask.ticks)];
+                return true;
+            });
+            if(recorded.empty()) return;
+            size_t size = 0;
+            for(size_t i = 0; i < ticks.size(); ++i) {
+                auto it = recorded.find(std::make_tuple(
+                    TickArchive::to_microseconds(ticks[i].server_timestamp), ticks[i].bid.ticks, ticks[i].ask.ticks));
+                if(it != recorded.end() && it->second > 0) {
+                    --it->second;
+                    ++stats_duplicates;
+                    continue;
+                }
+                ticks[size++] = ticks[i];
+            }
+            ticks.resize(size);
+        }
+
+        /** \brief Собрать день из окон и записать его
+         */
+        void persist_job(Job &job, TickRecorder &recorder) {
+            std::vector<RecordedTick> ticks;
+            for(size_t i = 0; i < job.windows.size(); ++i) {
+                ticks.insert(ticks.end(), job.windows[i].begin(), job.windows[i].end());
+                std::vector<RecordedTick>().swap(job.windows[i]);
+            }
+
+            std::lock_guard<std::mutex> lock(persist_mutex);
+            HistoryManifest &manifest = *manifests[job.symbol_index];
+            if(ticks.empty()) {
+                manifest.set_empty(job.day);
+                ++stats_empty;
+            } else {
+                /* отметка начатого дня: прошлая запись дня могла прерваться до сохранения манифеста */
+                if(manifest.get_watermark(job.day) != 0) {
+                    remove_recorded_ticks(recorder.get_path(), job, ticks);
+                } else {
+                    manifest.set_watermark(job.day);
+                    if(manifest.save() != OK) {
+                        ++stats_failed;
+                        return;
+                    }
+                }
+                recorder.write(ticks);
+                /* день отмечается в манифесте только после записи блоков на диск */
+                recorder.flush();
+                if(recorder.get_last_error() != OK) {
+                    ++stats_failed;
+                    return;
+                }
+                manifest.set_complete(job.day);
+                stats_ticks += ticks.size();
+                ++stats_completed;
+            }
+            manifest.save();
+        }
+
+        /** \brief Завершить окно
+         */
+        void finish_window(const Window &window, const bool is_failed, TickRecorder &recorder) {
+            Job *job = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(windows_mutex);
+                Job &window_job = jobs[window.job];
+                if(is_failed) window_job.is_failed = true;
+                if(--window_job.remaining != 0) return;
+                job = &window_job;
+            }
+            if(job->is_failed) {
+                ++stats_failed;
+                for(size_t i = 0; i < job->windows.size(); ++i) {
+                    std::vector<RecordedTick>().swap(job->windows[i]);
+                }
+                return;
+            }
+            persist_job(*job, recorder);
+        }
+
+        /** \brief Получить окно
+         * \param window Окно
+         * \return Вернет false, если окон больше нет
+         */
+        bool get_window(Window &window) {
+            {
+                std::lock_guard<std::mutex> lock(windows_mutex);
+                if(windows.empty()) return false;
+                window = windows.front();
+                windows.pop_front();
+            }
+            /* окно после ошибки ждет своей очереди, остальные окна в это время берут другие потоки */
+            while(!is_stop) {
+                const double wait_time = window.ready_time - get_time();
+                if(wait_time <= 0) break;
+                std::this_thread::sleep_for(std::chrono::milliseconds(
+                    (uint64_t)(std::min(wait_time, 0.1) * 1000.0) + 1));
+            }
+            return !is_stop;
+        }
+
+        /** \brief Поток загрузки окон
+         * \param worker Номер потока
+         * \param recorder Архив тиков
+         */
+        void run_worker(const uint32_t worker, TickRecorder &recorder) {
+            IntradeBarHttpApi api(
+                point,
+                sert_file,
+                cookie_file,
+                file_name_bets_log,
+                file_name_work_log);
+            std::mt19937 rng(std::random_device{}() ^ (worker * 0x9E3779B9U));
+            std::vector<double> prices;
+            std::vector<xtime::timestamp_t> timestamps;
+            Window window;
+            while(get_window(window)) {
+                const uint32_t symbol_index = jobs[window.job].symbol_index;
+                /* запрос захватывает следующую минуту, но не переходит через полночь GMT+3 */
+                const xtime::timestamp_t request_end = std::min(
+                    window.end + xtime::SECONDS_IN_MINUTE,
+                    get_next_server_day(window.begin));
+
+                concurrency.acquire(is_stop);
+                if(is_stop) {
+                    concurrency.release();
+                    break;
+                }
+                prices.clear();
+                timestamps.clear();
+                const double start_time = get_time();
+                const int err = api.get_quotes(
+                    symbol_index,
+                    window.begin,
+                    request_end - window.begin,
+                    prices,
+                    timestamps);
+                const double latency = get_time() - start_time;
+                concurrency.release();
+
+                if(err == OK || err == NO_DATA_IN_RESPONSE) {
+                    concurrency.on_success(latency);
+                } else {
+                    if(err == DDOS_GUARD_DETECTED) ++stats_ddos;
+                    concurrency.on_overload(latency);
+                    if((window.attempt + 1) < max_attempts) {
+                        ++window.attempt;
+                        ++stats_retries;
+                        const double backoff = std::min(backoff_max, backoff_base * (double)(1ULL << std::min(window.attempt, 16U)));
+                        std::uniform_real_distribution<double> jitter(0.5, 1.5);
+                        window.ready_time = get_time() + backoff * jitter(rng);
+                        std::lock_guard<std::mutex> lock(windows_mutex);
+                        windows.push_back(window);
+                        continue;
+                    }
+                    finish_window(window, true, recorder);
+                    continue;
+                }
+
+                /* из окна берем только тики его диапазона, остальное - перекрытие с соседним окном */
+                std::vector<RecordedTick> ticks;
+                ticks.reserve(prices.size());
+                for(size_t i = 0; i < prices.size(); ++i) {
+                    if(timestamps[i] < window.begin || timestamps[i] >= window.end) {
+                        ++stats_duplicates;
+                        continue;
+                    }
+                    RecordedTick tick;
+                    tick.symbol_index = symbol_index;
+                    tick.bid = tick.ask = get_price(prices[i], symbol_index);
+                    tick.server_timestamp = tick.local_timestamp = (xtime::ftimestamp_t)timestamps[i];
+                    ticks.push_back(tick);
+                }
+                std::stable_sort(ticks.begin(), ticks.end(), [](const RecordedTick &a, const RecordedTick &b) {
+                    return a.server_timestamp < b.server_timestamp;
+                });
+                jobs[window.job].windows[window.index].swap(ticks);
+                ++stats_windows;
+                finish_window(window, false, recorder);
+            }
+        }
+
+    public:
+
+        /** \brief Конструктор загрузчика тиков
+         * \param user_point Точка доступа к брокерку
+         * \param user_sert_file Файл-сертификат
+         * \param user_cookie_file Файл для записи cookie
+         * \param user_file_name_bets_log Файл для записи логов работы со сделками
+         * \param user_file_name_work_log Файл для записи логов работы http клиента
+         */
+        TickBackfill(
+                const std::string &user_point = "1.intrade.bar",
+                const std::string &user_sert_file = "curl-ca-bundle.crt",
+                const std::string &user_cookie_file = "intrade-bar.cookie",
+                const std::string &user_file_name_bets_log = "logger/intrade-bar-bets.log",
+                const std::string &user_file_name_work_log = "logger/intrade-bar-https-work.log") :
+                point(user_point),
+                sert_file(user_sert_file),
+                cookie_file(user_cookie_file),
+                file_name_bets_log(user_file_name_bets_log),
+                file_name_work_log(user_file_name_work_log) {
+            set_concurrency(1, 8, 2);
+        };
+
+        ~TickBackfill() {
+            stop();
+        }
+
+        /** \brief Разбить день на окна запроса /quotes
+         * \param day Метка времени начала дня (UTC)
+         * \param minutes Длительность окна в минутах
+         * \param ranges Диапазоны окон [начало, конец)
+         */
+        static void plan_windows(
+                const xtime::timestamp_t day,
+                const uint32_t minutes,
+                std::vector<std::pair<xtime::timestamp_t, xtime::timestamp_t>> &ranges) {
+            ranges.clear();
+            const xtime::timestamp_t first = xtime::get_first_timestamp_day(day);
+            const xtime::timestamp_t last = first + xtime::SECONDS_IN_DAY;
+            const xtime::timestamp_t length = std::max(1U, minutes) * xtime::SECONDS_IN_MINUTE;
+            xtime::timestamp_t begin = first;
+            while(begin < last) {
+                const xtime::timestamp_t end = std::min(std::min(begin + length, last), get_next_server_day(begin));
+                ranges.push_back(std::make_pair(begin, end));
+                begin = end;
+            }
+        }
+
+        /** \brief Установить количество одновременных запросов
+         * \param min_limit Минимальное количество
+         * \param max_limit Максимальное количество, равно числу потоков
+         * \param initial_limit Начальное количество
+         */
+        void set_concurrency(const uint32_t min_limit, const uint32_t max_limit, const uint32_t initial_limit) {
+            number_workers = std::max(1U, max_limit);
+            concurrency.set_limits(min_limit, max_limit, initial_limit);
+        }
+
+        /** \brief Установить длительность окна запроса
+         * \param minutes Длительность окна в минутах
+         */
+        void set_window(const uint32_t minutes) {
+            window_minutes = std::max(1U, std::min(minutes, (uint32_t)xtime::MINUTES_IN_DAY));
+        }
+
+        /** \brief Установить параметры повторных попыток
+         * \param user_max_attempts Максимальное количество попыток загрузки окна
+         * \param user_backoff_base Задержка после первой неудачной попытки, с
+         * \param user_backoff_max Максимальная задержка, с
+         */
+        void set_retry(const uint32_t user_max_attempts, const double user_backoff_base, const double user_backoff_max) {
+            max_attempts = std::max(1U, user_max_attempts);
+            backoff_base = user_backoff_base;
+            backoff_max = user_backoff_max;
+        }
+
+        /** \brief Загрузить тики символа за период
+         *
+         * Дни, которые манифест уже отметил загруженными, пропускаются.
+         * Загрузка выполняется при вызове run()
+         * \param path Директория архива тиков
+         * \param symbol_index Индекс символа
+         * \param date_start Метка времени первого дня
+         * \param date_stop Метка времени последнего дня (включительно), день должен быть завершен
+         * \return Код ошибки
+         */
+        int add_days(
+                const std::string &path,
+                const uint32_t symbol_index,
+                const xtime::timestamp_t date_start,
+                const xtime::timestamp_t date_stop) {
+            if(symbol_index >= CURRENCY_PAIRS) return INVALID_ARGUMENT;
+            const xtime::timestamp_t first_day = xtime::get_first_timestamp_day(date_start);
+            const xtime::timestamp_t last_day = xtime::get_first_timestamp_day(date_stop);
+            if(last_day < first_day) return INVALID_ARGUMENT;
+            if(!manifests[symbol_index]) {
+                manifests[symbol_index] = std::make_shared<HistoryManifest>(
+                    path + "/" + currency_pairs[symbol_index] + ".ticks.json");
+                manifests[symbol_index]->load();
+            }
+            std::vector<std::pair<xtime::timestamp_t, xtime::timestamp_t>> ranges;
+            for(xtime::timestamp_t day = first_day; day <= last_day; day += xtime::SECONDS_IN_DAY) {
+                if(manifests[symbol_index]->is_done(day)) continue;
+                plan_windows(day, window_minutes, ranges);
+                Job job;
+                job.symbol_index = symbol_index;
+                job.day = day;
+                job.windows.resize(ranges.size());
+                job.remaining = ranges.size();
+                jobs.push_back(job);
+                ++stats_days;
+                for(size_t i = 0; i < ranges.size(); ++i) {
+                    Window window;
+                    window.job = jobs.size() - 1;
+                    window.index = i;
+                    window.begin = ranges[i].first;
+                    window.end = ranges[i].second;
+                    windows.push_back(window);
+                }
+            }
+            return OK;
+        }
+
+        /** \brief Выполнить загрузку
+         *
+         * Метод блокирует вызывающий поток до загрузки всех окон
+         * \param recorder Архив тиков
+         * \return Код ошибки, OK если все дни загружены
+         */
+        int run(TickRecorder &recorder) {
+            is_stop = false;
+            /* окна дней идут подряд, поэтому в памяти одновременно собирается лишь несколько дней */
+            std::vector<std::future<void>> workers;
+            for(uint32_t w = 0; w < number_workers; ++w) {
+                workers.push_back(std::async(std::launch::async, [&, w]() {
+                    run_worker(w, recorder);
+                }));
+            }
+            int err = OK;
+            for(size_t w = 0; w < workers.size(); ++w) {
+                try {
+                    workers[w].get();
+                }
+                catch(...) {
+                    err = STRANGE_PROGRAM_BEHAVIOR;
+                }
+            }
+            {
+                std::lock_guard<std::mutex> lock(windows_mutex);
+                windows.clear();
+                jobs.clear();
+            }
+            if(err != OK) return err;
+            if(is_stop) return DATA_NOT_AVAILABLE;
+            return stats_failed == 0 ? OK : DATA_NOT_AVAILABLE;
+        }
+
+        /** \brief Остановить загрузку
+         */
+        void stop() {
+            is_stop = true;
+            concurrency.notify_all();
+        }
+
+        /** \brief Получить статистику загрузки
+         */
+        Stats get_stats() {
+            Stats stats;
+            stats.days = stats_days;
+            stats.completed = stats_completed;
+            stats.empty = stats_empty;
+            stats.failed = stats_failed;
+            stats.windows = stats_windows;
+            stats.retries = stats_retries;
+            stats.ddos = stats_ddos;
+            stats.ticks = stats_ticks;
+            stats.duplicates = stats_duplicates;
+            stats.limit = concurrency.get_limit();
+            return stats;
+        }
+    };
+}
+
+#endif // INTRADE_BAR_TICK_BACKFILL_HPP_INCLUDED
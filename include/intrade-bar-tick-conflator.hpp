@@ -0,0 +1,169 @@
+/*
+* intrade-bar-api-cpp - C ++ API client for intrade.bar
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef INTRADE_BAR_TICK_CONFLATOR_HPP_INCLUDED
+#define INTRADE_BAR_TICK_CONFLATOR_HPP_INCLUDED
+
+#include <intrade-bar-common.hpp>
+#include <xtime.hpp>
+#include <mutex>
+#include <atomic>
+#include <vector>
+
+namespace intrade_bar {
+    using namespace intrade_bar_common;
+
+    /** \brief Свернутый тик
+     *
+     * Содержит последнее состояние символа и экстремумы цены
+     * за время с прошлого чтения
+     */
+    class ConflatedTick {
+    public:
+        uint32_t symbol_index = 0;
+        double price = 0;                   /**< Последняя цена (bid+ask)/2 */
+        double bid = 0;                     /**< Последний bid */
+        double ask = 0;                     /**< Последний ask */
+        double high = 0;                    /**< Максимальная цена с прошлого чтения */
+        double low = 0;                     /**< Минимальная цена с прошлого чтения */
+        xtime::ftimestamp_t timestamp = 0;  /**< Метка времени последнего тика */
+        uint32_t count = 0;                 /**< Количество тиков, свернутых в этот снимок */
+        ConflatedTick() {};
+    };
+
+    /** \brief Класс для свертки тиков
+     *
+     * Поток котировок записывает каждый тик, а потребитель забирает снимок
+     * в удобном для себя темпе. Цены high и low учитывают все свернутые тики,
+     * поэтому экстремумы формирующегося бара не теряются.
+     */
+    class TickConflator {
+    private:
+        std::array<ConflatedTick, CURRENCY_PAIRS> ticks;
+        std::array<std::mutex, CURRENCY_PAIRS> ticks_mutex;
+        std::atomic<uint32_t> update_mask;  /**< Маска символов, у которых есть новые тики */
+
+        /** \brief Найти номер младшего установленного бита маски
+         */
+        static inline uint32_t get_lowest_bit(const uint32_t mask) {
+#           if defined(__GNUC__)
+            return (uint32_t)__builtin_ctz(mask);
+#           else
+            uint32_t index = 0;
+            while(!(mask & ((uint32_t)1 << index))) ++index;
+            return index;
+#           endif
+        }
+
+    public:
+
+        TickConflator() {
+            update_mask = 0;
+            for(size_t s = 0; s < CURRENCY_PAIRS; ++s) {
+                ticks[s].symbol_index = s;
+            }
+        };
+
+        /** \brief Добавить тик
+         * \param symbol_index Индекс символа
+         * \param bid Цена bid
+         * \param ask Цена ask
+         * \param price Цена (bid+ask)/2
+         * \param timestamp Метка времени тика
+         */
+        inline void update(
+                const size_t symbol_index,
+                const double bid,
+                const double ask,
+                const double price,
+                const xtime::ftimestamp_t timestamp) {
+            if(symbol_index >= CURRENCY_PAIRS) return;
+            {
+                std::lock_guard<std::mutex> lock(ticks_mutex[symbol_index]);
+                ConflatedTick &tick = ticks[symbol_index];
+                if(tick.count == 0) {
+                    tick.high = price;
+                    tick.low = price;
+                } else {
+                    if(price > tick.high) tick.high = price;
+                    if(price < tick.low) tick.low = price;
+                }
+                tick.price = price;
+                tick.bid = bid;
+                tick.ask = ask;
+                tick.timestamp = timestamp;
+                ++tick.count;
+            }
+            update_mask |= ((uint32_t)1 << symbol_index);
+        }
+
+        /** \brief Забрать снимок символа
+         * \param symbol_index Индекс символа
+         * \param tick Снимок. Поле count равно числу свернутых тиков
+         * \return вернет true, если с прошлого чтения были тики
+         */
+        inline bool pull(const size_t symbol_index, ConflatedTick &tick) {
+            if(symbol_index >= CURRENCY_PAIRS) return false;
+            const uint32_t bit = ((uint32_t)1 << symbol_index);
+            if(!(update_mask & bit)) return false;
+            update_mask &= ~bit;
+            std::lock_guard<std::mutex> lock(ticks_mutex[symbol_index]);
+            if(ticks[symbol_index].count == 0) return false;
+            tick = ticks[symbol_index];
+            ticks[symbol_index].count = 0;
+            return true;
+        }
+
+        /** \brief Забрать снимки всех символов, у которых были тики
+         * \param output Массив снимков. Массив очищается перед заполнением
+         * \return вернет true, если есть хотя бы один снимок
+         */
+        inline bool pull(std::vector<ConflatedTick> &output) {
+            output.clear();
+            uint32_t mask = update_mask.exchange(0);
+            if(mask == 0) return false;
+            /* обходим только символы с новыми тиками */
+            while(mask != 0) {
+                const uint32_t s = get_lowest_bit(mask);
+                mask &= mask - 1;
+                std::lock_guard<std::mutex> lock(ticks_mutex[s]);
+                if(ticks[s].count == 0) continue;
+                output.push_back(ticks[s]);
+                ticks[s].count = 0;
+            }
+            return !output.empty();
+        }
+
+        /** \brief Получить последний снимок символа без сброса счетчика
+         * \param symbol_index Индекс символа
+         * \return Снимок
+         */
+        inline ConflatedTick peek(const size_t symbol_index) {
+            if(symbol_index >= CURRENCY_PAIRS) return ConflatedTick();
+            std::lock_guard<std::mutex> lock(ticks_mutex[symbol_index]);
+            return ticks[symbol_index];
+        }
+    };
+}
+
+#endif // INTRADE_BAR_TICK_CONFLATOR_HPP_INCLUDED
@@ -0,0 +1,751 @@
+/*
+* intrade-bar-api-cpp - C ++ API client for intrade.bar
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef INTRADE_BAR_TICK_RECORDER_HPP_INCLUDED
+#define INTRADE_BAR_TICK_RECORDER_HPP_INCLUDED
+
+#include <intrade-bar-common.hpp>
+#include <xtime.hpp>
+#include <fstream>
+#include <vector>
+#include <array>
+#include <deque>
+#include <string>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#endif
+#include "zstd.h"
+
+namespace intrade_bar {
+
+    /** \brief Записанный тик
+     */
+    class RecordedTick {
+    public:
+        xtime::ftimestamp_t server_timestamp = 0;   /**< Метка времени сервера */
+        xtime::ftimestamp_t local_timestamp = 0;    /**< Метка времени получения тика */
+        intrade_bar_common::Price bid;
+        intrade_bar_common::Price ask;
+        uint32_t symbol_index = 0;
+
+        RecordedTick() {};
+    };
+
+    /** \brief Формат архива тиков
+     *
+     * Архив - директория с файлами сегментов за каждый час ticks-ГГГГ-ММ-ДД-ЧЧ.ibt (время сервера, UTC).
+     * Сегмент - последовательность независимых блоков: заголовок BlockHeader и данные, сжатые zstd.
+     * Данные блока хранятся по колонкам: номер символа (байт), затем varint со знаком (zigzag)
+     * для разницы меток времени сервера в микросекундах, задержки получения тика,
+     * изменения bid внутри символа и спреда ask - bid в тиках цены.
+     * Рядом с сегментом пишется индекс *.idx из записей IndexEntry для поиска по времени.
+     * Индекс дописывается после блока, поэтому при сбое читатель досканирует заголовки блоков сегмента.
+     * Перед дописыванием в существующий сегмент запись проверяет его и убирает оборванный блок в конце.
+     */
+    class TickArchive {
+    public:
+        static const uint32_t BLOCK_MAGIC = 0x42544249; /**< "IBTB" */
+
+        class BlockHeader {
+        public:
+            uint32_t magic = BLOCK_MAGIC;
+            uint32_t compressed_size = 0;   /**< Размер сжатых данных блока */
+            uint32_t raw_size = 0;          /**< Размер данных блока до сжатия */
+            uint32_t count = 0;             /**< Количество тиков */
+            int64_t first_time = 0;         /**< Минимальная метка времени сервера, мкс */
+            int64_t last_time = 0;          /**< Максимальная метка времени сервера, мкс */
+        };
+
+        class IndexEntry {
+        public:
+            int64_t first_time = 0;         /**< Минимальная метка времени сервера, мкс */
+            int64_t last_time = 0;          /**< Максимальная метка времени сервера, мкс */
+            uint64_t offset = 0;            /**< Смещение заголовка блока в сегменте */
+            uint32_t compressed_size = 0;
+            uint32_t count = 0;
+        };
+
+        static_assert(sizeof(BlockHeader) == 32, "BlockHeader size must be 32 bytes");
+        static_assert(sizeof(IndexEntry) == 32, "IndexEntry size must be 32 bytes");
+
+        static inline int64_t to_microseconds(const xtime::ftimestamp_t timestamp) {
+            return (int64_t)std::llround(timestamp * 1000000.0);
+        }
+
+        static inline xtime::ftimestamp_t to_ftimestamp(const int64_t microseconds) {
+            return (xtime::ftimestamp_t)microseconds / 1000000.0;
+        }
+
+        /** \brief Получить имя файла сегмента
+         * \param path Директория архива
+         * \param timestamp Метка времени внутри часа
+         */
+        static std::string get_segment_name(const std::string &path, const xtime::timestamp_t timestamp) {
+            xtime::DateTime date_time(xtime::get_first_timestamp_hour(timestamp));
+            char name[64];
+            std::snprintf(name, sizeof(name), "ticks-%04d-%02d-%02d-%02d.ibt",
+                (int)date_time.year, (int)date_time.month, (int)date_time.day, (int)date_time.hour);
+            if(path.empty()) return std::string(name);
+            const char last = path.back();
+            if(last == '/' || last == '\\') return path + name;
+            return path + "/" + name;
+        }
+
+        static inline void write_varint(std::vector<uint8_t> &output, const int64_t value) {
+            uint64_t data = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+            while(data >= 0x80) {
+                output.push_back((uint8_t)(data | 0x80));
+                data >>= 7;
+            }
+            output.push_back((uint8_t)data);
+        }
+
+        static inline bool read_varint(const uint8_t *&ptr, const uint8_t *end, int64_t &value) {
+            uint64_t data = 0;
+            uint32_t shift = 0;
+            while(ptr < end && shift < 64) {
+                const uint8_t byte = *ptr++;
+                data |= (uint64_t)(byte & 0x7F) << shift;
+                if(!(byte & 0x80)) {
+                    value = (int64_t)(data >> 1) ^ -(int64_t)(data & 1);
+                    return true;
+                }
+                shift += 7;
+            }
+            return false;
+        }
+
+        /** \brief Закодировать тики блока
+         * \param ticks Тики
+         * \param output Данные блока до сжатия
+         * \param header Заголовок блока
+         */
+        static void encode_block(
+                const std::vector<RecordedTick> &ticks,
+                std::vector<uint8_t> &output,
+                BlockHeader &header) {
+            output.clear();
+            header = BlockHeader();
+            header.count = ticks.size();
+            if(ticks.empty()) return;
+            header.first_time = header.last_time = to_microseconds(ticks[0].server_timestamp);
+            for(const RecordedTick &tick : ticks) {
+                output.push_back((uint8_t)tick.symbol_index);
+            }
+            int64_t last_time = header.first_time;
+            for(const RecordedTick &tick : ticks) {
+                const int64_t time = to_microseconds(tick.server_timestamp);
+                write_varint(output, time - last_time);
+                last_time = time;
+                header.first_time = std::min(header.first_time, time);
+                header.last_time = std::max(header.last_time, time);
+            }
+            for(const RecordedTick &tick : ticks) {
+                write_varint(output, to_microseconds(tick.local_timestamp) - to_microseconds(tick.server_timestamp));
+            }
+            std::array<int64_t, intrade_bar_common::CURRENCY_PAIRS> last_bid;
+            last_bid.fill(0);
+            for(const RecordedTick &tick : ticks) {
+                write_varint(output, tick.bid.ticks - last_bid[tick.symbol_index]);
+                last_bid[tick.symbol_index] = tick.bid.ticks;
+            }
+            for(const RecordedTick &tick : ticks) {
+                write_varint(output, tick.ask.ticks - tick.bid.ticks);
+            }
+            header.raw_size = output.size();
+        }
+
+        /** \brief Декодировать тики блока
+         * \param data Данные блока до сжатия
+         * \param size Размер данных
+         * \param header Заголовок блока
+         * \param ticks Тики
+         * \return Вернет true, если данные блока корректны
+         */
+        static bool decode_block(
+                const uint8_t *data,
+                const size_t size,
+                const BlockHeader &header,
+                std::vector<RecordedTick> &ticks) {
+            const uint32_t count = header.count;
+            ticks.resize(count);
+            if(size < count) return false;
+            const uint8_t *ptr = data;
+            const uint8_t *end = data + size;
+            for(uint32_t i = 0; i < count; ++i) {
+                const uint32_t symbol_index = *ptr++;
+                if(symbol_index >= intrade_bar_common::CURRENCY_PAIRS) return false;
+                ticks[i].symbol_index = symbol_index;
+                ticks[i].bid.scale = ticks[i].ask.scale = intrade_bar_common::pricescale_currency_pairs[symbol_index];
+            }
+            int64_t time = header.first_time;
+            std::vector<int64_t> times(count);
+            for(uint32_t i = 0; i < count; ++i) {
+                int64_t delta = 0;
+                if(!read_varint(ptr, end, delta)) return false;
+                time += delta;
+                times[i] = time;
+                ticks[i].server_timestamp = to_ftimestamp(time);
+            }
+            for(uint32_t i = 0; i < count; ++i) {
+                int64_t delay = 0;
+                if(!read_varint(ptr, end, delay)) return false;
+                ticks[i].local_timestamp = to_ftimestamp(times[i] + delay);
+            }
+            std::array<int64_t, intrade_bar_common::CURRENCY_PAIRS> last_bid;
+            last_bid.fill(0);
+            for(uint32_t i = 0; i < count; ++i) {
+                int64_t delta = 0;
+                if(!read_varint(ptr, end, delta)) return false;
+                last_bid[ticks[i].symbol_index] += delta;
+                ticks[i].bid.ticks = last_bid[ticks[i].symbol_index];
+            }
+            for(uint32_t i = 0; i < count; ++i) {
+                int64_t spread = 0;
+                if(!read_varint(ptr, end, spread)) return false;
+                ticks[i].ask.ticks = ticks[i].bid.ticks + spread;
+            }
+            return ptr == end;
+        }
+
+        /** \brief Прочитать заголовок блока
+         * \return Вернет true, если заголовок корректен и блок целиком есть в файле
+         */
+        static bool read_block_header(
+                std::ifstream &data_file,
+                const uint64_t offset,
+                const uint64_t file_size,
+                BlockHeader &header) {
+            if(offset + sizeof(BlockHeader) > file_size) return false;
+            data_file.clear();
+            data_file.seekg(offset);
+            if(!data_file.read((char*)&header, sizeof(header))) return false;
+            if(header.magic != BLOCK_MAGIC) return false;
+            return (offset + sizeof(header) + header.compressed_size) <= file_size;
+        }
+
+        /** \brief Загрузить индекс сегмента
+         *
+         * Блоки, которые не попали в индекс из-за сбоя, находятся по заголовкам.
+         * Если после оборванного блока в сегмент дописывались новые блоки,
+         * они находятся по записям индекса, указывающим на целые блоки
+         * \param data_file Файл сегмента
+         * \param file_name Имя файла сегмента
+         * \param entries Записи целых блоков сегмента по порядку
+         * \return Размер начала сегмента, в котором блоки идут подряд без повреждений
+         */
+        static uint64_t load_index(
+                std::ifstream &data_file,
+                const std::string &file_name,
+                std::vector<IndexEntry> &entries) {
+            entries.clear();
+            data_file.clear();
+            data_file.seekg(0, std::ios_base::end);
+            const uint64_t file_size = data_file.tellg();
+            std::vector<IndexEntry> index;
+            {
+                std::ifstream index_file(file_name + ".idx", std::ios_base::binary);
+                IndexEntry entry;
+                while(index_file.read((char*)&entry, sizeof(entry))) {
+                    index.push_back(entry);
+                }
+            }
+            uint64_t offset = 0;
+            size_t i = 0;
+            for(; i < index.size(); ++i) {
+                if(index[i].offset != offset) break;
+                const uint64_t next = index[i].offset + sizeof(BlockHeader) + index[i].compressed_size;
+                if(next > file_size) break;
+                entries.push_back(index[i]);
+                offset = next;
+            }
+            BlockHeader header;
+            IndexEntry entry;
+            while(read_block_header(data_file, offset, file_size, header)) {
+                entry.first_time = header.first_time;
+                entry.last_time = header.last_time;
+                entry.offset = offset;
+                entry.compressed_size = header.compressed_size;
+                entry.count = header.count;
+                entries.push_back(entry);
+                offset += sizeof(header) + header.compressed_size;
+            }
+            const uint64_t valid_size = offset;
+            /* оборванный блок не скрывает блоки, записанные после него */
+            for(; i < index.size(); ++i) {
+                if(index[i].offset < offset) continue;
+                if(!read_block_header(data_file, index[i].offset, file_size, header)) continue;
+                if(header.compressed_size != index[i].compressed_size || header.count != index[i].count) continue;
+                entries.push_back(index[i]);
+                offset = index[i].offset + sizeof(header) + header.compressed_size;
+            }
+            data_file.clear();
+            return valid_size;
+        }
+
+        /** \brief Восстановить сегмент после сбоя
+         *
+         * Если сегмент заканчивается оборванным блоком, содержит поврежденные данные
+         * или его индекс не совпадает с блоками, целые блоки переписываются подряд
+         * во временные файлы, которые затем заменяют сегмент и индекс
+         * \param file_name Имя файла сегмента
+         * \return Код ошибки, 0 если ошибок нет или сегмента еще нет
+         */
+        static int repair_segment(const std::string &file_name) {
+            const std::string index_name = file_name + ".idx";
+            std::vector<IndexEntry> entries;
+            {
+                std::ifstream data_file(file_name, std::ios_base::binary);
+                if(!data_file) return intrade_bar_common::OK;
+                const uint64_t valid_size = load_index(data_file, file_name, entries);
+                data_file.seekg(0, std::ios_base::end);
+                const uint64_t file_size = data_file.tellg();
+                std::ifstream index_file(index_name, std::ios_base::binary | std::ios_base::ate);
+                const uint64_t index_size = index_file ? (uint64_t)index_file.tellg() : 0;
+                if(valid_size == file_size && index_size == entries.size() * sizeof(IndexEntry)) {
+                    /* индекс мог отставать после сбоя, его дописывает load_index по заголовкам */
+                    bool is_same = true;
+                    IndexEntry entry;
+                    index_file.seekg(0);
+                    for(size_t i = 0; i < entries.size() && is_same; ++i) {
+                        is_same = index_file.read((char*)&entry, sizeof(entry)) &&
+                            entry.offset == entries[i].offset &&
+                            entry.compressed_size == entries[i].compressed_size;
+                    }
+                    if(is_same) return intrade_bar_common::OK;
+                }
+
+                std::ofstream temp_data(file_name + ".tmp", std::ios_base::binary | std::ios_base::trunc);
+                std::ofstream temp_index(index_name + ".tmp", std::ios_base::binary | std::ios_base::trunc);
+                if(!temp_data || !temp_index) return intrade_bar_common::STRANGE_PROGRAM_BEHAVIOR;
+                std::vector<char> block;
+                uint64_t offset = 0;
+                for(IndexEntry &block_entry : entries) {
+                    block.resize(sizeof(BlockHeader) + block_entry.compressed_size);
+                    data_file.clear();
+                    data_file.seekg(block_entry.offset);
+                    if(!data_file.read(block.data(), block.size())) return intrade_bar_common::STRANGE_PROGRAM_BEHAVIOR;
+                    temp_data.write(block.data(), block.size());
+                    block_entry.offset = offset;
+                    temp_index.write((const char*)&block_entry, sizeof(block_entry));
+                    offset += block.size();
+                }
+                temp_data.flush();
+                temp_index.flush();
+                if(!temp_data || !temp_index) return intrade_bar_common::STRANGE_PROGRAM_BEHAVIOR;
+            }
+            /* индекс заменяется после данных: устаревший индекс читатель досканирует по заголовкам */
+            if(!replace_file(file_name + ".tmp", file_name)) return intrade_bar_common::STRANGE_PROGRAM_BEHAVIOR;
+            if(!replace_file(index_name + ".tmp", index_name)) return intrade_bar_common::STRANGE_PROGRAM_BEHAVIOR;
+            return intrade_bar_common::OK;
+        }
+
+    private:
+
+        static bool replace_file(const std::string &temp_file_name, const std::string &file_name) {
+#           if defined(_WIN32) || defined(_WIN64)
+            return MoveFileExA(temp_file_name.c_str(), file_name.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#           else
+            return std::rename(temp_file_name.c_str(), file_name.c_str()) == 0;
+#           endif
+        }
+    };
+
+    /** \brief Запись тиков в сжатый архив
+     *
+     * Метод write только добавляет тик в буфер, поэтому его можно вызывать из потока вебсокета.
+     * Кодирование, сжатие и запись блоков выполняет фоновый поток.
+     * Блок закрывается, когда в нем BLOCK_TICKS тиков или прошло FLUSH_DELAY мс.
+     */
+    class TickRecorder {
+    public:
+        static const uint32_t BLOCK_TICKS = 8192;   /**< Максимальное количество тиков в блоке */
+        static const uint32_t FLUSH_DELAY = 1000;   /**< Максимальное время хранения тиков в буфере, мс */
+
+    private:
+        const std::string path;
+        const int level;
+
+        std::mutex buffer_mutex;
+        std::condition_variable buffer_cv;
+        std::condition_variable flush_cv;
+        std::vector<RecordedTick> buffer;
+        std::deque<std::vector<RecordedTick>> queue;
+        uint64_t pushed_blocks = 0;
+        uint64_t written_blocks = 0;
+        bool is_shutdown = false;
+
+        std::atomic<uint64_t> recorded_ticks = ATOMIC_VAR_INIT(0);
+        std::atomic<int> last_error = ATOMIC_VAR_INIT(intrade_bar_common::OK);
+        std::thread writer_thread;
+
+        /* состояние фонового потока */
+        std::ofstream data_file;
+        std::ofstream index_file;
+        xtime::timestamp_t segment_hour = 0;
+        ZSTD_CCtx *cctx = nullptr;
+        std::vector<uint8_t> raw_data;
+        std::vector<uint8_t> compressed_data;
+
+        /** \brief Открыть сегмент часа
+         */
+        bool open_segment(const xtime::timestamp_t hour) {
+            if(hour == segment_hour && data_file.is_open()) return true;
+            if(data_file.is_open()) data_file.close();
+            if(index_file.is_open()) index_file.close();
+            segment_hour = hour;
+            const std::string file_name = TickArchive::get_segment_name(path, hour);
+            /* сегмент, записанный до сбоя, может заканчиваться оборванным блоком,
+             * новые блоки нельзя дописывать за ним
+             */
+            if(TickArchive::repair_segment(file_name) != intrade_bar_common::OK) return false;
+            data_file.open(file_name, std::ios_base::binary | std::ios_base::app);
+            index_file.open(file_name + ".idx", std::ios_base::binary | std::ios_base::app);
+            return data_file.is_open() && index_file.is_open();
+        }
+
+        /** \brief Сжать и записать блок одного часа
+         */
+        int write_block(const std::vector<RecordedTick> &ticks) {
+            TickArchive::BlockHeader header;
+            TickArchive::encode_block(ticks, raw_data, header);
+            compressed_data.resize(ZSTD_compressBound(raw_data.size()));
+            const size_t size = ZSTD_compressCCtx(
+                cctx,
+                compressed_data.data(), compressed_data.size(),
+                raw_data.data(), raw_data.size(),
+                level);
+            if(ZSTD_isError(size)) return intrade_bar_common::STRANGE_PROGRAM_BEHAVIOR;
+            header.compressed_size = size;
+
+            const xtime::timestamp_t hour = xtime::get_first_timestamp_hour(
+                (xtime::timestamp_t)(header.first_time / 1000000));
+            if(!open_segment(hour)) return intrade_bar_common::STRANGE_PROGRAM_BEHAVIOR;
+            TickArchive::IndexEntry entry;
+            entry.first_time = header.first_time;
+            entry.last_time = header.last_time;
+            entry.offset = data_file.tellp();
+            entry.compressed_size = header.compressed_size;
+            entry.count = header.count;
+            data_file.write((const char*)&header, sizeof(header));
+            data_file.write((const char*)compressed_data.data(), size);
+            data_file.flush();
+            if(!data_file) return intrade_bar_common::STRANGE_PROGRAM_BEHAVIOR;
+            index_file.write((const char*)&entry, sizeof(entry));
+            index_file.flush();
+            if(!index_file) return intrade_bar_common::STRANGE_PROGRAM_BEHAVIOR;
+            return intrade_bar_common::OK;
+        }
+
+        /** \brief Разбить тики по часам и записать блоки
+         */
+        void write_ticks(const std::vector<RecordedTick> &ticks) {
+            std::vector<RecordedTick> part;
+            part.reserve(ticks.size());
+            xtime::timestamp_t hour = 0;
+            for(const RecordedTick &tick : ticks) {
+                const xtime::timestamp_t tick_hour = xtime::get_first_timestamp_hour(
+                    (xtime::timestamp_t)tick.server_timestamp);
+                if((tick_hour != hour || part.size() >= BLOCK_TICKS) && !part.empty()) {
+                    const int err = write_block(part);
+                    if(err != intrade_bar_common::OK) last_error = err;
+                    part.clear();
+                }
+                hour = tick_hour;
+                part.push_back(tick);
+            }
+            if(part.empty()) return;
+            const int err = write_block(part);
+            if(err != intrade_bar_common::OK) last_error = err;
+        }
+
+        void run() {
+            while(true) {
+                std::vector<RecordedTick> ticks;
+                {
+                    std::unique_lock<std::mutex> lock(buffer_mutex);
+                    if(queue.empty() && !is_shutdown) {
+                        buffer_cv.wait_for(lock, std::chrono::milliseconds(FLUSH_DELAY));
+                    }
+                    if(queue.empty() && !buffer.empty()) {
+                        queue.push_back(std::move(buffer));
+                        buffer = std::vector<RecordedTick>();
+                        buffer.reserve(BLOCK_TICKS);
+                        ++pushed_blocks;
+                    }
+                    if(queue.empty()) {
+                        if(is_shutdown) break;
+                        continue;
+                    }
+                    ticks = std::move(queue.front());
+                    queue.pop_front();
+                }
+                write_ticks(ticks);
+                {
+                    std::lock_guard<std::mutex> lock(buffer_mutex);
+                    ++written_blocks;
+                }
+                flush_cv.notify_all();
+            }
+        }
+
+    public:
+
+        /** \brief Конструктор записи тиков
+         * \param user_path Директория архива, должна существовать
+         * \param user_level Уровень сжатия zstd
+         */
+        TickRecorder(const std::string &user_path, const int user_level = 3) :
+                path(user_path), level(user_level) {
+            cctx = ZSTD_createCCtx();
+            buffer.reserve(BLOCK_TICKS);
+            writer_thread = std::thread(&TickRecorder::run, this);
+        }
+
+        TickRecorder(const TickRecorder&) = delete;
+        TickRecorder &operator=(const TickRecorder&) = delete;
+
+        ~TickRecorder() {
+            {
+                std::lock_guard<std::mutex> lock(buffer_mutex);
+                is_shutdown = true;
+            }
+            buffer_cv.notify_one();
+            if(writer_thread.joinable()) writer_thread.join();
+            ZSTD_freeCCtx(cctx);
+        }
+
+        /** \brief Записать тик
+         * \param symbol_index Номер символа
+         * \param bid Цена bid
+         * \param ask Цена ask
+         * \param server_timestamp Метка времени сервера
+         * \param local_timestamp Метка времени получения тика
+         */
+        void write(
+                const uint32_t symbol_index,
+                const double bid,
+                const double ask,
+                const xtime::ftimestamp_t server_timestamp,
+                const xtime::ftimestamp_t local_timestamp) {
+            if(symbol_index >= intrade_bar_common::CURRENCY_PAIRS) return;
+            RecordedTick tick;
+            tick.symbol_index = symbol_index;
+            tick.bid = intrade_bar_common::get_price(bid, symbol_index);
+            tick.ask = intrade_bar_common::get_price(ask, symbol_index);
+            tick.server_timestamp = server_timestamp;
+            tick.local_timestamp = local_timestamp;
+            bool is_full = false;
+            {
+                std::lock_guard<std::mutex> lock(buffer_mutex);
+                buffer.push_back(tick);
+                if(buffer.size() >= BLOCK_TICKS) {
+                    queue.push_back(std::move(buffer));
+                    buffer = std::vector<RecordedTick>();
+                    buffer.reserve(BLOCK_TICKS);
+                    ++pushed_blocks;
+                    is_full = true;
+                }
+            }
+            ++recorded_ticks;
+            if(is_full) buffer_cv.notify_one();
+        }
+
+        /** \brief Записать готовый набор тиков
+         *
+         * Тики записываются отдельными блоками, не смешиваясь с буфером потока,
+         * поэтому исторические данные одного символа остаются в своих блоках
+         * \param ticks Тики, упорядоченные по времени сервера
+         */
+        void write(const std::vector<RecordedTick> &ticks) {
+            if(ticks.empty()) return;
+            {
+                std::lock_guard<std::mutex> lock(buffer_mutex);
+                queue.push_back(ticks);
+                ++pushed_blocks;
+            }
+            recorded_ticks += ticks.size();
+            buffer_cv.notify_one();
+        }
+
+        /** \brief Записать тик потока котировок
+         *
+         * Метка времени получения берется в момент вызова
+         * \param tick Тик потока
+         */
+        void write(const intrade_bar_common::StreamTick &tick) {
+            auto it = intrade_bar_common::currency_pairs_indx.find(tick.symbol);
+            if(it == intrade_bar_common::currency_pairs_indx.end()) return;
+            write(it->second, tick.bid, tick.ask, tick.timestamp, xtime::get_ftimestamp());
+        }
+
+        /** \brief Записать на диск все тики из буфера
+         *
+         * Метод ждет, пока фоновый поток запишет блоки
+         */
+        void flush() {
+            std::unique_lock<std::mutex> lock(buffer_mutex);
+            if(!buffer.empty()) {
+                queue.push_back(std::move(buffer));
+                buffer = std::vector<RecordedTick>();
+                buffer.reserve(BLOCK_TICKS);
+                ++pushed_blocks;
+            }
+            const uint64_t target = pushed_blocks;
+            buffer_cv.notify_one();
+            flush_cv.wait(lock, [&]{ return written_blocks >= target; });
+        }
+
+        /** \brief Получить директорию архива
+         */
+        inline const std::string &get_path() const {
+            return path;
+        }
+
+        /** \brief Получить количество записанных тиков
+         */
+        inline uint64_t get_recorded_ticks() const {
+            return recorded_ticks;
+        }
+
+        /** \brief Получить последнюю ошибку записи
+         * \return Код ошибки, 0 если ошибок не было
+         */
+        inline int get_last_error() const {
+            return last_error;
+        }
+    };
+
+    /** \brief Чтение архива тиков
+     */
+    class TickArchiveReader {
+    private:
+        std::string path;
+        std::vector<uint8_t> compressed_data;
+        std::vector<uint8_t> raw_data;
+        std::vector<RecordedTick> block_ticks;
+        ZSTD_DCtx *dctx = nullptr;
+
+        /** \brief Прочитать и распаковать блок
+         */
+        bool read_block(std::ifstream &data_file, const TickArchive::IndexEntry &entry) {
+            TickArchive::BlockHeader header;
+            data_file.clear();
+            data_file.seekg(entry.offset);
+            if(!data_file.read((char*)&header, sizeof(header))) return false;
+            if(header.magic != TickArchive::BLOCK_MAGIC) return false;
+            compressed_data.resize(header.compressed_size);
+            if(!data_file.read((char*)compressed_data.data(), header.compressed_size)) return false;
+            raw_data.resize(header.raw_size);
+            const size_t size = ZSTD_decompressDCtx(
+                dctx,
+                raw_data.data(), raw_data.size(),
+                compressed_data.data(), compressed_data.size());
+            if(ZSTD_isError(size) || size != header.raw_size) return false;
+            return TickArchive::decode_block(raw_data.data(), size, header, block_ticks);
+        }
+
+    public:
+
+        /** \brief Конструктор чтения архива
+         * \param user_path Директория архива
+         */
+        TickArchiveReader(const std::string &user_path) :
+                path(user_path) {
+            dctx = ZSTD_createDCtx();
+        }
+
+        TickArchiveReader(const TickArchiveReader&) = delete;
+        TickArchiveReader &operator=(const TickArchiveReader&) = delete;
+
+        ~TickArchiveReader() {
+            ZSTD_freeDCtx(dctx);
+        }
+
+        /** \brief Перебрать тики за период
+         *
+         * Тики передаются в порядке записи. Блоки вне периода не читаются
+         * \param start_timestamp Начальная метка времени сервера
+         * \param stop_timestamp Конечная метка времени сервера (включительно)
+         * \param callback Функция для тика, вернет false чтобы остановить перебор
+         * \return Код ошибки, DATA_NOT_AVAILABLE если за период нет ни одного сегмента
+         */
+        int for_each(
+                const xtime::ftimestamp_t start_timestamp,
+                const xtime::ftimestamp_t stop_timestamp,
+                const std::function<bool(const RecordedTick &tick)> &callback) {
+            if(stop_timestamp < start_timestamp) return intrade_bar_common::INVALID_ARGUMENT;
+            const int64_t start_time = TickArchive::to_microseconds(start_timestamp);
+            const int64_t stop_time = TickArchive::to_microseconds(stop_timestamp);
+            const xtime::timestamp_t first_hour = xtime::get_first_timestamp_hour((xtime::timestamp_t)start_timestamp);
+            const xtime::timestamp_t last_hour = xtime::get_first_timestamp_hour((xtime::timestamp_t)stop_timestamp);
+            bool is_found = false;
+            std::vector<TickArchive::IndexEntry> entries;
+            for(xtime::timestamp_t hour = first_hour; hour <= last_hour; hour += xtime::SECONDS_IN_HOUR) {
+                const std::string file_name = TickArchive::get_segment_name(path, hour);
+                std::ifstream data_file(file_name, std::ios_base::binary);
+                if(!data_file) continue;
+                is_found = true;
+                TickArchive::load_index(data_file, file_name, entries);
+                for(const TickArchive::IndexEntry &entry : entries) {
+                    if(entry.last_time < start_time || entry.first_time > stop_time) continue;
+                    if(!read_block(data_file, entry)) return intrade_bar_common::DECOMPRESSOR_ERROR;
+                    for(const RecordedTick &tick : block_ticks) {
+                        const int64_t time = TickArchive::to_microseconds(tick.server_timestamp);
+                        if(time < start_time || time > stop_time) continue;
+                        if(!callback(tick)) return intrade_bar_common::OK;
+                    }
+                }
+            }
+            return is_found ? intrade_bar_common::OK : intrade_bar_common::DATA_NOT_AVAILABLE;
+        }
+
+        /** \brief Получить тики за период
+         * \param start_timestamp Начальная метка времени сервера
+         * \param stop_timestamp Конечная метка времени сервера (включительно)
+         * \param ticks Тики
+         * \return Код ошибки
+         */
+        int get_ticks(
+                const xtime::ftimestamp_t start_timestamp,
+                const xtime::ftimestamp_t stop_timestamp,
+                std::vector<RecordedTick> &ticks) {
+            ticks.clear();
+            return for_each(start_timestamp, stop_timestamp, [&](const RecordedTick &tick) -> bool {
+                ticks.push_back(tick);
+                return true;
+            });
+        }
+    };
+}
+
+#endif // INTRADE_BAR_TICK_RECORDER_HPP_INCLUDED
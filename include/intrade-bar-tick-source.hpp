@@ -0,0 +1,465 @@
+/*
+* intrade-bar-api-cpp - C ++ API client for intrade.bar
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef INTRADE_BAR_TICK_SOURCE_HPP_INCLUDED
+#define INTRADE_BAR_TICK_SOURCE_HPP_INCLUDED
+
+#include <intrade-bar-common.hpp>
+#include "client_ws.hpp"
+#include "client_wss.hpp"
+#include <xtime.hpp>
+#include <nlohmann/json.hpp>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <functional>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include <array>
+#include <random>
+#include <mutex>
+#include <atomic>
+#include <thread>
+
+namespace intrade_bar {
+    using namespace intrade_bar_common;
+
+    /** \brief Интерфейс источника тиков
+     *
+     * Источник тиков передает данные в QuotationsStream через функции обратного вызова.
+     * Сообщения в формате брокера проходят через парсер, готовые тики - сразу в построитель баров.
+     */
+    class TickSource {
+    public:
+        /** \brief Сообщение в формате брокера
+         *
+         * Пример: {"Updates":1585580369,"ask":0.872,"bid":0.871861,"symbol":"AUD\/CAD"}
+         */
+        std::function<void(const std::string &message)> on_message = nullptr;
+
+        /** \brief Готовый тик, минуя парсер
+         */
+        std::function<void(
+            const size_t symbol_index,
+            const double bid,
+            const double ask,
+            const xtime::ftimestamp_t server_timestamp)> on_tick = nullptr;
+
+        /** \brief Событие источника (открытие, закрытие, ошибка)
+         *
+         * Если is_error равен true, соединение считается потерянным
+         */
+        std::function<void(const nlohmann::json &j, const bool is_error)> on_event = nullptr;
+
+        /** \brief Запустить источник
+         *
+         * Метод блокирует поток, пока источник не остановлен или соединение не потеряно
+         */
+        virtual void run() = 0;
+
+        /** \brief Остановить источник
+         */
+        virtual void stop() = 0;
+
+        /** \brief Нужно ли перезапускать источник после завершения run()
+         * \return вернет true, если источник нужно перезапустить
+         */
+        virtual bool is_restartable() {
+            return false;
+        }
+
+        virtual ~TickSource() {};
+    };
+
+    /** \brief Источник тиков от вебсокета
+     *
+     * SOCKET_TYPE задает схему соединения: SimpleWeb::WSS для брокера
+     * или SimpleWeb::WS для локального тестового сервера без TLS
+     */
+    template<class SOCKET_TYPE>
+    class WebSocketTickSource : public TickSource {
+    private:
+        using WssClient = SimpleWeb::SocketClient<SOCKET_TYPE>;
+        using json = nlohmann::json;
+
+        std::string point = "1.intrade.bar";
+        std::string path = "/fxconnect";
+        std::string sert_file = "curl-ca-bundle.crt";
+
+        std::array<std::shared_ptr<WssClient>, intrade_bar_common::CURRENCY_PAIRS>  clients;    /**< Webclosket Клиенты */
+        std::shared_ptr<SimpleWeb::io_context> io_service;
+        std::array<std::shared_ptr<SimpleWeb::strand>, intrade_bar_common::CURRENCY_PAIRS> strands; /**< Strand для каждого символа, сохраняет порядок обработки тиков */
+        uint32_t number_io_threads = 1;         /**< Количество потоков, в которых работает io_service */
+        std::atomic<bool> is_stop;
+
+        static std::shared_ptr<SimpleWeb::SocketClient<SimpleWeb::WSS>> create_client(
+                const std::string &ws_point,
+                const std::string &sert_file,
+                const SimpleWeb::WSS *) {
+            return std::make_shared<SimpleWeb::SocketClient<SimpleWeb::WSS>>(
+                ws_point,
+                true,
+                std::string(),
+                std::string(),
+                std::string(sert_file));
+        }
+
+        static std::shared_ptr<SimpleWeb::SocketClient<SimpleWeb::WS>> create_client(
+                const std::string &ws_point,
+                const std::string &/*sert_file*/,
+                const SimpleWeb::WS *) {
+            return std::make_shared<SimpleWeb::SocketClient<SimpleWeb::WS>>(ws_point);
+        }
+
+    public:
+
+        /** \brief Конструктор источника тиков от вебсокета
+         * \param user_point Точка доступа (хост и порт), для брокера intrade.bar или 1.intrade.bar
+         * \param user_sert_file Файл-сертификат. По умолчанию используется от curl: curl-ca-bundle.crt. Для WS не нужен
+         * \param user_number_io_threads Количество потоков для io_service. При значении больше 1
+         * тики каждого символа обрабатываются в своем strand, порядок тиков символа сохраняется
+         * \param user_path Путь потока котировок на сервере
+         */
+        WebSocketTickSource(
+                const std::string &user_point = "1.intrade.bar",
+                const std::string &user_sert_file = "curl-ca-bundle.crt",
+                const uint32_t user_number_io_threads = 1,
+                const std::string &user_path = "/fxconnect") :
+                point(user_point),
+                path(user_path),
+                sert_file(user_sert_file),
+                number_io_threads(std::max(user_number_io_threads, (uint32_t)1)) {
+            is_stop = false;
+        }
+
+        void run() override {
+            if(is_stop) return;
+            const std::string ws_point(point + path);
+            std::shared_ptr<SimpleWeb::io_context> service = std::make_shared<SimpleWeb::io_context>();
+            std::atomic_store(&io_service, service);
+            /* создадим соединения для каждой валютной пары */
+            for(size_t s = 0; s < intrade_bar_common::CURRENCY_PAIRS; ++s) {
+                if(number_io_threads > 1) {
+                    strands[s] = std::make_shared<SimpleWeb::strand>(SimpleWeb::make_strand(*service));
+                }
+                std::shared_ptr<WssClient> client = create_client(
+                        ws_point,
+                        sert_file,
+                        (const SOCKET_TYPE *)nullptr);
+
+                /* читаем собщения, которые пришли */
+                client->on_message =
+                        [&,s](std::shared_ptr<typename WssClient::Connection> connection,
+                        std::shared_ptr<typename WssClient::InMessage> message) {
+                    if(on_message == nullptr) return;
+                    if(number_io_threads <= 1) {
+                        on_message(message->string());
+                        return;
+                    }
+                    /* буфер сообщения будет переиспользован, поэтому копируем строку до передачи в strand */
+                    std::string response(message->string());
+                    SimpleWeb::post(*strands[s], [&, response]() {
+                        on_message(response);
+                    });
+                };
+
+                client->on_open =
+                    [&,s](std::shared_ptr<typename WssClient::Connection> connection) {
+                    std::string init_message(intrade_bar_common::extended_name_currency_pairs[s]);
+                    connection->send(init_message);
+                    if(on_event == nullptr) return;
+                    try {
+                        json j;
+                        j["function"] = "QuotationsStream";
+                        j["action"] = "open_connection";
+                        on_event(j, false);
+                    }
+                    catch(...) {}
+                };
+
+                client->on_close =
+                        [&](std::shared_ptr<typename WssClient::Connection> /*connection*/,
+                        int status, const std::string & /*reason*/) {
+                    std::cerr << "websocket " << point << ": "
+                        "closed connection with status code " << status
+                        << std::endl;
+                    std::shared_ptr<SimpleWeb::io_context> service_ptr = std::atomic_load(&io_service);
+                    if(service_ptr) service_ptr->stop();
+                    if(on_event == nullptr) return;
+                    try {
+                        json j;
+                        j["function"] = "QuotationsStream";
+                        j["action"] = "close_connection";
+                        j["status_code"] = status;
+                        on_event(j, true);
+                    }
+                    catch(...) {}
+                };
+
+                // See http://www.boost.org/doc/libs/1_55_0/doc/html/boost_asio/reference.html, Error Codes for error code meanings
+                client->on_error =
+                        [&, s](std::shared_ptr<typename WssClient::Connection> /*connection*/,
+                        const SimpleWeb::error_code &ec) {
+                    std::shared_ptr<SimpleWeb::io_context> service_ptr = std::atomic_load(&io_service);
+                    if(service_ptr) service_ptr->stop();
+                    std::cout
+                        << "websocket " << point << " (symbol index: " << s << ") error: " << ec
+                        << std::endl;
+                    if(on_event == nullptr) return;
+                    try {
+                        json j;
+                        std::ostringstream os;
+                        os << ec;
+                        j["function"] = "QuotationsStream";
+                        j["error"] = "wss";
+                        j["error_code"] = os.str();
+                        on_event(j, true);
+                    }
+                    catch(...) {}
+                };
+                client->io_service = service;
+                std::atomic_store(&clients[s], client);
+                client->start();
+            } // for s
+
+            std::cout << "websocket " << point << " connection" << std::endl;
+            /* дополнительные потоки io_service */
+            std::vector<std::thread> io_threads;
+            for(uint32_t t = 1; t < number_io_threads; ++t) {
+                io_threads.push_back(std::thread([service]() {
+                    try {
+                        service->run();
+                    }
+                    catch(...) {
+                        service->stop();
+                    }
+                }));
+            }
+            if(!is_stop) service->run();
+            else service->stop();
+            for(size_t t = 0; t < io_threads.size(); ++t) {
+                io_threads[t].join();
+            }
+
+            for(size_t s = 0; s < intrade_bar_common::CURRENCY_PAIRS; ++s) {
+                std::atomic_store(&clients[s], std::shared_ptr<WssClient>());
+                strands[s].reset();
+            }
+        }
+
+        void stop() override {
+            is_stop = true;
+            for(size_t s = 0; s < intrade_bar_common::CURRENCY_PAIRS; ++s) {
+                std::shared_ptr<WssClient> client_ptr = std::atomic_load(&clients[s]);
+                if(client_ptr) {
+                    client_ptr->stop();
+                }
+            }
+            std::shared_ptr<SimpleWeb::io_context> service_ptr = std::atomic_load(&io_service);
+            if(service_ptr) service_ptr->stop();
+        }
+
+        bool is_restartable() override {
+            return !is_stop;
+        }
+    };
+
+    using WssTickSource = WebSocketTickSource<SimpleWeb::WSS>;  /**< Вебсокет брокера по TLS */
+    using WsTickSource = WebSocketTickSource<SimpleWeb::WS>;    /**< Вебсокет без TLS, например локальный тестовый сервер */
+
+    /** \brief Создать источник тиков по адресу вебсокета
+     *
+     * Адрес вида wss://host[:port][/path] или ws://host[:port][/path].
+     * Без схемы используется wss, без пути - путь потока котировок брокера /fxconnect
+     * \param url Адрес вебсокета
+     * \param sert_file Файл-сертификат для wss
+     * \param number_io_threads Количество потоков для io_service
+     * \return Источник тиков
+     */
+    inline std::shared_ptr<TickSource> create_websocket_tick_source(
+            const std::string &url,
+            const std::string &sert_file = "curl-ca-bundle.crt",
+            const uint32_t number_io_threads = 1) {
+        std::string address = url;
+        bool is_tls = true;
+        const std::string ws_scheme("ws://");
+        const std::string wss_scheme("wss://");
+        if(address.compare(0, wss_scheme.size(), wss_scheme) == 0) {
+            address = address.substr(wss_scheme.size());
+        } else
+        if(address.compare(0, ws_scheme.size(), ws_scheme) == 0) {
+            address = address.substr(ws_scheme.size());
+            is_tls = false;
+        }
+        std::string path("/fxconnect");
+        const size_t pos = address.find('/');
+        if(pos != std::string::npos) {
+            path = address.substr(pos);
+            address = address.substr(0, pos);
+        }
+        if(is_tls) return std::make_shared<WssTickSource>(address, sert_file, number_io_threads, path);
+        return std::make_shared<WsTickSource>(address, sert_file, number_io_threads, path);
+    }
+
+    /** \brief Источник тиков из файла записи
+     *
+     * Файл содержит сообщения брокера, по одному на строку, в том виде,
+     * в котором они приходят от вебсокета
+     */
+    class ReplayTickSource : public TickSource {
+    private:
+        using json = nlohmann::json;
+
+        std::string file_name;
+        double speed = 0;               /**< Скорость воспроизведения, 0 - максимально быстро */
+        std::atomic<bool> is_stop;
+
+    public:
+
+        /** \brief Конструктор источника тиков из файла
+         * \param user_file_name Имя файла записи
+         * \param user_speed Скорость воспроизведения относительно реального времени. 0 - без пауз
+         */
+        ReplayTickSource(
+                const std::string &user_file_name,
+                const double user_speed = 0) :
+                file_name(user_file_name), speed(user_speed) {
+            is_stop = false;
+        }
+
+        void run() override {
+            std::ifstream file(file_name);
+            if(!file) {
+                if(on_event == nullptr) return;
+                json j;
+                j["function"] = "ReplayTickSource";
+                j["error"] = "file_not_open";
+                j["file_name"] = file_name;
+                on_event(j, true);
+                return;
+            }
+            xtime::ftimestamp_t last_tick_time = 0;
+            std::string line;
+            while(!is_stop && std::getline(file, line)) {
+                if(line.size() == 0) continue;
+                if(speed > 0) {
+                    /* выдерживаем паузы между тиками */
+                    try {
+                        json j = json::parse(line);
+                        const xtime::ftimestamp_t tick_time = j["Updates"];
+                        if(last_tick_time != 0 && tick_time > last_tick_time) {
+                            const uint64_t delay = (uint64_t)(((tick_time - last_tick_time) * 1000.0) / speed);
+                            std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+                        }
+                        last_tick_time = tick_time;
+                    }
+                    catch(...) {}
+                }
+                if(on_message != nullptr) on_message(line);
+            }
+        }
+
+        void stop() override {
+            is_stop = true;
+        }
+    };
+
+    /** \brief Генератор тиков
+     *
+     * Генерирует случайное блуждание цены для всех символов.
+     * Тики передаются напрямую в построитель баров, без парсера
+     */
+    class GeneratorTickSource : public TickSource {
+    private:
+        xtime::ftimestamp_t start_timestamp = 0;
+        xtime::ftimestamp_t tick_period = 0.1;  /**< Период между тиками во времени сервера */
+        uint64_t max_ticks = 0;                 /**< Количество тиков, 0 - без ограничений */
+        bool is_real_time = false;              /**< Выдерживать ли период тиков в реальном времени */
+        uint32_t seed = 0;
+        std::atomic<bool> is_stop;
+        std::atomic<uint64_t> ticks;
+
+    public:
+
+        /** \brief Конструктор генератора тиков
+         * \param user_start_timestamp Начальная метка времени сервера
+         * \param user_tick_period Период между тиками в секундах
+         * \param user_max_ticks Количество тиков, 0 - пока не будет вызван stop()
+         * \param user_is_real_time Если true, тики выдаются с периодом user_tick_period в реальном времени
+         * \param user_seed Зерно генератора случайных чисел
+         */
+        GeneratorTickSource(
+                const xtime::ftimestamp_t user_start_timestamp,
+                const xtime::ftimestamp_t user_tick_period = 0.1,
+                const uint64_t user_max_ticks = 0,
+                const bool user_is_real_time = false,
+                const uint32_t user_seed = 0) :
+                start_timestamp(user_start_timestamp),
+                tick_period(user_tick_period),
+                max_ticks(user_max_ticks),
+                is_real_time(user_is_real_time),
+                seed(user_seed) {
+            is_stop = false;
+            ticks = 0;
+        }
+
+        void run() override {
+            std::mt19937 generator(seed);
+            std::uniform_int_distribution<int> step(-2, 2);
+            std::array<int64_t, CURRENCY_PAIRS> price_ticks;
+            for(size_t s = 0; s < CURRENCY_PAIRS; ++s) {
+                price_ticks[s] = pricescale_currency_pairs[s];
+            }
+            xtime::ftimestamp_t timestamp = start_timestamp;
+            while(!is_stop && (max_ticks == 0 || ticks < max_ticks)) {
+                for(size_t s = 0; s < CURRENCY_PAIRS; ++s) {
+                    price_ticks[s] += step(generator);
+                    const double scale = (double)pricescale_currency_pairs[s];
+                    const double bid = (double)price_ticks[s] / scale;
+                    const double ask = (double)(price_ticks[s] + 2) / scale;
+                    if(on_tick != nullptr) on_tick(s, bid, ask, timestamp);
+                    ++ticks;
+                }
+                timestamp += tick_period;
+                if(is_real_time) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds((uint64_t)(tick_period * 1000.0)));
+                }
+            }
+        }
+
+        void stop() override {
+            is_stop = true;
+        }
+
+        /** \brief Получить количество выданных тиков
+         * \return Количество тиков
+         */
+        inline uint64_t get_ticks() {
+            return ticks;
+        }
+    };
+}
+
+#endif // INTRADE_BAR_TICK_SOURCE_HPP_INCLUDED
@@ -0,0 +1,345 @@
+/*
+* intrade-bar-api-cpp - C ++ API client for intrade.bar
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef INTRADE_BAR_TIMEFRAME_AGGREGATOR_HPP_INCLUDED
+#define INTRADE_BAR_TIMEFRAME_AGGREGATOR_HPP_INCLUDED
+
+#include <intrade-bar-common.hpp>
+#include <xquotes_common.hpp>
+#include <xtime.hpp>
+#include <vector>
+#include <array>
+#include <map>
+#include <mutex>
+#include <algorithm>
+
+namespace intrade_bar {
+
+    /** \brief Построение баров старших таймфреймов из минутных баров
+     *
+     * Бары таймфрейма выравниваются по началу эпохи, поэтому сетка M5 совпадает с метками
+     * закрытия CLASSIC опционов (get_classic_bo_closing_timestamp).
+     * Обновление последней минуты бара (новый тик или следующая минута) выполняется за O(1).
+     * Если минута пришла не по порядку или была исправлена историей так, что ее максимум
+     * уменьшился или минимум вырос, бар пересчитывается по своим минутам (не более period минут).
+     *
+     * Минуты хранятся только у открытого бара и у баров, закрытых не раньше окна исправлений
+     * (по умолчанию 60 минут). У более старых баров остается только OHLCV: исправление такого бара
+     * может лишь расширить его диапазон, дописать минуты до первой или после последней минуты бара.
+     */
+    class TimeframeAggregator {
+    private:
+
+        /// Бар таймфрейма вместе с минутами, из которых он построен
+        class Bar {
+        public:
+            xquotes_common::Candle candle;
+            std::vector<xquotes_common::Candle> minutes;    /**< Минуты бара, пусто для баров старше окна исправлений */
+            uint32_t first_minute = 0;  /**< Номер первой минуты бара с данными */
+            uint32_t last_minute = 0;   /**< Номер последней минуты бара, по которой было обновление */
+        };
+
+        using Series = std::map<xtime::timestamp_t, Bar>;
+
+        std::vector<uint32_t> periods;                                          /**< Периоды таймфреймов в минутах */
+        std::vector<std::array<Series, intrade_bar_common::CURRENCY_PAIRS>> series;
+        uint32_t max_bars = 1440;                                               /**< Количество хранимых баров каждого таймфрейма */
+        uint32_t correction_minutes = 60;                                       /**< Окно исправлений, в течение которого у закрытых баров хранятся минуты */
+        mutable std::mutex aggregator_mutex;
+
+        static void recalculate(Bar &bar) {
+            const xtime::timestamp_t timestamp = bar.candle.timestamp;
+            bar.candle = xquotes_common::Candle();
+            bar.candle.timestamp = timestamp;
+            bool is_first = true;
+            for(uint32_t m = 0; m < bar.minutes.size(); ++m) {
+                const xquotes_common::Candle &minute = bar.minutes[m];
+                if(minute.close == 0) continue;
+                if(is_first) {
+                    bar.candle.open = minute.open;
+                    bar.candle.high = minute.high;
+                    bar.candle.low = minute.low;
+                    bar.first_minute = m;
+                    is_first = false;
+                } else {
+                    bar.candle.high = std::max(bar.candle.high, minute.high);
+                    bar.candle.low = std::min(bar.candle.low, minute.low);
+                }
+                bar.candle.close = minute.close;
+                bar.candle.volume += minute.volume;
+                bar.last_minute = m;
+            }
+        }
+
+        /** \brief Обновить бар без минут одной минутой
+         *
+         * Прежнее значение минуты неизвестно, поэтому минута внутри бара только расширяет его диапазон
+         */
+        static void update_compact_bar(Bar &bar, const uint32_t index, const xquotes_common::Candle &minute) {
+            if(bar.candle.close == 0) {
+                bar.candle.open = minute.open;
+                bar.candle.high = minute.high;
+                bar.candle.low = minute.low;
+                bar.candle.close = minute.close;
+                bar.candle.volume = minute.volume;
+                bar.first_minute = index;
+                bar.last_minute = index;
+                return;
+            }
+            bar.candle.high = std::max(bar.candle.high, minute.high);
+            bar.candle.low = std::min(bar.candle.low, minute.low);
+            if(index < bar.first_minute) {
+                bar.candle.open = minute.open;
+                bar.candle.volume += minute.volume;
+                bar.first_minute = index;
+            } else
+            if(index > bar.last_minute) {
+                bar.candle.close = minute.close;
+                bar.candle.volume += minute.volume;
+                bar.last_minute = index;
+            } else {
+                if(index == bar.first_minute) bar.candle.open = minute.open;
+                if(index == bar.last_minute) bar.candle.close = minute.close;
+            }
+        }
+
+        /** \brief Обновить бар одной минутой
+         */
+        static void update_bar(Bar &bar, const uint32_t index, const xquotes_common::Candle &minute) {
+            if(bar.minutes.empty()) {
+                update_compact_bar(bar, index, minute);
+                return;
+            }
+            const xquotes_common::Candle old = bar.minutes[index];
+            bar.minutes[index] = minute;
+            const bool is_empty_bar = bar.candle.close == 0;
+
+            if(old.close == 0 && (is_empty_bar || index > bar.last_minute)) {
+                /* следующая минута бара */
+                if(is_empty_bar) {
+                    bar.candle.open = minute.open;
+                    bar.candle.high = minute.high;
+                    bar.candle.low = minute.low;
+                    bar.first_minute = index;
+                } else {
+                    bar.candle.high = std::max(bar.candle.high, minute.high);
+                    bar.candle.low = std::min(bar.candle.low, minute.low);
+                }
+                bar.candle.close = minute.close;
+                bar.candle.volume += minute.volume;
+                bar.last_minute = index;
+                return;
+            }
+
+            if(old.close != 0 && index == bar.last_minute &&
+                minute.high >= old.high && minute.low <= old.low &&
+                (index != 0 || minute.open == old.open)) {
+                /* новый тик последней минуты только расширяет ее диапазон */
+                bar.candle.high = std::max(bar.candle.high, minute.high);
+                bar.candle.low = std::min(bar.candle.low, minute.low);
+                bar.candle.close = minute.close;
+                bar.candle.volume += minute.volume - old.volume;
+                return;
+            }
+
+            /* минута пришла не по порядку или исправлена */
+            recalculate(bar);
+        }
+
+        /** \brief Проверить, нужно ли хранить минуты бара
+         * \param period Период в минутах
+         * \param bar_timestamp Метка времени бара
+         * \param last_timestamp Метка времени последнего бара серии
+         */
+        inline bool is_detailed(
+                const uint32_t period,
+                const xtime::timestamp_t bar_timestamp,
+                const xtime::timestamp_t last_timestamp) const {
+            return (bar_timestamp + (xtime::timestamp_t)(period + correction_minutes) * xtime::SECONDS_IN_MINUTE) > last_timestamp;
+        }
+
+        /** \brief Убрать минуты у баров, вышедших из окна исправлений
+         *
+         * Бары выходят из окна по порядку, поэтому проход останавливается на первом баре без минут
+         */
+        void compact_series(const uint32_t period, Series &bars) {
+            if(bars.empty()) return;
+            const xtime::timestamp_t last_timestamp = bars.rbegin()->first;
+            for(auto it = bars.rbegin(); it != bars.rend(); ++it) {
+                if(is_detailed(period, it->first, last_timestamp)) continue;
+                if(it->second.minutes.empty()) break;
+                std::vector<xquotes_common::Candle>().swap(it->second.minutes);
+            }
+        }
+
+    public:
+
+        /** \brief Конструктор агрегатора
+         * \param user_periods Периоды таймфреймов в минутах, например {5, 15, 60}
+         * \param user_max_bars Количество хранимых баров каждого таймфрейма
+         */
+        TimeframeAggregator(
+                const std::vector<uint32_t> &user_periods = std::vector<uint32_t>(),
+                const uint32_t user_max_bars = 1440) :
+                max_bars(user_max_bars) {
+            set_periods(user_periods);
+        }
+
+        /** \brief Установить окно исправлений
+         *
+         * Закрытые бары хранят свои минуты, пока с их закрытия прошло меньше указанного времени,
+         * и в этом окне исправления минут пересчитываются точно
+         * \param minutes Окно исправлений в минутах
+         */
+        void set_correction_window(const uint32_t minutes) {
+            std::lock_guard<std::mutex> lock(aggregator_mutex);
+            correction_minutes = minutes;
+            for(size_t p = 0; p < series.size(); ++p) {
+                for(uint32_t s = 0; s < intrade_bar_common::CURRENCY_PAIRS; ++s) {
+                    compact_series(periods[p], series[p][s]);
+                }
+            }
+        }
+
+        /** \brief Установить периоды таймфреймов
+         *
+         * Накопленные бары сбрасываются
+         * \param user_periods Периоды таймфреймов в минутах, больше одной минуты
+         */
+        void set_periods(const std::vector<uint32_t> &user_periods) {
+            std::lock_guard<std::mutex> lock(aggregator_mutex);
+            periods.clear();
+            for(size_t i = 0; i < user_periods.size(); ++i) {
+                if(user_periods[i] <= 1 || user_periods[i] > xtime::MINUTES_IN_DAY) continue;
+                if(std::find(periods.begin(), periods.end(), user_periods[i]) != periods.end()) continue;
+                periods.push_back(user_periods[i]);
+            }
+            series.clear();
+            series.resize(periods.size());
+        }
+
+        /** \brief Получить периоды таймфреймов
+         * \return Периоды таймфреймов в минутах
+         */
+        std::vector<uint32_t> get_periods() const {
+            std::lock_guard<std::mutex> lock(aggregator_mutex);
+            return periods;
+        }
+
+        /** \brief Проверить, есть ли таймфреймы
+         */
+        bool empty() const {
+            std::lock_guard<std::mutex> lock(aggregator_mutex);
+            return periods.empty();
+        }
+
+        /** \brief Получить метку времени бара таймфрейма
+         * \param period Период в минутах
+         * \param timestamp Метка времени внутри бара
+         */
+        static inline xtime::timestamp_t get_bar_timestamp(const uint32_t period, const xtime::timestamp_t timestamp) {
+            const xtime::timestamp_t seconds = period * xtime::SECONDS_IN_MINUTE;
+            return timestamp - timestamp % seconds;
+        }
+
+        /** \brief Обновить бары всех таймфреймов минутным баром
+         *
+         * Минутный бар может быть новым, обновленным новым тиком или исправленным историей
+         * \param symbol_index Номер символа
+         * \param minute_candle Минутный бар
+         */
+        void update(const uint32_t symbol_index, const xquotes_common::Candle &minute_candle) {
+            if(symbol_index >= intrade_bar_common::CURRENCY_PAIRS) return;
+            if(minute_candle.close == 0 || minute_candle.timestamp == 0) return;
+            const xtime::timestamp_t minute_timestamp = xtime::get_first_timestamp_minute(minute_candle.timestamp);
+            std::lock_guard<std::mutex> lock(aggregator_mutex);
+            for(size_t p = 0; p < periods.size(); ++p) {
+                const uint32_t period = periods[p];
+                const xtime::timestamp_t bar_timestamp = get_bar_timestamp(period, minute_timestamp);
+                Series &bars = series[p][symbol_index];
+
+                /* обычно обновляется последний бар, поиск по дереву не нужен */
+                Bar *bar = nullptr;
+                if(!bars.empty() && bars.rbegin()->first == bar_timestamp) {
+                    bar = &bars.rbegin()->second;
+                } else {
+                    if(!bars.empty() && bars.size() >= max_bars && bar_timestamp < bars.begin()->first) continue;
+                    auto it = bars.find(bar_timestamp);
+                    if(it == bars.end()) {
+                        it = bars.emplace(bar_timestamp, Bar()).first;
+                        it->second.candle.timestamp = bar_timestamp;
+                        if(is_detailed(period, bar_timestamp, bars.rbegin()->first)) it->second.minutes.resize(period);
+                        while(bars.size() > max_bars) bars.erase(bars.begin());
+                        /* новый последний бар сдвигает окно исправлений */
+                        if(bar_timestamp == bars.rbegin()->first) compact_series(period, bars);
+                    }
+                    bar = &it->second;
+                }
+                const uint32_t index = (uint32_t)((minute_timestamp - bar_timestamp) / xtime::SECONDS_IN_MINUTE);
+                update_bar(*bar, index, minute_candle);
+            }
+        }
+
+        /** \brief Получить бар таймфрейма
+         * \param period Период в минутах
+         * \param symbol_index Номер символа
+         * \param timestamp Метка времени внутри бара
+         * \param candle Бар
+         * \return Вернет true, если бар есть
+         */
+        bool get_candle(
+                const uint32_t period,
+                const uint32_t symbol_index,
+                const xtime::timestamp_t timestamp,
+                xquotes_common::Candle &candle) const {
+            if(symbol_index >= intrade_bar_common::CURRENCY_PAIRS) return false;
+            std::lock_guard<std::mutex> lock(aggregator_mutex);
+            auto it_period = std::find(periods.begin(), periods.end(), period);
+            if(it_period == periods.end()) return false;
+            const Series &bars = series[it_period - periods.begin()][symbol_index];
+            auto it = bars.find(get_bar_timestamp(period, timestamp));
+            if(it == bars.end() || it->second.candle.close == 0) return false;
+            candle = it->second.candle;
+            return true;
+        }
+
+        /** \brief Получить бары таймфрейма всех символов
+         * \param period Период в минутах
+         * \param timestamp Метка времени внутри бара
+         * \return Бары символов, у которых есть данные
+         */
+        std::map<std::string, xquotes_common::Candle> get_candles(
+                const uint32_t period,
+                const xtime::timestamp_t timestamp) const {
+            std::map<std::string, xquotes_common::Candle> candles;
+            for(uint32_t symbol_index = 0; symbol_index < intrade_bar_common::CURRENCY_PAIRS; ++symbol_index) {
+                xquotes_common::Candle candle;
+                if(!get_candle(period, symbol_index, timestamp, candle)) continue;
+                candles[intrade_bar_common::currency_pairs[symbol_index]] = candle;
+            }
+            return candles;
+        }
+    };
+}
+
+#endif // INTRADE_BAR_TIMEFRAME_AGGREGATOR_HPP_INCLUDED
@@ -26,6 +26,9 @@
 
 #include <intrade-bar-common.hpp>
 #include <intrade-bar-logger.hpp>
+#include <intrade-bar-tick-source.hpp>
+#include <intrade-bar-tick-conflator.hpp>
+#include <intrade-bar-compressed-history.hpp>
 #include "client_wss.hpp"
 #include <openssl/ssl.h>
 #include <wincrypt.h>
@@ -35,6 +38,7 @@
 #include <mutex>
 #include <atomic>
 #include <future>
+#include <thread>
 #include "utf8.h" // http://utfcpp.sourceforge.net/
 
 /*
@@ -49,16 +53,14 @@ namespace intrade_bar {
      */
     class QuotationsStream {
     private:
-        using WssClient = SimpleWeb::SocketClient<SimpleWeb::WSS>;
         using json = nlohmann::json;
 
-        std::string point = "1.intrade.bar";
-
-        std::array<std::shared_ptr<WssClient>, intrade_bar_common::CURRENCY_PAIRS>  clients;    /**< Webclosket Клиенты */
-        std::shared_ptr<SimpleWeb::io_context> io_service;
-        std::future<void> client_future;        /**< Поток соединения */
+        std::shared_ptr<TickSource> tick_source;    /**< Источник тиков */
+        std::future<void> client_future;            /**< Поток источника тиков */
 
         std::string file_name_websocket_log;    /**< Файл для записи логов */
+        uint16_t websocket_log_file_id = 0;     /**< Номер файла логов для событий */
+        uint16_t parser_error_event_id = 0;     /**< Номер события ошибки парсера */
 
         void fix_utf8_string(std::string& str) {
             std::string temp;
@@ -71,13 +73,26 @@ namespace intrade_bar {
         std::atomic<bool> is_error;             /**< Ошибка соединения */
         std::atomic<bool> is_close_connection;  /**< Флаг для закрытия соединения */
         std::atomic<bool> is_open_equal_close;  /**< Если флаг установлен, цена открытия будет равна цене закрытия предыдущего бара */
+        std::atomic<bool> is_conflation;        /**< Если флаг установлен, тики сворачиваются для медленных потребителей */
+        TickConflator conflator;                /**< Свертка тиков */
 
         typedef std::pair<double,xtime::ftimestamp_t> tick_price;                       /**< Тип для хранения тика (с учетом (bid+ask)/2) */
         std::array<tick_price, CURRENCY_PAIRS> array_tick_price;                        /**< Массив для хранение всех тиков */
         std::array<std::vector<xquotes_common::Candle>, CURRENCY_PAIRS> array_candles;  /**< Массив для хранения баров */
+        std::array<std::map<xtime::timestamp_t, CandleSource>, CURRENCY_PAIRS> array_repaired_candles; /**< Источник восстановленных баров */
+        std::array<CompressedCandleHistory, CURRENCY_PAIRS> array_compressed_candles;  /**< Сжатая часть истории баров */
+        std::atomic<uint32_t> compressed_hot_bars;  /**< Количество несжатых последних баров, 0 - сжатие отключено */
+        std::array<std::atomic<double>, CURRENCY_PAIRS> array_tick_arrival;            /**< Время ПК получения последнего тика */
         std::string error_message;
-        std::recursive_mutex candles_mutex;
-        std::recursive_mutex price_mutex;
+        std::string parser_error_name;          /**< Тип последней ошибки парсера */
+        std::string parser_error_what;          /**< Текст последней ошибки парсера */
+        static const size_t PARSER_ERROR_RESPONSE_SIZE = 256;
+        std::array<char, PARSER_ERROR_RESPONSE_SIZE> parser_error_response;  /**< Начало сообщения, вызвавшего ошибку парсера, полное сообщение пишется в лог */
+        size_t parser_error_response_size = 0;
+        int parser_error_exception_id = 0;
+        bool is_parser_error_message = false;   /**< Сообщение об ошибке парсера еще не собрано в error_message */
+        std::array<std::recursive_mutex, CURRENCY_PAIRS> candles_mutex; /**< Блокировка баров отдельно для каждого символа */
+        std::array<std::recursive_mutex, CURRENCY_PAIRS> price_mutex;   /**< Блокировка цены отдельно для каждого символа */
         std::recursive_mutex error_message_mutex;
         std::recursive_mutex array_offset_timestamp_mutex;
 
@@ -89,7 +104,7 @@ namespace intrade_bar {
         std::atomic<double> offset_timestamp;                           /**< Смещение метки времени */
         std::atomic<bool> is_autoupdate_logger_offset_timestamp;
 
-        std::atomic<double> last_server_timestamp;
+        std::atomic<double> last_tick_time;     /**< Последняя метка времени тика, общая для всех символов, только растет */
 
         /** \brief Обновить смещение метки времени
          *
@@ -119,6 +134,28 @@ namespace intrade_bar {
             if(is_autoupdate_logger_offset_timestamp) intrade_bar::Logger::set_offset_timestamp(offset_timestamp);
         }
 
+        /** \brief Перенести старые бары в сжатую историю
+         *
+         * Бары переносятся целыми блоками, в массиве остается от hot_bars до hot_bars + BLOCK_BARS баров.
+         * Вызывается под блокировкой candles_mutex
+         * \param symbol_index Индекс символа
+         */
+        void compress_candles(const size_t symbol_index) {
+            const uint32_t hot_bars = compressed_hot_bars;
+            if(hot_bars == 0) return;
+            std::vector<xquotes_common::Candle> &candles = array_candles[symbol_index];
+            if(candles.size() < (size_t)hot_bars + CompressedCandleHistory::BLOCK_BARS) return;
+            const size_t cold_bars =
+                ((candles.size() - hot_bars) / CompressedCandleHistory::BLOCK_BARS) *
+                CompressedCandleHistory::BLOCK_BARS;
+            array_compressed_candles[symbol_index].append(candles.data(), cold_bars);
+            candles.erase(candles.begin(), candles.begin() + cold_bars);
+            /* после загрузки длинной истории возвращаем память массива */
+            if(candles.capacity() > 4 * ((size_t)hot_bars + CompressedCandleHistory::BLOCK_BARS)) {
+                candles.shrink_to_fit();
+            }
+        }
+
         /** \brief Обновить массив баров
          * \param symbol_index Индекс символа
          * \param price Цена
@@ -132,7 +169,16 @@ namespace intrade_bar {
             const xtime::timestamp_t minute_timestamp =
                 xtime::get_first_timestamp_minute(
                     (xtime::timestamp_t)timestamp);
-            std::lock_guard<std::recursive_mutex> lock(candles_mutex);
+            std::lock_guard<std::recursive_mutex> lock(candles_mutex[symbol_index]);
+            /* бар, в который пришел тик, больше не считается восстановленным.
+             * Цены восстановленного бара не настоящие, поэтому бар строится заново с первого тика
+             */
+            if(!array_repaired_candles[symbol_index].empty() &&
+                array_repaired_candles[symbol_index].erase(minute_timestamp) != 0 &&
+                !array_candles[symbol_index].empty() &&
+                array_candles[symbol_index].back().timestamp == minute_timestamp) {
+                array_candles[symbol_index].pop_back();
+            }
             /* проверяем, пуст ли массив */
             if (array_candles[symbol_index].size() == 0 ||
                 (!is_open_equal_close &&
@@ -172,6 +218,102 @@ namespace intrade_bar {
                 }
                 array_candles[symbol_index].back().close = price;
             }
+            compress_candles(symbol_index);
+        }
+
+        /** \brief Обработать тик
+         *
+         * Общая часть для парсера и прямой передачи тиков: часы сервера, цена и бары
+         * \param symbol_index Индекс символа
+         * \param bid Цена bid
+         * \param ask Цена ask
+         * \param tick_time Метка времени сервера
+         */
+        void process_tick(
+                const size_t symbol_index,
+                const double bid,
+                const double ask,
+                const xtime::ftimestamp_t tick_time) {
+            /* проверяем, проинициализированы ли все валютные пары */
+            is_currency_pair_init[symbol_index] = true;
+            is_websocket_init = true;
+            array_tick_arrival[symbol_index] = xtime::get_ftimestamp();
+
+            /* проверяем, не поменялась ли метка времени
+             * тики разных символов могут обрабатываться в разных потоках,
+             * поэтому смещение обновляет только тот поток, который первым увидел новую метку времени
+             */
+            xtime::ftimestamp_t prev_tick_time = last_tick_time;
+            while(prev_tick_time < tick_time) {
+                if(!last_tick_time.compare_exchange_weak(prev_tick_time, tick_time)) continue;
+                /* если метка времени поменялась, найдем время сервера */
+                xtime::ftimestamp_t pc_time = xtime::get_ftimestamp();
+                xtime::ftimestamp_t offset_time = tick_time - pc_time;
+                update_offset_timestamp(offset_time);
+                break;
+            }
+
+            const double price = Price::from_bid_ask(bid, ask, pricescale_currency_pairs[symbol_index]).to_double();
+
+            /* обновляем данные */
+            update_candles(symbol_index, price, tick_time);
+            if(is_conflation) conflator.update(symbol_index, bid, ask, price, tick_time);
+            std::lock_guard<std::recursive_mutex> lock(price_mutex[symbol_index]);
+            array_tick_price[symbol_index].first = price;
+            array_tick_price[symbol_index].second = tick_time;
+        }
+
+        /** \brief Записать событие источника тиков
+         * \param j Событие
+         * \param is_connection_error Флаг потери соединения
+         */
+        void source_event(const json &j, const bool is_connection_error) {
+            if(is_connection_error) {
+                is_error = true;
+                is_websocket_init = false;
+            }
+            try {
+                intrade_bar::Logger::log(file_name_websocket_log, j);
+                std::lock_guard<std::recursive_mutex> lock(error_message_mutex);
+                error_message = j.dump();
+                is_parser_error_message = false;
+            }
+            catch(...) {}
+        }
+
+        /** \brief Записать ошибку парсера
+         *
+         * Поток котировок не формирует JSON при ошибке: событие уходит в буфер логера,
+         * а сообщение об ошибке собирается только при вызове get_error_message().
+         * Для него сохраняется только начало ответа в буфер фиксированного размера, без выделения памяти
+         * \param error Тип ошибки
+         * \param what Текст исключения
+         * \param exception_id Номер исключения
+         * \param response Ответ от сервера
+         */
+        void parser_error(
+                const char *error,
+                const char *what,
+                const int exception_id,
+                const std::string &response) {
+            intrade_bar::Logger::log_event(
+                websocket_log_file_id,
+                parser_error_event_id,
+                error,
+                what,
+                exception_id,
+                response);
+            try {
+                std::lock_guard<std::recursive_mutex> lock(error_message_mutex);
+                parser_error_name = error;
+                parser_error_what = what;
+                parser_error_exception_id = exception_id;
+                parser_error_response_size = std::min(response.size(), parser_error_response.size());
+                std::copy(response.begin(), response.begin() + parser_error_response_size, parser_error_response.begin());
+                is_parser_error_message = true;
+            }
+            catch(...) {}
+            is_error = true;
         }
 
         /** \brief Парсер сообщения от вебсокета
@@ -187,114 +329,27 @@ namespace intrade_bar {
                 auto it = extended_name_currency_pairs_indx.find(symbol_name);
                 if(it == extended_name_currency_pairs_indx.end()) return;
                 const size_t symbol_index = it->second;
-                //size_t symbol_index = std::distance(extended_name_currency_pairs_indx.begin(), it);// (it - extended_name_currency_pairs_indx.begin());
-
-                /* проверяем, проинициализированы ли все валютные пары */
-                is_currency_pair_init[symbol_index] = true;
-                is_websocket_init = true;
 
                 /* получаем метку времени */
-                xtime::ftimestamp_t tick_time = j["Updates"];
-
-                /* проверяем, не поменялась ли метка времени */
-                static xtime::ftimestamp_t last_tick_time = 0;
-                if(last_tick_time < tick_time) {
-                    /* если метка времени поменялась, найдем время сервера */
-                    xtime::ftimestamp_t pc_time = xtime::get_ftimestamp();
-                    xtime::ftimestamp_t offset_time = tick_time - pc_time;
-                    update_offset_timestamp(offset_time);
-                    last_tick_time = tick_time;
-
-                    /* запоминаем последнюю метку времени сервера */
-                    last_server_timestamp = tick_time;
-                }
+                const xtime::ftimestamp_t tick_time = j["Updates"];
 
                 /* читаем значение цены */
                 const double bid = j["bid"];
                 const double ask = j["ask"];
-                double price = (bid + ask) / 2.0d;
-
-                /* округляем цену */
-                price = (double)((double)((uint64_t)((price *
-                    (double)pricescale_currency_pairs[symbol_index])
-                    + 0.5d)) /
-                    (double)pricescale_currency_pairs[symbol_index]);
-
-                /* обновляем данные */
-                update_candles(symbol_index, price, tick_time);
-                std::lock_guard<std::recursive_mutex> lock(price_mutex);
-                array_tick_price[symbol_index].first = price;
-                array_tick_price[symbol_index].second = tick_time;
+
+                process_tick(symbol_index, bid, ask, tick_time);
             }
             catch(const json::parse_error& e) {
-                try {
-                    std::string utf8line = response;
-                    fix_utf8_string(utf8line);
-
-                    json j;
-                    j["function"] = "QuotationsStream::parser(const std::string &response)";
-                    j["error"] = "json::parse_error";
-                    j["what"] = e.what();
-                    j["exception_id"] = e.id;
-                    j["response"] = utf8line;
-                    intrade_bar::Logger::log(file_name_websocket_log, j);
-                    std::lock_guard<std::recursive_mutex> lock(error_message_mutex);
-                    error_message = j.dump();
-                }
-                catch(...) {}
-                is_error = true;
+                parser_error("json::parse_error", e.what(), e.id, response);
             }
             catch(json::out_of_range& e) {
-                try {
-                    std::string utf8line = response;
-                    fix_utf8_string(utf8line);
-
-                    json j;
-                    j["function"] = "QuotationsStream::parser(const std::string &response)";
-                    j["error"] = "json::out_of_range";
-                    j["what"] = e.what();
-                    j["exception_id"] = e.id;
-                    j["response"] = utf8line;
-                    intrade_bar::Logger::log(file_name_websocket_log, j);
-                    std::lock_guard<std::recursive_mutex> lock(error_message_mutex);
-                    error_message = j.dump();
-                }
-                catch(...) {}
-                is_error = true;
+                parser_error("json::out_of_range", e.what(), e.id, response);
             }
             catch(json::type_error& e) {
-                try {
-                    std::string utf8line = response;
-                    fix_utf8_string(utf8line);
-
-                    json j;
-                    j["function"] = "QuotationsStream::parser(const std::string &response)";
-                    j["error"] = "json::type_error";
-                    j["what"] = e.what();
-                    j["exception_id"] = e.id;
-                    j["response"] = utf8line;
-                    intrade_bar::Logger::log(file_name_websocket_log, j);
-                    std::lock_guard<std::recursive_mutex> lock(error_message_mutex);
-                    error_message = j.dump();
-                }
-                catch(...) {}
-                is_error = true;
+                parser_error("json::type_error", e.what(), e.id, response);
             }
             catch(...) {
-                /* ничего не делаем */
-                std::lock_guard<std::recursive_mutex> lock(error_message_mutex);
-                try {
-                    std::string utf8line = response;
-                    fix_utf8_string(utf8line);
-                    json j;
-                    j["function"] = "QuotationsStream::parser(const std::string &response)";
-                    j["error"] = "unknown_parser_error";
-                    j["response"] = utf8line;
-                    intrade_bar::Logger::log(file_name_websocket_log, j);
-                    error_message = j.dump();
-                }
-                catch(...) {}
-                is_error = true;
+                parser_error("unknown_parser_error", "", 0, response);
             }
         }
 
@@ -304,14 +359,38 @@ namespace intrade_bar {
          * \param user_point Точка доступа к брокерку, равна intrade.bar или 1.intrade.bar
          * \param sert_file Файл-сертификат. По умолчанию используется от curl: curl-ca-bundle.crt
          * \param file_websocket_log Файл для записи логов.
+         * \param user_number_io_threads Количество потоков для io_service. При значении больше 1
+         * тики каждого символа обрабатываются в своем strand, порядок тиков символа сохраняется
          */
         QuotationsStream(
                 std::string stream_point = "1.intrade.bar",
                 std::string sert_file = "curl-ca-bundle.crt",
-                std::string file_websocket_log = "logger/intrade-bar-websocket.log") : point(stream_point) {
+                std::string file_websocket_log = "logger/intrade-bar-websocket.log",
+                const uint32_t user_number_io_threads = 1) :
+                QuotationsStream(
+                    std::make_shared<WssTickSource>(stream_point, sert_file, user_number_io_threads),
+                    file_websocket_log) {
+        }
+
+        /** \brief Конструктор класс для получения потока котировок от произвольного источника
+         *
+         * Источником может быть вебсокет брокера или тестового сервера, файл записи или генератор тиков
+         * \param user_tick_source Источник тиков
+         * \param file_websocket_log Файл для записи логов.
+         */
+        QuotationsStream(
+                std::shared_ptr<TickSource> user_tick_source,
+                std::string file_websocket_log = "logger/intrade-bar-websocket.log") :
+                tick_source(user_tick_source) {
             /* инициализируем переменные */
             file_name_websocket_log = file_websocket_log;
+            websocket_log_file_id = intrade_bar::Logger::get_file_id(file_name_websocket_log);
+            parser_error_event_id = intrade_bar::Logger::register_event(
+                "QuotationsStream::parser(const std::string &response)",
+                {"error", "what", "exception_id", "response"},
+                intrade_bar::LOG_LEVEL_ERROR);
             offset_timestamp = 0;
+            last_tick_time = 0;
             is_websocket_init = false;
             is_close_connection = false;
             is_error = false;
@@ -320,116 +399,39 @@ namespace intrade_bar {
              * чтобы соответствовать цене исторических баров от поставщика FXCM
              */
             is_open_equal_close = true;
+            is_conflation = false;
+            compressed_hot_bars = 0;
 
             for(size_t i = 0; i < is_currency_pair_init.size(); ++i) {
                 is_currency_pair_init[i] = false;
+                array_tick_arrival[i] = 0;
+                array_compressed_candles[i] = CompressedCandleHistory(pricescale_currency_pairs[i]);
             }
 
-            /* запустим соединение в отдельном потоке */
-            client_future = std::async(std::launch::async,[&, sert_file]() {
-                const std::string ws_point(point + "/fxconnect");
+            tick_source->on_message = [&](const std::string &message) {
+                parser(message);
+            };
+            tick_source->on_tick = [&](
+                    const size_t symbol_index,
+                    const double bid,
+                    const double ask,
+                    const xtime::ftimestamp_t server_timestamp) {
+                inject_tick(symbol_index, bid, ask, server_timestamp);
+            };
+            tick_source->on_event = [&](const json &j, const bool is_connection_error) {
+                source_event(j, is_connection_error);
+            };
+
+            /* запустим источник тиков в отдельном потоке */
+            client_future = std::async(std::launch::async,[&]() {
                 while(true) {
                     try {
-                        io_service = std::make_shared<SimpleWeb::io_context>();
-                        /* создадим соединения для каждой валютной пары */
-                        for(size_t s = 0; s < intrade_bar_common::CURRENCY_PAIRS; ++s) {
-                            clients[s] = std::make_shared<WssClient>(
-                                    ws_point,
-                                    true,
-                                    std::string(),
-                                    std::string(),
-                                    std::string(sert_file));
-
-                            /* читаем собщения, которые пришли */
-                            clients[s]->on_message =
-                                    [&,s](std::shared_ptr<WssClient::Connection> connection,
-                                    std::shared_ptr<WssClient::InMessage> message) {
-#                               if(0)
-                                std::cout
-                                    << "intrade-bar wss message->string: "
-                                    << message->string()
-                                    << std::endl;
-#                               endif
-                                parser(message->string());
-                            };
-
-                            clients[s]->on_open =
-                                [&,s](std::shared_ptr<WssClient::Connection> connection) {
-                                std::string init_message(intrade_bar_common::extended_name_currency_pairs[s]);
-                                connection->send(init_message);
-#                               if(0)
-                                std::cout
-                                    << "init_message: "
-                                    << init_message
-                                    << std::endl;
-#                               endif
-                                try {
-                                    json j;
-                                    j["function"] = "QuotationsStream";
-                                    j["action"] = "open_connection";
-                                    intrade_bar::Logger::log(file_name_websocket_log, j);
-                                    std::lock_guard<std::recursive_mutex> lock(error_message_mutex);
-                                    error_message = j.dump();
-                                }
-                                catch(...) {}
-                            };
-
-                            clients[s]->on_close =
-                                    [&](std::shared_ptr<WssClient::Connection> /*connection*/,
-                                    int status, const std::string & /*reason*/) {
-                                std::cerr << "intrade.bar wss: "
-                                    "closed connection with status code " << status
-                                    << std::endl;
-                                is_error = true;
-                                if(io_service) io_service->stop();
-                                is_websocket_init = false;
-                                try {
-                                    json j;
-                                    j["function"] = "QuotationsStream";
-                                    j["action"] = "close_connection";
-                                    j["status_code"] = status;
-                                    intrade_bar::Logger::log(file_name_websocket_log, j);
-                                    std::lock_guard<std::recursive_mutex> lock(error_message_mutex);
-                                    error_message = j.dump();
-                                }
-                                catch(...) {}
-                            };
-
-                            // See http://www.boost.org/doc/libs/1_55_0/doc/html/boost_asio/reference.html, Error Codes for error code meanings
-                            clients[s]->on_error =
-                                    [&](std::shared_ptr<WssClient::Connection> /*connection*/,
-                                    const SimpleWeb::error_code &ec) {
-                                is_error = true;
-                                if(io_service) io_service->stop();
-                                is_websocket_init = false;
-                                std::cout
-                                    << "intrade.bar (symbol index: " << s << ") wss error: " << ec
-                                    << std::endl;
-                                try {
-                                    json j;
-                                    std::ostringstream os;
-                                    os << ec;
-                                    j["function"] = "QuotationsStream";
-                                    j["error"] = "wss";
-                                    j["error_code"] = os.str();
-                                    intrade_bar::Logger::log(file_name_websocket_log, j);
-                                    std::lock_guard<std::recursive_mutex> lock(error_message_mutex);
-                                    error_message = j.dump();
-                                }
-                                catch(...) {}
-                            };
-                            clients[s]->io_service = io_service;
-                            clients[s]->start();
-                        } // for s
-
-                        std::cout << "wss intrade.bar connection" << std::endl;
-                        if(io_service) io_service->run();
-                        is_websocket_init = false;
-
-                        for(size_t s = 0; s < intrade_bar_common::CURRENCY_PAIRS; ++s) {
-                            clients[s].reset();
+                        tick_source->run();
+                        /* после завершения файла записи или генератора данные остаются доступны */
+                        if(tick_source->is_restartable()) {
+                            is_websocket_init = false;
+                            std::cout << "restart wss intrade.bar connection" << std::endl;
                         }
-                        std::cout << "restart wss intrade.bar connection" << std::endl;
                     } catch (std::exception& e) {
                         is_websocket_init = false;
                         try {
@@ -469,6 +471,8 @@ namespace intrade_bar {
                         catch(...) {}
                         break;
                     }
+                    /* файл записи и генератор не перезапускаются */
+                    if(!tick_source->is_restartable()) break;
 					const uint64_t RECONNECT_DELAY = 5000;
 					std::this_thread::sleep_for(std::chrono::milliseconds(RECONNECT_DELAY));
                 } // while
@@ -477,19 +481,7 @@ namespace intrade_bar {
 
         ~QuotationsStream() {
             is_close_connection = true;
-            for(size_t s = 0; s < intrade_bar_common::CURRENCY_PAIRS; ++s) {
-                std::shared_ptr<WssClient> client_ptr = std::atomic_load(&clients[s]);
-                if(client_ptr) {
-                    client_ptr->stop();
-                }
-            }
-            io_service->stop();
-            while(is_websocket_init) {
-                const uint64_t RECONNECT_DELAY = 1000;
-                std::this_thread::sleep_for(std::chrono::milliseconds(RECONNECT_DELAY));
-            }
-            io_service.reset();
-
+            tick_source->stop();
             if(client_future.valid()) {
                 try {
                     client_future.wait();
@@ -502,8 +494,29 @@ namespace intrade_bar {
                     std::cerr << "Error: ~QuotationsStream()" << std::endl;
                 }
             }
+            is_websocket_init = false;
         };
 
+        /** \brief Передать тик напрямую, минуя парсер
+         *
+         * Тик проходит тот же путь, что и тики от вебсокета: часы сервера, цена, бары.
+         * Метод можно использовать для тестов и замеров скорости построения баров без сети
+         * \param symbol_index Индекс символа
+         * \param bid Цена bid
+         * \param ask Цена ask
+         * \param server_timestamp Метка времени сервера
+         * \return Код ошибки, вернет 0 если все в порядке
+         */
+        inline int inject_tick(
+                const size_t symbol_index,
+                const double bid,
+                const double ask,
+                const xtime::ftimestamp_t server_timestamp) {
+            if(symbol_index >= CURRENCY_PAIRS) return intrade_bar_common::INVALID_ARGUMENT;
+            process_tick(symbol_index, bid, ask, server_timestamp);
+            return intrade_bar_common::OK;
+        }
+
         /** \brief Включить автообновление смещения метки времени логера
          */
         void enable_autoupdate_logger_offset_timestamp() {
@@ -548,11 +561,13 @@ namespace intrade_bar {
 
         /** \brief Получить последнюю метку времени сервера
          *
-         * Данный метод возвращает последнюю полученную метку времени сервера. Часовая зона: UTC/GMT
+         * Данный метод возвращает последнюю полученную метку времени сервера. Часовая зона: UTC/GMT.
+         * Метка берется из last_tick_time, который меняется только через CAS на большее значение,
+         * поэтому при нескольких потоках обработки метка не уменьшается
          * \return Метка времени сервера
          */
         inline xtime::ftimestamp_t get_last_server_timestamp() {
-            return last_server_timestamp;
+            return last_tick_time;
         }
 
         /** \brief Получить смещение метки времени ПК
@@ -571,10 +586,106 @@ namespace intrade_bar {
             if(symbol_index >= CURRENCY_PAIRS ||
                 !is_websocket_init ||
                 !is_currency_pair_init[symbol_index]) return 0.0;
-            std::lock_guard<std::recursive_mutex> lock(price_mutex);
+            std::lock_guard<std::recursive_mutex> lock(price_mutex[symbol_index]);
             return array_tick_price[symbol_index].first;
         }
 
+        /** \brief Получить метку времени последнего тика символа
+         *
+         * \param symbol_index Индекс символа
+         * \return Метка времени сервера последнего тика или 0, если тиков не было
+         */
+        inline xtime::ftimestamp_t get_last_tick_timestamp(const size_t symbol_index) {
+            if(symbol_index >= CURRENCY_PAIRS ||
+                !is_currency_pair_init[symbol_index]) return 0;
+            std::lock_guard<std::recursive_mutex> lock(price_mutex[symbol_index]);
+            return array_tick_price[symbol_index].second;
+        }
+
+        /** \brief Получить время без тиков символа
+         *
+         * \param symbol_index Индекс символа
+         * \return Время в секундах с момента получения последнего тика. Если тиков не было, вернет -1
+         */
+        inline double get_tick_staleness(const size_t symbol_index) {
+            if(symbol_index >= CURRENCY_PAIRS) return -1;
+            const double arrival = array_tick_arrival[symbol_index];
+            if(arrival == 0) return -1;
+            return xtime::get_ftimestamp() - arrival;
+        }
+
+        /** \brief Восстановить бар
+         *
+         * Бар из price_now заполняет только пропуск в данных.
+         * Бар из исторических данных заменяет пропуск или бар, восстановленный по price_now.
+         * Бары, построенные по потоку котировок, не изменяются
+         * \param symbol_index Индекс символа
+         * \param candle Бар
+         * \param source Источник бара
+         * \return Код ошибки, вернет 0 если бар был записан
+         */
+        int repair_candle(
+                const size_t symbol_index,
+                const xquotes_common::Candle &candle,
+                const CandleSource source) {
+            if(symbol_index >= CURRENCY_PAIRS ||
+                candle.close == 0 ||
+                source == SOURCE_STREAM) return intrade_bar_common::INVALID_ARGUMENT;
+            const xtime::timestamp_t timestamp = xtime::get_first_timestamp_minute(candle.timestamp);
+            std::lock_guard<std::recursive_mutex> lock(candles_mutex[symbol_index]);
+            std::vector<xquotes_common::Candle> &candles = array_candles[symbol_index];
+            CompressedCandleHistory &history = array_compressed_candles[symbol_index];
+            if(!history.empty() && timestamp <= history.get_last_timestamp()) {
+                xquotes_common::Candle old_candle;
+                if(history.get_timestamp_candle(timestamp, old_candle) && old_candle.close != 0) {
+                    auto it_source = array_repaired_candles[symbol_index].find(timestamp);
+                    if(it_source == array_repaired_candles[symbol_index].end() ||
+                        it_source->second >= source) return intrade_bar_common::DATA_NOT_AVAILABLE;
+                }
+                xquotes_common::Candle new_candle = candle;
+                new_candle.timestamp = timestamp;
+                history.update(new_candle);
+                array_repaired_candles[symbol_index][timestamp] = source;
+                return intrade_bar_common::OK;
+            }
+            auto it = std::lower_bound(candles.begin(), candles.end(), timestamp,
+                [](const xquotes_common::Candle &c, const xtime::timestamp_t t) {
+                return c.timestamp < t;
+            });
+            if(it != candles.end() && it->timestamp == timestamp) {
+                if(it->close != 0) {
+                    auto it_source = array_repaired_candles[symbol_index].find(timestamp);
+                    /* бар потока котировок или уже восстановленный по истории не трогаем */
+                    if(it_source == array_repaired_candles[symbol_index].end() ||
+                        it_source->second >= source) return intrade_bar_common::DATA_NOT_AVAILABLE;
+                }
+                *it = candle;
+                it->timestamp = timestamp;
+            } else {
+                it = candles.insert(it, candle);
+                it->timestamp = timestamp;
+            }
+            array_repaired_candles[symbol_index][timestamp] = source;
+            compress_candles(symbol_index);
+            return intrade_bar_common::OK;
+        }
+
+        /** \brief Получить источник бара
+         * \param symbol_index Индекс символа
+         * \param timestamp Метка времени бара
+         * \return Источник бара
+         */
+        inline CandleSource get_candle_source(
+                const size_t symbol_index,
+                const xtime::timestamp_t timestamp) {
+            if(symbol_index >= CURRENCY_PAIRS) return SOURCE_STREAM;
+            std::lock_guard<std::recursive_mutex> lock(candles_mutex[symbol_index]);
+            auto it = array_repaired_candles[symbol_index].find(
+                xtime::get_first_timestamp_minute(timestamp));
+            if(it == array_repaired_candles[symbol_index].end()) return SOURCE_STREAM;
+            return it->second;
+        }
+
         /** \brief Получить бар
          *
          * \param symbol_index Индекс символа
@@ -586,11 +697,14 @@ namespace intrade_bar {
             if(symbol_index >= CURRENCY_PAIRS ||
                 !is_websocket_init ||
                 !is_currency_pair_init[symbol_index]) return xquotes_common::Candle();
-            std::lock_guard<std::recursive_mutex> lock(candles_mutex);
+            std::lock_guard<std::recursive_mutex> lock(candles_mutex[symbol_index]);
             const size_t array_candles_size =
                 array_candles[symbol_index].size();
-            if(offset >= array_candles_size)
+            if(offset >= array_candles_size) {
+                xquotes_common::Candle candle;
+                if(array_compressed_candles[symbol_index].get_candle(offset - array_candles_size, candle)) return candle;
                 return xquotes_common::Candle();
+            }
             return array_candles[symbol_index][array_candles_size - offset - 1];
         }
 
@@ -601,8 +715,8 @@ namespace intrade_bar {
             if(symbol_index >= CURRENCY_PAIRS ||
                 !is_websocket_init ||
                 !is_currency_pair_init[symbol_index]) return 0;
-            std::lock_guard<std::recursive_mutex> lock(candles_mutex);
-            return array_candles[symbol_index].size();
+            std::lock_guard<std::recursive_mutex> lock(candles_mutex[symbol_index]);
+            return array_candles[symbol_index].size() + array_compressed_candles[symbol_index].size();
         }
 
         /** \brief Получить бар по метке времени
@@ -618,7 +732,7 @@ namespace intrade_bar {
                 !is_currency_pair_init[symbol_index]) return xquotes_common::Candle();
             const xtime::timestamp_t first_timestamp =
                 xtime::get_first_timestamp_minute(timestamp);
-            std::lock_guard<std::recursive_mutex> lock(candles_mutex);
+            std::lock_guard<std::recursive_mutex> lock(candles_mutex[symbol_index]);
             const size_t array_candles_size = array_candles[symbol_index].size();
             if(array_candles_size == 0) return xquotes_common::Candle();
 
@@ -637,6 +751,13 @@ namespace intrade_bar {
                 return xquotes_common::Candle();
             }
 
+            /* старые бары ищем в сжатой истории */
+            if(first_timestamp < array_candles[symbol_index].front().timestamp) {
+                xquotes_common::Candle candle;
+                if(array_compressed_candles[symbol_index].get_timestamp_candle(first_timestamp, candle)) return candle;
+                return xquotes_common::Candle();
+            }
+
             size_t index = array_candles_size - 1;
             while(true) {
                 if(array_candles[symbol_index][index].timestamp == first_timestamp) {
@@ -664,9 +785,22 @@ namespace intrade_bar {
             const xtime::timestamp_t stop_date = candles.back().timestamp;
             if(start_date > stop_date) return intrade_bar_common::INVALID_ARGUMENT;
             /* необходимо взять массив баров и дополнить его новыми данными */
-            std::lock_guard<std::recursive_mutex> lock(candles_mutex);
+            std::lock_guard<std::recursive_mutex> lock(candles_mutex[symbol_index]);
+            CompressedCandleHistory &history = array_compressed_candles[symbol_index];
+            if(!history.empty() && start_date <= history.get_last_timestamp()) {
+                /* бары, попадающие в сжатую историю, объединяем с ее блоками, остальные объединяем с массивом */
+                const size_t index = (size_t)(std::upper_bound(candles.begin(), candles.end(), history.get_last_timestamp(),
+                    [](const xtime::timestamp_t t, const xquotes_common::Candle &c) {
+                    return t < c.timestamp;
+                }) - candles.begin());
+                history.merge(candles.data(), index);
+                if(index == candles.size()) return intrade_bar_common::OK;
+                std::vector<xquotes_common::Candle> new_candles(candles.begin() + index, candles.end());
+                return init_array_candles(symbol_index, new_candles);
+            }
             if(array_candles[symbol_index].size() == 0) {
                 array_candles[symbol_index] = candles;
+                compress_candles(symbol_index);
                 return intrade_bar_common::OK;
             }
             const xtime::timestamp_t data_start_date = array_candles[symbol_index].front().timestamp;
@@ -688,6 +822,7 @@ namespace intrade_bar {
             }
 
             array_candles[symbol_index] = new_array_candles;
+            compress_candles(symbol_index);
             return intrade_bar_common::OK;
         }
 
@@ -722,6 +857,7 @@ namespace intrade_bar {
             is_error = false;
             std::lock_guard<std::recursive_mutex> lock(error_message_mutex);
             error_message.clear();
+            is_parser_error_message = false;
         }
 
         /** \brief Проверить инициализацию символа
@@ -737,8 +873,25 @@ namespace intrade_bar {
          */
         std::string get_error_message() {
             std::lock_guard<std::recursive_mutex> lock(error_message_mutex);
-            if(is_error) return error_message;
-            return std::string();
+            if(!is_error) return std::string();
+            if(is_parser_error_message) {
+                try {
+                    std::string utf8line(parser_error_response.data(), parser_error_response_size);
+                    fix_utf8_string(utf8line);
+                    json j;
+                    j["function"] = "QuotationsStream::parser(const std::string &response)";
+                    j["error"] = parser_error_name;
+                    if(parser_error_name != "unknown_parser_error") {
+                        j["what"] = parser_error_what;
+                        j["exception_id"] = parser_error_exception_id;
+                    }
+                    j["response"] = utf8line;
+                    error_message = j.dump();
+                }
+                catch(...) {}
+                is_parser_error_message = false;
+            }
+            return error_message;
         }
 
         /** \brief Установаить опцию по настройке цене открытия
@@ -752,6 +905,90 @@ namespace intrade_bar {
             is_open_equal_close = is_enable;
         }
 
+        /** \brief Установить опцию свертки тиков
+         *
+         * Если опция установлена, последнее состояние каждого символа и экстремумы цены
+         * накапливаются до чтения методом pull_ticks()
+         * \param is_enable Если указать true, свертка тиков будет включена
+         */
+        inline void set_option_conflation(const bool is_enable) {
+            is_conflation = is_enable;
+        }
+
+        /** \brief Установить опцию сжатой истории баров
+         *
+         * Если опция установлена, в массиве баров остаются только последние hot_bars баров,
+         * более старые бары переносятся блоками в сжатую историю (целые тики, разности и упаковка битов).
+         * Методы get_candle(), get_timestamp_candle() и get_num_candles() видят всю историю.
+         * Опция позволяет держать в памяти месяцы минутных баров по всем символам
+         * \param hot_bars Количество несжатых последних баров, 0 - сжатие отключено
+         * \param max_bars Максимальное количество баров в сжатой истории, 0 - без ограничения
+         */
+        void set_option_compressed_history(const uint32_t hot_bars, const size_t max_bars = 0) {
+            compressed_hot_bars = hot_bars;
+            for(size_t i = 0; i < CURRENCY_PAIRS; ++i) {
+                std::lock_guard<std::recursive_mutex> lock(candles_mutex[i]);
+                array_compressed_candles[i].set_max_bars(max_bars);
+                compress_candles(i);
+            }
+        }
+
+        /** \brief Получить бары символа в диапазоне меток времени
+         *
+         * Бары сжатой истории распаковываются блоками сразу в массив вызывающей стороны
+         * \param symbol_index Индекс символа
+         * \param start Начальная метка времени
+         * \param stop Конечная метка времени (включительно)
+         * \param candles Массив, в конец которого будут добавлены бары
+         * \return Количество добавленных баров
+         */
+        size_t get_candles(
+                const size_t symbol_index,
+                const xtime::timestamp_t start,
+                const xtime::timestamp_t stop,
+                std::vector<xquotes_common::Candle> &candles) {
+            if(symbol_index >= CURRENCY_PAIRS) return 0;
+            std::lock_guard<std::recursive_mutex> lock(candles_mutex[symbol_index]);
+            const size_t old_size = candles.size();
+            array_compressed_candles[symbol_index].get_candles(start, stop, candles);
+            const std::vector<xquotes_common::Candle> &hot = array_candles[symbol_index];
+            auto first = std::lower_bound(hot.begin(), hot.end(), start,
+                [](const xquotes_common::Candle &c, const xtime::timestamp_t t) {
+                return c.timestamp < t;
+            });
+            for(; first != hot.end() && first->timestamp <= stop; ++first) {
+                candles.push_back(*first);
+            }
+            return candles.size() - old_size;
+        }
+
+        /** \brief Получить объем памяти сжатой истории символа
+         * \param symbol_index Индекс символа
+         * \return Объем памяти в байтах
+         */
+        size_t get_compressed_history_memory(const size_t symbol_index) {
+            if(symbol_index >= CURRENCY_PAIRS) return 0;
+            std::lock_guard<std::recursive_mutex> lock(candles_mutex[symbol_index]);
+            return array_compressed_candles[symbol_index].get_memory_usage();
+        }
+
+        /** \brief Забрать свернутые тики всех символов
+         * \param ticks Массив снимков символов, у которых были тики с прошлого чтения
+         * \return вернет true, если есть хотя бы один снимок
+         */
+        inline bool pull_ticks(std::vector<ConflatedTick> &ticks) {
+            return conflator.pull(ticks);
+        }
+
+        /** \brief Забрать свернутый тик символа
+         * \param symbol_index Индекс символа
+         * \param tick Снимок символа
+         * \return вернет true, если с прошлого чтения были тики
+         */
+        inline bool pull_tick(const size_t symbol_index, ConflatedTick &tick) {
+            return conflator.pull(symbol_index, tick);
+        }
+
     };
 
     /** \brief Класс потока котировок
@@ -780,6 +1017,9 @@ namespace intrade_bar {
         std::atomic<bool> is_stream_init;       /**< Состояние потока котировок */
         std::atomic<bool> is_error;             /**< Ошибка соединения */
         std::atomic<bool> is_shutdown;          /**< Флаг для закрытия соединения */
+        std::atomic<bool> is_conflation;        /**< Если флаг установлен, тики сворачиваются вместо вызова on_tick */
+        std::atomic<uint32_t> stream_symbol_index;
+        TickConflator conflator;                /**< Свертка тиков */
 
         const uint32_t array_offset_timestamp_size = 256;
         std::array<xtime::ftimestamp_t, 256> array_offset_timestamp;    /**< Массив смещения метки времени */
@@ -857,15 +1097,13 @@ namespace intrade_bar {
                 tick.bid = j["bid"];
                 tick.ask = j["ask"];
                 tick.precision = precision_currency_pairs[symbol_index];
-                const double price = (tick.bid + tick.ask) / 2.0d;
-
-                /* округляем цену */
-                tick.price = (double)((double)((uint64_t)((price *
-                    (double)pricescale_currency_pairs[symbol_index])
-                    + 0.5d)) /
-                    (double)pricescale_currency_pairs[symbol_index]);
-
+                tick.fixed_price = Price::from_bid_ask(tick.bid, tick.ask, pricescale_currency_pairs[symbol_index]);
+                tick.price = tick.fixed_price.to_double();
 
+                if(is_conflation) {
+                    conflator.update(symbol_index, tick.bid, tick.ask, tick.price, tick.timestamp);
+                    return;
+                }
                 if(on_tick != nullptr && is_client_thread) on_tick(tick);
             }
             catch(const json::parse_error& e) {
@@ -902,6 +1140,8 @@ namespace intrade_bar {
             is_stream_init = false;
             is_shutdown = false;
             is_error = false;
+            is_conflation = false;
+            stream_symbol_index = 0;
         };
 
         bool start(const std::string &symbol_name) {
@@ -910,6 +1150,7 @@ namespace intrade_bar {
             auto it_symbol = currency_pairs_indx.find(symbol_name);
             if(it_symbol == currency_pairs_indx.end()) return false;
             const size_t symbol_index = it_symbol->second;
+            stream_symbol_index = symbol_index;
 
             const std::string ws_point(point + "/fxconnect");
             const std::string ws_sert_file(sert_file);
@@ -1176,6 +1417,24 @@ namespace intrade_bar {
         inline void clear_error() {
             is_error = false;
         }
+
+        /** \brief Установить опцию свертки тиков
+         *
+         * Если опция установлена, on_tick не вызывается, тики сворачиваются
+         * и забираются методом pull_tick()
+         * \param is_enable Если указать true, свертка тиков будет включена
+         */
+        inline void set_option_conflation(const bool is_enable) {
+            is_conflation = is_enable;
+        }
+
+        /** \brief Забрать свернутый тик
+         * \param tick Снимок символа. Поле count равно числу свернутых тиков
+         * \return вернет true, если с прошлого чтения были тики
+         */
+        inline bool pull_tick(ConflatedTick &tick) {
+            return conflator.pull(stream_symbol_index, tick);
+        }
     };
 }
 
@@ -173,12 +173,7 @@ namespace intrade_bar {
                         /* читаем значение цены */
                         const double bid = j["Rates"][0];
                         const double ask = j["Rates"][1];
-                        double price = (bid +  ask) / 2;
-                        /* округляем цену */
-                        price = (double)(((uint64_t)((price *
-                            (double)pricescale_currency_pairs[it->second])
-                            + 0.5)) /
-                            (double)pricescale_currency_pairs[it->second]);
+                        const double price = Price::from_bid_ask(bid, ask, pricescale_currency_pairs[it->second]).to_double();
                         /* обновляем данные */
                         update_candles(it->second, price, tick_time);
                         std::lock_guard<std::mutex> lock(price_mutex);